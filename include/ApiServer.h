@@ -6,5 +6,6 @@
 
 namespace ApiServer {
   void init(AsyncWebServer& server);
-  void registerRoutes(StripState& dimState, StripState& ws1State, StripState& ws2State, Adafruit_NeoPixel& strip1, Adafruit_NeoPixel& strip2);
+  // Routes read and write strip state through StripStore.
+  void registerRoutes();
 }
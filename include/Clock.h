@@ -0,0 +1,44 @@
+#pragma once
+#include <Arduino.h>
+
+// Time base for everything that follows the lamp's clock: animations,
+// sequence steps and fades, the scheduler and TimeService. Monotonic time is
+// 64-bit, so it does not wrap like millis() after 49 days; wall time is epoch
+// seconds (UTC). Both follow the hardware (esp_timer, SNTP system time) until
+// simulate() makes them run up to MAX_SPEED times faster from a chosen wall
+// time, so a day of schedule, a DST change or a 32-bit wrap can be watched on
+// the lamp in minutes. Frame pacing, timeouts and diagnostics stay on real
+// time (millis()). Safe from any task.
+namespace Clock {
+
+  static const uint32_t MAX_SPEED = 3600; // one hour per second
+
+  // Monotonic clock time since boot.
+  int64_t us();
+  uint64_t ms();
+  // Monotonic clock time (ms) at hardware time `realUs` (esp_timer_get_time()).
+  uint64_t msAt(int64_t realUs);
+
+  // Wall clock, epoch seconds (UTC): system time unless simulating.
+  time_t now();
+
+  // Real time until `clockUs` of clock time have passed (rounded up), for
+  // sleeping and hardware timers.
+  uint64_t realUs(uint64_t clockUs);
+  unsigned long realMs(uint64_t clockMs);
+
+  // Run simulated time: the wall clock restarts at `epoch` (0 keeps the
+  // current time) and both clocks advance `speed` (1..MAX_SPEED) times
+  // faster. `wrapInMs` > 0 also moves monotonic time forward so that its low
+  // 32 bits wrap after that many milliseconds (running animations end).
+  // Returns false for a bad speed or when no wall time is known and `epoch` is 0.
+  bool simulate(time_t epoch, uint32_t speed, uint32_t wrapInMs = 0);
+  // Back to hardware time; monotonic time continues from where it is.
+  void realTime();
+  bool simulated();
+  uint32_t speed();
+
+  // {"simulated":true,"speed":60,"now":1774746000,"iso":"2026-03-29T01:00:00Z","ms":123456}
+  String json();
+
+} // namespace Clock
@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// Color temperature. A blackbody table (1000..12000 K in 100 K steps,
+// generated by tools/blackbody.py) maps Kelvin to packed 0x00RRGGBB colors in
+// linear light, brightest channel 255; in between, neighbouring entries are
+// lerped, so a conversion in the render loop is one lookup and one lerp.
+// Each addressable strip has a calibration (gain per channel, 255 = 1.0) so
+// strips with different LED bins show the same white; it is kept in NVS.
+namespace ColorTemp {
+
+  static const uint16_t MIN_K = 1000;
+  static const uint16_t MAX_K = 12000;
+  static const uint16_t STEP_K = 100;
+
+  // Load the calibration. Call once from setup().
+  void begin();
+
+  // Uncalibrated blackbody color at `kelvin` (clamped to MIN_K..MAX_K).
+  uint32_t color(uint16_t kelvin);
+
+  // Color for strip 1 or 2 (calibrated) at `kelvin`, scaled by `intensity`
+  // (0..255, Adafruit brightness semantics).
+  uint32_t color(uint16_t kelvin, uint8_t intensity, int stripIndex);
+
+  // Any color through the calibration of strip 1 or 2, scaled by `intensity`.
+  uint32_t calibrate(uint32_t color, uint8_t intensity, int stripIndex);
+
+  // Temperature a fraction `t` (0..256) of the way from `fromK` to `toK`,
+  // interpolated in mired (1e6 / K), where equal steps look equally large.
+  uint16_t mix(uint16_t fromK, uint16_t toK, uint16_t t);
+
+  // Channel gains of strip 1 or 2, packed 0x00RRGGBB. Safe from any task;
+  // set() persists them.
+  uint32_t calibration(int stripIndex);
+  void setCalibration(int stripIndex, uint8_t r, uint8_t g, uint8_t b);
+
+  // {"ws1":{"r":255,"g":230,"b":210},"ws2":{...}}
+  String calibrationJson();
+
+} // namespace ColorTemp
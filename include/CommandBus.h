@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Arbitration between the sources that control the lamp. Every command that
+// changes the output names its source; a source may act while no source of
+// higher priority holds the output. Manual commands (HTTP API, scene button)
+// always act and take the output for an override period (DEFAULT_HOLD_MIN
+// unless the command says otherwise): what the schedule or another lamp was
+// running stops, and their commands are refused until the override ends.
+// Then the schedule resumes: the last thing it started (or was refused) is
+// picked up where it would be by now, e.g. a sunrise sequence continues at
+// the right point.
+//
+// The hardware itself is only written by LEDController on the render task;
+// sources change StripStore or queue requests for it.
+namespace CommandBus {
+
+  enum class Source : uint8_t { Schedule = 0, Network, Manual }; // rising priority
+
+  static const uint32_t DEFAULT_HOLD_MIN = 120;
+  static const uint32_t MAX_HOLD_MIN = 24 * 60;
+
+  // Manual command: takes the output, holding it for `holdMin` minutes (-1
+  // for the configured default, 0 for no hold). Safe from any task.
+  void manual(long holdMin = -1);
+
+  // Command from another lamp: false while a manual override holds the output.
+  bool network();
+
+  // What a schedule entry starts. Returns false (the caller skips it) while a
+  // manual override holds the output; it is resumed when the override ends.
+  struct ScheduleAction {
+    enum Kind : uint8_t { None = 0, Anim, Sequence, Scene } kind;
+    LEDController::Animation anim; // Anim
+    unsigned long durationMs;      // Anim
+    int slot;                      // Sequence, Scene
+  };
+  bool schedule(const ScheduleAction& action);
+
+  // End the override now and resume the schedule. Safe from any task.
+  void resume();
+
+  // Default hold for manual commands, in minutes (0 = manual commands do not
+  // block the schedule).
+  void setDefaultHold(uint32_t minutes);
+
+  // Render task, before the other modules: stops what a manual command
+  // preempted and resumes the schedule when the override expires.
+  void loop();
+  // Milliseconds (real time) until loop() has work.
+  unsigned long msUntilNext();
+
+  // {"owner":"manual","holdMs":5400000,"defaultHoldMin":120,
+  //  "resume":{"kind":"sequence","slot":0,"ageMs":1234},"refused":{"schedule":1,"network":0}}
+  String json();
+
+} // namespace CommandBus
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+
+// Daily light integral (DLI): how much light the plants got per day, in
+// mol/m² per channel. Each channel has a weight, the PPFD at the plants
+// (µmol/m²/s) with the channel fully on (measure it with a PAR meter); its
+// level is the weight times the output fraction. LEDController reports the
+// output whenever it writes the hardware (a PWM duty, a flushed strip), and
+// the previous level is integrated over the time it was on, so an unchanged
+// output costs nothing per frame. Times are on Clock, so simulated days add up
+// like real ones.
+//
+// Totals are kept per local day: today's partial total is saved every
+// SAVE_MS, finished days go to a ring of DAYS in NVS. With a target set, the
+// output is dimmed to the floor over RAMP_MS once today's total reaches it,
+// until the next day.
+namespace DailyLight {
+
+  enum Channel { Pwm = 0, Red, Green, Blue, ChannelCount };
+
+  static const int DAYS = 14;
+  static const unsigned long SAVE_MS = 10UL * 60UL * 1000UL;
+  static const unsigned long RAMP_MS = 60000;
+
+  // Load weights, the cap and the stored days. Call once from setup() before
+  // LEDController::initPwm.
+  void begin();
+
+  // Hardware output (render task): PWM duty, and the channel sums of strip 1
+  // or 2 over its `pixels` pixels.
+  void setPwm(uint8_t duty);
+  void setStrip(int stripIndex, uint32_t red, uint32_t green, uint32_t blue, uint16_t pixels);
+
+  // Render task: day changes, saving, the cap ramp.
+  void loop();
+  // Milliseconds until loop() has work.
+  unsigned long msUntilNext();
+
+  // Output scale for the cap (255 = not dimmed). Safe from any task.
+  uint8_t outputScale();
+
+  // Weights in µmol/m²/s per channel at full output. Stored in NVS.
+  void setWeight(Channel channel, uint32_t ppfd);
+  // Daily target in mmol/m² (0 = no cap) and the output scale (0..255) once
+  // it is reached. Stored in NVS.
+  void setCap(uint32_t targetMmol, uint8_t floor);
+  uint32_t capTarget();
+  uint8_t capFloor();
+
+  // {"date":20261018,"ppfd":85.2,"today":{"mol":12.345,"pwm":9.1,"red":1.2,"green":1.1,"blue":0.9},
+  //  "weights":{"pwm":100,"red":15,"green":15,"blue":15},
+  //  "cap":{"target":15.000,"floor":0,"capped":false,"scale":255},
+  //  "days":[{"date":20261017,"mol":14.2,"pwm":10.5,"red":1.3,"green":1.2,"blue":1.2}]}
+  // date is YYYYMMDD local (0 before the clock is set); days newest first.
+  String json();
+
+} // namespace DailyLight
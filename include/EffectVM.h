@@ -0,0 +1,102 @@
+#pragma once
+#include <Arduino.h>
+
+// User-programmable per-pixel effects. A program is a short straight-line
+// stack machine routine run once per logical pixel (layout in PixelOutput.h)
+// that leaves one packed 0x00RRGGBB color. Programs are uploaded over HTTP,
+// checked once by verify() and stored on LittleFS as /fx/<name>.fx. There are
+// no jumps, so a verified program costs at most MAX_CODE instructions per
+// pixel and every frame has a fixed upper bound; division by zero gives 0
+// and arithmetic wraps, so no input can fault.
+//
+// Values are int32. Opcodes are one byte; Push8/Push16/Push32/Param carry a
+// 1/2/4/1 byte little-endian immediate (Push8 is unsigned, Push16 signed).
+// Stack effects are listed as (pops -> pushes). tools/fxasm.py assembles the
+// text form (mnemonics are the lower case names below).
+namespace EffectVM {
+
+  enum class Op : uint8_t {
+    Push8 = 0, Push16, Push32, Param,   // (0 -> 1)
+    Idx, Pos, Len, Count, Side, Time,   // (0 -> 1) inputs, see Inputs
+    Dup, Drop, Swap, Over,              // (1 -> 2), (1 -> 0), (2 -> 2), (2 -> 3)
+    Add, Sub, Mul, Div, Mod,            // (2 -> 1)
+    Neg, Abs,                           // (1 -> 1)
+    Min, Max, And, Or, Xor, Shl, Shr,   // (2 -> 1) shifts use b & 31, Shr is arithmetic
+    Lt, Gt, Eq,                         // (2 -> 1) 1 or 0
+    Sel,                                // (c a b -> c ? a : b)
+    Muldiv,                             // (a b c -> a * b / c) 64-bit intermediate
+    Sin8, Tri8, Clamp8,                 // (1 -> 1) sine/triangle over x & 255 -> 0..255; clamp to 0..255
+    Scale8,                             // (a s -> a * (s + 1) / 256)
+    Rgb,                                // (r g b -> color) channels clamped to 0..255
+    Lerpc,                              // (a b t -> color) blend two colors, t 0..256
+    Scalec,                             // (c s -> color) every channel * (s + 1) / 256
+    Addc,                               // (a b -> color) per-channel saturating add
+    Out,                                // (color -> ) last instruction
+    // Appended after Out so stored programs keep their opcodes
+    Noise2,                             // (x y -> n) Noise::noise2, 256 = one cell, n 0..255
+    Noise3,                             // (x y z -> n) Noise::noise3
+    OpCount
+  };
+
+  static const uint16_t MAX_CODE = 128;  // bytes, so at most 128 instructions per pixel
+  static const uint8_t MAX_STACK = 16;
+  static const uint8_t PARAM_COUNT = 4;
+  static const size_t NAME_LEN = 16;     // including terminator
+
+  struct Program {
+    uint8_t code[MAX_CODE];
+    uint16_t length;
+    uint16_t ops;       // instructions per pixel (set by verify)
+    uint8_t maxStack;   // deepest stack use (set by verify)
+  };
+
+  // Per-pixel inputs. Pos/Len are relative to the pixel's own strip, counted
+  // from its first pixel; Side is 0 for the left strip (strip 2), 1 for the
+  // right one. Time is milliseconds since the effect started (wraps after
+  // 24 days).
+  struct Inputs {
+    int32_t idx, pos, len, count, side, time;
+    const int32_t* params; // PARAM_COUNT values
+  };
+
+  // Check `code` once: known opcodes, complete immediates, stack depth within
+  // 0..MAX_STACK at every instruction and exactly one color left for the
+  // final Out. Fills `out` on success; returns nullptr or a short reason.
+  const char* verify(const uint8_t* code, size_t length, Program& out);
+
+  // Run a verified program for one pixel.
+  uint32_t run(const Program& prog, const Inputs& in);
+
+  // Render a whole logical frame: `total` pixels, the first `n2` on the left strip.
+  void render(const Program& prog, uint32_t* frame, uint16_t total, uint16_t n2,
+              uint32_t timeMs, const int32_t* params);
+
+  // Built-in program equivalent to the native Waves effect, used as the
+  // default for benchmarks and as an example.
+  extern const uint8_t WAVES_CODE[];
+  extern const size_t WAVES_LENGTH;
+
+  // Flash storage (/fx/<name>.fx). Names are [A-Za-z0-9_-], up to 15 chars.
+  // store() verifies into `out` before writing; `err` (optional) receives a
+  // short reason.
+  bool store(const char* name, const uint8_t* code, size_t length, Program& out, const char** err = nullptr);
+  bool load(const char* name, Program& out);
+  bool exists(const char* name);
+  bool remove(const char* name);
+
+  // Queue an effect start: the program is loaded and the Program animation
+  // started by loop() on the render task. durationMs 0 runs until stopped.
+  // Safe from any task; returns false if the program does not exist.
+  bool start(const char* name, const int32_t* params, uint8_t brightness, unsigned long durationMs);
+
+  // Apply a pending start. Call from main loop before LEDController::loop().
+  void loop();
+
+  // Used by LEDController while the Program animation runs (render task).
+  void renderActive(uint32_t* frame, uint16_t total, uint16_t n2, uint32_t timeMs);
+  uint8_t activeBrightness();
+
+  // {"running":"name"|null,"programs":[{"name":"ripple","bytes":34},...]}
+  String listJson();
+
+} // namespace EffectVM
@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+
+// In-memory event log. Records are small binary structs (uptime, event id,
+// up to four 32-bit arguments) written into a fixed ring without locks, so
+// logging is cheap from any task or interrupt and never blocks on Serial.
+// Text is produced only when the log is read (/api/log, or the optional
+// Serial drain task). When the ring wraps the oldest records are overwritten
+// and readers are told how many they missed.
+namespace EventLog {
+
+  static const uint32_t CAPACITY = 128; // records, power of two
+  static const int MAX_ARGS = 4;
+
+  // Add new events at the end (the id is part of the record).
+  enum class Event : uint16_t {
+    Boot = 0,
+    FsMountFailed,     //
+    WifiConnected,     // ok, ipv4
+    TimeSynced,        // ok, epoch
+    TimeSyncDeferred,  // ok, epoch
+    HttpStarted,       //
+    OtaStart,          //
+    OtaProgress,       // percent
+    OtaEnd,            // bytes, ms, bytes/s
+    OtaError,          // ota_error_t
+    HeapFragmented,    // largest block, warn threshold, free heap
+    SyncLeader,        // leader id, 1 if this lamp
+    OverrideStart,     // minutes
+    OverrideEnd,       // schedule action resumed (CommandBus::ScheduleAction::Kind)
+    StateRestored,     // what (1 sequence, 2 animation, 0 strips only), seconds in
+    Count
+  };
+
+  struct Record {
+    uint32_t seq;      // position in the log (cursor)
+    uint32_t ms;       // millis() when logged
+    uint16_t event;
+    uint32_t args[MAX_ARGS];
+  };
+
+  // Append a record. Lock-free; safe from any task and from ISRs.
+  void log(Event e, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0);
+
+  // Sequence number the next record will get.
+  uint32_t head();
+
+  // Copy up to `max` records with seq >= cursor into `out`. `next` receives
+  // the cursor for the following call and `dropped` the number of records
+  // that were overwritten before they could be read.
+  size_t read(uint32_t cursor, Record* out, size_t max, uint32_t& next, uint32_t& dropped);
+
+  // Event name ("ota_end") and formatted text of a record.
+  const char* eventName(uint16_t event);
+  String format(const Record& r);
+
+  // {"next":42,"dropped":0,"events":[{"seq":40,"ms":1234,"event":"ota_end","text":"..."},...]}
+  String json(uint32_t cursor, size_t max);
+
+  // Print new records to Serial from a low-priority task, every `periodMs`.
+  void startSerialDrain(unsigned long periodMs = 200);
+
+} // namespace EventLog
@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+// Frame recorder: captures every flushed frame (raw strip pixel buffers as
+// sent on the wire, PWM duty and timestamp) into a compact delta-encoded
+// binary file on LittleFS, and reads/diffs such recordings.
+//
+// File layout (little endian):
+//   header: "ALFR", u8 version, u8 bytesPerPixel, u16 n2, u16 n1, u16 reserved
+//   frame:  u8 flags, varint dtMs, [u8 pwm if FlagPwm],
+//           [varint runCount, runCount x (varint skip, varint len, len bytes) if FlagPixels]
+// Pixel bytes are the left strip (strip2) followed by the right strip (strip1).
+// Runs are relative to the previous frame; the first frame is relative to zeros.
+namespace FrameRecorder {
+
+  static const uint16_t MAX_FRAME_BYTES = 3 * 256;
+
+  // Start recording into `path` (truncated). Returns false if the file cannot
+  // be opened or the layout does not fit MAX_FRAME_BYTES.
+  bool start(const char* path, uint16_t n2, uint16_t n1);
+  // Flush and close the recording. Safe to call when not recording.
+  void stop();
+  bool recording();
+  uint32_t framesRecorded();
+
+  // Append a frame. `pixels` holds n2 + n1 pixels (see layout above).
+  void capture(unsigned long nowMs, uint8_t pwm, const uint8_t* pixels);
+
+  // Sequential decoder for recordings.
+  class Reader {
+  public:
+    bool open(const char* path);
+    void close();
+    // Decode the next frame; false at end of file or on a corrupt record.
+    bool next();
+    const uint8_t* pixels() const { return m_frame; }
+    uint16_t frameBytes() const { return m_bytes; }
+    uint16_t n1() const { return m_n1; }
+    uint16_t n2() const { return m_n2; }
+    uint8_t pwm() const { return m_pwm; }
+    unsigned long timeMs() const { return m_timeMs; }
+  private:
+    bool readVarint(uint32_t& out);
+    File m_file;
+    uint8_t m_frame[MAX_FRAME_BYTES];
+    uint16_t m_bytes = 0;
+    uint16_t m_n1 = 0;
+    uint16_t m_n2 = 0;
+    uint8_t m_pwm = 0;
+    unsigned long m_timeMs = 0;
+  };
+
+  struct DiffReport {
+    uint32_t frames;          // frames compared
+    uint32_t mismatched;      // frames with a channel delta above tolerance
+    int32_t firstMismatch;    // index of first mismatching frame, -1 if none
+    uint8_t maxDelta;         // largest channel delta seen (pixels or PWM)
+    long maxTimeSkewMs;       // largest timestamp difference between paired frames
+    bool layoutMismatch;      // strip sizes differ
+    bool lengthMismatch;      // one recording has more frames than the other
+  };
+
+  // Compare two recordings frame by frame. Returns true when both could be
+  // opened, layouts match, lengths match and no delta exceeds `tolerance`.
+  bool diff(const char* pathA, const char* pathB, uint8_t tolerance, DiffReport& out);
+
+} // namespace FrameRecorder
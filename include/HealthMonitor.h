@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+// Periodic heap and stack health sampling. Samples go into a fixed ring
+// buffer so fragmentation trends stay visible after long uptimes; lifetime
+// minimums are kept separately.
+namespace HealthMonitor {
+
+  // Tasks whose stack high-water marks are sampled (by FreeRTOS task name)
+  static const int TASK_COUNT = 3;
+
+  struct Sample {
+    uint32_t uptimeS;
+    uint32_t freeHeap;       // bytes
+    uint32_t largestBlock;   // largest allocatable block, bytes
+    uint32_t minFreeHeap;    // minimum free heap since boot, bytes
+    uint32_t stackFree[TASK_COUNT]; // stack high-water mark per task, bytes
+  };
+
+  // Sample every `intervalMs`; warn when the largest free block drops below
+  // `largestBlockWarn` bytes. Call from setup() after the tasks exist.
+  void begin(unsigned long intervalMs = 60000UL, uint32_t largestBlockWarn = 8192);
+
+  // Call from main loop; takes a sample when due.
+  void loop();
+
+  // JSON with the current sample, lifetime minimums and the ring (oldest first),
+  // printed piecewise (about 8.5 KB with a full ring) instead of built in RAM.
+  void json(Print& out);
+
+} // namespace HealthMonitor
@@ -0,0 +1,78 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Phase-locked animations across several lamps on one LAN. Lamps talk UDP
+// multicast: each sends a beacon once a second, one lamp is elected leader
+// (lowest id among those heard) and the others poll it
+// NTP-style, keeping the lowest-delay exchanges of the last SAMPLES polls to
+// estimate the offset and drift of its clock against their own. That gives
+// every lamp the same network clock (networkUs()).
+//
+// A shared start carries its start time on the network clock. Each lamp maps
+// it to its own clock and starts the animation there, so all of them
+// compute the same elapsed time for every frame; while it runs the start is
+// re-mapped once a second as the estimate moves. A lamp that takes over as
+// leader keeps its estimate, so the network clock does not jump.
+namespace LampSync {
+
+  static const uint16_t PORT = 4210;      // multicast group 239.255.76.83
+  static const uint8_t SAMPLES = 16;      // clock polls kept (one per second)
+  static const uint8_t MAX_PEERS = 8;
+  static const unsigned long START_LEAD_MS = 300; // shared starts begin this far ahead
+
+  // What the protocol needs from the platform. On the lamp that is esp_timer,
+  // AsyncUDP on the multicast group and WifiMgr (LampSyncUdp.cpp); host tests
+  // bring their own clock and sockets.
+  struct Port {
+    uint32_t id;          // this lamp, nonzero; the lowest id heard leads
+    int64_t (*nowUs)();   // local monotonic clock, the one Clock::msAt() takes
+    bool (*ready)();      // network up
+    bool (*open)();       // start receiving on PORT; packets go to receive()
+    void (*send)(const uint8_t* data, size_t length, uint32_t ip); // ip 0: every lamp
+  };
+
+  // Call once from setup(); the socket is opened once WiFi is connected.
+  void begin();              // the ESP32 port, id from the MAC
+  void begin(const Port& port);
+
+  // A packet from `fromIp`; rxUs is port.nowUs() when it arrived. Any task.
+  void receive(const uint8_t* data, size_t length, uint32_t fromIp, int64_t rxUs);
+
+  // Main loop (render task): beacons, polls, leader election, applying
+  // shared starts when they become due and re-aligning the running one.
+  void loop();
+
+  // Milliseconds until loop() has work (a start becoming due, next beacon).
+  unsigned long msUntilNext();
+
+  // Network clock in microseconds (the local clock until synchronized).
+  int64_t networkUs();
+
+  // True for the leader and for a follower with enough clock samples.
+  bool synced();
+
+  // Start `anim` here and on every lamp of the group START_LEAD_MS from now.
+  // `key` names the start: lamps that announce the same key (a scheduled
+  // event firing on each of them) converge on the announcement of the lowest
+  // id. 0 picks a random key. Without WiFi, or while Clock runs simulated
+  // time, the start is local. Safe from any task.
+  void startShared(LEDController::Animation anim, unsigned long durationMs, uint32_t key = 0);
+  // Stop the animation here and on every lamp of the group. Safe from any task.
+  void stopShared();
+  // Start or stop `anim` on this lamp only; applied by loop() on the render
+  // task like the shared ones, which they replace. Safe from any task.
+  void startLocal(LEDController::Animation anim, unsigned long durationMs);
+  void stopLocal();
+
+  // {"id":"1a2b3c4d","role":"follower","leader":"0a1b2c3d","synced":true,
+  //  "offsetUs":-12345,"driftPpm":3.2,"delayUs":2100,"samples":16,
+  //  "peers":[{"id":"0a1b2c3d","ip":"192.168.1.20","leader":true,"synced":true,"skewUs":850,"ageMs":420}],
+  //  "maxSkewUs":850}
+  // skewUs is the smallest (own network clock at receipt - peer network clock
+  // at send) over the peer's last beacons: the difference between the two
+  // clocks plus the fastest one-way delay. maxSkewUs is the largest magnitude
+  // among synced peers.
+  String statusJson();
+
+} // namespace LampSync
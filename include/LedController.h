@@ -1,6 +1,8 @@
 #pragma once
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
+#include "PixelOutput.h"
+#include "EffectVM.h"
 
 // Shared simple struct for strip state
 struct StripState {
@@ -12,17 +14,157 @@ struct StripState {
 namespace LEDController {
   void initPwm(int pin, int channel, int freq, int res, uint8_t initialDuty);
   void registerStrips(Adafruit_NeoPixel& strip1, Adafruit_NeoPixel& strip2);
-  void setPwmDuty(int channel, uint8_t duty);
-  void setStripSolid(Adafruit_NeoPixel& strip, const StripState& st);
+  // Animation frames go through the generic output writer unless the writer
+  // specialized for the installation is selected (after registerStrips):
+  //   LEDController::useFixedOutput<NEO_GRB, WS2_COUNT, WS1_COUNT>();
+  // Returns false (generic writer stays) if the strips do not match in pixel
+  // count or color order; the order is probed on pixel 0 of each strip.
+  bool setOutputWriter(PixelOutput::Writer writer, neoPixelType order, uint16_t n2, uint16_t n1);
+  template <neoPixelType Order, uint16_t N2, uint16_t N1>
+  bool useFixedOutput()
+  {
+    return setOutputWriter(&PixelOutput::Fixed<Order, N2, N1>::write, Order, N2, N1);
+  }
+
+  // Time `iterations` frame writes through the specialized and the generic
+  // writer into scratch buffers (live output untouched); `match` is true when
+  // both produced the same bytes.
+  struct OutputBench {
+    uint32_t iterations;
+    uint32_t pixels;
+    uint32_t fixedUs;
+    uint32_t genericUs;
+    bool fixedActive;
+    bool match;
+  };
+  OutputBench benchOutput(uint32_t iterations);
+
+  // Time `frames` renders of the native Waves effect and of effect program
+  // `prog` into scratch frames sized for the installation (live output
+  // untouched). Render only; output cost is the same for both.
+  struct EffectBench {
+    uint32_t frames;
+    uint32_t pixels;
+    uint32_t nativeUs;
+    uint32_t programUs;
+  };
+  EffectBench benchEffect(const EffectVM::Program& prog, uint32_t frames);
+
+  // Render time per frame of every noise-based effect (and Waves for
+  // reference) over `frames` consecutive frames into a scratch frame.
+  struct EffectTiming {
+    const char* name;
+    uint32_t avgUs;
+    uint32_t maxUs;
+  };
+  static const int EFFECT_TIMING_COUNT = 4; // waves, caustics, clouds, storm
+  void benchEffects(uint32_t frames, EffectTiming* out);
+
+  // Force a redraw of strip 1 or 2 from its StripStore snapshot on the next loop
+  // (normal state changes are picked up from the StripStore generation).
   void markDirty(int stripIndex);
-  void loop(StripState& ws1State, StripState& ws2State);
+  void loop();
+  // Frame period. loop() renders at most one frame per interval, so bursts of
+  // state changes (slider drags) coalesce into one update per frame.
+  static const unsigned long FRAME_INTERVAL_MS = 16;
+  // Hold the current output (no rendering, no show()) until unfrozen, e.g.
+  // during an OTA upload. Changes made meanwhile are applied afterwards.
+  // Safe from any task.
+  void setOutputFrozen(bool frozen);
+  bool outputFrozen();
+  // Milliseconds until the next frame is due (0 if overdue).
+  unsigned long msUntilNextFrame();
+  // True if a state change is waiting for the next frame.
+  bool hasPendingChanges();
+
+  // Frame timing since the last reset (render + flush time per presented
+  // frame, and frames that started later than 2x FRAME_INTERVAL_MS after the
+  // previous one while animating).
+  struct FrameStats {
+    uint32_t frames;
+    uint32_t renderUsTotal;
+    uint32_t renderUsMax;
+    uint32_t intervalMsMax;
+    uint32_t lateFrames;
+  };
+  FrameStats frameStats();
+  void resetFrameStats();
   
   // Animations for addressable strips (affect both strips together)
-  enum class Animation { None = 0, Sunrise, Sunset, Waves, Police, Christmas };
-  // Start an animation; durationMs is used for sunrise/sunset (default 30000ms)
+  // Playback streams a baked recording (see startPlayback); Program runs the
+  // effect program loaded by EffectVM::start. Caustics, Clouds and Storm are
+  // ambient effects on the Noise kernel (Storm flashes the PWM strip too).
+  // Dawn is a sunrise following the blackbody curve from 1800 K to 6500 K
+  // (see ColorTemp); Sunrise and Sunset also take their colors from it.
+  enum class Animation { None = 0, Sunrise, Sunset, Waves, Police, Christmas, Playback, Program, Caustics, Clouds, Storm, Dawn };
+  // Start an animation; durationMs is used for sunrise/sunset (default 30000ms).
+  // For the looping effects (waves, police, christmas, caustics, clouds,
+  // storm, programs) 0 means until stopped.
   void startAnimation(Animation anim, unsigned long durationMs = 30000);
   void stopAnimation();
   Animation currentAnimation();
+  // Animation time is Clock::ms() truncated to unsigned long (differences
+  // stay correct across the 32-bit wrap).
+  // Start with the animation clock at `startMs` (not in the future), e.g. a start shared with other lamps (LampSync). Render task only.
+  void startAnimationAt(Animation anim, unsigned long durationMs, unsigned long startMs);
+  // Move the running animation's start without resetting it (effects are
+  // functions of the elapsed time, so this shifts its phase). Render task only.
+  void retimeAnimation(unsigned long startMs);
+  unsigned long animationStart();
+  unsigned long animationDuration();
+
+  // Animation names shared by the HTTP API and the scheduler. Query names are
+  // lower case ("sunrise"); display names are capitalized ("Sunrise", "None").
+  // Playback and Program have no query name since they need a file (see
+  // startPlayback, EffectVM::start).
+  bool animationFromName(const char* name, Animation& out);
+  const char* animationName(Animation anim);
+
+  // Deterministically render `anim` with a synthetic clock (one frame every
+  // frameMs, starting at a fixed time) into a FrameRecorder file. Hardware
+  // output is untouched; a running animation is stopped and the static strip
+  // state is redrawn afterwards. Blocks the caller for the duration of the render.
+  bool renderOffline(Animation anim, unsigned long durationMs, unsigned long frameMs, const char* path);
+
+  // Play a baked recording (made with renderOffline) as an animation. Each
+  // frame is decoded from the delta stream and copied into the strip buffers,
+  // so the cost per frame does not depend on the effect that was baked.
+  // Returns false if the file is missing or was baked for other strip sizes.
+  bool startPlayback(const char* path, bool repeat);
+
+  // Recorder control from other tasks (HTTP handlers). The request is carried
+  // out by loop() on the render task. Returns false if one is still pending.
+  struct RecorderRequest {
+    enum Kind { Start, Stop, Render, Play } kind;
+    Animation anim;            // Render only
+    unsigned long durationMs;  // Render only
+    unsigned long frameMs;     // Render only
+    bool repeat;               // Play only
+    char path[32];             // LittleFS file (Start/Render/Play)
+  };
+  bool requestRecorder(const RecorderRequest& req);
+
+  // Static per-pixel images (POST /api/pixels). A strip with an image shows
+  // it instead of its solid color, at the strip's brightness and on/off state,
+  // until clearPixels(). Indices follow the logical frame (PixelOutput.h).
+  // An upload writes a copy of the current image between beginPixels() and
+  // endPixels(), so a frame never shows half of one. One upload at a time:
+  // beginPixels() returns 0 while another runs, otherwise a token for the
+  // calls below. setPixel() goes between lockPixels() and unlockPixels(). An
+  // upload that has not unlocked for PIXELS_STALL_MS is dropped by loop(); its
+  // lockPixels() and endPixels() then return false.
+  static const unsigned long PIXELS_STALL_MS = 2000;
+  uint32_t beginPixels();
+  bool lockPixels(uint32_t token);
+  void setPixel(uint16_t index, uint32_t color);
+  void unlockPixels(uint32_t token);
+  // Publish the upload (apply = false drops it): strips in `stripMask` (bit 0
+  // strip 1, bit 1 strip 2) show the image from now on, strips in
+  // `clearMask` go back to their solid color. Redrawn on the next frame.
+  bool endPixels(uint32_t token, bool apply, uint8_t stripMask, uint8_t clearMask = 0);
+  // Strip 1 or 2 (0 = both) back to its solid color; false while an upload runs.
+  bool clearPixels(int stripIndex);
+  uint16_t stripLength(int stripIndex);
 
   // Readback helpers (report actual hardware state)
   uint8_t getPwmDuty(int channel); // read LEDC duty (0..255)
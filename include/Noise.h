@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+
+// Integer value noise for the ambient effects and effect programs. Lattice
+// values come from a 256-entry permutation table and cells are blended with a
+// smoothstep lookup table, so a sample is a handful of table reads and 8-bit
+// lerps with no floating point. Coordinates are 24.8 fixed point (256 = one
+// lattice cell); the pattern repeats every 256 cells. Results are 0..255.
+namespace Noise {
+
+  uint8_t noise1(uint32_t x);
+  uint8_t noise2(uint32_t x, uint32_t y);
+  uint8_t noise3(uint32_t x, uint32_t y, uint32_t z);
+
+  // Sum of `octaves` noise2 layers, each at twice the frequency and half the
+  // weight of the previous one, normalized to 0..255.
+  uint8_t fractal2(uint32_t x, uint32_t y, uint8_t octaves);
+
+  // Ridge: 255 where n crosses the middle, 0 at the extremes (caustic lines)
+  inline uint8_t ridge(uint8_t n)
+  {
+    int d = 2 * (int)n - 255;
+    return (uint8_t)(255 - (d < 0 ? -d : d));
+  }
+
+  // Time `samples` noise3 calls (microseconds).
+  uint32_t benchUs(uint32_t samples);
+
+} // namespace Noise
@@ -1,9 +1,19 @@
 #pragma once
 #include <Arduino.h>
 
+// ArduinoOTA on its own task. ArduinoOTA.handle() receives a whole upload in
+// one blocking call, so it runs on a separate "ota" task instead of the loop
+// task. While an upload runs, LED output is frozen on the current frame
+// (no show() with interrupts off competing with the TCP stream), WiFi modem
+// sleep is off and progress is reported at most every 10%.
 namespace OTAHandler {
-  // Initialize ArduinoOTA. Return true if initialization attempted; false on fatal error.
+  // Initialize ArduinoOTA and start the OTA task. Return true if initialization attempted; false on fatal error.
   bool begin(const char* hostname);
-  // Call regularly from loop()
-  void handle();
+
+  // True while an upload is in progress (between onStart and onEnd/onError).
+  bool active();
+
+  // {"active":false,"progress":0,"last":{"ok":true,"bytes":1234567,"durationMs":15230,"bytesPerSec":81062,"error":0}}
+  // `last` is the most recent upload, kept in NVS across the reboot that follows it.
+  String statusJson();
 }
@@ -0,0 +1,91 @@
+#pragma once
+#include <Arduino.h>
+
+// Pixel math on packed 32-bit words (0x00RRGGBB, or 0xWWRRGGBB / any four
+// 8-bit lanes) using SIMD-within-a-register arithmetic: the even and odd
+// lanes are processed as two 16-bit-spaced pairs, so one multiply handles two
+// channels and no channel is unpacked. Every kernel has a per-channel scalar
+// reference in namespace Ref; verify() compares the two on the device.
+namespace PixelKernels {
+
+  static const uint32_t LANES_EVEN = 0x00FF00FFu; // lanes 0 and 2
+  static const uint32_t LANES_LOW7 = 0x7F7F7F7Fu;
+  static const uint32_t LANES_MSB = 0x80808080u;
+
+  // Every lane times (s + 1) / 256, i.e. Adafruit_NeoPixel brightness
+  // semantics: 255 leaves the color unchanged, 0 gives black.
+  inline uint32_t scale(uint32_t c, uint8_t s)
+  {
+    uint32_t f = (uint32_t)s + 1;
+    uint32_t even = ((c & LANES_EVEN) * f >> 8) & LANES_EVEN;
+    uint32_t odd = ((c >> 8) & LANES_EVEN) * f & ~LANES_EVEN;
+    return even | odd;
+  }
+
+  // a + (b - a) * t / 256 per lane, t = 0..256 (256 gives b)
+  inline uint32_t lerp(uint32_t a, uint32_t b, uint16_t t)
+  {
+    uint32_t u = 256 - (uint32_t)t;
+    uint32_t even = (((a & LANES_EVEN) * u + (b & LANES_EVEN) * t) >> 8) & LANES_EVEN;
+    uint32_t odd = (((a >> 8) & LANES_EVEN) * u + ((b >> 8) & LANES_EVEN) * t) & ~LANES_EVEN;
+    return even | odd;
+  }
+
+  // Per-lane a + b, clamped to 255
+  inline uint32_t addSat(uint32_t a, uint32_t b)
+  {
+    uint32_t sum = ((a & LANES_LOW7) + (b & LANES_LOW7)) ^ ((a ^ b) & LANES_MSB);
+    // lane carry: floor((a + b) / 2) >= 128
+    uint32_t carry = ((a & b) + (((a ^ b) >> 1) & LANES_LOW7)) & LANES_MSB;
+    return sum | ((carry >> 7) * 0xFF);
+  }
+
+  // Additive blend: a + b scaled by s, clamped
+  inline uint32_t add(uint32_t a, uint32_t b, uint8_t s)
+  {
+    return addSat(a, scale(b, s));
+  }
+
+  // Buffer versions (dst may alias a source)
+  inline void fill(uint32_t* dst, uint16_t n, uint32_t c)
+  {
+    for (uint16_t i = 0; i < n; ++i) dst[i] = c;
+  }
+  inline void scale(uint32_t* dst, const uint32_t* src, uint16_t n, uint8_t s)
+  {
+    for (uint16_t i = 0; i < n; ++i) dst[i] = scale(src[i], s);
+  }
+  inline void lerp(uint32_t* dst, const uint32_t* a, const uint32_t* b, uint16_t n, uint16_t t)
+  {
+    for (uint16_t i = 0; i < n; ++i) dst[i] = lerp(a[i], b[i], t);
+  }
+  inline void add(uint32_t* dst, const uint32_t* src, uint16_t n, uint8_t s)
+  {
+    for (uint16_t i = 0; i < n; ++i) dst[i] = add(dst[i], src[i], s);
+  }
+  inline void addSat(uint32_t* dst, const uint32_t* src, uint16_t n)
+  {
+    for (uint16_t i = 0; i < n; ++i) dst[i] = addSat(dst[i], src[i]);
+  }
+
+  // Scalar references (one channel at a time)
+  namespace Ref {
+    uint32_t scale(uint32_t c, uint8_t s);
+    uint32_t lerp(uint32_t a, uint32_t b, uint16_t t);
+    uint32_t addSat(uint32_t a, uint32_t b);
+    uint32_t add(uint32_t a, uint32_t b, uint8_t s);
+  }
+
+  // Compare every kernel with its reference on `samples` pseudo-random
+  // inputs (plus edge values), and time both over a frame-sized buffer.
+  struct KernelReport {
+    const char* name;
+    uint32_t mismatches;
+    uint32_t swarUs;
+    uint32_t scalarUs;
+  };
+  static const int KERNEL_COUNT = 4; // scale, lerp, addSat, add
+  // Fills `out` (KERNEL_COUNT entries); returns the total mismatch count.
+  uint32_t verify(uint32_t samples, uint32_t benchIterations, KernelReport* out);
+
+} // namespace PixelKernels
@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include "PixelKernels.h"
+
+// Output stage for animation frames. Animations render into one logical
+// frame of packed 0x00RRGGBB words covering both strips: index 0 is the far
+// end of the left strip (strip 2, mounted reversed), the right strip
+// (strip 1) follows in its own order. A Writer scales the frame by a
+// brightness and scatters it into the raw strip buffers.
+//
+// Fixed<Order, N2, N1> is specialized for one installation: the color order
+// and both pixel counts are template arguments and the destination of every
+// logical pixel comes from a constexpr table, so the compiler emits
+// straight-line stores. Generic works for any strips through the
+// Adafruit_NeoPixel API and is used when the registered strips do not match.
+namespace PixelOutput {
+
+  static const uint16_t MAX_PIXELS = 256; // logical frame size (both strips)
+
+  // Writes `frame` scaled by `brightness` into the buffers of the left
+  // (strip 2) and right (strip 1) strip.
+  typedef void (*Writer)(const uint32_t* frame, uint8_t brightness,
+                         Adafruit_NeoPixel& left, Adafruit_NeoPixel& right);
+
+  // Byte offsets of the channels within a pixel for an Adafruit NEO_xxx order
+  // (bits 4-5 red, 2-3 green, 0-1 blue).
+  template <neoPixelType Order>
+  struct ColorOrder {
+    static constexpr uint8_t R = (Order >> 4) & 3;
+    static constexpr uint8_t G = (Order >> 2) & 3;
+    static constexpr uint8_t B = Order & 3;
+    static_assert(((Order >> 6) & 3) == R, "RGBW orders are not supported");
+  };
+
+  // Installation layout: logical pixel i -> byte offset in its strip buffer
+  template <uint16_t N2, uint16_t N1>
+  struct Layout {
+    static constexpr uint16_t COUNT = N2 + N1;
+    static constexpr bool left(uint16_t i) { return i < N2; }
+    static constexpr uint16_t byteOffset(uint16_t i)
+    {
+      return (uint16_t)(3 * (i < N2 ? N2 - 1 - i : i - N2));
+    }
+  };
+
+  // Compile-time index list (C++11 has no std::index_sequence)
+  template <uint16_t... I> struct Seq {};
+  template <uint16_t N, uint16_t... I> struct MakeSeq : MakeSeq<N - 1, N - 1, I...> {};
+  template <uint16_t... I> struct MakeSeq<0, I...> { typedef Seq<I...> type; };
+
+  template <class L, class S> struct OffsetTable;
+  template <class L, uint16_t... I>
+  struct OffsetTable<L, Seq<I...> > {
+    static constexpr uint16_t value[sizeof...(I)] = { L::byteOffset(I)... };
+  };
+  template <class L, uint16_t... I>
+  constexpr uint16_t OffsetTable<L, Seq<I...> >::value[sizeof...(I)];
+
+  template <neoPixelType Order, uint16_t N2, uint16_t N1>
+  struct Fixed {
+    typedef ColorOrder<Order> C;
+    typedef Layout<N2, N1> L;
+    typedef OffsetTable<L, typename MakeSeq<L::COUNT>::type> Offsets;
+    static_assert(L::COUNT <= MAX_PIXELS, "installation larger than the logical frame");
+
+    static void store(uint8_t* dst, uint32_t c, uint8_t brightness)
+    {
+      c = PixelKernels::scale(c, brightness);
+      dst[C::R] = (uint8_t)(c >> 16);
+      dst[C::G] = (uint8_t)(c >> 8);
+      dst[C::B] = (uint8_t)c;
+    }
+
+    static void write(const uint32_t* frame, uint8_t brightness,
+                      Adafruit_NeoPixel& left, Adafruit_NeoPixel& right)
+    {
+      uint8_t* l = left.getPixels();
+      uint8_t* r = right.getPixels();
+      for (uint16_t i = 0; i < N2; ++i) store(l + Offsets::value[i], frame[i], brightness);
+      for (uint16_t i = N2; i < L::COUNT; ++i) store(r + Offsets::value[i], frame[i], brightness);
+    }
+  };
+
+  // Runtime fallback: any counts and color orders, via setPixelColor. The
+  // strips' own brightness must be 255 (unscaled).
+  void writeGeneric(const uint32_t* frame, uint8_t brightness,
+                    Adafruit_NeoPixel& left, Adafruit_NeoPixel& right);
+
+} // namespace PixelOutput
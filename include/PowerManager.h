@@ -0,0 +1,38 @@
+#pragma once
+#include <Arduino.h>
+
+// Idle-aware main loop support. Instead of spinning, loop() blocks on a task
+// notification until its next deadline (next animation frame, next scheduler
+// check) or until another task calls wake() because a command arrived.
+// While nothing animates the CPU runs at a low frequency and, when the SDK
+// has power management enabled, automatic light sleep is allowed, but only
+// while the PWM (LEDC) output is off.
+namespace PowerManager {
+
+  enum State { Active = 0, Idle = 1, StateCount = 2 };
+
+  // Call once from setup(), on the loop task.
+  void begin();
+
+  // Wake the loop task early. Safe to call from any task.
+  void wake();
+  // Same, from an interrupt handler.
+  void wakeFromISR();
+
+  // Block the loop task for up to `timeoutMs` or until wake(). `busy` selects
+  // the power state (Active while an animation renders, otherwise Idle).
+  void sleepUntilNext(unsigned long timeoutMs, bool busy);
+
+  // Whether the PWM output is on (duty > 0); keeps light sleep off while it
+  // is, since LEDC stops with the APB clock. Render task; may be called
+  // before begin().
+  void pwmOutput(bool on);
+
+  State state();
+
+  // JSON object with time spent per state (running and blocked), wake-up count,
+  // current CPU frequency, whether automatic light sleep is available and
+  // whether the PWM output is keeping it off.
+  String statsJson();
+
+} // namespace PowerManager
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Named scene presets ("feeding", "night", ...). A scene captures the dim
+// (PWM) strip, both addressable strips and an optional animation. Scenes live
+// in a fixed-slot table persisted to NVS and are found by slot index or by a
+// hashed name with bounded probing, so recall is constant time.
+namespace Scenes {
+
+  static const int SLOT_COUNT = 8; // power of two (hash & (SLOT_COUNT - 1))
+  static const size_t NAME_LEN = 16; // including terminator
+
+  struct Scene {
+    char name[NAME_LEN];
+    StripState dim;
+    StripState ws1;
+    StripState ws2;
+    LEDController::Animation anim; // None = static colors only
+    unsigned long animDurationMs;
+  };
+
+  // Load the table from flash. Optionally watch a push button (active low) on
+  // `buttonPin` that cycles through the stored scenes; pass -1 for none.
+  void begin(int buttonPin = -1);
+
+  // Apply a pending recall/button press. Call from main loop before
+  // LEDController::loop() so the whole scene lands in one frame.
+  void loop();
+
+  // Capture the current strip state (plus an optional animation) under `name`.
+  // Returns the slot index, or -1 if the name is invalid or the table is full.
+  int save(const char* name, LEDController::Animation anim, unsigned long animDurationMs);
+  bool remove(const char* name);
+
+  // Slot of a stored scene, or -1.
+  int find(const char* name);
+
+  // Queue a recall; it is applied by loop() on the render task. Safe from any
+  // task. Returns false if the slot is empty.
+  bool recall(int slot);
+
+  // JSON array of stored scenes: [{"slot":0,"name":"night","anim":"Waves",...},...]
+  String listJson();
+
+} // namespace Scenes
@@ -1,24 +1,81 @@
 #pragma once
 #include <Arduino.h>
-#include <Adafruit_NeoPixel.h>
-#include "LEDController.h"
-#include "LEDController.h"
 #include "LEDController.h"
 
 // Lightweight flexible scheduler for daily tasks.
+//
+// Entries fire on rules: a fixed time of day, an offset from the computed
+// sunrise/sunset at the configured location, the start/end of a seasonal
+// photoperiod, or every N minutes within a window, each limited to a set of
+// weekdays. Fire times are planned once per (local) day, when the solar times
+// are computed too; loop() only compares the clock with the earliest planned
+// time, so a tick costs the same however many entries exist.
 namespace Scheduler {
 
-  // Initialize scheduler with references to the shared StripState objects and strips
-  void init(StripState& dimState, StripState& ws1State, StripState& ws2State, Adafruit_NeoPixel& strip1, Adafruit_NeoPixel& strip2);
+  enum class Trigger : uint8_t {
+    Time = 0,   // `minute` of day
+    Sunrise,    // sunrise + `minute` (may be negative)
+    Sunset,     // sunset + `minute`
+    PhotoStart, // start of the seasonal photoperiod + `minute`
+    PhotoEnd,   // end of the seasonal photoperiod + `minute`
+    Interval,   // every `intervalMin` from `minute` of day up to `untilMinute`
+  };
+
+  // Weekday mask bits, bit 0 = Sunday (struct tm::tm_wday)
+  static const uint8_t EVERY_DAY = 0x7F;
+  static const uint8_t WEEKDAYS = 0x3E;
+  static const uint8_t WEEKENDS = 0x41;
+
+  struct Rule {
+    Trigger trigger;
+    int minute;        // minute of day (Time/Interval) or offset in minutes
+    uint8_t days;      // weekday mask
+    bool isUtc;        // Time/Interval: minute of day is UTC instead of local
+    int intervalMin;   // Interval only
+    int untilMinute;   // Interval only: last minute of day a firing may happen
+  };
+
+  // Initialize scheduler with the default entries. Call after Sequencer::begin().
+  void init();
+
+  // Location for Sunrise/Sunset rules (degrees, north and east positive).
+  void setLocation(float latDeg, float lonDeg);
+
+  // Seasonal photoperiod for PhotoStart/PhotoEnd rules: day length follows a
+  // cosine between `winterMinutes` (at the winter solstice) and
+  // `summerMinutes`, centered on `centerMinute` local time. The seasons flip
+  // for southern latitudes.
+  void setPhotoperiod(int winterMinutes, int summerMinutes, int centerMinute);
 
   // Call from main loop frequently
   void loop();
 
+  // Milliseconds (real time) until loop() has work to do again (next planned
+  // firing, or the next clock check while time is not synced).
+  unsigned long msUntilNextCheck();
+
+  // Add an entry that starts `anim` when `rule` fires, or instead starts
+  // sequence `sequenceSlot` (see Sequencer) or recalls scene `sceneSlot` when
+  // one is >= 0. Returns false when the table is full.
+  bool addRule(const Rule& rule, LEDController::Animation anim, unsigned long durationMs, int sequenceSlot = -1, int sceneSlot = -1);
+
   // Add a schedule entry programmatically (optional use)
-  void addDailyEntry(int hour, int minute, bool isUtc, LEDController::Animation anim, unsigned long durationMs, int followUpAction /* 0=none,1=waves,2=stopall,3=turnoff */);
+  void addDailyEntry(int hour, int minute, bool isUtc, LEDController::Animation anim, unsigned long durationMs);
+
+  // Daily entry that starts a sequence (e.g. sunrise, then waves)
+  void addSequenceEntry(int hour, int minute, bool isUtc, int sequenceSlot);
+
+  // Daily entry that recalls a stored scene (see Scenes) instead of starting an animation
+  void addSceneEntry(int hour, int minute, bool isUtc, int sceneSlot);
 
   // Return JSON array of scheduled entries. Caller receives a String containing
-  // an array like [{"hour":6,"minute":0,"isUtc":false,"anim":"Sunrise","durationMs":1200000,"followUp":1},...]
+  // an array like [{"hour":6,"minute":0,"isUtc":false,"anim":"Sunrise","durationMs":1200000,"sequence":-1,
+  // "trigger":"time","offsetMin":0,"days":127,"nextFire":1718000000},...]
   String getScheduleJson();
 
+  // JSON object with today's planned solar and photoperiod times (epoch
+  // seconds, 0 when there is none, e.g. polar day/night):
+  // {"lat":52.23,"lon":21.01,"sunrise":...,"sunset":...,"photoStart":...,"photoEnd":...}
+  String sunJson();
+
 } // namespace Scheduler
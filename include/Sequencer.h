@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Named sequences of steps run one after another: start an animation, recall
+// a scene, wait, fade a strip, stop or switch everything off. Each step's end
+// is a one-shot esp_timer, so the next step starts on time instead of at the
+// next poll; the step itself is carried out by loop() on the render task.
+//
+// Text form (used by the API and for the built-in sequences), comma separated:
+//   anim:<name>:<ms>     start animation, next step after <ms> (0 = at once; a
+//                        looping effect then runs until something replaces it)
+//   scene:<name>         recall a stored scene
+//   wait:<ms>
+//   fade:<dim|ws1|ws2|all>:<ms>:<brightness>[:<r>:<g>:<b>]
+//                        fade to the brightness (and color); 0 ends switched off
+//   stop                 stop the running animation
+//   off                  stop the animation and switch all strips off
+// e.g. "anim:sunset:1800000,fade:dim:60000:0,off"
+namespace Sequencer {
+
+  static const int SLOT_COUNT = 4;
+  static const int MAX_STEPS = 12;
+  static const size_t NAME_LEN = 16; // including terminator
+
+  // Create the step timer. Call once from setup() before sequences start.
+  void begin();
+
+  // Carry out due steps and fades. Call from main loop before LEDController::loop().
+  void loop();
+
+  // True while a fade needs a new value every frame.
+  bool fading();
+
+  // Running sequence (render task): copies its name (NAME_LEN bytes) and the
+  // time since it started, a catch-up start included. False when idle.
+  bool running(char* name, uint32_t& elapsedMs);
+
+  // Define (or replace) sequence `name` from its text form. Returns the slot,
+  // or -1 if the text does not parse or the table is full. `err` (optional)
+  // receives a short reason.
+  int define(const char* name, const char* text, const char** err = nullptr);
+  bool remove(const char* name);
+  int find(const char* name);
+
+  // Queue start/stop; applied by loop(). Safe from any task. `elapsedMs`
+  // starts the sequence that far in, as if it had been running: steps that
+  // would be over only leave their end state (a fade's final value, a scene,
+  // off) and the current one continues part way.
+  bool start(int slot, uint32_t elapsedMs = 0);
+  void stop();
+
+  // {"running":true,"name":"evening","step":1,"steps":3,"kind":"wait","remainingMs":1234,
+  //  "sequences":[{"slot":0,"name":"evening","steps":"anim:sunset:3600000,off"},...]}
+  String statusJson();
+
+} // namespace Sequencer
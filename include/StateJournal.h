@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Live state kept across reboots and power cuts: the strips (StripStore), the
+// running animation and the running sequence with their progress. Records go
+// to an append-only LittleFS log (/state.log); a restart reads the newest
+// valid one. Changes are coalesced into one append at most every INTERVAL_MS,
+// and while something timed runs (a sequence, an animation with a duration) a
+// checkpoint is appended every CHECKPOINT_MS, so its progress is known even if
+// the wall time is not after the restart. A full log (MAX_RECORDS) is
+// compacted: the newest record goes to a fresh file that replaces it, so
+// writes move through the filesystem instead of rewriting one block.
+namespace StateJournal {
+
+  static const unsigned long INTERVAL_MS = 10000;
+  static const unsigned long CHECKPOINT_MS = 60000;
+  static const uint16_t MAX_RECORDS = 256;
+
+  // Read the journal (LittleFS mounted). If it holds a record, the three
+  // states are replaced with the journaled ones and true is returned.
+  bool begin(StripState& dim, StripState& ws1, StripState& ws2);
+
+  // Restart the journaled sequence or animation where it would be by now: the
+  // wall time since the record is added when it is known at both ends,
+  // otherwise it continues from the record. Call once from setup() after the
+  // sequences are defined.
+  void restore();
+
+  // Main loop (render task), after LEDController::loop(): appends when due.
+  void loop();
+  // Milliseconds until loop() appends.
+  unsigned long msUntilNext();
+
+  // {"records":12,"bytes":768,"appends":40,"compactions":0,"failures":0,"pending":false,
+  //  "lastAgeMs":1234,"restored":{"kind":"sequence","name":"morning","elapsedMs":1234567}}
+  // kind is strips, sequence or anim; restored is null after a start without a journal.
+  String json();
+
+} // namespace StateJournal
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+// Version of what /api/state reports. It is bumped where that changes: strip
+// writes (StripStore), the strip brightness and PWM duty put on the hardware,
+// animation starts and stops, and schedule changes. Each section keeps the
+// version of its last change, so ?since=<version> can leave out the ones that
+// did not change. Bump after the change is visible. Safe from any task.
+namespace StateVersion {
+
+  // Dim, Ws1 and Ws2 are in StripStore::Target order
+  enum Section { Dim = 0, Ws1, Ws2, Animation, Schedule, SectionCount };
+
+  void bump(Section section);
+
+  // Current version. Versions start at a random value each boot, so one kept
+  // across a reboot does not match.
+  uint32_t current();
+  // First version of this boot
+  uint32_t first();
+  // Version of the section's last change (first() before any)
+  uint32_t changedAt(Section section);
+
+} // namespace StateVersion
@@ -0,0 +1,55 @@
+#pragma once
+#include <Arduino.h>
+#include "LEDController.h"
+
+// Versioned storage for the shared StripState objects (dim PWM strip and both
+// addressable strips). Writers (AsyncTCP handlers, scheduler) are serialized by
+// a short spinlock; readers (render loop, /api/state) use a seqlock and never
+// block, so they always see a consistent snapshot of a target.
+namespace StripStore {
+
+  enum Target { Dim = 0, WS1 = 1, WS2 = 2, TargetCount = 3 };
+
+  // Seed all targets. Generations start at 0.
+  void init(const StripState& dim, const StripState& ws1, const StripState& ws2);
+
+  // Consistent snapshot of a target. `gen` receives the target generation the
+  // snapshot belongs to (increments by one on every write that changes it).
+  StripState read(Target t);
+  StripState read(Target t, uint32_t& gen);
+
+  // Replace a target and bump its generation. Writing the current state is a
+  // no-op (nothing is bumped or counted as superseded).
+  void write(Target t, const StripState& st);
+
+  // Generation of a single target, or the global generation which increments
+  // on any change. Both are monotonic.
+  uint32_t generation(Target t);
+  uint32_t generation();
+
+  // Coalescing: the renderer reports the generation it applied. A write that
+  // lands while the previous one is still unapplied supersedes it; those are
+  // counted per target (the renderer only ever applies the latest value).
+  void markApplied(Target t, uint32_t gen);
+  uint32_t superseded(Target t);
+
+  namespace detail {
+    void lockWriter();
+    void unlockWriter();
+    StripState current(Target t);
+    void commit(Target t, const StripState& st);
+  }
+
+  // Read-modify-write under the writer lock so concurrent updates of different
+  // fields are never lost. Keep `fn` short: it runs inside a critical section.
+  template <typename Fn>
+  void update(Target t, Fn fn)
+  {
+    detail::lockWriter();
+    StripState st = detail::current(t);
+    fn(st);
+    detail::commit(t, st);
+    detail::unlockWriter();
+  }
+
+} // namespace StripStore
@@ -4,6 +4,10 @@
 namespace WifiMgr {
   // Returns true if connected within timeout, false otherwise. Non-fatal failures allowed.
   bool begin(const char* hostname, const char* ssid, const char* password);
+  // True once associated and holding an IP (no allocation; cheap to poll)
+  bool connected();
   // Human-readable IP (may be 0.0.0.0 if not connected)
   String ipString();
+  // IPv4 address as a 32-bit value, first octet in the low byte (0 if not connected)
+  uint32_t ipAddress();
 }
@@ -1,8 +1,27 @@
 #include "ApiServer.h"
 #include <ESPAsyncWebServer.h>
 #include "LEDController.h"
+#include "StripStore.h"
+#include "FrameRecorder.h"
+#include <LittleFS.h>
 #include "TimeService.h"
 #include "Scheduler.h"
+#include "PowerManager.h"
+#include "HealthMonitor.h"
+#include "OTAHandler.h"
+#include "EventLog.h"
+#include "Scenes.h"
+#include "Sequencer.h"
+#include "PixelKernels.h"
+#include "EffectVM.h"
+#include "Noise.h"
+#include "LampSync.h"
+#include "Clock.h"
+#include "ColorTemp.h"
+#include "CommandBus.h"
+#include "StateJournal.h"
+#include "DailyLight.h"
+#include "StateVersion.h"
 
 namespace ApiServer {
 
@@ -69,15 +88,28 @@ static String htmlIndex()
     </div>
   </div>
 
+  <div class="card">
+    <h2>Color Temperature (both WS2812 strips)</h2>
+    <div class="row">
+      <label>Kelvin <input id="kK" type="range" min="1800" max="10000" step="100" value="4000" oninput="setKelvin()"></label>
+      <span id="kV" class="small">4000 K</span>
+      <label>Intensity <input id="kB" type="range" min="0" max="255" value="128" oninput="setKelvin()"></label>
+    </div>
+  </div>
+
   <div class="card">
     <div class="row">
       <button onclick="fetch('/api/onall')">All On</button>
       <button onclick="fetch('/api/offall')">All Off</button>
   <button onclick="startAnim('sunrise')">Sunrise</button>
+  <button onclick="startAnim('dawn')">Dawn</button>
   <button onclick="startAnim('sunset')">Sunset</button>
   <button onclick="startAnim('waves')">Waves</button>
   <button onclick="startAnim('police')">Police</button>
   <button onclick="startAnim('christmas')">Christmas</button>
+  <button onclick="startAnim('caustics')">Caustics</button>
+  <button onclick="startAnim('clouds')">Clouds</button>
+  <button onclick="startAnim('storm')">Storm</button>
   <button onclick="startTest('sunrise')">Test Sunrise (1m)</button>
   <button onclick="startTest('sunset')">Test Sunset (1m)</button>
   <button onclick="fetch('/api/anim/stop')">Stop Anim</button>
@@ -100,19 +132,37 @@ function hexToRgb(hex) {
 function rgbToHex(r, g, b) {
   return "#" + ((1 << 24) + (r << 16) + (g << 8) + b).toString(16).slice(1);
 }
+// At most one outstanding request per control. While one is in flight only
+// the latest URL is kept and sent when it completes.
+const inflight = {};
+function send(key, url){
+  const slot = inflight[key] || (inflight[key] = { busy: false, next: null });
+  if (slot.busy) { slot.next = url; return; }
+  slot.busy = true;
+  fetch(url).catch(() => {}).finally(() => {
+    slot.busy = false;
+    if (slot.next) { const n = slot.next; slot.next = null; send(key, n); }
+  });
+}
 function setDim(){
   const b = document.getElementById('dimB').value;
-  fetch('/api/dim/brightness?b=' + b);
+  send('dim', '/api/dim/brightness?b=' + b);
 }
 function setWS1(){
   const b = document.getElementById('ws1B').value;
   const c = hexToRgb(document.getElementById('ws1C').value);
-  fetch(`/api/ws1/set?b=${b}&r=${c.r}&g=${c.g}&b2=${c.b}`);
+  send('ws1', `/api/ws1/set?b=${b}&r=${c.r}&g=${c.g}&b2=${c.b}`);
 }
 function setWS2(){
   const b = document.getElementById('ws2B').value;
   const c = hexToRgb(document.getElementById('ws2C').value);
-  fetch(`/api/ws2/set?b=${b}&r=${c.r}&g=${c.g}&b2=${c.b}`);
+  send('ws2', `/api/ws2/set?b=${b}&r=${c.r}&g=${c.g}&b2=${c.b}`);
+}
+function setKelvin(){
+  const k = document.getElementById('kK').value;
+  const b = document.getElementById('kB').value;
+  document.getElementById('kV').textContent = `${k} K`;
+  send('kelvin', `/api/kelvin?k=${k}&b=${b}`);
 }
 function startAnim(name){
   // duration optional in ms; default server side
@@ -123,10 +173,14 @@ function startTest(name){
   fetch(`/api/anim/start?name=${name}&dur=60000`);
 }
 
+// Polls with ?since= and merges the changed sections into `state`
+let state = {}, stateVersion = -1;
 function updateStatus() {
-  fetch('/api/state')
+  fetch(stateVersion < 0 ? '/api/state' : `/api/state?since=${stateVersion}`)
     .then(res => res.json())
-    .then(state => {
+    .then(update => {
+      state = update.delta ? Object.assign(state, update) : update;
+      stateVersion = update.version;
   document.getElementById('time').textContent = state.time || '--';
       document.getElementById('dimB').value = state.dim.brightness;
       document.getElementById('ws1B').value = state.ws1.brightness;
@@ -148,10 +202,13 @@ function updateStatus() {
           let out = '';
           state.schedule.forEach(e => {
             const dir = e.isUtc ? 'UTC' : 'local';
-            out += `${String(e.hour).padStart(2,'0')}:${String(e.minute).padStart(2,'0')} (${dir}) ${e.anim} for ${Math.round(e.durationMs/60000)}m`;
-            if (e.followUp) {
-              out += ` → follow:${e.followUp}`;
-            }
+            const hhmm = `${String(e.hour).padStart(2,'0')}:${String(e.minute).padStart(2,'0')}`;
+            if (e.trigger === 'time' || e.trigger === undefined) out += `${hhmm} (${dir})`;
+            else if (e.trigger === 'interval') out += `every ${e.intervalMin}m from ${hhmm} (${dir})`;
+            else out += `${e.trigger}${e.offsetMin >= 0 ? '+' : ''}${e.offsetMin}m`;
+            if (e.scene >= 0) out += ` scene ${e.scene}`;
+            else if (e.sequence >= 0) out += ` sequence ${e.sequence}`;
+            else out += ` ${e.anim} for ${Math.round(e.durationMs/60000)}m`;
             out += '<br>';
           });
           schedEl.innerHTML = out;
@@ -172,144 +229,1120 @@ window.onload = () => {
 )HTML";
 }
 
-uint8_t getQueryU8(AsyncWebServerRequest* req, const char* name, uint8_t def)
+// ------------------- Query reader -------------------
+// Reads the already-parsed query parameters by index so lookups build no
+// temporary Strings; numbers are parsed in place.
+
+// Raw value of a query parameter, or nullptr if absent.
+static const char* queryValue(AsyncWebServerRequest* req, const char* name)
 {
-  if (req->hasParam(name)) {
-    int v = req->getParam(name)->value().toInt();
-    if (v < 0) v = 0;
-    if (v > 255) v = 255;
-    return (uint8_t)v;
+  size_t n = req->params();
+  for (size_t i = 0; i < n; ++i) {
+    AsyncWebParameter* p = req->getParam(i);
+    if (!p->isPost() && strcmp(p->name().c_str(), name) == 0) return p->value().c_str();
   }
-  return def;
+  return nullptr;
 }
 
-void registerRoutes(StripState& dimState, StripState& ws1State, StripState& ws2State, Adafruit_NeoPixel& strip1, Adafruit_NeoPixel& strip2)
+// Decimal query parameter clamped to [lo, hi]; `def` if absent or not a number.
+static long queryInt(AsyncWebServerRequest* req, const char* name, long def, long lo, long hi)
 {
-  if (!s_server) return;
+  const char* v = queryValue(req, name);
+  if (!v) return def;
+  bool neg = (*v == '-');
+  if (neg) ++v;
+  if (*v < '0' || *v > '9') return def;
+  long acc = 0;
+  for (; *v >= '0' && *v <= '9'; ++v) {
+    if (acc > 214748363L) { acc = 2147483647L; continue; } // saturate
+    acc = acc * 10 + (*v - '0');
+  }
+  if (neg) acc = -acc;
+  if (acc < lo) acc = lo;
+  if (acc > hi) acc = hi;
+  return acc;
+}
 
-  s_server->on("/", HTTP_GET, [](AsyncWebServerRequest* req){
-    AsyncWebServerResponse* res = req->beginResponse(200, "text/html", htmlIndex());
-    res->addHeader("Cache-Control", "no-store");
-    req->send(res);
-  });
+static uint8_t queryU8(AsyncWebServerRequest* req, const char* name, uint8_t def)
+{
+  return (uint8_t)queryInt(req, name, def, 0, 255);
+}
 
-  s_server->on("/api/dim/on", HTTP_GET, [&](AsyncWebServerRequest* req){
-    dimState.on = true;
-    LEDController::setPwmDuty(0, dimState.brightness);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
-  s_server->on("/api/dim/off", HTTP_GET, [&](AsyncWebServerRequest* req){
-    dimState.on = false;
-    LEDController::setPwmDuty(0, 0);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
-  s_server->on("/api/dim/brightness", HTTP_GET, [&](AsyncWebServerRequest* req){
-    uint8_t b = getQueryU8(req, "b", dimState.brightness);
-    dimState.brightness = b;
-    LEDController::setPwmDuty(0, dimState.on ? b : 0);
-    req->send(200, "application/json", String("{\"ok\":true,\"brightness\":") + b + "}");
-  });
+// -1 if the query parameter is absent, else its value clamped to 0..255.
+static int queryOptU8(AsyncWebServerRequest* req, const char* name)
+{
+  return (int)queryInt(req, name, -1, 0, 255);
+}
 
-  // WS1
-  s_server->on("/api/ws1/on", HTTP_GET, [&](AsyncWebServerRequest* req){ ws1State.on = true; LEDController::markDirty(1); req->send(200, "application/json", "{\"ok\":true}"); });
-  s_server->on("/api/ws1/off", HTTP_GET, [&](AsyncWebServerRequest* req){ ws1State.on = false; LEDController::markDirty(1); req->send(200, "application/json", "{\"ok\":true}"); });
-  s_server->on("/api/ws1/set", HTTP_GET, [&](AsyncWebServerRequest* req){
-    ws1State.brightness = getQueryU8(req, "b", ws1State.brightness);
-    ws1State.r = getQueryU8(req, "r", ws1State.r);
-    ws1State.g = getQueryU8(req, "g", ws1State.g);
-    ws1State.b = getQueryU8(req, "b2", ws1State.b);
-    LEDController::markDirty(1);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
+static int hexDigit(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
 
-  // WS2
-  s_server->on("/api/ws2/on", HTTP_GET, [&](AsyncWebServerRequest* req){ ws2State.on = true; LEDController::markDirty(2); req->send(200, "application/json", "{\"ok\":true}"); });
-  s_server->on("/api/ws2/off", HTTP_GET, [&](AsyncWebServerRequest* req){ ws2State.on = false; LEDController::markDirty(2); req->send(200, "application/json", "{\"ok\":true}"); });
-  s_server->on("/api/ws2/set", HTTP_GET, [&](AsyncWebServerRequest* req){
-    ws2State.brightness = getQueryU8(req, "b", ws2State.brightness);
-    ws2State.r = getQueryU8(req, "r", ws2State.r);
-    ws2State.g = getQueryU8(req, "g", ws2State.g);
-    ws2State.b = getQueryU8(req, "b2", ws2State.b);
-    LEDController::markDirty(2);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
+// LittleFS path from the query (must be absolute and fit the output buffer)
+static bool queryPath(AsyncWebServerRequest* req, const char* name, const char* def, char* out, size_t outLen)
+{
+  const char* p = queryValue(req, name);
+  if (!p) p = def;
+  size_t len = strlen(p);
+  if (len < 2 || p[0] != '/' || len >= outLen) return false;
+  memcpy(out, p, len + 1);
+  return true;
+}
 
-  s_server->on("/api/onall", HTTP_GET, [&](AsyncWebServerRequest* req){
-    dimState.on = ws1State.on = ws2State.on = true;
-    LEDController::setPwmDuty(0, dimState.brightness);
-    LEDController::markDirty(1); LEDController::markDirty(2);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
-  s_server->on("/api/offall", HTTP_GET, [&](AsyncWebServerRequest* req){
-    dimState.on = ws1State.on = ws2State.on = false;
-    LEDController::setPwmDuty(0, 0);
-    LEDController::markDirty(1); LEDController::markDirty(2);
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
+// ------------------- Helpers -------------------
 
-  // Animations
-  s_server->on("/api/anim/start", HTTP_GET, [&](AsyncWebServerRequest* req){
-    String name = req->hasParam("name") ? req->getParam("name")->value() : String("");
-    unsigned long dur = 30000;
-    if (req->hasParam("dur")) dur = (unsigned long)req->getParam("dur")->value().toInt();
-    // If sunrise/sunset and no dur specified, default to 20 minutes
-    if (!req->hasParam("dur") && (name == "sunrise" || name == "sunset")) {
-      dur = 20UL * 60UL * 1000UL; // 20 minutes in ms
-    }
-    if (name == "sunrise") {
-      LEDController::startAnimation(LEDController::Animation::Sunrise, dur);
-    } else if (name == "sunset") {
-      LEDController::startAnimation(LEDController::Animation::Sunset, dur);
-    } else if (name == "waves") {
-      LEDController::startAnimation(LEDController::Animation::Waves, dur);
-    } else if (name == "police") {
-      LEDController::startAnimation(LEDController::Animation::Police, dur);
-    } else if (name == "christmas") {
-      LEDController::startAnimation(LEDController::Animation::Christmas, dur);
-    }
-    req->send(200, "application/json", "{\"ok\":true}");
-  });
-  s_server->on("/api/anim/stop", HTTP_GET, [&](AsyncWebServerRequest* req){
-    LEDController::stopAnimation();
-    req->send(200, "application/json", "{\"ok\":true}");
+// Apply the optional b/r/g/b2 query of a /set request to a strip, or k
+// (color temperature in Kelvin, calibrated for the strip) instead of the
+// color. Missing fields keep their current value; the update is a single
+// store write. False (nothing changed) if a color would replace a per-pixel
+// image while an upload holds it.
+static bool applyStripQuery(AsyncWebServerRequest* req, StripStore::Target target)
+{
+  int b = queryOptU8(req, "b");
+  int r = queryOptU8(req, "r");
+  int g = queryOptU8(req, "g");
+  int b2 = queryOptU8(req, "b2");
+  long k = queryInt(req, "k", 0, ColorTemp::MIN_K, ColorTemp::MAX_K);
+  int stripIndex = target == StripStore::WS2 ? 2 : 1;
+  if (k && target != StripStore::Dim) {
+    uint32_t c = ColorTemp::color((uint16_t)k, 255, stripIndex);
+    r = (uint8_t)(c >> 16);
+    g = (uint8_t)(c >> 8);
+    b2 = (uint8_t)c;
+  }
+  // A solid color replaces a per-pixel image (/api/pixels)
+  if (target != StripStore::Dim && (r >= 0 || g >= 0 || b2 >= 0) && !LEDController::clearPixels(stripIndex))
+    return false;
+  StripStore::update(target, [=](StripState& st){
+    if (b >= 0) st.brightness = (uint8_t)b;
+    if (r >= 0) st.r = (uint8_t)r;
+    if (g >= 0) st.g = (uint8_t)g;
+    if (b2 >= 0) st.b = (uint8_t)b2;
   });
+  return true;
+}
+
+static void setOn(StripStore::Target target, bool on)
+{
+  StripStore::update(target, [=](StripState& st){ st.on = on; });
+}
+
+// Reply {"ok":true} to a command and wake the main loop so it is applied
+// without waiting for the next idle deadline.
+static void sendOk(AsyncWebServerRequest* req)
+{
+  PowerManager::wake();
+  req->send(200, "application/json", "{\"ok\":true}");
+}
+
+static void sendError(AsyncWebServerRequest* req, int code, const char* error)
+{
+  req->send(code, "application/json", String("{\"ok\":false,\"error\":\"") + error + "\"}");
+}
+
+// Commands that change the output are manual (CommandBus): they take it from
+// the schedule and the other lamps for ?hold=<minutes> (default from
+// /api/override, 0 = no hold).
+static void takeOutput(AsyncWebServerRequest* req)
+{
+  CommandBus::manual(queryInt(req, "hold", -1, 0, CommandBus::MAX_HOLD_MIN));
+}
+
+// Same as sendOk for recorder/player requests which may be refused while one is pending
+static void sendQueued(AsyncWebServerRequest* req, bool ok)
+{
+  if (!ok) {
+    sendError(req, 409, "busy");
+    return;
+  }
+  sendOk(req);
+}
+
+// ------------------- Handlers -------------------
+// State changes go through StripStore; LEDController applies them on its
+// next frame when it sees the generation move.
+
+static void handleIndex(AsyncWebServerRequest* req)
+{
+  AsyncWebServerResponse* res = req->beginResponse(200, "text/html", htmlIndex());
+  res->addHeader("Cache-Control", "no-store");
+  req->send(res);
+}
+
+static void handleDimOn(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::Dim, true); sendOk(req); }
+static void handleDimOff(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::Dim, false); sendOk(req); }
+
+static void handleDimBrightness(AsyncWebServerRequest* req)
+{
+  int b = queryOptU8(req, "b");
+  uint8_t applied;
+  if (b < 0) {
+    // Read only: no write, so nothing is bumped or journaled
+    applied = StripStore::read(StripStore::Dim).brightness;
+  } else {
+    takeOutput(req);
+    StripStore::update(StripStore::Dim, [&](StripState& st){ st.brightness = applied = (uint8_t)b; });
+    PowerManager::wake();
+  }
+  req->send(200, "application/json", String("{\"ok\":true,\"brightness\":") + applied + "}");
+}
+
+static void handleWs1On(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::WS1, true); sendOk(req); }
+static void handleWs1Off(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::WS1, false); sendOk(req); }
+static void handleWs1Set(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  if (!applyStripQuery(req, StripStore::WS1)) { sendError(req, 409, "busy"); return; }
+  sendOk(req);
+}
+static void handleWs2On(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::WS2, true); sendOk(req); }
+static void handleWs2Off(AsyncWebServerRequest* req) { takeOutput(req); setOn(StripStore::WS2, false); sendOk(req); }
+static void handleWs2Set(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  if (!applyStripQuery(req, StripStore::WS2)) { sendError(req, 409, "busy"); return; }
+  sendOk(req);
+}
+
+// Both addressable strips at one color temperature: /api/kelvin?k=2700&b=180
+static void handleKelvin(AsyncWebServerRequest* req)
+{
+  if (!queryValue(req, "k")) { sendError(req, 400, "k"); return; }
+  takeOutput(req);
+  // Both images go first so the strips change together or not at all
+  if (!LEDController::clearPixels(0) || !applyStripQuery(req, StripStore::WS1) ||
+      !applyStripQuery(req, StripStore::WS2)) { sendError(req, 409, "busy"); return; }
+  sendOk(req);
+}
+
+// Channel gains of a strip (255 = 1.0): /api/kelvin/cal?strip=2&r=255&g=235&b=220.
+// Without strip it only reports both.
+static void handleKelvinCal(AsyncWebServerRequest* req)
+{
+  int strip = (int)queryInt(req, "strip", 0, 0, 2);
+  if (strip) {
+    uint32_t gain = ColorTemp::calibration(strip);
+    int r = queryOptU8(req, "r");
+    int g = queryOptU8(req, "g");
+    int b = queryOptU8(req, "b");
+    ColorTemp::setCalibration(strip, r >= 0 ? (uint8_t)r : (uint8_t)(gain >> 16),
+                              g >= 0 ? (uint8_t)g : (uint8_t)(gain >> 8), b >= 0 ? (uint8_t)b : (uint8_t)gain);
+  }
+  req->send(200, "application/json", ColorTemp::calibrationJson());
+}
+
+static void handleOnAll(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  setOn(StripStore::Dim, true); setOn(StripStore::WS1, true); setOn(StripStore::WS2, true);
+  sendOk(req);
+}
 
-  s_server->on("/api/state", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    String animName = "None";
-    switch (LEDController::currentAnimation()) {
-      case LEDController::Animation::Sunrise: animName = "Sunrise"; break;
-      case LEDController::Animation::Sunset: animName = "Sunset"; break;
-  case LEDController::Animation::Waves: animName = "Waves"; break;
-  case LEDController::Animation::Police: animName = "Police"; break;
-  case LEDController::Animation::Christmas: animName = "Christmas"; break;
-      default: break;
+static void handleOffAll(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  setOn(StripStore::Dim, false); setOn(StripStore::WS1, false); setOn(StripStore::WS2, false);
+  sendOk(req);
+}
+
+// ------------------- Pixel upload -------------------
+// POST /api/pixels bodies are decoded chunk by chunk as they arrive
+// (onRequestBody) straight into LEDController's image; no copy of the body
+// is kept. The handler runs once the body is complete and publishes the
+// image. Body, handler and disconnect all run on the AsyncTCP task. A client
+// that disconnects early releases the image at once; one that goes quiet is
+// dropped by LEDController after PIXELS_STALL_MS.
+
+struct PixelUpload {
+  AsyncWebServerRequest* req; // owner, nullptr when idle
+  uint32_t token;             // LEDController upload
+  bool done;                  // whole body received
+  int strip;                  // 1 or 2: strip order; 0: logical frame
+  uint16_t n2;                // pixels of strip 2 (start of the logical frame)
+  uint16_t pos;               // next pixel, in target order
+  uint16_t limit;             // pixels in the target
+  uint8_t bpp;                // 3 (RGB) or 4 (RGBW)
+  bool rle;                   // runs of <count><pixel>
+  uint8_t have;               // bytes of the current record
+  uint8_t rec[5];             // [count] r g b [w]
+  uint8_t mask;               // strips written (bit 0 strip 1, bit 1 strip 2)
+  uint16_t written;
+  uint32_t dropped;           // pixels past the end of the target
+};
+static PixelUpload s_pixels = {};
+
+static void pixelsDisconnect(AsyncWebServerRequest* req)
+{
+  if (s_pixels.req != req) return; // handled, or replaced after a stall
+  s_pixels.req = nullptr;
+  LEDController::endPixels(s_pixels.token, false, 0);
+}
+
+static void pixelsBegin(AsyncWebServerRequest* req)
+{
+  uint32_t token = LEDController::beginPixels();
+  if (!token) return; // busy
+  PixelUpload& u = s_pixels;
+  u = PixelUpload{};
+  u.req = req;
+  u.token = token;
+  req->onDisconnect([req]() { pixelsDisconnect(req); });
+  u.strip = (int)queryInt(req, "strip", 0, 0, 2);
+  u.n2 = LEDController::stripLength(2);
+  uint16_t n1 = LEDController::stripLength(1);
+  u.limit = u.strip == 1 ? n1 : u.strip == 2 ? u.n2 : (uint16_t)min((uint32_t)PixelOutput::MAX_PIXELS, (uint32_t)u.n2 + n1);
+  u.pos = (uint16_t)queryInt(req, "start", 0, 0, u.limit);
+  const char* fmt = queryValue(req, "fmt");
+  u.bpp = (fmt && strcmp(fmt, "rgbw") == 0) ? 4 : 3;
+  u.rle = queryU8(req, "rle", 0) != 0;
+}
+
+// Store `count` pixels of `color` at the current position
+static void pixelsPut(PixelUpload& u, uint32_t color, uint16_t count)
+{
+  for (; count; --count, ++u.pos) {
+    if (u.pos >= u.limit) { u.dropped += count; return; }
+    uint16_t i = u.strip == 1 ? u.n2 + u.pos : u.strip == 2 ? u.n2 - 1 - u.pos : u.pos;
+    LEDController::setPixel(i, color);
+    u.mask |= i < u.n2 ? 2 : 1;
+    ++u.written;
+  }
+}
+
+static void pixelsBody(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total)
+{
+  if (strcmp(req->url().c_str(), "/api/pixels") != 0) return;
+  if (index == 0) pixelsBegin(req);
+  PixelUpload& u = s_pixels;
+  if (u.req != req || !LEDController::lockPixels(u.token)) return;
+  uint8_t need = u.bpp + (u.rle ? 1 : 0);
+  for (size_t k = 0; k < len; ++k) {
+    u.rec[u.have++] = data[k];
+    if (u.have < need) continue;
+    u.have = 0;
+    const uint8_t* px = u.rec + (u.rle ? 1 : 0);
+    uint32_t r = px[0], g = px[1], b = px[2];
+    if (u.bpp == 4) {
+      // The strips are RGB: white goes into all three channels
+      uint32_t w = px[3];
+      r = r + w > 255 ? 255 : r + w;
+      g = g + w > 255 ? 255 : g + w;
+      b = b + w > 255 ? 255 : b + w;
     }
+    pixelsPut(u, r << 16 | g << 8 | b, u.rle ? u.rec[0] : 1);
+  }
+  LEDController::unlockPixels(u.token);
+  if (index + len >= total) u.done = true;
+}
+
+// POST /api/pixels?strip=<1|2>&start=<pixel>&fmt=<rgb|rgbw>&rle=1 with the
+// pixel bytes as body (Content-Type: application/octet-stream)
+static void handlePixels(AsyncWebServerRequest* req)
+{
+  PixelUpload& u = s_pixels;
+  if (u.req != req) {
+    if (req->contentLength()) sendError(req, 409, "busy");
+    else sendError(req, 400, "body");
+    return;
+  }
+  u.req = nullptr;
+  if (!u.done || u.have) {
+    bool held = LEDController::endPixels(u.token, false, 0);
+    sendError(req, held ? 400 : 408, !held ? "stalled" : u.done ? "truncated" : "body");
+    return;
+  }
+  if (!LEDController::endPixels(u.token, true, u.mask)) { sendError(req, 408, "stalled"); return; }
+  takeOutput(req);
+  PowerManager::wake();
+  req->send(200, "application/json", String("{\"ok\":true,\"pixels\":") + String(u.written) + ",\"dropped\":" + String(u.dropped) + "}");
+}
+
+// Strip 1 or 2 (default both) back to its solid color
+static void handlePixelsClear(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  if (!LEDController::clearPixels((int)queryInt(req, "strip", 0, 0, 2))) { sendError(req, 409, "busy"); return; }
+  sendOk(req);
+}
+
+static void handleAnimStart(AsyncWebServerRequest* req)
+{
+  LEDController::Animation anim;
+  if (LEDController::animationFromName(queryValue(req, "name"), anim)) {
+    takeOutput(req);
+    // If sunrise/sunset/dawn and no dur specified, default to 20 minutes
+    bool longDefault = anim == LEDController::Animation::Sunrise || anim == LEDController::Animation::Sunset ||
+                       anim == LEDController::Animation::Dawn;
+    long dur = queryInt(req, "dur", longDefault ? 20L * 60L * 1000L : 30000L, 0, 2147483647L);
+    // Shared with the other lamps (LampSync) unless local=1
+    if (queryU8(req, "local", 0)) LampSync::startLocal(anim, (unsigned long)dur);
+    else LampSync::startShared(anim, (unsigned long)dur);
+  }
+  sendOk(req);
+}
+
+static void handleAnimStop(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  if (queryU8(req, "local", 0)) LampSync::stopLocal();
+  else LampSync::stopShared();
+  sendOk(req);
+}
+
+// Baked playback: /api/anim/play?path=/bake_christmas.bin&loop=1
+static void handleAnimPlay(AsyncWebServerRequest* req)
+{
+  LEDController::RecorderRequest r = {};
+  r.kind = LEDController::RecorderRequest::Play;
+  r.repeat = queryU8(req, "loop", 0) != 0;
+  if (!queryPath(req, "path", "", r.path, sizeof(r.path)) || !LittleFS.exists(r.path)) { sendError(req, 404, "path"); return; }
+  takeOutput(req);
+  sendQueued(req, LEDController::requestRecorder(r));
+}
+
+// Frame recorder. Recordings are LittleFS files in the FrameRecorder format.
+static void handleRecStart(AsyncWebServerRequest* req)
+{
+  LEDController::RecorderRequest r = {};
+  r.kind = LEDController::RecorderRequest::Start;
+  if (!queryPath(req, "path", "/rec.bin", r.path, sizeof(r.path))) { sendError(req, 400, "path"); return; }
+  sendQueued(req, LEDController::requestRecorder(r));
+}
+
+static void handleRecStop(AsyncWebServerRequest* req)
+{
+  LEDController::RecorderRequest r = {};
+  r.kind = LEDController::RecorderRequest::Stop;
+  sendQueued(req, LEDController::requestRecorder(r));
+}
+
+// Deterministic offline render of an animation: /api/rec/render?name=waves&dur=10000&frame=20&path=/waves.bin
+static void handleRecRender(AsyncWebServerRequest* req)
+{
+  LEDController::RecorderRequest r = {};
+  r.kind = LEDController::RecorderRequest::Render;
+  if (!LEDController::animationFromName(queryValue(req, "name"), r.anim)) { sendError(req, 400, "name"); return; }
+  r.durationMs = (unsigned long)queryInt(req, "dur", 10000L, 1, 2147483647L);
+  r.frameMs = (unsigned long)queryInt(req, "frame", 20L, 1, 60000L);
+  if (!queryPath(req, "path", "/rec.bin", r.path, sizeof(r.path))) { sendError(req, 400, "path"); return; }
+  sendQueued(req, LEDController::requestRecorder(r));
+}
+
+static void handleRecStatus(AsyncWebServerRequest* req)
+{
+  String json = String("{\"recording\":") + (FrameRecorder::recording() ? "true" : "false") +
+                ",\"frames\":" + String(FrameRecorder::framesRecorded()) + "}";
+  req->send(200, "application/json", json);
+}
+
+// Golden comparison: /api/rec/diff?a=/rec.bin&b=/golden_waves.bin&tol=0
+static void handleRecDiff(AsyncWebServerRequest* req)
+{
+  char a[32], b[32];
+  if (!queryPath(req, "a", "/rec.bin", a, sizeof(a)) || !queryPath(req, "b", "", b, sizeof(b))) {
+    sendError(req, 400, "path");
+    return;
+  }
+  uint8_t tol = queryU8(req, "tol", 0);
+  FrameRecorder::DiffReport rep;
+  bool same = FrameRecorder::diff(a, b, tol, rep);
+  String json = String("{\"ok\":") + (same ? "true" : "false") +
+                ",\"frames\":" + String(rep.frames) +
+                ",\"mismatched\":" + String(rep.mismatched) +
+                ",\"firstMismatch\":" + String(rep.firstMismatch) +
+                ",\"maxDelta\":" + String(rep.maxDelta) +
+                ",\"maxTimeSkewMs\":" + String(rep.maxTimeSkewMs) +
+                ",\"layoutMismatch\":" + (rep.layoutMismatch ? "true" : "false") +
+                ",\"lengthMismatch\":" + (rep.lengthMismatch ? "true" : "false") + "}";
+  req->send(200, "application/json", json);
+}
+
+static void handleRecFile(AsyncWebServerRequest* req)
+{
+  char path[32];
+  if (!queryPath(req, "path", "/rec.bin", path, sizeof(path)) || !LittleFS.exists(path)) {
+    sendError(req, 404, "path");
+    return;
+  }
+  req->send(LittleFS, path, "application/octet-stream", true);
+}
+
+// Scenes: /api/scene/save?name=night[&anim=waves&dur=600000] captures the
+// current strip state; recall by ?slot=<n> or ?name=<name>.
+static void handleSceneSave(AsyncWebServerRequest* req)
+{
+  LEDController::Animation anim = LEDController::Animation::None;
+  const char* animName = queryValue(req, "anim");
+  if (animName && !LEDController::animationFromName(animName, anim)) { sendError(req, 400, "anim"); return; }
+  long dur = queryInt(req, "dur", 30000L, 0, 2147483647L);
+  int slot = Scenes::save(queryValue(req, "name"), anim, (unsigned long)dur);
+  if (slot < 0) { sendError(req, 400, "name or table full"); return; }
+  req->send(200, "application/json", String("{\"ok\":true,\"slot\":") + slot + "}");
+}
+
+static void handleSceneRecall(AsyncWebServerRequest* req)
+{
+  const char* name = queryValue(req, "name");
+  int slot = name ? Scenes::find(name) : (int)queryInt(req, "slot", -1, -1, Scenes::SLOT_COUNT - 1);
+  if (slot >= 0) takeOutput(req);
+  if (!Scenes::recall(slot)) { sendError(req, 404, "scene"); return; }
+  sendOk(req);
+}
+
+static void handleSceneDelete(AsyncWebServerRequest* req)
+{
+  if (!Scenes::remove(queryValue(req, "name"))) { sendError(req, 404, "scene"); return; }
+  sendOk(req);
+}
+
+static void handleScenes(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", Scenes::listJson());
+}
+
+// Sequences: /api/seq/define?name=evening&steps=anim:sunset:1800000,off
+// (step syntax in Sequencer.h), then /api/seq/start?name=evening.
+static void handleSeqDefine(AsyncWebServerRequest* req)
+{
+  const char* err = nullptr;
+  int slot = Sequencer::define(queryValue(req, "name"), queryValue(req, "steps"), &err);
+  if (slot < 0) { sendError(req, 400, err ? err : "steps"); return; }
+  req->send(200, "application/json", String("{\"ok\":true,\"slot\":") + slot + "}");
+}
+
+static void handleSeqDelete(AsyncWebServerRequest* req)
+{
+  if (!Sequencer::remove(queryValue(req, "name"))) { sendError(req, 404, "sequence"); return; }
+  sendOk(req);
+}
+
+static void handleSeqStart(AsyncWebServerRequest* req)
+{
+  int slot = Sequencer::find(queryValue(req, "name"));
+  if (slot >= 0) takeOutput(req);
+  if (!Sequencer::start(slot)) { sendError(req, 404, "sequence"); return; }
+  sendOk(req);
+}
+
+static void handleSeqStop(AsyncWebServerRequest* req)
+{
+  takeOutput(req);
+  Sequencer::stop();
+  sendOk(req);
+}
+
+static void handleSeqStatus(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", Sequencer::statusJson());
+}
+
+// Effect programs: /api/fx/upload?name=ripple&code=<hex bytecode> (assemble
+// with tools/fxasm.py), then /api/fx/start?name=ripple&p0=..&p3=&b=&dur=.
+static void handleFxUpload(AsyncWebServerRequest* req)
+{
+  const char* hex = queryValue(req, "code");
+  uint8_t code[EffectVM::MAX_CODE];
+  size_t len = 0;
+  if (!hex || !*hex) { sendError(req, 400, "code"); return; }
+  for (const char* p = hex; *p; p += 2) {
+    int hi = hexDigit(p[0]), lo = p[1] ? hexDigit(p[1]) : -1;
+    if (hi < 0 || lo < 0) { sendError(req, 400, "code must be hex"); return; }
+    if (len >= sizeof(code)) { sendError(req, 400, "too long"); return; }
+    code[len++] = (uint8_t)(hi << 4 | lo);
+  }
+  static EffectVM::Program prog; // HTTP task only
+  const char* err = nullptr;
+  if (!EffectVM::store(queryValue(req, "name"), code, len, prog, &err)) { sendError(req, 400, err ? err : "code"); return; }
+  req->send(200, "application/json", String("{\"ok\":true,\"bytes\":") + prog.length +
+            ",\"ops\":" + prog.ops + ",\"stack\":" + prog.maxStack + "}");
+}
+
+static void handleFxStart(AsyncWebServerRequest* req)
+{
+  static const char* const PARAM_NAMES[EffectVM::PARAM_COUNT] = { "p0", "p1", "p2", "p3" };
+  int32_t params[EffectVM::PARAM_COUNT];
+  for (int i = 0; i < EffectVM::PARAM_COUNT; ++i) params[i] = (int32_t)queryInt(req, PARAM_NAMES[i], 0, -2147483647L, 2147483647L);
+  uint8_t b = queryU8(req, "b", 255);
+  long dur = queryInt(req, "dur", 0, 0, 2147483647L);
+  const char* name = queryValue(req, "name");
+  if (!EffectVM::exists(name)) { sendError(req, 404, "program"); return; }
+  takeOutput(req);
+  if (!EffectVM::start(name, params, b, (unsigned long)dur)) { sendError(req, 404, "program"); return; }
+  sendOk(req);
+}
+
+static void handleFxDelete(AsyncWebServerRequest* req)
+{
+  if (!EffectVM::remove(queryValue(req, "name"))) { sendError(req, 404, "program"); return; }
+  sendOk(req);
+}
+
+static void handleFxList(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", EffectVM::listJson());
+}
+
+// Daily light integral: /api/dli reports today and the last days;
+// ?pwm=&red=&green=&blue= set channel weights (µmol/m²/s at full output),
+// ?target=<mmol/m²>&floor=<0-255> the cap (target 0 = none)
+static void handleDli(AsyncWebServerRequest* req)
+{
+  static const char* const WEIGHT_NAMES[DailyLight::ChannelCount] = { "pwm", "red", "green", "blue" };
+  for (int c = 0; c < DailyLight::ChannelCount; ++c) {
+    long w = queryInt(req, WEIGHT_NAMES[c], -1, 0, 5000);
+    if (w >= 0) DailyLight::setWeight((DailyLight::Channel)c, (uint32_t)w);
+  }
+  if (queryValue(req, "target") || queryValue(req, "floor")) {
+    long target = queryInt(req, "target", (long)DailyLight::capTarget(), 0, 200000L);
+    DailyLight::setCap((uint32_t)target, queryU8(req, "floor", DailyLight::capFloor()));
+  }
+  req->send(200, "application/json", DailyLight::json());
+}
+
+static void handleJournal(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", StateJournal::json());
+}
+
+// Manual override: /api/override reports it, ?min=<n> sets the default hold
+// of manual commands, ?resume=1 ends the current one
+static void handleOverride(AsyncWebServerRequest* req)
+{
+  long minutes = queryInt(req, "min", -1, 0, CommandBus::MAX_HOLD_MIN);
+  if (minutes >= 0) CommandBus::setDefaultHold((uint32_t)minutes);
+  if (queryU8(req, "resume", 0)) CommandBus::resume();
+  req->send(200, "application/json", CommandBus::json());
+}
+
+// Request dispatch timing, reported by /api/stats
+struct DispatchStats {
+  uint32_t count;
+  uint32_t lookupUsTotal;
+  uint32_t lookupUsMax;
+  uint32_t handlerUsTotal;
+  uint32_t handlerUsMax;
+};
+static DispatchStats s_dispatch = {0, 0, 0, 0, 0};
+
+// /api/state sections, each with the StateVersion of its last change: the
+// version is the ETag, known before serializing, and ?since=<version> leaves
+// out the sections that did not change after it.
+static const StateVersion::Section STATE_SECTIONS[] = {
+  StateVersion::Schedule, StateVersion::Animation, StateVersion::Dim, StateVersion::Ws1, StateVersion::Ws2
+};
+enum StateSection { SecSchedule = 0, SecAnimation, SecDim, SecWs1, SecWs2, SEC_COUNT };
+static_assert(sizeof(STATE_SECTIONS) / sizeof(STATE_SECTIONS[0]) == SEC_COUNT, "one StateVersion section per /api/state section");
 
+struct StateSnapshot {
+  LEDController::Animation anim;
+  StripState dim, ws1, ws2; // brightness as output (PWM duty, strip readback)
+};
+
+static uint32_t s_stateFullBytes = 0; // size of the last full body, what a 304 or delta saves
+
+// Bytes sent and saved for the most recent /api/state clients, by address
+struct StateClient {
+  uint32_t ip;
+  unsigned long firstMs;
+  unsigned long lastMs;
+  uint32_t requests;
+  uint32_t notModified;
+  uint32_t deltas;
+  uint32_t bytesSent;
+  uint32_t bytesSaved;
+};
+static const int STATE_CLIENTS = 8;
+static StateClient s_stateClients[STATE_CLIENTS];
+
+static void readState(StateSnapshot& s)
+{
+  s.anim = LEDController::currentAnimation();
+  s.dim = StripStore::read(StripStore::Dim);
+  s.dim.brightness = LEDController::getPwmDuty(0);
+  s.ws1 = StripStore::read(StripStore::WS1);
+  s.ws2 = StripStore::read(StripStore::WS2);
+  // Colors stay the stored ones; on/brightness follow the hardware when readable
+  StripState hw;
+  if (LEDController::readStripHardware(1, hw)) { s.ws1.on = hw.on; s.ws1.brightness = hw.brightness; }
+  if (LEDController::readStripHardware(2, hw)) { s.ws2.on = hw.on; s.ws2.brightness = hw.brightness; }
+}
+
+static StateClient& stateClient(AsyncWebServerRequest* req)
+{
+  uint32_t ip = req->client() ? (uint32_t)req->client()->remoteIP() : 0;
+  unsigned long now = millis();
+  int slot = 0;
+  for (int i = 0; i < STATE_CLIENTS; ++i) {
+    StateClient& c = s_stateClients[i];
+    if (c.requests && c.ip == ip) { c.lastMs = now; return c; }
+    // otherwise reuse a free slot, or the one idle the longest
+    const StateClient& best = s_stateClients[slot];
+    if (best.requests && (!c.requests || now - c.lastMs > now - best.lastMs)) slot = i;
+  }
+  StateClient& c = s_stateClients[slot];
+  c = StateClient{ip, now, now, 0, 0, 0, 0, 0};
+  return c;
+}
+
+static String stateClientsJson()
+{
+  unsigned long now = millis();
+  String json = String("{\"version\":") + String(StateVersion::current()) + ",\"fullBytes\":" + String(s_stateFullBytes) + ",\"clients\":[";
+  bool any = false;
+  for (int i = 0; i < STATE_CLIENTS; ++i) {
+    const StateClient& c = s_stateClients[i];
+    if (!c.requests) continue;
+    if (any) json += ",";
+    any = true;
+    uint32_t total = c.bytesSent + c.bytesSaved;
+    json += String("{\"ip\":\"") + IPAddress(c.ip).toString() + "\"";
+    json += String(",\"requests\":") + String(c.requests);
+    json += String(",\"notModified\":") + String(c.notModified);
+    json += String(",\"deltas\":") + String(c.deltas);
+    json += String(",\"bytesSent\":") + String(c.bytesSent);
+    json += String(",\"bytesSaved\":") + String(c.bytesSaved);
+    json += String(",\"savedPct\":") + String(total ? (uint32_t)((uint64_t)c.bytesSaved * 100 / total) : 0u);
+    json += String(",\"ageS\":") + String((now - c.firstMs) / 1000);
+    json += String(",\"idleS\":") + String((now - c.lastMs) / 1000) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+// Per-target coalescing counters: writes (= target generation) and writes
+// superseded by a newer value before they reached the strip. Also request
+// dispatch latency (route lookup and handler time), frame timing and what
+// conditional and delta /api/state requests saved per client.
+// ?reset=1 clears the dispatch, frame and client counters after reporting them.
+static void handleStats(AsyncWebServerRequest* req)
+{
+  static const char* const names[StripStore::TargetCount] = { "dim", "ws1", "ws2" };
+  String json = "{\"writes\":{";
+  for (int i = 0; i < StripStore::TargetCount; ++i) {
+    if (i) json += ",";
+    json += String("\"") + names[i] + "\":" + String(StripStore::generation((StripStore::Target)i));
+  }
+  json += "},\"superseded\":{";
+  for (int i = 0; i < StripStore::TargetCount; ++i) {
+    if (i) json += ",";
+    json += String("\"") + names[i] + "\":" + String(StripStore::superseded((StripStore::Target)i));
+  }
+  DispatchStats d = s_dispatch;
+  uint32_t n = d.count ? d.count : 1;
+  json += "},\"dispatch\":{";
+  json += String("\"requests\":") + String(d.count);
+  json += String(",\"lookupUsAvg\":") + String(d.lookupUsTotal / n);
+  json += String(",\"lookupUsMax\":") + String(d.lookupUsMax);
+  json += String(",\"handlerUsAvg\":") + String(d.handlerUsTotal / n);
+  json += String(",\"handlerUsMax\":") + String(d.handlerUsMax);
+  LEDController::FrameStats f = LEDController::frameStats();
+  json += "},\"frames\":{";
+  json += String("\"frames\":") + String(f.frames);
+  json += String(",\"renderUsAvg\":") + String(f.frames ? f.renderUsTotal / f.frames : 0);
+  json += String(",\"renderUsMax\":") + String(f.renderUsMax);
+  json += String(",\"intervalMsMax\":") + String(f.intervalMsMax);
+  json += String(",\"lateFrames\":") + String(f.lateFrames);
+  json += "},\"state\":" + stateClientsJson() + "}";
+  if (queryU8(req, "reset", 0)) {
+    s_dispatch = DispatchStats{0, 0, 0, 0, 0};
+    LEDController::resetFrameStats();
+    for (int i = 0; i < STATE_CLIENTS; ++i) s_stateClients[i] = StateClient{0, 0, 0, 0, 0, 0, 0, 0};
+  }
+  req->send(200, "application/json", json);
+}
+
+// Pixel kernel check: /api/bench/kernels?n=20000&iter=200 compares every SWAR
+// kernel with its scalar reference on n inputs and times both.
+static void handleBenchKernels(AsyncWebServerRequest* req)
+{
+  uint32_t samples = (uint32_t)queryInt(req, "n", 20000, 1, 1000000);
+  uint32_t iterations = (uint32_t)queryInt(req, "iter", 200, 1, 10000);
+  PixelKernels::KernelReport rep[PixelKernels::KERNEL_COUNT];
+  uint32_t mismatches = PixelKernels::verify(samples, iterations, rep);
+  String json = String("{\"ok\":") + (mismatches == 0 ? "true" : "false");
+  json += String(",\"samples\":") + String(samples) + ",\"pixelsTimed\":" + String(iterations * 256UL) + ",\"kernels\":[";
+  for (int k = 0; k < PixelKernels::KERNEL_COUNT; ++k) {
+    if (k) json += ",";
+    json += String("{\"name\":\"") + rep[k].name + "\",\"mismatches\":" + String(rep[k].mismatches);
+    json += String(",\"swarUs\":") + String(rep[k].swarUs) + ",\"scalarUs\":" + String(rep[k].scalarUs) + "}";
+  }
+  json += "]}";
+  req->send(200, "application/json", json);
+}
+
+// Output writer benchmark: /api/bench/output?n=2000 (runs on the HTTP task,
+// scratch buffers only)
+static void handleBenchOutput(AsyncWebServerRequest* req)
+{
+  uint32_t n = (uint32_t)queryInt(req, "n", 1000, 1, 20000);
+  LEDController::OutputBench b = LEDController::benchOutput(n);
   String json = "{";
-  // include current time if available
-  String t = TimeService::nowIso();
-  json += "\"time\":\"" + t + "\",";
-  // include schedule info
-  String sched = Scheduler::getScheduleJson();
-  json += "\"schedule\":" + sched + ",";
-    json += "\"animation\":\"" + animName + "\",";
-    // Read actual PWM duty and strip hardware brightnesss where possible
-    uint8_t hwPwm = LEDController::getPwmDuty(0);
-    json += "\"dim\":{\"on\":" + String(dimState.on) + ",\"brightness\":" + String(hwPwm) + "},";
-    StripState hw;
-    if (LEDController::readStripHardware(1, hw)) {
-      json += "\"ws1\":{\"on\":" + String(hw.on) + ",\"brightness\":" + String(hw.brightness) + ",\"r\":" + String(ws1State.r) + ",\"g\":" + String(ws1State.g) + ",\"b\":" + String(ws1State.b) + "},";
-    } else {
-      json += "\"ws1\":{\"on\":" + String(ws1State.on) + ",\"brightness\":" + String(ws1State.brightness) + ",\"r\":" + String(ws1State.r) + ",\"g\":" + String(ws1State.g) + ",\"b\":" + String(ws1State.b) + "},";
-    }
-    if (LEDController::readStripHardware(2, hw)) {
-      json += "\"ws2\":{\"on\":" + String(hw.on) + ",\"brightness\":" + String(hw.brightness) + ",\"r\":" + String(ws2State.r) + ",\"g\":" + String(ws2State.g) + ",\"b\":" + String(ws2State.b) + "}";
-    } else {
-      json += "\"ws2\":{\"on\":" + String(ws2State.on) + ",\"brightness\":" + String(ws2State.brightness) + ",\"r\":" + String(ws2State.r) + ",\"g\":" + String(ws2State.g) + ",\"b\":" + String(ws2State.b) + "}";
-    }
-    json += "}";
-    req->send(200, "application/json", json);
-  });
+  json += String("\"iterations\":") + String(b.iterations);
+  json += String(",\"pixels\":") + String(b.pixels);
+  json += String(",\"fixedActive\":") + (b.fixedActive ? "true" : "false");
+  json += String(",\"fixedUs\":") + String(b.fixedUs);
+  json += String(",\"genericUs\":") + String(b.genericUs);
+  json += String(",\"fixedNsPerPixel\":") + String(b.pixels ? (uint32_t)((uint64_t)b.fixedUs * 1000 / ((uint64_t)b.iterations * b.pixels)) : 0u);
+  json += String(",\"genericNsPerPixel\":") + String(b.pixels ? (uint32_t)((uint64_t)b.genericUs * 1000 / ((uint64_t)b.iterations * b.pixels)) : 0u);
+  json += String(",\"match\":") + (b.match ? "true" : "false");
+  json += "}";
+  req->send(200, "application/json", json);
+}
+
+// Effect program benchmark: /api/bench/fx?name=ripple&n=200 renders n frames
+// with the program (default: the built-in Waves program) and with the native
+// Waves effect (HTTP task, scratch frame only).
+static void handleBenchFx(AsyncWebServerRequest* req)
+{
+  uint32_t n = (uint32_t)queryInt(req, "n", 200, 1, 10000);
+  const char* name = queryValue(req, "name");
+  static EffectVM::Program prog; // HTTP task only
+  if (name ? !EffectVM::load(name, prog) : EffectVM::verify(EffectVM::WAVES_CODE, EffectVM::WAVES_LENGTH, prog) != nullptr) {
+    sendError(req, 404, "program");
+    return;
+  }
+  LEDController::EffectBench b = LEDController::benchEffect(prog, n);
+  uint64_t pixelFrames = (uint64_t)b.frames * (b.pixels ? b.pixels : 1);
+  String json = "{";
+  json += String("\"program\":\"") + (name ? name : "waves (built-in)") + "\"";
+  json += String(",\"ops\":") + String(prog.ops);
+  json += String(",\"frames\":") + String(b.frames);
+  json += String(",\"pixels\":") + String(b.pixels);
+  json += String(",\"nativeUs\":") + String(b.nativeUs);
+  json += String(",\"programUs\":") + String(b.programUs);
+  json += String(",\"nativeNsPerPixel\":") + String((uint32_t)((uint64_t)b.nativeUs * 1000 / pixelFrames));
+  json += String(",\"programNsPerPixel\":") + String((uint32_t)((uint64_t)b.programUs * 1000 / pixelFrames));
+  json += String(",\"programUsPerFrame\":") + String(b.frames ? b.programUs / b.frames : 0);
+  json += "}";
+  req->send(200, "application/json", json);
+}
+
+// Ambient effect benchmark: /api/bench/effects?n=600 renders n consecutive
+// frames of every noise-based effect (and Waves) into a scratch frame and
+// reports average and worst render time against the frame budget, plus the
+// cost of one noise3 sample.
+static void handleBenchEffects(AsyncWebServerRequest* req)
+{
+  uint32_t n = (uint32_t)queryInt(req, "n", 600, 1, 10000);
+  LEDController::EffectTiming t[LEDController::EFFECT_TIMING_COUNT];
+  LEDController::benchEffects(n, t);
+  static const uint32_t NOISE_SAMPLES = 10000;
+  uint32_t noiseUs = Noise::benchUs(NOISE_SAMPLES);
+  uint32_t budgetUs = LEDController::FRAME_INTERVAL_MS * 1000UL;
+  String json = String("{\"frames\":") + String(n) + ",\"budgetUs\":" + String(budgetUs);
+  json += String(",\"noise3Ns\":") + String((uint32_t)((uint64_t)noiseUs * 1000 / NOISE_SAMPLES)) + ",\"effects\":[";
+  for (int e = 0; e < LEDController::EFFECT_TIMING_COUNT; ++e) {
+    if (e) json += ",";
+    json += String("{\"name\":\"") + t[e].name + "\",\"avgUs\":" + String(t[e].avgUs) +
+            ",\"maxUs\":" + String(t[e].maxUs) + ",\"fits\":" + (t[e].maxUs < budgetUs ? "true" : "false") + "}";
+  }
+  json += "]}";
+  req->send(200, "application/json", json);
+}
+
+static void handlePower(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", PowerManager::statsJson());
+}
+
+// Event log: /api/log?cursor=<next from the previous reply>&max=16. Start
+// with cursor=0; `dropped` counts records overwritten before they were read.
+static void handleLog(AsyncWebServerRequest* req)
+{
+  uint32_t cursor = (uint32_t)queryInt(req, "cursor", 0, 0, 2147483647L);
+  size_t max = (size_t)queryInt(req, "max", 16, 1, 16);
+  req->send(200, "application/json", EventLog::json(cursor, max));
+}
+
+static void handleOta(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", OTAHandler::statusJson());
+}
+
+// Simulated time: /api/clock?speed=60&epoch=1774746000[&wrapIn=<ms>], /api/clock?real=1
+static void handleClock(AsyncWebServerRequest* req)
+{
+  if (queryU8(req, "real", 0)) {
+    Clock::realTime();
+    PowerManager::wake();
+  } else if (req->hasParam("speed")) {
+    uint32_t speed = (uint32_t)queryInt(req, "speed", 1, 1, Clock::MAX_SPEED);
+    time_t epoch = (time_t)queryInt(req, "epoch", 0, 0, 2147483647L);
+    uint32_t wrapIn = (uint32_t)queryInt(req, "wrapIn", 0, 0, 2147483647L);
+    if (!Clock::simulate(epoch, speed, wrapIn)) { sendError(req, 400, "epoch"); return; }
+    PowerManager::wake(); // the scheduler replans on its next check
+  }
+  req->send(200, "application/json", Clock::json());
+}
+
+static void handleSync(AsyncWebServerRequest* req)
+{
+  req->send(200, "application/json", LampSync::statusJson());
+}
+
+static void handleHealth(AsyncWebServerRequest* req)
+{
+  AsyncResponseStream* res = req->beginResponseStream("application/json");
+  HealthMonitor::json(*res);
+  req->send(res);
+}
+
+static String stripJson(const char* name, const StripState& st, bool color)
+{
+  String json = String("\"") + name + "\":{\"on\":" + String(st.on) + ",\"brightness\":" + String(st.brightness);
+  if (color) json += ",\"r\":" + String(st.r) + ",\"g\":" + String(st.g) + ",\"b\":" + String(st.b);
+  return json + "}";
+}
+
+// Full state, or with ?since=<version> only the sections changed after that
+// version ("delta":true; time and gen are always included). The ETag is the
+// version: If-None-Match with the current one answers 304 before anything
+// is serialized.
+static void handleState(AsyncWebServerRequest* req)
+{
+  // Version first: a change after it is read is sent again with the next one
+  uint32_t version = StateVersion::current();
+  StateClient& client = stateClient(req);
+  client.requests++;
+  String etag = String("\"") + String(version) + "\"";
+
+  AsyncWebHeader* match = req->getHeader("If-None-Match");
+  if (match && match->value() == etag) {
+    client.notModified++;
+    client.bytesSaved += s_stateFullBytes;
+    AsyncWebServerResponse* res = req->beginResponse(304);
+    res->addHeader("ETag", etag);
+    req->send(res);
+    return;
+  }
+
+  StateSnapshot s;
+  readState(s);
+
+  // A version from another boot (or not issued yet) gets the full state
+  long since = queryInt(req, "since", -1, -1, 2147483647L);
+  bool delta = since >= (long)StateVersion::first() && since <= (long)version;
+  bool sec[SEC_COUNT];
+  for (int i = 0; i < SEC_COUNT; ++i) sec[i] = !delta || (long)StateVersion::changedAt(STATE_SECTIONS[i]) > since;
+
+  String json = String("{\"version\":") + String(version);
+  if (delta) json += ",\"delta\":true";
+  json += ",\"time\":\"" + TimeService::nowIso() + "\"";
+  // gen lets clients tell whether any strip was written
+  json += ",\"gen\":" + String(StripStore::generation());
+  if (sec[SecSchedule]) {
+    json += ",\"schedule\":" + Scheduler::getScheduleJson();
+    json += ",\"sun\":" + Scheduler::sunJson();
+  }
+  if (sec[SecAnimation]) json += String(",\"animation\":\"") + LEDController::animationName(s.anim) + "\"";
+  if (sec[SecDim]) json += "," + stripJson("dim", s.dim, false);
+  if (sec[SecWs1]) json += "," + stripJson("ws1", s.ws1, true);
+  if (sec[SecWs2]) json += "," + stripJson("ws2", s.ws2, true);
+  json += "}";
+
+  if (!delta) s_stateFullBytes = json.length();
+  else {
+    client.deltas++;
+    if (s_stateFullBytes > json.length()) client.bytesSaved += s_stateFullBytes - json.length();
+  }
+  client.bytesSent += json.length();
+  AsyncWebServerResponse* res = req->beginResponse(200, "application/json", json);
+  res->addHeader("ETag", etag);
+  res->addHeader("Cache-Control", "no-cache");
+  req->send(res);
+}
+
+// ------------------- Route table -------------------
+// Sorted by path (strcmp order, checked at compile time) and searched with a
+// binary search from a single catch-all handler, instead of one heap-allocated
+// std::function per route matched linearly by the web server.
+
+typedef void (*RouteHandler)(AsyncWebServerRequest*);
+
+static void handleBenchRouter(AsyncWebServerRequest* req); // needs the table
+
+struct Route {
+  const char* path;
+  WebRequestMethodComposite methods;
+  RouteHandler handler;
+};
+
+static constexpr Route ROUTES[] = {
+  { "/",                   HTTP_GET, handleIndex },
+  { "/api/anim/play",      HTTP_GET, handleAnimPlay },
+  { "/api/anim/start",     HTTP_GET, handleAnimStart },
+  { "/api/anim/stop",      HTTP_GET, handleAnimStop },
+  { "/api/bench/effects",  HTTP_GET, handleBenchEffects },
+  { "/api/bench/fx",       HTTP_GET, handleBenchFx },
+  { "/api/bench/kernels",  HTTP_GET, handleBenchKernels },
+  { "/api/bench/output",   HTTP_GET, handleBenchOutput },
+  { "/api/bench/router",   HTTP_GET, handleBenchRouter },
+  { "/api/clock",          HTTP_GET, handleClock },
+  { "/api/dim/brightness", HTTP_GET, handleDimBrightness },
+  { "/api/dim/off",        HTTP_GET, handleDimOff },
+  { "/api/dim/on",         HTTP_GET, handleDimOn },
+  { "/api/dli",            HTTP_GET, handleDli },
+  { "/api/fx/delete",      HTTP_GET, handleFxDelete },
+  { "/api/fx/list",        HTTP_GET, handleFxList },
+  { "/api/fx/start",       HTTP_GET, handleFxStart },
+  { "/api/fx/upload",      HTTP_GET, handleFxUpload },
+  { "/api/health",         HTTP_GET, handleHealth },
+  { "/api/journal",        HTTP_GET, handleJournal },
+  { "/api/kelvin",         HTTP_GET, handleKelvin },
+  { "/api/kelvin/cal",     HTTP_GET, handleKelvinCal },
+  { "/api/log",            HTTP_GET, handleLog },
+  { "/api/offall",         HTTP_GET, handleOffAll },
+  { "/api/onall",          HTTP_GET, handleOnAll },
+  { "/api/ota",            HTTP_GET, handleOta },
+  { "/api/override",       HTTP_GET, handleOverride },
+  { "/api/pixels",         HTTP_POST, handlePixels },
+  { "/api/pixels/clear",   HTTP_GET, handlePixelsClear },
+  { "/api/power",          HTTP_GET, handlePower },
+  { "/api/rec/diff",       HTTP_GET, handleRecDiff },
+  { "/api/rec/file",       HTTP_GET, handleRecFile },
+  { "/api/rec/render",     HTTP_GET, handleRecRender },
+  { "/api/rec/start",      HTTP_GET, handleRecStart },
+  { "/api/rec/status",     HTTP_GET, handleRecStatus },
+  { "/api/rec/stop",       HTTP_GET, handleRecStop },
+  { "/api/scene/delete",   HTTP_GET, handleSceneDelete },
+  { "/api/scene/recall",   HTTP_GET, handleSceneRecall },
+  { "/api/scene/save",     HTTP_GET, handleSceneSave },
+  { "/api/scenes",         HTTP_GET, handleScenes },
+  { "/api/seq/define",     HTTP_GET, handleSeqDefine },
+  { "/api/seq/delete",     HTTP_GET, handleSeqDelete },
+  { "/api/seq/start",      HTTP_GET, handleSeqStart },
+  { "/api/seq/status",     HTTP_GET, handleSeqStatus },
+  { "/api/seq/stop",       HTTP_GET, handleSeqStop },
+  { "/api/state",          HTTP_GET, handleState },
+  { "/api/stats",          HTTP_GET, handleStats },
+  { "/api/sync",           HTTP_GET, handleSync },
+  { "/api/ws1/off",        HTTP_GET, handleWs1Off },
+  { "/api/ws1/on",         HTTP_GET, handleWs1On },
+  { "/api/ws1/set",        HTTP_GET, handleWs1Set },
+  { "/api/ws2/off",        HTTP_GET, handleWs2Off },
+  { "/api/ws2/on",         HTTP_GET, handleWs2On },
+  { "/api/ws2/set",        HTTP_GET, handleWs2Set },
+};
+
+static constexpr size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+static constexpr bool pathLess(const char* a, const char* b)
+{
+  return (*a == *b) ? (*a != '\0' && pathLess(a + 1, b + 1))
+                    : ((unsigned char)*a < (unsigned char)*b);
+}
+
+static constexpr bool routesSorted(size_t i)
+{
+  return i + 1 >= ROUTE_COUNT || (pathLess(ROUTES[i].path, ROUTES[i + 1].path) && routesSorted(i + 1));
+}
+
+static_assert(routesSorted(0), "ROUTES must be sorted by path (strcmp order) and unique");
+
+static const Route* findRoute(const char* path)
+{
+  size_t lo = 0, hi = ROUTE_COUNT;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int c = strcmp(path, ROUTES[mid].path);
+    if (c == 0) return &ROUTES[mid];
+    if (c < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  return nullptr;
+}
+
+// Bench baseline only: the matching ESPAsyncWebServer did before the route
+// table, once per handler registered with on() until one accepted: method
+// check, then the URL compared with the handler's URI and with URI + "/" as a
+// prefix (a temporary String per rejected handler). The table is scanned
+// backwards so a longer path is tried before its prefix (/api/kelvin/cal
+// before /api/kelvin), as registration order had to ensure.
+static const Route* findRouteLinear(const String& url, WebRequestMethodComposite method)
+{
+  static String s_uris[ROUTE_COUNT]; // the handlers' String members
+  if (!s_uris[0].length())
+    for (size_t i = 0; i < ROUTE_COUNT; ++i) s_uris[i] = ROUTES[i].path;
+  for (size_t i = ROUTE_COUNT; i-- > 0;) {
+    if (!(ROUTES[i].methods & method)) continue;
+    if (s_uris[i] != url && !url.startsWith(s_uris[i] + "/")) continue;
+    return &ROUTES[i];
+  }
+  return nullptr;
+}
+
+// Route lookup benchmark: /api/bench/router?n=200 looks up every route path
+// (and one unknown path) n times with the route table and with the linear
+// matcher it replaced, and reports the average time per lookup of each.
+static void handleBenchRouter(AsyncWebServerRequest* req)
+{
+  uint32_t n = (uint32_t)queryInt(req, "n", 200, 1, 10000);
+  static const size_t PATHS = ROUTE_COUNT + 1;
+  String urls[PATHS];
+  WebRequestMethodComposite methods[PATHS];
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    urls[i] = ROUTES[i].path;
+    methods[i] = ROUTES[i].methods;
+  }
+  urls[ROUTE_COUNT] = "/api/unknown";
+  methods[ROUTE_COUNT] = HTTP_GET;
+  bool match = true;
+  for (size_t i = 0; i < PATHS; ++i)
+    match &= findRoute(urls[i].c_str()) == findRouteLinear(urls[i], methods[i]);
+
+  const Route* volatile sink = nullptr; // keeps the lookups from being optimized out
+  uint32_t t0 = micros();
+  for (uint32_t k = 0; k < n; ++k)
+    for (size_t i = 0; i < PATHS; ++i) sink = findRoute(urls[i].c_str());
+  uint32_t tableUs = micros() - t0;
+  t0 = micros();
+  for (uint32_t k = 0; k < n; ++k)
+    for (size_t i = 0; i < PATHS; ++i) sink = findRouteLinear(urls[i], methods[i]);
+  uint32_t linearUs = micros() - t0;
+  (void)sink;
+
+  uint64_t lookups = (uint64_t)n * PATHS;
+  String json = String("{\"routes\":") + String((uint32_t)ROUTE_COUNT);
+  json += String(",\"lookups\":") + String((uint32_t)lookups);
+  json += String(",\"tableNs\":") + String((uint32_t)((uint64_t)tableUs * 1000 / lookups));
+  json += String(",\"linearNs\":") + String((uint32_t)((uint64_t)linearUs * 1000 / lookups));
+  json += String(",\"match\":") + (match ? "true" : "false") + "}";
+  req->send(200, "application/json", json);
+}
+
+static void dispatch(AsyncWebServerRequest* req)
+{
+  uint32_t t0 = micros();
+  const Route* route = findRoute(req->url().c_str());
+  uint32_t t1 = micros();
+  if (!route) {
+    sendError(req, 404, "not found");
+  } else if (!(route->methods & req->method())) {
+    sendError(req, 405, "method");
+  } else {
+    route->handler(req);
+  }
+  uint32_t t2 = micros();
+
+  DispatchStats& d = s_dispatch;
+  ++d.count;
+  d.lookupUsTotal += t1 - t0;
+  d.handlerUsTotal += t2 - t1;
+  if (t1 - t0 > d.lookupUsMax) d.lookupUsMax = t1 - t0;
+  if (t2 - t1 > d.handlerUsMax) d.handlerUsMax = t2 - t1;
+}
+
+void registerRoutes()
+{
+  if (!s_server) return;
+  // Every request reaches the catch-all handler since no per-path handlers are
+  // registered; request bodies (only /api/pixels takes one) arrive first.
+  s_server->onRequestBody(pixelsBody);
+  s_server->onNotFound(dispatch);
 }
 
 } // namespace ApiServer
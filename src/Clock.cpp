@@ -0,0 +1,139 @@
+#include "Clock.h"
+#include <esp_timer.h>
+#include <time.h>
+
+namespace Clock {
+
+static const time_t WALL_VALID = 1000000000; // same threshold as TimeService::begin
+
+// clock = s_clockBaseUs + (hardware - s_realBaseUs) * s_speed
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_realBaseUs = 0;
+static int64_t s_clockBaseUs = 0;
+static uint32_t s_speed = 1;
+static bool s_simulated = false;
+static int64_t s_wallBaseUs = 0; // simulated wall time at s_clockBaseUs
+
+static int64_t clockAtLocked(int64_t realUs)
+{
+  return s_clockBaseUs + (realUs - s_realBaseUs) * (int64_t)s_speed;
+}
+
+int64_t us()
+{
+  int64_t real = esp_timer_get_time();
+  portENTER_CRITICAL(&s_mux);
+  int64_t t = clockAtLocked(real);
+  portEXIT_CRITICAL(&s_mux);
+  return t;
+}
+
+uint64_t ms()
+{
+  return (uint64_t)(us() / 1000);
+}
+
+uint64_t msAt(int64_t realUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  int64_t t = clockAtLocked(realUs);
+  portEXIT_CRITICAL(&s_mux);
+  return (uint64_t)(t / 1000);
+}
+
+time_t now()
+{
+  int64_t real = esp_timer_get_time();
+  portENTER_CRITICAL(&s_mux);
+  bool sim = s_simulated;
+  int64_t wallUs = s_wallBaseUs + (clockAtLocked(real) - s_clockBaseUs);
+  portEXIT_CRITICAL(&s_mux);
+  return sim ? (time_t)(wallUs / 1000000) : time(nullptr);
+}
+
+uint64_t realUs(uint64_t clockUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  uint32_t speed = s_speed;
+  portEXIT_CRITICAL(&s_mux);
+  return (clockUs + speed - 1) / speed;
+}
+
+unsigned long realMs(uint64_t clockMs)
+{
+  portENTER_CRITICAL(&s_mux);
+  uint32_t speed = s_speed;
+  portEXIT_CRITICAL(&s_mux);
+  uint64_t real = (clockMs + speed - 1) / speed;
+  return real > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (unsigned long)real;
+}
+
+bool simulate(time_t epoch, uint32_t speed, uint32_t wrapInMs)
+{
+  if (speed < 1 || speed > MAX_SPEED) return false;
+  time_t wall = epoch ? epoch : now();
+  if (wall < WALL_VALID) return false;
+  int64_t real = esp_timer_get_time();
+  portENTER_CRITICAL(&s_mux);
+  int64_t cur = clockAtLocked(real);
+  if (wrapInMs > 0) {
+    // Next point (not in the past) where the low 32 bits of ms() are 2^32 - wrapInMs
+    uint64_t curMs = (uint64_t)cur / 1000;
+    uint64_t target = (curMs & ~0xFFFFFFFFULL) + (0x100000000ULL - wrapInMs);
+    if (target < curMs) target += 0x100000000ULL;
+    cur = (int64_t)target * 1000;
+  }
+  s_realBaseUs = real;
+  s_clockBaseUs = cur;
+  s_speed = speed;
+  s_wallBaseUs = (int64_t)wall * 1000000;
+  s_simulated = true;
+  portEXIT_CRITICAL(&s_mux);
+  return true;
+}
+
+void realTime()
+{
+  int64_t real = esp_timer_get_time();
+  portENTER_CRITICAL(&s_mux);
+  s_clockBaseUs = clockAtLocked(real);
+  s_realBaseUs = real;
+  s_speed = 1;
+  s_simulated = false;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+bool simulated()
+{
+  portENTER_CRITICAL(&s_mux);
+  bool sim = s_simulated;
+  portEXIT_CRITICAL(&s_mux);
+  return sim;
+}
+
+uint32_t speed()
+{
+  portENTER_CRITICAL(&s_mux);
+  uint32_t v = s_speed;
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+String json()
+{
+  time_t t = now();
+  char iso[32] = "";
+  if (t >= WALL_VALID) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%SZ", &tm);
+  }
+  String json = String("{\"simulated\":") + (simulated() ? "true" : "false");
+  json += String(",\"speed\":") + String((unsigned long)speed());
+  json += String(",\"now\":") + String((unsigned long)t);
+  json += String(",\"iso\":\"") + iso + "\"";
+  json += String(",\"ms\":") + String((unsigned long long)ms()) + "}";
+  return json;
+}
+
+} // namespace Clock
@@ -0,0 +1,120 @@
+#include "ColorTemp.h"
+#include "PixelKernels.h"
+#include <Preferences.h>
+#include <atomic>
+
+namespace ColorTemp {
+
+static const char* NVS_NAMESPACE = "colortemp";
+static const uint32_t UNITY = 0xFFFFFF;
+
+// Generated by tools/blackbody.py
+static const uint32_t BLACKBODY[] = {
+  0xFF0700, 0xFF0D00, 0xFF1300, 0xFF1900, 0xFF1F00, // 1000 K
+  0xFF2500, 0xFF2B00, 0xFF3100, 0xFF3800, 0xFF3E00, // 1500 K
+  0xFF4402, 0xFF4A04, 0xFF5007, 0xFF560A, 0xFF5B0E, // 2000 K
+  0xFF6111, 0xFF6615, 0xFF6C19, 0xFF711E, 0xFF7623, // 2500 K
+  0xFF7B27, 0xFF802C, 0xFF8532, 0xFF8A37, 0xFF8F3D, // 3000 K
+  0xFF9342, 0xFF9748, 0xFF9C4E, 0xFFA054, 0xFFA45A, // 3500 K
+  0xFFA861, 0xFFAC67, 0xFFB06D, 0xFFB374, 0xFFB77A, // 4000 K
+  0xFFBB80, 0xFFBE87, 0xFFC18D, 0xFFC594, 0xFFC89A, // 4500 K
+  0xFFCBA1, 0xFFCEA7, 0xFFD1AD, 0xFFD4B4, 0xFFD6BA, // 5000 K
+  0xFFD9C0, 0xFFDCC7, 0xFFDECD, 0xFFE1D3, 0xFFE3D9, // 5500 K
+  0xFFE6DF, 0xFFE8E5, 0xFFEAEB, 0xFFEDF1, 0xFFEFF7, // 6000 K
+  0xFFF1FD, 0xFBEFFF, 0xF6ECFF, 0xF1E9FF, 0xECE6FF, // 6500 K
+  0xE7E3FF, 0xE3E1FF, 0xDFDEFF, 0xDBDBFF, 0xD7D9FF, // 7000 K
+  0xD3D7FF, 0xD0D5FF, 0xCDD2FF, 0xC9D0FF, 0xC6CEFF, // 7500 K
+  0xC3CDFF, 0xC1CBFF, 0xBEC9FF, 0xBBC7FF, 0xB9C6FF, // 8000 K
+  0xB7C4FF, 0xB4C2FF, 0xB2C1FF, 0xB0C0FF, 0xAEBEFF, // 8500 K
+  0xACBDFF, 0xAABCFF, 0xA8BAFF, 0xA7B9FF, 0xA5B8FF, // 9000 K
+  0xA3B7FF, 0xA2B6FF, 0xA0B4FF, 0x9FB3FF, 0x9DB2FF, // 9500 K
+  0x9CB1FF, 0x9AB0FF, 0x99AFFF, 0x98AFFF, 0x97AEFF, // 10000 K
+  0x95ADFF, 0x94ACFF, 0x93ABFF, 0x92AAFF, 0x91A9FF, // 10500 K
+  0x90A9FF, 0x8FA8FF, 0x8EA7FF, 0x8DA6FF, 0x8CA6FF, // 11000 K
+  0x8BA5FF, 0x8AA4FF, 0x89A4FF, 0x89A3FF, 0x88A3FF, // 11500 K
+  0x87A2FF, // 12000 K
+};
+static const uint16_t BLACKBODY_COUNT = sizeof(BLACKBODY) / sizeof(BLACKBODY[0]);
+static_assert(BLACKBODY_COUNT == (MAX_K - MIN_K) / STEP_K + 1, "regenerate BLACKBODY with tools/blackbody.py");
+
+// Written by HTTP handlers, read by the render loop
+static std::atomic<uint32_t> s_cal[2] = { {UNITY}, {UNITY} };
+
+static int slot(int stripIndex)
+{
+  return stripIndex == 2 ? 1 : 0;
+}
+
+void begin()
+{
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, true)) return;
+  s_cal[0] = prefs.getUInt("ws1", UNITY) & UNITY;
+  s_cal[1] = prefs.getUInt("ws2", UNITY) & UNITY;
+  prefs.end();
+}
+
+uint32_t color(uint16_t kelvin)
+{
+  if (kelvin <= MIN_K) return BLACKBODY[0];
+  if (kelvin >= MAX_K) return BLACKBODY[BLACKBODY_COUNT - 1];
+  uint16_t off = kelvin - MIN_K;
+  uint16_t i = off / STEP_K;
+  uint16_t t = (uint16_t)((uint32_t)(off % STEP_K) * 256 / STEP_K);
+  return PixelKernels::lerp(BLACKBODY[i], BLACKBODY[i + 1], t);
+}
+
+uint32_t color(uint16_t kelvin, uint8_t intensity, int stripIndex)
+{
+  return calibrate(color(kelvin), intensity, stripIndex);
+}
+
+uint32_t calibrate(uint32_t c, uint8_t intensity, int stripIndex)
+{
+  uint32_t gain = s_cal[slot(stripIndex)].load(std::memory_order_relaxed);
+  uint32_t f = (uint32_t)intensity + 1;
+  uint32_t out = 0;
+  for (int shift = 0; shift <= 16; shift += 8) {
+    uint32_t v = (c >> shift) & 0xFF;
+    uint32_t g = ((gain >> shift) & 0xFF) + 1;
+    out |= ((v * g * f) >> 16) << shift;
+  }
+  return out;
+}
+
+uint16_t mix(uint16_t fromK, uint16_t toK, uint16_t t)
+{
+  if (t == 0) return fromK;
+  if (t >= 256) return toK;
+  uint32_t from = 1000000UL / (fromK ? fromK : 1);
+  uint32_t to = 1000000UL / (toK ? toK : 1);
+  int32_t mired = (int32_t)from + (((int32_t)to - (int32_t)from) * (int32_t)t) / 256;
+  return (uint16_t)(1000000UL / (uint32_t)(mired > 0 ? mired : 1));
+}
+
+uint32_t calibration(int stripIndex)
+{
+  return s_cal[slot(stripIndex)].load(std::memory_order_relaxed);
+}
+
+void setCalibration(int stripIndex, uint8_t r, uint8_t g, uint8_t b)
+{
+  uint32_t gain = (uint32_t)r << 16 | (uint32_t)g << 8 | b;
+  s_cal[slot(stripIndex)] = gain;
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.putUInt(stripIndex == 2 ? "ws2" : "ws1", gain);
+  prefs.end();
+}
+
+static String gainJson(uint32_t gain)
+{
+  return String("{\"r\":") + String((gain >> 16) & 0xFF) + ",\"g\":" + String((gain >> 8) & 0xFF) + ",\"b\":" + String(gain & 0xFF) + "}";
+}
+
+String calibrationJson()
+{
+  return String("{\"ws1\":") + gainJson(calibration(1)) + ",\"ws2\":" + gainJson(calibration(2)) + "}";
+}
+
+} // namespace ColorTemp
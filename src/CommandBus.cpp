@@ -0,0 +1,181 @@
+#include "CommandBus.h"
+#include "Sequencer.h"
+#include "Scenes.h"
+#include "PowerManager.h"
+#include "EventLog.h"
+#include "Clock.h"
+
+namespace CommandBus {
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static Source s_owner = Source::Schedule;
+static bool s_holding = false;
+static unsigned long s_holdStartMs = 0;    // millis()
+static unsigned long s_holdMs = 0;
+static uint32_t s_defaultHoldMin = DEFAULT_HOLD_MIN;
+static bool s_preempt = false;              // stop what the previous owner runs
+static unsigned long s_preemptAnimMs = 0;   // animation clock at the manual command
+static bool s_resumeNow = false;            // resume() called
+// Last schedule action and when (Clock ms) it started or would have
+static ScheduleAction s_last = { ScheduleAction::None, LEDController::Animation::None, 0, -1 };
+static uint64_t s_lastAtMs = 0;
+static uint32_t s_refusedSchedule = 0;
+static uint32_t s_refusedNetwork = 0;
+
+static const char* const SOURCE_NAMES[] = { "schedule", "network", "manual" };
+static const char* const KIND_NAMES[] = { "none", "anim", "sequence", "scene" };
+
+static bool holdingLocked()
+{
+  return s_holding && millis() - s_holdStartMs < s_holdMs;
+}
+
+void manual(long holdMin)
+{
+  unsigned long animMs = (unsigned long)Clock::ms();
+  bool started;
+  portENTER_CRITICAL(&s_mux);
+  uint32_t minutes = holdMin < 0 ? s_defaultHoldMin : (uint32_t)(holdMin > (long)MAX_HOLD_MIN ? (long)MAX_HOLD_MIN : holdMin);
+  Source prev = s_owner;
+  started = minutes > 0 && !holdingLocked();
+  s_owner = Source::Manual;
+  s_holding = minutes > 0;
+  s_holdStartMs = millis();
+  s_holdMs = minutes * 60000UL;
+  if (prev != Source::Manual) {
+    s_preempt = true;
+    s_preemptAnimMs = animMs;
+  }
+  portEXIT_CRITICAL(&s_mux);
+  // Queued before the command's own sequence start, if any, so that one wins
+  if (prev == Source::Schedule) Sequencer::stop();
+  if (started) EventLog::log(EventLog::Event::OverrideStart, minutes);
+  PowerManager::wake();
+}
+
+bool network()
+{
+  portENTER_CRITICAL(&s_mux);
+  bool ok = !holdingLocked();
+  if (ok) s_owner = Source::Network;
+  else ++s_refusedNetwork;
+  portEXIT_CRITICAL(&s_mux);
+  return ok;
+}
+
+bool schedule(const ScheduleAction& action)
+{
+  uint64_t nowMs = Clock::ms();
+  portENTER_CRITICAL(&s_mux);
+  bool ok = !holdingLocked();
+  if (ok) s_owner = Source::Schedule;
+  else ++s_refusedSchedule;
+  s_last = action;
+  s_lastAtMs = nowMs;
+  portEXIT_CRITICAL(&s_mux);
+  return ok;
+}
+
+void resume()
+{
+  portENTER_CRITICAL(&s_mux);
+  s_resumeNow = s_holding;
+  portEXIT_CRITICAL(&s_mux);
+  PowerManager::wake();
+}
+
+void setDefaultHold(uint32_t minutes)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_defaultHoldMin = minutes > MAX_HOLD_MIN ? MAX_HOLD_MIN : minutes;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+// Carry on with the schedule's last action as if it had never been interrupted
+static void resumeSchedule(const ScheduleAction& a, uint64_t atMs)
+{
+  uint64_t elapsed = Clock::ms() - atMs;
+  switch (a.kind) {
+    case ScheduleAction::Anim:
+      // Effects are functions of the elapsed time; a finished one stays finished
+      if (a.durationMs == 0 || elapsed < a.durationMs)
+        LEDController::startAnimationAt(a.anim, a.durationMs, (unsigned long)atMs);
+      break;
+    case ScheduleAction::Sequence:
+      Sequencer::start(a.slot, elapsed > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)elapsed);
+      break;
+    case ScheduleAction::Scene:
+      Scenes::recall(a.slot);
+      break;
+    case ScheduleAction::None:
+      break;
+  }
+}
+
+void loop()
+{
+  portENTER_CRITICAL(&s_mux);
+  bool preempt = s_preempt;
+  unsigned long preemptMs = s_preemptAnimMs;
+  s_preempt = false;
+  bool expired = s_holding && (s_resumeNow || !holdingLocked());
+  if (expired) {
+    s_holding = false;
+    s_owner = Source::Schedule;
+  }
+  s_resumeNow = false;
+  ScheduleAction last = s_last;
+  uint64_t lastAtMs = s_lastAtMs;
+  portEXIT_CRITICAL(&s_mux);
+
+  // An animation started before the manual command belongs to the previous
+  // owner (starts from the command itself come later)
+  if (preempt && LEDController::currentAnimation() != LEDController::Animation::None &&
+      (long)(LEDController::animationStart() - preemptMs) < 0)
+    LEDController::stopAnimation();
+
+  if (expired) {
+    EventLog::log(EventLog::Event::OverrideEnd, (uint32_t)last.kind);
+    resumeSchedule(last, lastAtMs);
+  }
+}
+
+unsigned long msUntilNext()
+{
+  portENTER_CRITICAL(&s_mux);
+  unsigned long left = 0xFFFFFFFFUL;
+  if (s_preempt || s_resumeNow) left = 0;
+  else if (s_holding) {
+    unsigned long since = millis() - s_holdStartMs;
+    left = since >= s_holdMs ? 0 : s_holdMs - since;
+  }
+  portEXIT_CRITICAL(&s_mux);
+  return left;
+}
+
+String json()
+{
+  portENTER_CRITICAL(&s_mux);
+  Source owner = s_owner;
+  bool holding = holdingLocked();
+  unsigned long left = holding ? s_holdMs - (millis() - s_holdStartMs) : 0;
+  uint32_t defMin = s_defaultHoldMin;
+  ScheduleAction last = s_last;
+  uint64_t lastAtMs = s_lastAtMs;
+  uint32_t refusedSchedule = s_refusedSchedule;
+  uint32_t refusedNetwork = s_refusedNetwork;
+  portEXIT_CRITICAL(&s_mux);
+  uint64_t nowMs = Clock::ms();
+
+  String json = String("{\"owner\":\"") + SOURCE_NAMES[(int)owner] + "\"";
+  json += String(",\"holdMs\":") + String(left);
+  json += String(",\"defaultHoldMin\":") + String(defMin);
+  json += String(",\"resume\":{\"kind\":\"") + KIND_NAMES[(int)last.kind] + "\"";
+  if (last.kind == ScheduleAction::Anim) json += String(",\"anim\":\"") + LEDController::animationName(last.anim) + "\"";
+  if (last.kind == ScheduleAction::Sequence || last.kind == ScheduleAction::Scene) json += String(",\"slot\":") + String(last.slot);
+  if (last.kind != ScheduleAction::None) json += String(",\"ageMs\":") + String((unsigned long)(nowMs - lastAtMs));
+  json += String("},\"refused\":{\"schedule\":") + String(refusedSchedule) + ",\"network\":" + String(refusedNetwork) + "}}";
+  return json;
+}
+
+} // namespace CommandBus
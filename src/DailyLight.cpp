@@ -0,0 +1,310 @@
+#include "DailyLight.h"
+#include "TimeService.h"
+#include "LEDController.h"
+#include "Clock.h"
+#include <Preferences.h>
+#include <atomic>
+#include <time.h>
+
+namespace DailyLight {
+
+static const char* NVS_NAMESPACE = "dli";
+static const time_t TIME_VALID = 1000000000; // same threshold as TimeService::begin
+static const unsigned long CHECK_MS = 1000;  // day change and cap checks (real time)
+// Longer steps between integrations are clock jumps (Clock::simulate), not light
+static const uint64_t MAX_STEP_MS = 3600000ULL;
+// Accumulators are in milli-µmol/m²/s × ms; this many make one mmol/m²
+static const uint64_t UNITS_PER_MMOL = 1000000000ULL;
+static const uint32_t MAX_WEIGHT = 5000;
+static const char* const CHANNEL_NAMES[ChannelCount] = { "pwm", "red", "green", "blue" };
+static const uint32_t DEFAULT_WEIGHTS[ChannelCount] = { 100, 15, 15, 15 };
+
+// Persisted as raw bytes ("today", "days"); change the keys if these change
+struct Today {
+  uint32_t date; // YYYYMMDD, 0 before the clock was set
+  uint64_t acc[ChannelCount];
+};
+struct Day {
+  uint32_t date;
+  uint32_t mmol[ChannelCount];
+};
+struct Ring {
+  uint8_t head;  // next slot to write
+  uint8_t count;
+  Day days[DAYS];
+};
+
+// Written by the render task (and setWeight/setCap), read by /api/dli
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static Today s_today;
+static Ring s_ring;
+static uint32_t s_weight[ChannelCount];   // µmol/m²/s at full output
+static uint32_t s_level[ChannelCount];    // current output, milli-µmol/m²/s
+static uint64_t s_lastMs = 0;             // Clock ms of the last integration
+static uint32_t s_targetMmol = 0;
+static uint8_t s_floor = 0;
+static bool s_capped = false;
+static uint64_t s_cappedAtMs = 0;
+static std::atomic<uint8_t> s_scale(255);
+
+// Render task only
+static uint8_t s_pwmDuty = 0;
+static uint32_t s_stripSum[2][3] = {};
+static uint16_t s_stripPixels[2] = { 0, 0 };
+static bool s_checked = false;
+static unsigned long s_lastCheckMs = 0;
+static unsigned long s_lastSaveMs = 0;
+static Today s_saved;
+
+// Call with s_mux held
+static void integrateLocked(uint64_t nowMs)
+{
+  uint64_t dt = nowMs - s_lastMs;
+  s_lastMs = nowMs;
+  if (dt > MAX_STEP_MS) return;
+  for (int c = 0; c < ChannelCount; ++c) s_today.acc[c] += (uint64_t)s_level[c] * dt;
+}
+
+// Levels from the last reported output. Call with s_mux held.
+static void updateLevelsLocked()
+{
+  s_level[Pwm] = s_weight[Pwm] * 1000u * s_pwmDuty / 255u;
+  uint32_t pixels = (uint32_t)s_stripPixels[0] + s_stripPixels[1];
+  for (int c = 0; c < 3; ++c) {
+    uint64_t sum = (uint64_t)s_stripSum[0][c] + s_stripSum[1][c];
+    s_level[Red + c] = pixels ? (uint32_t)(s_weight[Red + c] * 1000ULL * sum / (255ULL * pixels)) : 0;
+  }
+}
+
+static void pushDayLocked()
+{
+  Day& d = s_ring.days[s_ring.head];
+  d.date = s_today.date;
+  for (int c = 0; c < ChannelCount; ++c) d.mmol[c] = (uint32_t)(s_today.acc[c] / UNITS_PER_MMOL);
+  s_ring.head = (uint8_t)((s_ring.head + 1) % DAYS);
+  if (s_ring.count < DAYS) ++s_ring.count;
+}
+
+static uint32_t localDate()
+{
+  time_t t = TimeService::now();
+  if (t < TIME_VALID) return 0;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  return (uint32_t)(tm.tm_year + 1900) * 10000u + (uint32_t)(tm.tm_mon + 1) * 100u + (uint32_t)tm.tm_mday;
+}
+
+static void save(bool withDays)
+{
+  Today today;
+  Ring ring;
+  portENTER_CRITICAL(&s_mux);
+  today = s_today;
+  if (withDays) ring = s_ring;
+  portEXIT_CRITICAL(&s_mux);
+  s_lastSaveMs = millis();
+  if (!withDays && memcmp(&today, &s_saved, sizeof(today)) == 0) return; // dark since the last save
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.putBytes("today", &today, sizeof(today));
+  if (withDays) prefs.putBytes("days", &ring, sizeof(ring));
+  prefs.end();
+  s_saved = today;
+}
+
+void begin()
+{
+  memset(&s_today, 0, sizeof(s_today));
+  memset(&s_ring, 0, sizeof(s_ring));
+  memcpy(s_weight, DEFAULT_WEIGHTS, sizeof(s_weight));
+  Preferences prefs;
+  if (prefs.begin(NVS_NAMESPACE, true)) {
+    if (prefs.getBytesLength("w") == sizeof(s_weight)) prefs.getBytes("w", s_weight, sizeof(s_weight));
+    if (prefs.getBytesLength("today") == sizeof(s_today)) prefs.getBytes("today", &s_today, sizeof(s_today));
+    if (prefs.getBytesLength("days") == sizeof(s_ring)) prefs.getBytes("days", &s_ring, sizeof(s_ring));
+    s_targetMmol = prefs.getUInt("target", 0);
+    s_floor = prefs.getUChar("floor", 0);
+    prefs.end();
+  }
+  if (s_ring.head >= DAYS || s_ring.count > DAYS) memset(&s_ring, 0, sizeof(s_ring));
+  s_saved = s_today;
+  s_lastMs = Clock::ms();
+}
+
+void setPwm(uint8_t duty)
+{
+  if (duty == s_pwmDuty) return;
+  uint64_t nowMs = Clock::ms();
+  portENTER_CRITICAL(&s_mux);
+  integrateLocked(nowMs);
+  s_pwmDuty = duty;
+  updateLevelsLocked();
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void setStrip(int stripIndex, uint32_t red, uint32_t green, uint32_t blue, uint16_t pixels)
+{
+  int i = stripIndex == 2 ? 1 : 0;
+  uint32_t* sum = s_stripSum[i];
+  if (sum[0] == red && sum[1] == green && sum[2] == blue && s_stripPixels[i] == pixels) return;
+  uint64_t nowMs = Clock::ms();
+  portENTER_CRITICAL(&s_mux);
+  integrateLocked(nowMs);
+  sum[0] = red;
+  sum[1] = green;
+  sum[2] = blue;
+  s_stripPixels[i] = pixels;
+  updateLevelsLocked();
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void loop()
+{
+  unsigned long now = millis();
+  bool ramping = s_capped && s_scale.load() != s_floor;
+  if (s_checked && !ramping && now - s_lastCheckMs < CHECK_MS) return;
+  s_lastCheckMs = now;
+  uint32_t date = localDate();
+  uint64_t nowMs = Clock::ms();
+  bool newDay = false;
+  uint8_t scale = 255;
+  portENTER_CRITICAL(&s_mux);
+  integrateLocked(nowMs);
+  if (date && date != s_today.date) {
+    // Light from before the clock was set counts for the day it was set on
+    if (s_today.date) {
+      pushDayLocked();
+      memset(s_today.acc, 0, sizeof(s_today.acc));
+    }
+    s_today.date = date;
+    s_capped = false;
+    newDay = true;
+  }
+  uint64_t total = 0;
+  for (int c = 0; c < ChannelCount; ++c) total += s_today.acc[c];
+  if (!s_targetMmol || total < (uint64_t)s_targetMmol * UNITS_PER_MMOL) {
+    s_capped = false; // no target, or it was raised
+  } else if (!s_capped) {
+    s_capped = true;
+    // Already over the target at boot: no ramp
+    s_cappedAtMs = s_checked ? nowMs : nowMs - RAMP_MS;
+  }
+  if (s_capped) {
+    uint64_t since = nowMs - s_cappedAtMs;
+    scale = since >= RAMP_MS ? s_floor : (uint8_t)(255 - (uint32_t)(255 - s_floor) * (uint32_t)since / RAMP_MS);
+  }
+  portEXIT_CRITICAL(&s_mux);
+  s_scale.store(scale);
+  s_checked = true;
+  if (newDay || now - s_lastSaveMs >= SAVE_MS) save(newDay);
+}
+
+unsigned long msUntilNext()
+{
+  if (!s_checked || (s_capped && s_scale.load() != s_floor)) return LEDController::FRAME_INTERVAL_MS;
+  unsigned long since = millis() - s_lastCheckMs;
+  return since >= CHECK_MS ? 0 : CHECK_MS - since;
+}
+
+uint8_t outputScale()
+{
+  return s_scale.load();
+}
+
+void setWeight(Channel channel, uint32_t ppfd)
+{
+  if (channel < 0 || channel >= ChannelCount) return;
+  uint64_t nowMs = Clock::ms();
+  uint32_t weights[ChannelCount];
+  portENTER_CRITICAL(&s_mux);
+  integrateLocked(nowMs);
+  s_weight[channel] = ppfd > MAX_WEIGHT ? MAX_WEIGHT : ppfd;
+  updateLevelsLocked();
+  memcpy(weights, s_weight, sizeof(weights));
+  portEXIT_CRITICAL(&s_mux);
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.putBytes("w", weights, sizeof(weights));
+  prefs.end();
+}
+
+void setCap(uint32_t targetMmol, uint8_t floor)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_targetMmol = targetMmol; // applied by the next check
+  s_floor = floor;
+  portEXIT_CRITICAL(&s_mux);
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.putUInt("target", targetMmol);
+  prefs.putUChar("floor", floor);
+  prefs.end();
+}
+
+uint32_t capTarget()
+{
+  portENTER_CRITICAL(&s_mux);
+  uint32_t v = s_targetMmol;
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+uint8_t capFloor()
+{
+  portENTER_CRITICAL(&s_mux);
+  uint8_t v = s_floor;
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+static String mol(uint64_t units)
+{
+  return String((double)units / (double)UNITS_PER_MMOL / 1000.0, 3);
+}
+
+String json()
+{
+  Today today;
+  Ring ring;
+  uint32_t weights[ChannelCount];
+  uint32_t levels[ChannelCount];
+  portENTER_CRITICAL(&s_mux);
+  today = s_today;
+  ring = s_ring;
+  memcpy(weights, s_weight, sizeof(weights));
+  memcpy(levels, s_level, sizeof(levels));
+  uint32_t target = s_targetMmol;
+  uint8_t floor = s_floor;
+  bool capped = s_capped;
+  portEXIT_CRITICAL(&s_mux);
+
+  uint64_t total = 0;
+  uint32_t ppfd = 0;
+  for (int c = 0; c < ChannelCount; ++c) {
+    total += today.acc[c];
+    ppfd += levels[c];
+  }
+  String json = String("{\"date\":") + String(today.date);
+  json += String(",\"ppfd\":") + String(ppfd / 1000.0, 1);
+  json += String(",\"today\":{\"mol\":") + mol(total);
+  for (int c = 0; c < ChannelCount; ++c) json += String(",\"") + CHANNEL_NAMES[c] + "\":" + mol(today.acc[c]);
+  json += "},\"weights\":{";
+  for (int c = 0; c < ChannelCount; ++c) json += String(c ? "," : "") + "\"" + CHANNEL_NAMES[c] + "\":" + String(weights[c]);
+  json += String("},\"cap\":{\"target\":") + String(target / 1000.0, 3);
+  json += String(",\"floor\":") + String(floor);
+  json += String(",\"capped\":") + (capped ? "true" : "false");
+  json += String(",\"scale\":") + String(outputScale());
+  json += "},\"days\":[";
+  for (int i = 0; i < ring.count; ++i) {
+    const Day& d = ring.days[(ring.head + DAYS - 1 - i) % DAYS];
+    uint32_t sum = 0;
+    for (int c = 0; c < ChannelCount; ++c) sum += d.mmol[c];
+    json += String(i ? "," : "") + "{\"date\":" + String(d.date) + ",\"mol\":" + String(sum / 1000.0, 3);
+    for (int c = 0; c < ChannelCount; ++c) json += String(",\"") + CHANNEL_NAMES[c] + "\":" + String(d.mmol[c] / 1000.0, 3);
+    json += "}";
+  }
+  json += "]}";
+  return json;
+}
+
+} // namespace DailyLight
@@ -0,0 +1,385 @@
+#include "EffectVM.h"
+#include "LEDController.h"
+#include "PixelKernels.h"
+#include "Noise.h"
+#include "PowerManager.h"
+#include <LittleFS.h>
+#include <atomic>
+
+namespace EffectVM {
+
+struct OpInfo {
+  uint8_t imm;    // immediate bytes
+  uint8_t pops;
+  uint8_t pushes;
+};
+
+// Indexed by Op
+static const OpInfo OPS[(int)Op::OpCount] = {
+  {1, 0, 1}, {2, 0, 1}, {4, 0, 1}, {1, 0, 1},             // Push8 Push16 Push32 Param
+  {0, 0, 1}, {0, 0, 1}, {0, 0, 1}, {0, 0, 1}, {0, 0, 1}, {0, 0, 1}, // Idx Pos Len Count Side Time
+  {0, 1, 2}, {0, 1, 0}, {0, 2, 2}, {0, 2, 3},             // Dup Drop Swap Over
+  {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1},  // Add Sub Mul Div Mod
+  {0, 1, 1}, {0, 1, 1},                                   // Neg Abs
+  {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, {0, 2, 1}, // Min .. Shr
+  {0, 2, 1}, {0, 2, 1}, {0, 2, 1},                        // Lt Gt Eq
+  {0, 3, 1},                                              // Sel
+  {0, 3, 1},                                              // Muldiv
+  {0, 1, 1}, {0, 1, 1}, {0, 1, 1},                        // Sin8 Tri8 Clamp8
+  {0, 2, 1},                                              // Scale8
+  {0, 3, 1},                                              // Rgb
+  {0, 3, 1},                                              // Lerpc
+  {0, 2, 1},                                              // Scalec
+  {0, 2, 1},                                              // Addc
+  {0, 1, 0},                                              // Out
+  {0, 2, 1},                                              // Noise2
+  {0, 3, 1},                                              // Noise3
+};
+
+// 128 + 127 * sin(2 pi i / 256)
+static const uint8_t SIN8[256] = {
+  128, 131, 134, 137, 140, 144, 147, 150, 153, 156, 159, 162, 165, 168, 171, 174,
+  177, 179, 182, 185, 188, 191, 193, 196, 199, 201, 204, 206, 209, 211, 213, 216,
+  218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 239, 240, 241, 243, 244,
+  245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+  255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+  245, 244, 243, 241, 240, 239, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+  218, 216, 213, 211, 209, 206, 204, 201, 199, 196, 193, 191, 188, 185, 182, 179,
+  177, 174, 171, 168, 165, 162, 159, 156, 153, 150, 147, 144, 140, 137, 134, 131,
+  128, 125, 122, 119, 116, 112, 109, 106, 103, 100,  97,  94,  91,  88,  85,  82,
+   79,  77,  74,  71,  68,  65,  63,  60,  57,  55,  52,  50,  47,  45,  43,  40,
+   38,  36,  34,  32,  30,  28,  26,  24,  22,  21,  19,  17,  16,  15,  13,  12,
+   11,  10,   8,   7,   6,   6,   5,   4,   3,   3,   2,   2,   2,   1,   1,   1,
+    1,   1,   1,   1,   2,   2,   2,   3,   3,   4,   5,   6,   6,   7,   8,  10,
+   11,  12,  13,  15,  16,  17,  19,  21,  22,  24,  26,  28,  30,  32,  34,  36,
+   38,  40,  43,  45,  47,  50,  52,  55,  57,  60,  63,  65,  68,  71,  74,  77,
+   79,  82,  85,  88,  91,  94,  97, 100, 103, 106, 109, 112, 116, 119, 122, 125,
+};
+
+// Waves as a program (tools/fxasm.py form):
+//   #003264 #05e6ff                      ; deep and crest colors
+//   pos 256 mul len div                  ; position along the strip, 256 per strip
+//   time 51 1000 muldiv add              ; + phase, 51/256 turn per second
+//   sin8 dup mul 8 shr                   ; contrast curve
+//   lerpc out
+const uint8_t WAVES_CODE[] = {
+  (uint8_t)Op::Push32, 0x64, 0x32, 0x00, 0x00,
+  (uint8_t)Op::Push32, 0xFF, 0xE6, 0x05, 0x00,
+  (uint8_t)Op::Pos, (uint8_t)Op::Push16, 0x00, 0x01, (uint8_t)Op::Mul, (uint8_t)Op::Len, (uint8_t)Op::Div,
+  (uint8_t)Op::Time, (uint8_t)Op::Push8, 51, (uint8_t)Op::Push16, 0xE8, 0x03, (uint8_t)Op::Muldiv, (uint8_t)Op::Add,
+  (uint8_t)Op::Sin8, (uint8_t)Op::Dup, (uint8_t)Op::Mul, (uint8_t)Op::Push8, 8, (uint8_t)Op::Shr,
+  (uint8_t)Op::Lerpc, (uint8_t)Op::Out,
+};
+const size_t WAVES_LENGTH = sizeof(WAVES_CODE);
+
+// ------------------- verifier -------------------
+
+const char* verify(const uint8_t* code, size_t length, Program& out)
+{
+  if (!code || length == 0) return "empty";
+  if (length > MAX_CODE) return "too long";
+  int depth = 0, maxDepth = 0;
+  uint16_t ops = 0;
+  size_t pc = 0;
+  bool ended = false;
+  while (pc < length) {
+    uint8_t op = code[pc];
+    if (op >= (uint8_t)Op::OpCount) return "unknown opcode";
+    const OpInfo& info = OPS[op];
+    if (pc + 1 + info.imm > length) return "truncated immediate";
+    if ((Op)op == Op::Param && code[pc + 1] >= PARAM_COUNT) return "param index";
+    if (depth < info.pops) return "stack underflow";
+    depth += info.pushes - info.pops;
+    if (depth > MAX_STACK) return "stack overflow";
+    if (depth > maxDepth) maxDepth = depth;
+    ++ops;
+    pc += 1 + info.imm;
+    if ((Op)op == Op::Out) {
+      if (pc != length) return "code after out";
+      if (depth != 0) return "out must leave an empty stack";
+      ended = true;
+    }
+  }
+  if (!ended) return "missing out";
+  memcpy(out.code, code, length);
+  out.length = (uint16_t)length;
+  out.ops = ops;
+  out.maxStack = (uint8_t)maxDepth;
+  return nullptr;
+}
+
+// ------------------- interpreter -------------------
+
+static inline int32_t clamp8(int32_t v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+uint32_t run(const Program& prog, const Inputs& in)
+{
+  int32_t st[MAX_STACK];
+  int sp = 0; // number of values on the stack
+  const uint8_t* pc = prog.code;
+  for (;;) {
+    Op op = (Op)*pc++;
+    switch (op) {
+      case Op::Push8:  st[sp++] = *pc++; break;
+      case Op::Push16: st[sp++] = (int16_t)(pc[0] | (pc[1] << 8)); pc += 2; break;
+      case Op::Push32:
+        st[sp++] = (int32_t)((uint32_t)pc[0] | ((uint32_t)pc[1] << 8) | ((uint32_t)pc[2] << 16) | ((uint32_t)pc[3] << 24));
+        pc += 4;
+        break;
+      case Op::Param:  st[sp++] = in.params[*pc++]; break;
+      case Op::Idx:    st[sp++] = in.idx; break;
+      case Op::Pos:    st[sp++] = in.pos; break;
+      case Op::Len:    st[sp++] = in.len; break;
+      case Op::Count:  st[sp++] = in.count; break;
+      case Op::Side:   st[sp++] = in.side; break;
+      case Op::Time:   st[sp++] = in.time; break;
+      case Op::Dup:    st[sp] = st[sp - 1]; ++sp; break;
+      case Op::Drop:   --sp; break;
+      case Op::Swap:   { int32_t t = st[sp - 1]; st[sp - 1] = st[sp - 2]; st[sp - 2] = t; break; }
+      case Op::Over:   st[sp] = st[sp - 2]; ++sp; break;
+      default: {
+        // Binary and ternary operators: operands a (deepest) .. c (top)
+        int32_t* s = st + sp;
+        switch (op) {
+          case Op::Add: s[-2] = (int32_t)((uint32_t)s[-2] + (uint32_t)s[-1]); --sp; break;
+          case Op::Sub: s[-2] = (int32_t)((uint32_t)s[-2] - (uint32_t)s[-1]); --sp; break;
+          case Op::Mul: s[-2] = (int32_t)((uint32_t)s[-2] * (uint32_t)s[-1]); --sp; break;
+          case Op::Div:
+            s[-2] = (s[-1] == 0 || (s[-1] == -1 && s[-2] == INT32_MIN)) ? 0 : s[-2] / s[-1];
+            --sp;
+            break;
+          case Op::Mod:
+            s[-2] = (s[-1] == 0 || s[-1] == -1) ? 0 : s[-2] % s[-1];
+            --sp;
+            break;
+          case Op::Neg: s[-1] = (int32_t)(0u - (uint32_t)s[-1]); break;
+          case Op::Abs: if (s[-1] < 0) s[-1] = (int32_t)(0u - (uint32_t)s[-1]); break;
+          case Op::Min: if (s[-1] < s[-2]) s[-2] = s[-1]; --sp; break;
+          case Op::Max: if (s[-1] > s[-2]) s[-2] = s[-1]; --sp; break;
+          case Op::And: s[-2] &= s[-1]; --sp; break;
+          case Op::Or:  s[-2] |= s[-1]; --sp; break;
+          case Op::Xor: s[-2] ^= s[-1]; --sp; break;
+          case Op::Shl: s[-2] = (int32_t)((uint32_t)s[-2] << (s[-1] & 31)); --sp; break;
+          case Op::Shr: s[-2] = s[-2] >> (s[-1] & 31); --sp; break;
+          case Op::Lt:  s[-2] = s[-2] < s[-1]; --sp; break;
+          case Op::Gt:  s[-2] = s[-2] > s[-1]; --sp; break;
+          case Op::Eq:  s[-2] = s[-2] == s[-1]; --sp; break;
+          case Op::Sel: s[-3] = s[-3] ? s[-2] : s[-1]; sp -= 2; break;
+          case Op::Muldiv:
+            s[-3] = s[-1] == 0 ? 0 : (int32_t)((int64_t)s[-3] * s[-2] / s[-1]);
+            sp -= 2;
+            break;
+          case Op::Sin8: s[-1] = SIN8[s[-1] & 255]; break;
+          case Op::Tri8: { int32_t x = s[-1] & 255; s[-1] = x < 128 ? 2 * x : 511 - 2 * x; break; }
+          case Op::Clamp8: s[-1] = clamp8(s[-1]); break;
+          case Op::Scale8: s[-2] = (int32_t)(((int64_t)s[-2] * (clamp8(s[-1]) + 1)) >> 8); --sp; break;
+          case Op::Rgb:
+            s[-3] = (clamp8(s[-3]) << 16) | (clamp8(s[-2]) << 8) | clamp8(s[-1]);
+            sp -= 2;
+            break;
+          case Op::Lerpc: {
+            int32_t t = s[-1] < 0 ? 0 : (s[-1] > 256 ? 256 : s[-1]);
+            s[-3] = (int32_t)PixelKernels::lerp((uint32_t)s[-3] & 0xFFFFFF, (uint32_t)s[-2] & 0xFFFFFF, (uint16_t)t);
+            sp -= 2;
+            break;
+          }
+          case Op::Scalec:
+            s[-2] = (int32_t)PixelKernels::scale((uint32_t)s[-2] & 0xFFFFFF, (uint8_t)clamp8(s[-1]));
+            --sp;
+            break;
+          case Op::Addc:
+            s[-2] = (int32_t)PixelKernels::addSat((uint32_t)s[-2] & 0xFFFFFF, (uint32_t)s[-1] & 0xFFFFFF);
+            --sp;
+            break;
+          case Op::Noise2: s[-2] = Noise::noise2((uint32_t)s[-2], (uint32_t)s[-1]); --sp; break;
+          case Op::Noise3:
+            s[-3] = Noise::noise3((uint32_t)s[-3], (uint32_t)s[-2], (uint32_t)s[-1]);
+            sp -= 2;
+            break;
+          default: // Out (verify() guarantees it is last and the only value left)
+            return (uint32_t)st[0] & 0xFFFFFF;
+        }
+      }
+    }
+  }
+}
+
+void render(const Program& prog, uint32_t* frame, uint16_t total, uint16_t n2,
+            uint32_t timeMs, const int32_t* params)
+{
+  Inputs in;
+  in.count = total;
+  in.time = (int32_t)(timeMs & 0x7FFFFFFF);
+  in.params = params;
+  for (uint16_t ci = 0; ci < total; ++ci) {
+    bool left = ci < n2;
+    in.idx = ci;
+    in.side = left ? 0 : 1;
+    in.pos = left ? n2 - 1 - ci : ci - n2;
+    in.len = left ? n2 : total - n2;
+    frame[ci] = run(prog, in);
+  }
+}
+
+// ------------------- storage -------------------
+
+static bool validName(const char* name)
+{
+  if (!name || !*name) return false;
+  size_t len = 0;
+  for (const char* p = name; *p; ++p, ++len) {
+    char c = *p;
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!ok) return false;
+  }
+  return len < NAME_LEN;
+}
+
+static bool pathFor(const char* name, char* out, size_t outLen)
+{
+  if (!validName(name)) return false;
+  snprintf(out, outLen, "/fx/%s.fx", name);
+  return true;
+}
+
+bool store(const char* name, const uint8_t* code, size_t length, Program& out, const char** err)
+{
+  char path[32];
+  if (!pathFor(name, path, sizeof(path))) { if (err) *err = "name"; return false; }
+  const char* why = verify(code, length, out);
+  if (why) { if (err) *err = why; return false; }
+  LittleFS.mkdir("/fx");
+  File f = LittleFS.open(path, FILE_WRITE);
+  if (!f || f.write(code, length) != length) {
+    if (f) f.close();
+    if (err) *err = "write";
+    return false;
+  }
+  f.close();
+  return true;
+}
+
+bool load(const char* name, Program& out)
+{
+  char path[32];
+  if (!pathFor(name, path, sizeof(path))) return false;
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return false;
+  uint8_t code[MAX_CODE];
+  size_t len = f.size() <= MAX_CODE ? f.read(code, f.size()) : 0;
+  f.close();
+  // Verified again: the file may have been replaced by other means
+  return len > 0 && verify(code, len, out) == nullptr;
+}
+
+bool exists(const char* name)
+{
+  char path[32];
+  return pathFor(name, path, sizeof(path)) && LittleFS.exists(path);
+}
+
+bool remove(const char* name)
+{
+  char path[32];
+  return pathFor(name, path, sizeof(path)) && LittleFS.remove(path);
+}
+
+// ------------------- running effect -------------------
+
+struct StartRequest {
+  char name[NAME_LEN];
+  int32_t params[PARAM_COUNT];
+  uint8_t brightness;
+  unsigned long durationMs;
+};
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static StartRequest s_request;
+static std::atomic<bool> s_pending(false);
+
+// Render task only, except s_activeName (read by listJson under s_mux)
+static Program s_active;
+static bool s_activeValid = false;
+static int32_t s_activeParams[PARAM_COUNT];
+static uint8_t s_activeBrightness = 255;
+static char s_activeName[NAME_LEN] = "";
+
+bool start(const char* name, const int32_t* params, uint8_t brightness, unsigned long durationMs)
+{
+  if (!exists(name)) return false;
+  portENTER_CRITICAL(&s_mux);
+  strncpy(s_request.name, name, NAME_LEN - 1);
+  s_request.name[NAME_LEN - 1] = '\0';
+  for (int i = 0; i < PARAM_COUNT; ++i) s_request.params[i] = params ? params[i] : 0;
+  s_request.brightness = brightness;
+  s_request.durationMs = durationMs;
+  portEXIT_CRITICAL(&s_mux);
+  s_pending.store(true); // a newer start replaces one not yet applied
+  PowerManager::wake();
+  return true;
+}
+
+void loop()
+{
+  if (!s_pending.exchange(false)) return;
+  StartRequest req;
+  portENTER_CRITICAL(&s_mux);
+  req = s_request;
+  portEXIT_CRITICAL(&s_mux);
+
+  if (!load(req.name, s_active)) return;
+  s_activeValid = true;
+  memcpy(s_activeParams, req.params, sizeof(s_activeParams));
+  s_activeBrightness = req.brightness;
+  portENTER_CRITICAL(&s_mux);
+  memcpy(s_activeName, req.name, NAME_LEN);
+  portEXIT_CRITICAL(&s_mux);
+  LEDController::startAnimation(LEDController::Animation::Program, req.durationMs);
+}
+
+void renderActive(uint32_t* frame, uint16_t total, uint16_t n2, uint32_t timeMs)
+{
+  if (!s_activeValid) {
+    PixelKernels::fill(frame, total, 0);
+    return;
+  }
+  render(s_active, frame, total, n2, timeMs, s_activeParams);
+}
+
+uint8_t activeBrightness()
+{
+  return s_activeBrightness;
+}
+
+String listJson()
+{
+  char running[NAME_LEN];
+  portENTER_CRITICAL(&s_mux);
+  memcpy(running, s_activeName, NAME_LEN);
+  portEXIT_CRITICAL(&s_mux);
+  bool live = running[0] && LEDController::currentAnimation() == LEDController::Animation::Program;
+
+  String json = String("{\"running\":") + (live ? String("\"") + running + "\"" : String("null")) + ",\"programs\":[";
+  File dir = LittleFS.open("/fx");
+  bool first = true;
+  if (dir && dir.isDirectory()) {
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+      String name = f.name();
+      int slash = name.lastIndexOf('/');
+      if (slash >= 0) name = name.substring(slash + 1);
+      if (name.endsWith(".fx")) {
+        if (!first) json += ",";
+        first = false;
+        json += String("{\"name\":\"") + name.substring(0, name.length() - 3) + "\",\"bytes\":" + String((uint32_t)f.size()) + "}";
+      }
+      f.close();
+    }
+  }
+  json += "]}";
+  return json;
+}
+
+} // namespace EffectVM
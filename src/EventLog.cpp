@@ -0,0 +1,175 @@
+#include "EventLog.h"
+#include <atomic>
+
+namespace EventLog {
+
+static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+// A slot is published by storing seq + 1 into `commit` after the payload;
+// 0 marks a slot being (re)written. Readers copy the payload between two
+// loads of `commit` and keep the copy only if both match (seqlock).
+struct Slot {
+  std::atomic<uint32_t> commit;
+  uint32_t ms;
+  uint16_t event;
+  uint32_t args[MAX_ARGS];
+};
+
+static Slot s_slots[CAPACITY];
+static std::atomic<uint32_t> s_head(0);
+
+struct EventInfo {
+  const char* name;
+  // printf-like: %u %d %x consume one argument, %i an IPv4 address,
+  // %T epoch seconds (UTC), %% a percent sign
+  const char* format;
+};
+
+static const EventInfo EVENTS[(int)Event::Count] = {
+  { "boot",               "Boot" },
+  { "fs_mount_failed",    "LittleFS mount failed" },
+  { "wifi",               "WiFi connected: %u, IP: %i" },
+  { "time_sync",          "Time synced: %u, now=%T" },
+  { "time_sync_deferred", "Deferred time sync: %u, now=%T" },
+  { "http_started",       "HTTP server started" },
+  { "ota_start",          "OTA Start" },
+  { "ota_progress",       "OTA Progress: %u%%" },
+  { "ota_end",            "OTA End: %u bytes in %u ms (%u B/s)" },
+  { "ota_error",          "OTA Error[%u]" },
+  { "heap_fragmented",    "Heap fragmented: largest block %u < %u (free %u)" },
+  { "sync_leader",        "Sync leader: %x (self: %u)" },
+  { "override_start",     "Manual override for %u min" },
+  { "override_end",       "Manual override ended, resuming schedule (%u)" },
+  { "state_restored",     "Restored live state (%u), %u s in" },
+};
+
+void log(Event e, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+  uint32_t seq = s_head.fetch_add(1, std::memory_order_relaxed);
+  Slot& s = s_slots[seq & (CAPACITY - 1)];
+  s.commit.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.ms = millis();
+  s.event = (uint16_t)e;
+  s.args[0] = a0;
+  s.args[1] = a1;
+  s.args[2] = a2;
+  s.args[3] = a3;
+  s.commit.store(seq + 1, std::memory_order_release);
+}
+
+uint32_t head()
+{
+  return s_head.load(std::memory_order_acquire);
+}
+
+size_t read(uint32_t cursor, Record* out, size_t max, uint32_t& next, uint32_t& dropped)
+{
+  uint32_t end = head();
+  dropped = 0;
+  if (end - cursor > CAPACITY) { // cursor fell behind the ring
+    dropped = end - CAPACITY - cursor;
+    cursor = end - CAPACITY;
+  }
+  size_t n = 0;
+  for (; cursor != end && n < max; ++cursor) {
+    const Slot& s = s_slots[cursor & (CAPACITY - 1)];
+    uint32_t c1 = s.commit.load(std::memory_order_acquire);
+    // 0 or an older lap: the writer has claimed the slot but not finished.
+    // Stop here so records stay in order; the next read resumes at it.
+    if (c1 == 0 || (int32_t)(c1 - (cursor + 1)) < 0) break;
+    Record r;
+    r.seq = cursor;
+    r.ms = s.ms;
+    r.event = s.event;
+    memcpy(r.args, s.args, sizeof(r.args));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t c2 = s.commit.load(std::memory_order_relaxed);
+    if (c1 != cursor + 1 || c2 != c1) {
+      ++dropped; // overwritten by a newer record meanwhile
+      continue;
+    }
+    out[n++] = r;
+  }
+  next = cursor;
+  return n;
+}
+
+const char* eventName(uint16_t event)
+{
+  return event < (uint16_t)Event::Count ? EVENTS[event].name : "unknown";
+}
+
+String format(const Record& r)
+{
+  if (r.event >= (uint16_t)Event::Count) return String("event ") + r.event;
+  String out;
+  int arg = 0;
+  char buf[32];
+  for (const char* p = EVENTS[r.event].format; *p; ++p) {
+    if (*p != '%' || !p[1]) { out += *p; continue; }
+    char spec = *++p;
+    if (spec == '%') { out += '%'; continue; }
+    uint32_t v = arg < MAX_ARGS ? r.args[arg++] : 0;
+    switch (spec) {
+      case 'd': snprintf(buf, sizeof(buf), "%ld", (long)(int32_t)v); break;
+      case 'x': snprintf(buf, sizeof(buf), "%lx", (unsigned long)v); break;
+      case 'i': snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (unsigned)(v & 255), (unsigned)((v >> 8) & 255),
+                         (unsigned)((v >> 16) & 255), (unsigned)(v >> 24)); break;
+      case 'T': {
+        time_t t = (time_t)v;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        break;
+      }
+      default: snprintf(buf, sizeof(buf), "%lu", (unsigned long)v); break;
+    }
+    out += buf;
+  }
+  return out;
+}
+
+String json(uint32_t cursor, size_t max)
+{
+  static const size_t BATCH = 16;
+  Record recs[BATCH];
+  if (max > BATCH) max = BATCH;
+  uint32_t next, dropped;
+  size_t n = read(cursor, recs, max, next, dropped);
+  String out = String("{\"next\":") + String(next) + ",\"dropped\":" + String(dropped) + ",\"events\":[";
+  for (size_t i = 0; i < n; ++i) {
+    if (i) out += ",";
+    out += String("{\"seq\":") + String(recs[i].seq) + ",\"ms\":" + String(recs[i].ms) +
+           ",\"event\":\"" + eventName(recs[i].event) + "\",\"text\":\"" + format(recs[i]) + "\"}";
+  }
+  out += "]}";
+  return out;
+}
+
+static void drainTask(void* arg)
+{
+  TickType_t period = pdMS_TO_TICKS((unsigned long)(uintptr_t)arg);
+  uint32_t cursor = 0;
+  Record recs[8];
+  for (;;) {
+    uint32_t next, dropped;
+    size_t n = read(cursor, recs, 8, next, dropped);
+    if (dropped) Serial.printf("[log] %u records dropped\n", (unsigned)dropped);
+    for (size_t i = 0; i < n; ++i) {
+      Serial.printf("[%lu] %s\n", (unsigned long)recs[i].ms, format(recs[i]).c_str());
+    }
+    cursor = next;
+    if (n < 8) vTaskDelay(period);
+  }
+}
+
+void startSerialDrain(unsigned long periodMs)
+{
+  static TaskHandle_t task = nullptr;
+  if (task) return;
+  // Below the loop task (priority 1): printing never delays a frame
+  xTaskCreatePinnedToCore(drainTask, "logdrain", 3072, (void*)(uintptr_t)periodMs, tskIDLE_PRIORITY, &task, 1);
+}
+
+} // namespace EventLog
@@ -0,0 +1,268 @@
+#include "FrameRecorder.h"
+#include <LittleFS.h>
+
+namespace FrameRecorder {
+
+static const uint8_t FORMAT_VERSION = 1;
+static const uint8_t FLAG_PWM = 0x01;
+static const uint8_t FLAG_PIXELS = 0x02;
+// Unchanged gaps shorter than this are folded into the surrounding run: a
+// new run costs at least two varint bytes.
+static const uint16_t RUN_MERGE_GAP = 3;
+
+static File s_file;
+static bool s_recording = false;
+static uint32_t s_frames = 0;
+static uint16_t s_bytes = 0;
+static uint8_t s_prev[MAX_FRAME_BYTES];
+static uint8_t s_prevPwm = 0;
+static unsigned long s_prevMs = 0;
+
+// Small staging buffer so a frame costs one flash write at most.
+static uint8_t s_out[512];
+static size_t s_outLen = 0;
+
+static void flushOut()
+{
+  if (s_outLen && s_file) s_file.write(s_out, s_outLen);
+  s_outLen = 0;
+}
+
+static void putByte(uint8_t b)
+{
+  if (s_outLen == sizeof(s_out)) flushOut();
+  s_out[s_outLen++] = b;
+}
+
+static void putVarint(uint32_t v)
+{
+  while (v >= 0x80) {
+    putByte((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  putByte((uint8_t)v);
+}
+
+static void putU16(uint16_t v)
+{
+  putByte((uint8_t)v);
+  putByte((uint8_t)(v >> 8));
+}
+
+bool start(const char* path, uint16_t n2, uint16_t n1)
+{
+  stop();
+  uint32_t bytes = 3u * ((uint32_t)n2 + n1);
+  if (bytes > MAX_FRAME_BYTES) return false;
+  s_file = LittleFS.open(path, FILE_WRITE);
+  if (!s_file) return false;
+  s_bytes = (uint16_t)bytes;
+  memset(s_prev, 0, sizeof(s_prev));
+  s_prevPwm = 0;
+  s_prevMs = 0;
+  s_frames = 0;
+  s_outLen = 0;
+  putByte('A'); putByte('L'); putByte('F'); putByte('R');
+  putByte(FORMAT_VERSION);
+  putByte(3);
+  putU16(n2);
+  putU16(n1);
+  putU16(0);
+  s_recording = true;
+  return true;
+}
+
+void stop()
+{
+  if (!s_recording) return;
+  flushOut();
+  s_file.close();
+  s_recording = false;
+}
+
+bool recording()
+{
+  return s_recording;
+}
+
+uint32_t framesRecorded()
+{
+  return s_frames;
+}
+
+void capture(unsigned long nowMs, uint8_t pwm, const uint8_t* pixels)
+{
+  if (!s_recording) return;
+
+  // Count runs first so the run count can precede them.
+  uint32_t runCount = 0;
+  for (uint16_t i = 0; i < s_bytes; ) {
+    if (pixels[i] == s_prev[i]) { ++i; continue; }
+    ++runCount;
+    uint16_t gap = 0;
+    while (i < s_bytes && gap < RUN_MERGE_GAP) {
+      gap = (pixels[i] == s_prev[i]) ? gap + 1 : 0;
+      ++i;
+    }
+  }
+
+  uint8_t flags = 0;
+  if (s_frames == 0 || pwm != s_prevPwm) flags |= FLAG_PWM;
+  if (runCount) flags |= FLAG_PIXELS;
+  putByte(flags);
+  putVarint(s_frames == 0 ? 0 : (uint32_t)(nowMs - s_prevMs));
+  if (flags & FLAG_PWM) putByte(pwm);
+  if (flags & FLAG_PIXELS) {
+    putVarint(runCount);
+    uint16_t last = 0; // end of previous run
+    for (uint16_t i = 0; i < s_bytes; ) {
+      if (pixels[i] == s_prev[i]) { ++i; continue; }
+      uint16_t begin = i;
+      uint16_t end = i; // one past last changed byte
+      uint16_t gap = 0;
+      while (i < s_bytes && gap < RUN_MERGE_GAP) {
+        if (pixels[i] == s_prev[i]) {
+          ++gap;
+        } else {
+          gap = 0;
+          end = i + 1;
+        }
+        ++i;
+      }
+      putVarint(begin - last);
+      putVarint(end - begin);
+      for (uint16_t k = begin; k < end; ++k) putByte(pixels[k]);
+      last = end;
+      i = end;
+    }
+    memcpy(s_prev, pixels, s_bytes);
+  }
+  flushOut();
+
+  s_prevPwm = pwm;
+  s_prevMs = nowMs;
+  ++s_frames;
+}
+
+// ------------------- Reader -------------------
+
+bool Reader::open(const char* path)
+{
+  close();
+  m_file = LittleFS.open(path, FILE_READ);
+  if (!m_file) return false;
+  uint8_t hdr[12];
+  if (m_file.read(hdr, sizeof(hdr)) != sizeof(hdr) ||
+      hdr[0] != 'A' || hdr[1] != 'L' || hdr[2] != 'F' || hdr[3] != 'R' ||
+      hdr[4] != FORMAT_VERSION || hdr[5] != 3) {
+    close();
+    return false;
+  }
+  m_n2 = (uint16_t)(hdr[6] | (hdr[7] << 8));
+  m_n1 = (uint16_t)(hdr[8] | (hdr[9] << 8));
+  uint32_t bytes = 3u * ((uint32_t)m_n2 + m_n1);
+  if (bytes > MAX_FRAME_BYTES) {
+    close();
+    return false;
+  }
+  m_bytes = (uint16_t)bytes;
+  memset(m_frame, 0, sizeof(m_frame));
+  m_pwm = 0;
+  m_timeMs = 0;
+  return true;
+}
+
+void Reader::close()
+{
+  if (m_file) m_file.close();
+}
+
+bool Reader::readVarint(uint32_t& out)
+{
+  out = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = m_file.read();
+    if (c < 0) return false;
+    out |= (uint32_t)(c & 0x7F) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+bool Reader::next()
+{
+  if (!m_file) return false;
+  int flags = m_file.read();
+  if (flags < 0) return false;
+  uint32_t dt;
+  if (!readVarint(dt)) return false;
+  m_timeMs += dt;
+  if (flags & FLAG_PWM) {
+    int p = m_file.read();
+    if (p < 0) return false;
+    m_pwm = (uint8_t)p;
+  }
+  if (flags & FLAG_PIXELS) {
+    uint32_t runs;
+    if (!readVarint(runs)) return false;
+    uint32_t pos = 0;
+    for (uint32_t r = 0; r < runs; ++r) {
+      uint32_t skip, len;
+      if (!readVarint(skip) || !readVarint(len)) return false;
+      pos += skip;
+      if (pos + len > m_bytes) return false;
+      if (m_file.read(m_frame + pos, len) != len) return false;
+      pos += len;
+    }
+  }
+  return true;
+}
+
+// ------------------- Diff -------------------
+
+bool diff(const char* pathA, const char* pathB, uint8_t tolerance, DiffReport& out)
+{
+  memset(&out, 0, sizeof(out));
+  out.firstMismatch = -1;
+  // Readers carry a frame buffer each; keep them off the caller's stack.
+  static Reader a;
+  static Reader b;
+  if (!a.open(pathA)) return false;
+  if (!b.open(pathB)) {
+    a.close();
+    return false;
+  }
+  if (a.n1() != b.n1() || a.n2() != b.n2()) {
+    out.layoutMismatch = true;
+    a.close();
+    b.close();
+    return false;
+  }
+  while (true) {
+    bool hasA = a.next();
+    bool hasB = b.next();
+    if (hasA != hasB) out.lengthMismatch = true;
+    if (!hasA || !hasB) break;
+
+    uint8_t frameMax = (uint8_t)abs((int)a.pwm() - (int)b.pwm());
+    const uint8_t* pa = a.pixels();
+    const uint8_t* pb = b.pixels();
+    for (uint16_t i = 0; i < a.frameBytes(); ++i) {
+      uint8_t d = (uint8_t)abs((int)pa[i] - (int)pb[i]);
+      if (d > frameMax) frameMax = d;
+    }
+    long skew = labs((long)a.timeMs() - (long)b.timeMs());
+    if (skew > out.maxTimeSkewMs) out.maxTimeSkewMs = skew;
+    if (frameMax > out.maxDelta) out.maxDelta = frameMax;
+    if (frameMax > tolerance) {
+      if (out.firstMismatch < 0) out.firstMismatch = (int32_t)out.frames;
+      ++out.mismatched;
+    }
+    ++out.frames;
+  }
+  a.close();
+  b.close();
+  return !out.lengthMismatch && out.mismatched == 0;
+}
+
+} // namespace FrameRecorder
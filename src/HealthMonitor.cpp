@@ -0,0 +1,98 @@
+#include "HealthMonitor.h"
+#include "EventLog.h"
+
+namespace HealthMonitor {
+
+static const char* const TASK_NAMES[TASK_COUNT] = { "loopTask", "async_tcp", "ota" };
+static const int RING_SIZE = 60;
+
+static Sample s_ring[RING_SIZE];
+static int s_head = 0;   // next slot to write
+static int s_count = 0;
+static unsigned long s_intervalMs = 60000UL;
+static unsigned long s_lastSample = 0;
+static uint32_t s_warnBytes = 8192;
+static bool s_warned = false;
+// Lifetime minimums (UINT32_MAX until the first sample)
+static uint32_t s_minLargestBlock = UINT32_MAX;
+static uint32_t s_minStackFree[TASK_COUNT];
+static TaskHandle_t s_tasks[TASK_COUNT];
+
+static void takeSample()
+{
+  Sample& s = s_ring[s_head];
+  s.uptimeS = millis() / 1000UL;
+  s.freeHeap = ESP.getFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  s.minFreeHeap = ESP.getMinFreeHeap();
+  for (int i = 0; i < TASK_COUNT; ++i) {
+    // Tasks may start late (async_tcp is created on the first connection)
+    if (!s_tasks[i]) s_tasks[i] = xTaskGetHandle(TASK_NAMES[i]);
+    // ESP-IDF reports the high-water mark in bytes
+    s.stackFree[i] = s_tasks[i] ? (uint32_t)uxTaskGetStackHighWaterMark(s_tasks[i]) : 0;
+    if (s_tasks[i] && s.stackFree[i] < s_minStackFree[i]) s_minStackFree[i] = s.stackFree[i];
+  }
+  if (s.largestBlock < s_minLargestBlock) s_minLargestBlock = s.largestBlock;
+
+  // Edge-triggered warning so a fragmented heap does not flood the log
+  if (s.largestBlock < s_warnBytes && !s_warned) {
+    EventLog::log(EventLog::Event::HeapFragmented, s.largestBlock, s_warnBytes, s.freeHeap);
+    s_warned = true;
+  } else if (s.largestBlock >= s_warnBytes) {
+    s_warned = false;
+  }
+
+  s_head = (s_head + 1) % RING_SIZE;
+  if (s_count < RING_SIZE) ++s_count;
+}
+
+void begin(unsigned long intervalMs, uint32_t largestBlockWarn)
+{
+  s_intervalMs = intervalMs;
+  s_warnBytes = largestBlockWarn;
+  for (int i = 0; i < TASK_COUNT; ++i) {
+    s_tasks[i] = nullptr;
+    s_minStackFree[i] = UINT32_MAX;
+  }
+  takeSample();
+  s_lastSample = millis();
+}
+
+void loop()
+{
+  unsigned long nowMs = millis();
+  if (nowMs - s_lastSample < s_intervalMs) return;
+  s_lastSample = nowMs;
+  takeSample();
+}
+
+static void printSample(Print& out, const Sample& s)
+{
+  out.printf("{\"uptimeS\":%u,\"freeHeap\":%u,\"largestBlock\":%u,\"minFreeHeap\":%u,\"stackFree\":{",
+             (unsigned)s.uptimeS, (unsigned)s.freeHeap, (unsigned)s.largestBlock, (unsigned)s.minFreeHeap);
+  for (int i = 0; i < TASK_COUNT; ++i)
+    out.printf("%s\"%s\":%u", i ? "," : "", TASK_NAMES[i], (unsigned)s.stackFree[i]);
+  out.print("}}");
+}
+
+void json(Print& out)
+{
+  // Written on the HTTP task while the loop task may add a sample; a torn
+  // sample only affects this one report.
+  out.print("{\"current\":");
+  if (s_count) printSample(out, s_ring[(s_head + RING_SIZE - 1) % RING_SIZE]);
+  else out.print("null");
+  out.printf(",\"intervalMs\":%lu,\"warnLargestBlock\":%u,\"minLargestBlock\":%u,\"minStackFree\":{",
+             s_intervalMs, (unsigned)s_warnBytes, (unsigned)s_minLargestBlock);
+  for (int i = 0; i < TASK_COUNT; ++i)
+    out.printf("%s\"%s\":%u", i ? "," : "", TASK_NAMES[i], (unsigned)(s_minStackFree[i] == UINT32_MAX ? 0 : s_minStackFree[i]));
+  out.print("},\"samples\":[");
+  int start = (s_head + RING_SIZE - s_count) % RING_SIZE;
+  for (int i = 0; i < s_count; ++i) {
+    if (i) out.print(",");
+    printSample(out, s_ring[(start + i) % RING_SIZE]);
+  }
+  out.print("]}");
+}
+
+} // namespace HealthMonitor
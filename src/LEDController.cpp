@@ -1,5 +1,16 @@
 #include "LEDController.h"
+#include "StripStore.h"
+#include "FrameRecorder.h"
+#include "PixelOutput.h"
+#include "PixelKernels.h"
+#include "Noise.h"
+#include "Clock.h"
+#include "ColorTemp.h"
+#include "DailyLight.h"
+#include "PowerManager.h"
+#include "StateVersion.h"
 #include <Adafruit_NeoPixel.h>
+#include <atomic>
 
 namespace LEDController
 {
@@ -7,8 +18,38 @@ namespace LEDController
   // Internal state
   static Adafruit_NeoPixel *s_strip1 = nullptr;
   static Adafruit_NeoPixel *s_strip2 = nullptr;
-  static volatile bool s_ws1Dirty = false;
-  static volatile bool s_ws2Dirty = false;
+  static int s_pwmChannel = 0;
+  // Last duty written to the PWM strip by this module
+  static uint8_t s_pwmDuty = 0;
+  // Duty the PWM hardware holds (-1 unknown); equal writes are skipped
+  static int s_hwDuty = -1;
+  // Daily light cap (DailyLight::outputScale) applied to all live output
+  static uint8_t s_outScale = 255;
+  // Offline rendering fills the pixel buffers without touching the hardware
+  static bool s_suppressOutput = false;
+  // Set whenever a strip was flushed during the current loop
+  static bool s_framePresented = false;
+  // Baked playback state
+  static FrameRecorder::Reader s_player;
+  static char s_playerPath[32] = "";
+  static bool s_playerRepeat = false;
+  static bool s_playerPrimed = false; // a decoded frame is waiting for its time
+  // Start of the last rendered frame, for frame pacing
+  static unsigned long s_lastFrameMs = 0;
+  static LEDController::FrameStats s_frameStats = {0, 0, 0, 0, 0};
+  static std::atomic<bool> s_frameStatsReset(false);
+  // Output held by setOutputFrozen (OTA upload)
+  static std::atomic<bool> s_frozen(false);
+  // Pending recorder request (written by requestRecorder, consumed by loop)
+  static LEDController::RecorderRequest s_recRequest;
+  static std::atomic<bool> s_recPending(false);
+  // StripStore generations last applied to the hardware. A static strip is
+  // only redrawn when its generation moves (or a redraw is forced).
+  static uint32_t s_dimGen = 0;
+  static uint32_t s_ws1Gen = 0;
+  static uint32_t s_ws2Gen = 0;
+  static std::atomic<bool> s_ws1Force(false);
+  static std::atomic<bool> s_ws2Force(false);
   // Track last-set brightness for strips (0..255). Use 0 as off.
   static uint8_t s_ws1Brightness = 0;
   static uint8_t s_ws2Brightness = 0;
@@ -16,8 +57,6 @@ namespace LEDController
   static LEDController::Animation s_currentAnim = LEDController::Animation::None;
   static unsigned long s_animStart = 0;
   static unsigned long s_animDur = 0;
-  // Wave animation phase
-  static float s_wavePhase = 0.0f;
   // Police animation state
   static unsigned long s_policeLastToggle = 0;
   static bool s_policeBlue = false;
@@ -35,6 +74,185 @@ namespace LEDController
     ledcSetup(channel, freq, res);
     ledcAttachPin(pin, channel);
     ledcWrite(channel, initialDuty);
+    s_pwmChannel = channel;
+    s_pwmDuty = initialDuty;
+    s_hwDuty = initialDuty;
+    DailyLight::setPwm(initialDuty);
+    PowerManager::pwmOutput(initialDuty > 0);
+    StateVersion::bump(StateVersion::Dim);
+    s_dimGen = StripStore::generation(StripStore::Dim);
+  }
+
+  // Report a flushed strip to the light integral (DailyLight)
+  static void meter(Adafruit_NeoPixel *strip)
+  {
+    uint32_t r = 0, g = 0, b = 0;
+    uint16_t n = strip->numPixels();
+    for (uint16_t i = 0; i < n; ++i)
+    {
+      uint32_t c = strip->getPixelColor(i);
+      r += (c >> 16) & 0xFF;
+      g += (c >> 8) & 0xFF;
+      b += c & 0xFF;
+    }
+    DailyLight::setStrip(strip == s_strip1 ? 1 : 2, r, g, b, n);
+  }
+
+  // Flush a strip. All strip output goes through here so frames can be
+  // recorded and output suppressed during offline rendering.
+  static void present(Adafruit_NeoPixel *strip)
+  {
+    if (!s_suppressOutput)
+    {
+      strip->show();
+      meter(strip);
+    }
+    s_framePresented = true;
+  }
+
+  // Live output level under the daily light cap (offline renders are not capped)
+  static uint8_t capLevel(uint8_t v)
+  {
+    if (s_outScale == 255 || s_suppressOutput)
+      return v;
+    return (uint8_t)(((uint16_t)v * (s_outScale + 1)) >> 8);
+  }
+
+  // Logical animation frame (layout in PixelOutput.h) and the writer that
+  // scatters it into the strip buffers: generic until useFixedOutput() picks
+  // the writer specialized for the installation.
+  static uint32_t s_frame[PixelOutput::MAX_PIXELS];
+  // Last frame presentFrame flushed: a frame equal to it at the same
+  // brightness is not written again (the strips already show it)
+  static uint32_t s_shownFrame[PixelOutput::MAX_PIXELS];
+  static int s_shownBrightness = -1; // -1: strips changed since, redraw
+
+  // Static per-pixel images (POST /api/pixels), triple buffered: the uploader
+  // fills s_images[s_imgBack] and swaps it into s_imgReady, the render task
+  // swaps the newest one into s_imgFront. Image contents are only written by
+  // the uploader, so the last image it published stays stable while it is
+  // copied into the next upload.
+  static const uint8_t IMG_NEW = 0x80; // s_imgReady holds an image not picked up yet
+  static uint32_t s_images[3][PixelOutput::MAX_PIXELS];
+  static uint8_t s_imgMasks[3] = {0, 0, 0}; // strips showing the image (bit 0 strip 1, bit 1 strip 2)
+  static uint8_t s_imgFront = 0;            // render task
+  static std::atomic<uint8_t> s_imgReady(1);
+  static uint8_t s_imgBack = 2;             // uploader
+  static uint8_t s_imgLast = 0;             // uploader: buffer published last
+  // Upload ownership: generation << 2 | IMG_OWNED while an upload (or a
+  // clear) holds the back buffer, | IMG_WRITING while it writes to it. The
+  // render task drops an upload idle for PIXELS_STALL_MS by clearing
+  // IMG_OWNED, which only succeeds between writes; its token is then stale.
+  static const uint32_t IMG_WRITING = 1;
+  static const uint32_t IMG_OWNED = 2;
+  static std::atomic<uint32_t> s_imgOwner(0);
+  static std::atomic<unsigned long> s_imgTouchMs(0); // owner's last write
+  static PixelOutput::Writer s_writer = &PixelOutput::writeGeneric;
+  static PixelOutput::Writer s_fixedWriter = nullptr;
+  static neoPixelType s_fixedOrder = NEO_GRB;
+
+  // Every change of the running animation goes through here (/api/state)
+  static void setAnimation(LEDController::Animation anim)
+  {
+    if (anim == s_currentAnim)
+      return;
+    s_currentAnim = anim;
+    StateVersion::bump(StateVersion::Animation);
+  }
+
+  static uint16_t frameLength()
+  {
+    if (!s_strip1 || !s_strip2)
+      return 0;
+    uint32_t n = (uint32_t)s_strip2->numPixels() + s_strip1->numPixels();
+    return n > PixelOutput::MAX_PIXELS ? PixelOutput::MAX_PIXELS : (uint16_t)n;
+  }
+
+  // Set logical pixels [from, to) to one color
+  static void fillFrame(uint32_t color, uint16_t from, uint16_t to)
+  {
+    if (to > from)
+      PixelKernels::fill(s_frame + from, to - from, color);
+  }
+
+  // Fill logical pixels [from, to) with a color at `intensity`, each strip
+  // through its own calibration (strip 2 is the start of the frame)
+  static void fillCalibrated(uint32_t color, uint8_t intensity, uint16_t from, uint16_t to)
+  {
+    uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
+    if (from < n2)
+      fillFrame(ColorTemp::calibrate(color, intensity, 2), from, min(to, n2));
+    if (to > n2)
+      fillFrame(ColorTemp::calibrate(color, intensity, 1), max(from, n2), to);
+  }
+
+  static void fillKelvin(uint16_t kelvin, uint8_t intensity, uint16_t from, uint16_t to)
+  {
+    fillCalibrated(ColorTemp::color(kelvin), intensity, from, to);
+  }
+
+  // Put the logical frame on both strips at `brightness` and flush them
+  static void presentFrame(uint8_t brightness)
+  {
+    if (!s_strip1 || !s_strip2)
+      return;
+    brightness = capLevel(brightness);
+    size_t bytes = (size_t)frameLength() * sizeof(uint32_t);
+    if (s_suppressOutput)
+      s_shownBrightness = -1; // the buffers no longer hold what the strips show
+    else if (s_shownBrightness == brightness && memcmp(s_frame, s_shownFrame, bytes) == 0)
+    {
+      s_framePresented = true; // unchanged output still counts as a frame
+      return;
+    }
+    else
+    {
+      memcpy(s_shownFrame, s_frame, bytes);
+      s_shownBrightness = brightness;
+    }
+    // The writer scales by brightness itself; keep the library unscaled
+    if (s_strip2->getBrightness() != 255)
+      s_strip2->setBrightness(255);
+    if (s_strip1->getBrightness() != 255)
+      s_strip1->setBrightness(255);
+    s_writer(s_frame, brightness, *s_strip2, *s_strip1);
+    present(s_strip2);
+    present(s_strip1);
+  }
+
+  // Write the PWM strip duty (all PWM output from animations goes through here)
+  static void writePwm(uint8_t duty)
+  {
+    s_pwmDuty = duty;
+    s_framePresented = true;
+    uint8_t hw = capLevel(duty);
+    if (!s_suppressOutput && s_hwDuty != hw)
+    {
+      ledcWrite(s_pwmChannel, hw);
+      s_hwDuty = hw;
+      DailyLight::setPwm(hw);
+      PowerManager::pwmOutput(hw > 0);
+      StateVersion::bump(StateVersion::Dim);
+    }
+  }
+
+  // Combined pixel buffer (left strip2 then right strip1) for the recorder
+  static void captureFrame(unsigned long now)
+  {
+    static uint8_t frame[FrameRecorder::MAX_FRAME_BYTES];
+    size_t len = 0;
+    Adafruit_NeoPixel *order[2] = {s_strip2, s_strip1};
+    for (int i = 0; i < 2; ++i)
+    {
+      if (!order[i])
+        continue;
+      size_t bytes = (size_t)order[i]->numPixels() * 3;
+      if (len + bytes > sizeof(frame))
+        return;
+      memcpy(frame + len, order[i]->getPixels(), bytes);
+      len += bytes;
+    }
+    FrameRecorder::capture(now, s_pwmDuty, frame);
   }
 
   void registerStrips(Adafruit_NeoPixel &strip1, Adafruit_NeoPixel &strip2)
@@ -53,193 +271,437 @@ namespace LEDController
     }
   }
 
-  void setPwmDuty(int channel, uint8_t duty)
+  // Whether `strip` stores its bytes in `order`: write a probe into pixel 0,
+  // see where each channel landed, then put the pixel back
+  static bool orderMatches(Adafruit_NeoPixel &strip, neoPixelType order)
+  {
+    if (strip.numPixels() == 0)
+      return true;
+    uint8_t *px = strip.getPixels();
+    uint8_t saved[3];
+    memcpy(saved, px, sizeof(saved));
+    strip.setPixelColor(0, 0x010203);
+    bool match = px[(order >> 4) & 3] == 1 && px[(order >> 2) & 3] == 2 && px[order & 3] == 3;
+    memcpy(px, saved, sizeof(saved));
+    return match;
+  }
+
+  bool setOutputWriter(PixelOutput::Writer writer, neoPixelType order, uint16_t n2, uint16_t n1)
+  {
+    if (!s_strip1 || !s_strip2 || s_strip2->numPixels() != n2 || s_strip1->numPixels() != n1 ||
+        !orderMatches(*s_strip2, order) || !orderMatches(*s_strip1, order))
+      return false; // keep the generic writer
+    s_fixedWriter = writer;
+    s_fixedOrder = order;
+    s_writer = writer;
+    return true;
+  }
+
+  OutputBench benchOutput(uint32_t iterations)
   {
+    OutputBench res = {iterations, 0, 0, 0, s_writer != &PixelOutput::writeGeneric, false};
+    uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
+    uint16_t n1 = s_strip1 ? s_strip1->numPixels() : 0;
+    res.pixels = n2 + n1;
+    if (!s_fixedWriter || iterations == 0 || res.pixels > PixelOutput::MAX_PIXELS)
+      return res;
+    // Scratch strips and frame, so the live output is not touched
+    static uint32_t frame[PixelOutput::MAX_PIXELS];
+    for (uint16_t i = 0; i < res.pixels; ++i)
+      frame[i] = (uint32_t)i * 0x010305u + 0x402010u;
+    Adafruit_NeoPixel fixedL(n2, -1, s_fixedOrder), fixedR(n1, -1, s_fixedOrder);
+    Adafruit_NeoPixel genericL(n2, -1, s_fixedOrder), genericR(n1, -1, s_fixedOrder);
+
+    uint32_t t0 = micros();
+    for (uint32_t i = 0; i < iterations; ++i)
+      s_fixedWriter(frame, (uint8_t)(200 + (i & 7)), fixedL, fixedR);
+    res.fixedUs = micros() - t0;
+    t0 = micros();
+    for (uint32_t i = 0; i < iterations; ++i)
+      PixelOutput::writeGeneric(frame, (uint8_t)(200 + (i & 7)), genericL, genericR);
+    res.genericUs = micros() - t0;
+
+    res.match = memcmp(fixedL.getPixels(), genericL.getPixels(), (size_t)n2 * 3) == 0 &&
+                memcmp(fixedR.getPixels(), genericR.getPixels(), (size_t)n1 * 3) == 0;
+    return res;
+  }
+
+  static void setPwmDuty(int channel, uint8_t duty)
+  {
+    if (channel == s_pwmChannel)
+    {
+      writePwm(duty);
+      return;
+    }
     ledcWrite(channel, duty);
   }
 
-  void setStripSolid(Adafruit_NeoPixel &strip, const StripState &st)
+  // Brightness a static strip is drawn at, remembered for readStripHardware
+  static uint8_t staticBrightness(Adafruit_NeoPixel &strip, const StripState &st)
+  {
+    uint8_t b = capLevel(st.on ? st.brightness : 0);
+    uint8_t &shown = &strip == s_strip1 ? s_ws1Brightness : s_ws2Brightness;
+    if (shown != b)
+    {
+      shown = b;
+      StateVersion::bump(&strip == s_strip1 ? StateVersion::Ws1 : StateVersion::Ws2);
+    }
+    // Scale once and store the result; the library stays unscaled
+    if (strip.getBrightness() != 255)
+      strip.setBrightness(255);
+    return b;
+  }
+
+  static void setStripSolid(Adafruit_NeoPixel &strip, const StripState &st)
   {
-    uint8_t b = st.on ? st.brightness : 0;
-    strip.setBrightness(b);
-    // remember which strip we updated
-    if (&strip == s_strip1)
-      s_ws1Brightness = b;
-    if (&strip == s_strip2)
-      s_ws2Brightness = b;
-    uint32_t c = strip.Color(st.r, st.g, st.b);
+    s_shownBrightness = -1;
+    uint8_t b = staticBrightness(strip, st);
+    uint32_t c = PixelKernels::scale(Adafruit_NeoPixel::Color(st.r, st.g, st.b), b);
     strip.fill(c, 0, strip.numPixels());
-    strip.show();
+    present(&strip);
+  }
+
+  // Draw strip 1 or 2 from the current image instead of its solid color
+  static void setStripImage(Adafruit_NeoPixel &strip, int stripIndex, const StripState &st)
+  {
+    s_shownBrightness = -1;
+    uint8_t b = staticBrightness(strip, st);
+    const uint32_t *img = s_images[s_imgFront];
+    uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
+    uint16_t n = strip.numPixels();
+    for (uint16_t j = 0; j < n; ++j)
+    {
+      uint32_t i = stripIndex == 2 ? (uint32_t)n2 - 1 - j : (uint32_t)n2 + j;
+      strip.setPixelColor(j, i < PixelOutput::MAX_PIXELS ? PixelKernels::scale(img[i], b) : 0);
+    }
+    present(&strip);
   }
 
   void markDirty(int stripIndex)
   {
     if (stripIndex == 1)
-      s_ws1Dirty = true;
+      s_ws1Force.store(true);
     if (stripIndex == 2)
-      s_ws2Dirty = true;
+      s_ws2Force.store(true);
   }
 
-  void loop(StripState &ws1State, StripState &ws2State)
+  // Redraw a static strip from its StripStore snapshot if the snapshot moved
+  // since the last redraw or a redraw was forced via markDirty().
+  static void renderStatic(Adafruit_NeoPixel *strip, StripStore::Target t, uint32_t &renderedGen, std::atomic<bool> &force)
   {
-    unsigned long now = millis();
+    if (!strip)
+      return;
+    bool forced = force.exchange(false);
+    if (!forced && StripStore::generation(t) == renderedGen)
+      return;
+    uint32_t gen;
+    StripState st = StripStore::read(t, gen);
+    renderedGen = gen;
+    StripStore::markApplied(t, gen);
+    int stripIndex = t == StripStore::WS2 ? 2 : 1;
+    if (s_imgMasks[s_imgFront] & (1 << (stripIndex - 1)))
+      setStripImage(*strip, stripIndex, st);
+    else
+      setStripSolid(*strip, st);
+  }
+
+  // Pick up a newly published image and redraw both strips from it
+  static void takeImage()
+  {
+    if (!(s_imgReady.load() & IMG_NEW))
+      return;
+    s_imgFront = s_imgReady.exchange(s_imgFront) & 3;
+    s_ws1Force.store(true);
+    s_ws2Force.store(true);
+  }
+
+  static bool openPlayback()
+  {
+    if (!s_strip1 || !s_strip2 || !s_player.open(s_playerPath))
+      return false;
+    if (s_player.n2() != s_strip2->numPixels() || s_player.n1() != s_strip1->numPixels())
+    {
+      s_player.close();
+      return false;
+    }
+    s_playerPrimed = s_player.next();
+    return s_playerPrimed;
+  }
+
+  // Baked playback: copy every frame that is due at `now` into the strip
+  // buffers and flush once.
+  static void renderPlayback(unsigned long now)
+  {
+    unsigned long elapsed = now - s_animStart;
+    bool copied = false;
+    while (s_playerPrimed && s_player.timeMs() <= elapsed)
+    {
+      size_t n2Bytes = (size_t)s_strip2->numPixels() * 3;
+      memcpy(s_strip2->getPixels(), s_player.pixels(), n2Bytes);
+      memcpy(s_strip1->getPixels(), s_player.pixels() + n2Bytes, (size_t)s_strip1->numPixels() * 3);
+      writePwm(s_player.pwm());
+      copied = true;
+      s_playerPrimed = s_player.next();
+    }
+    if (copied)
+    {
+      // Baked frames bypass presentFrame; cap their bytes here
+      if (s_outScale != 255)
+      {
+        Adafruit_NeoPixel *order[2] = {s_strip2, s_strip1};
+        for (int k = 0; k < 2; ++k)
+        {
+          uint8_t *px = order[k]->getPixels();
+          for (size_t i = 0, n = (size_t)order[k]->numPixels() * 3; i < n; ++i)
+            px[i] = capLevel(px[i]);
+        }
+      }
+      s_shownBrightness = -1;
+      present(s_strip2);
+      present(s_strip1);
+    }
+    if (s_playerPrimed)
+      return;
+    s_player.close();
+    if (s_playerRepeat && openPlayback())
+    {
+      s_animStart = now;
+      return;
+    }
+    setAnimation(LEDController::Animation::None);
+    markDirty(1);
+    markDirty(2);
+  }
+
+  // Waves: each strip runs its own wave from its first pixel, deep blue to cyan
+  static void renderWaves(uint32_t *frame, uint16_t total, uint16_t n2, float phase)
+  {
+    static const uint32_t WAVE_DEEP = 0x003264;  // (0, 50, 100)
+    static const uint32_t WAVE_CREST = 0x05E6FF; // (5, 230, 255)
+    for (uint16_t ci = 0; ci < total; ++ci)
+    {
+      bool left = ci < n2;
+      uint16_t i = left ? n2 - 1 - ci : ci - n2;
+      uint16_t n = left ? n2 : total - n2;
+      float x = (float)i / (float)n;
+      float wave = (sinf((x * 6.28318f) + phase) + 1.0f) / 2.0f; // 0..1
+      // increase contrast by applying a simple curve
+      wave = powf(wave, 1.8f);
+      frame[ci] = PixelKernels::lerp(WAVE_DEEP, WAVE_CREST, (uint16_t)(wave * 256.0f));
+    }
+  }
+
+  // Position of logical pixel ci within its own strip, counted from the
+  // strip's first pixel, and which strip (0 = left)
+  static inline uint16_t stripPos(uint16_t ci, uint16_t n2, uint8_t &side)
+  {
+    side = ci < n2 ? 0 : 1;
+    return ci < n2 ? n2 - 1 - ci : ci - n2;
+  }
+
+  // Caustics: rippling lines of refracted sunlight on a blue-green floor. Two
+  // ridged noise layers drift in opposite directions; light is brightest
+  // where their lines cross.
+  static void renderCaustics(uint32_t *frame, uint16_t total, uint16_t n2, uint32_t ms)
+  {
+    static const uint32_t FLOOR = 0x002A3C;
+    static const uint32_t LIGHT = 0xB4FFF0;
+    for (uint16_t ci = 0; ci < total; ++ci)
+    {
+      uint8_t side;
+      uint32_t x = (uint32_t)stripPos(ci, n2, side) * 96;
+      uint32_t y = (uint32_t)side << 14; // strips sample different rows
+      uint32_t a = Noise::ridge(Noise::noise3(x + ms / 12, y, ms / 4));
+      uint32_t b = Noise::ridge(Noise::noise3(x * 3 / 2 - ms / 16, y + 0x800, ms / 5));
+      uint32_t v = (a * b) >> 8;
+      v = (v * v) >> 8; // thin, sharp lines
+      frame[ci] = PixelKernels::add(FLOOR, LIGHT, (uint8_t)v);
+    }
+  }
+
+  // Clouds: daylight with soft shadows drifting along the tank (about one
+  // pixel per second) and slowly changing shape.
+  static void renderClouds(uint32_t *frame, uint16_t total, uint16_t n2, uint32_t ms)
+  {
+    static const uint32_t SUN = 0xFFF0D8;
+    static const uint32_t SHADOW = 0x384050;
+    for (uint16_t ci = 0; ci < total; ++ci)
+    {
+      uint8_t side;
+      uint32_t x = (uint32_t)stripPos(ci, n2, side) * 48 + ms / 20;
+      uint32_t c = Noise::fractal2(x, ((uint32_t)side << 10) + ms / 80, 3);
+      // clear sky below the threshold, deepening shadow above it
+      uint32_t shade = c > 110 ? (c - 110) * 2 : 0;
+      if (shade > 220)
+        shade = 220;
+      frame[ci] = PixelKernels::lerp(SUN, SHADOW, (uint16_t)shade);
+    }
+  }
+
+  // Storm: dark rolling clouds and lightning. Time is split into 4.096 s
+  // slots; a hash of the slot decides whether it has a strike, when, where
+  // and how many pulses, so the storm is a pure function of time (offline
+  // renders are reproducible). Returns the flash level (0..255) for the PWM strip.
+  static uint8_t renderStorm(uint32_t *frame, uint16_t total, uint16_t n2, uint32_t ms)
+  {
+    static const uint32_t SKY_DARK = 0x04060C;
+    static const uint32_t SKY_LIGHT = 0x1C2434;
+    static const uint32_t BOLT = 0xC8D8FF;
+    static const uint32_t PULSE_MS = 70;
+    static const uint32_t PULSE_GAP_MS = 130;
+
+    uint32_t h = (ms >> 12) * 2654435761u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    uint32_t flash = 0;
+    if (h & 3) // three slots in four have a strike
+    {
+      int32_t dt = (int32_t)(ms & 4095) - (int32_t)((h >> 2) % 3000);
+      uint32_t pulses = 1 + (h >> 12) % 3;
+      for (uint32_t k = 0; k < pulses && dt >= 0; ++k)
+      {
+        int32_t into = dt - (int32_t)(k * PULSE_GAP_MS);
+        if (into >= 0 && into < (int32_t)PULSE_MS)
+          flash = 255 * (PULSE_MS - into) / PULSE_MS / (k + 1 == pulses ? 1 : 2);
+      }
+    }
+    uint16_t center = total ? (uint16_t)((h >> 16) % total) : 0;
+    uint16_t spread = total / 2 + 1;
+    for (uint16_t ci = 0; ci < total; ++ci)
+    {
+      uint8_t side;
+      uint32_t x = (uint32_t)stripPos(ci, n2, side) * 64 + ms / 8;
+      uint8_t c = Noise::fractal2(x, ((uint32_t)side << 10) + ms / 40, 3);
+      uint32_t px = PixelKernels::lerp(SKY_DARK, SKY_LIGHT, c);
+      if (flash)
+      {
+        uint16_t d = ci > center ? ci - center : center - ci;
+        if (d > spread)
+          d = spread;
+        // the whole sky lights up a little, most of it near the bolt
+        uint32_t level = flash / 3 + flash * 2 / 3 * (spread - d) / spread;
+        px = PixelKernels::add(px, BOLT, (uint8_t)level);
+      }
+      frame[ci] = px;
+    }
+    return (uint8_t)flash;
+  }
+
+  // Storm darkens the PWM strip to a quarter of its set level between flashes
+  static uint8_t stormBaseDuty()
+  {
+    StripState dim = StripStore::read(StripStore::Dim);
+    return dim.on ? dim.brightness / 4 : 0;
+  }
+
+  // Render one frame for time `now` (ms, same clock as s_animStart)
+  static void render(unsigned long now)
+  {
+    // Apply dim (PWM) state changes. Animations that drive the PWM strip
+    // overwrite this on their next frame, as they did before.
+    if (StripStore::generation(StripStore::Dim) != s_dimGen)
+    {
+      StripState dim = StripStore::read(StripStore::Dim, s_dimGen);
+      StripStore::markApplied(StripStore::Dim, s_dimGen);
+      setPwmDuty(s_pwmChannel, dim.on ? dim.brightness : 0);
+    }
+
+    if (s_currentAnim == LEDController::Animation::Playback)
+    {
+      renderPlayback(now);
+      return;
+    }
 
     // Handle animations first (override static color)
     if (s_currentAnim != LEDController::Animation::None)
     {
-      // Combined strips length (left = s_strip2, right = s_strip1)
-      uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
-      uint16_t n1 = s_strip1 ? s_strip1->numPixels() : 0;
-      uint16_t total = n2 + n1;
+      if (!s_strip1 || !s_strip2)
+        return;
+      // Logical frame: left strip (s_strip2) from its far end, then s_strip1
+      uint16_t n2 = s_strip2->numPixels();
+      uint16_t total = frameLength();
       unsigned long elapsed = now - s_animStart;
       unsigned long totalDur = max(1UL, s_animDur);
       float overallP = (float)elapsed / (float)totalDur;
       if (overallP > 1.0f)
         overallP = 1.0f;
 
-      // Helper to map combined index -> strip & pixel. For sunrise/sunset we
-      // reuse this to allow directional fill.
-      auto mapCombinedToStrip = [&](uint16_t combinedIdx, Adafruit_NeoPixel *&outStrip, uint16_t &outPixel) -> void
-      {
-        uint16_t logical = combinedIdx;
-        if (logical < n2)
-        {
-          // Left strip (s_strip2): invert index so combined 0 -> last pixel on left strip
-          outStrip = s_strip2;
-          outPixel = (n2 > 0) ? (n2 - 1 - logical) : 0;
-        }
-        else
-        {
-          // Right strip (s_strip1): normal mapping left-to-right inside right strip
-          outStrip = s_strip1;
-          outPixel = (n1 > 0) ? (logical - n2) : 0;
-        }
-      };
-
       if (s_currentAnim == LEDController::Animation::Sunrise)
       {
-        // Two-stage sunrise:
-        // - Stage 1 (0.0 .. 0.5 overallP): addressable fill from dark -> red; PWM remains off.
-        // - Stage 2 (0.5 .. 1.0 overallP): addressable transition red -> white; PWM fades 0 -> 255.
+        // Two-stage sunrise on the blackbody curve:
+        // - Stage 1 (0.0 .. 0.5 overallP): pixels fill from dark with embers warming 1000 -> 1800 K; PWM remains off.
+        // - Stage 2 (0.5 .. 1.0 overallP): all pixels 1800 -> 6500 K; PWM fades 0 -> 255.
         if (total > 0)
         {
           if (overallP < 0.5f)
           {
             float stageP = overallP * 2.0f; // 0..1 for stage 1
-            uint16_t numRed = (uint16_t)ceil(stageP * (float)total);
-            uint8_t redIntensity = (uint8_t)min(255, (int)(5 + stageP * 200.0f));
-            for (uint16_t ci = 0; ci < total; ++ci)
-            {
-              Adafruit_NeoPixel *strip;
-              uint16_t pix;
-              mapCombinedToStrip(ci, strip, pix);
-              if (!strip)
-                continue;
-              if (ci < numRed)
-              {
-                strip->setPixelColor(pix, strip->Color(redIntensity, 0, 0));
-              }
-              else
-              {
-                strip->setPixelColor(pix, 0);
-              }
-            }
-            // keep addressable brightness moderate during red draw
-            if (s_strip2)
-            {
-              s_strip2->setBrightness(120);
-              s_strip2->show();
-            }
-            if (s_strip1)
-            {
-              s_strip1->setBrightness(120);
-              s_strip1->show();
-            }
+            uint16_t numLit = min((uint16_t)ceil(stageP * (float)total), total);
+            uint16_t kelvin = ColorTemp::mix(1000, 1800, (uint16_t)(stageP * 256.0f));
+            uint8_t intensity = (uint8_t)min(255, (int)(5 + stageP * 200.0f));
+            fillKelvin(kelvin, intensity, 0, numLit);
+            fillFrame(0, numLit, total);
+            // keep addressable brightness moderate during the ember draw
+            presentFrame(120);
             // PWM remains off during first stage
-            ledcWrite(0, 0);
+            writePwm(0);
           }
           else
           {
             float stageP = (overallP - 0.5f) * 2.0f; // 0..1 for stage 2
-            // Transition addressable LEDs from red -> white
-            uint8_t r = (uint8_t)min(255, (int)(150 + stageP * 105.0f));
-            uint8_t g = (uint8_t)min(255, (int)(stageP * 255.0f));
-            uint8_t b = (uint8_t)min(255, (int)(stageP * 255.0f));
-            for (uint16_t ci = 0; ci < total; ++ci)
-            {
-              Adafruit_NeoPixel *strip;
-              uint16_t pix;
-              mapCombinedToStrip(ci, strip, pix);
-              if (!strip)
-                continue;
-              strip->setPixelColor(pix, strip->Color(r, g, b));
-            }
-            // ensure addressable brightness is full so color shows correctly
-            if (s_strip2)
-            {
-              s_strip2->setBrightness(255);
-              s_strip2->show();
-            }
-            if (s_strip1)
-            {
-              s_strip1->setBrightness(255);
-              s_strip1->show();
-            }
+            uint16_t kelvin = ColorTemp::mix(1800, 6500, (uint16_t)(stageP * 256.0f));
+            uint8_t intensity = (uint8_t)min(255, (int)(150 + stageP * 105.0f));
+            fillKelvin(kelvin, intensity, 0, total);
+            // full brightness so color shows correctly
+            presentFrame(255);
             // PWM fades in across stage 2
             uint8_t pwmDuty = (uint8_t)min(255, (int)(stageP * 255.0f + 0.5f));
-            ledcWrite(0, pwmDuty);
+            writePwm(pwmDuty);
           }
         }
         if (overallP >= 1.0f)
         {
-          // finalize fully white and PWM max
-          for (uint16_t ci = 0; ci < total; ++ci)
-          {
-            Adafruit_NeoPixel *strip;
-            uint16_t pix;
-            mapCombinedToStrip(ci, strip, pix);
-            if (!strip)
-              continue;
-            strip->setPixelColor(pix, strip->Color(255, 255, 255));
-          }
-          if (s_strip2)
-          {
-            s_strip2->setBrightness(255);
-            s_strip2->show();
-          }
-          if (s_strip1)
-          {
-            s_strip1->setBrightness(255);
-            s_strip1->show();
-          }
-          ledcWrite(0, 255);
-          s_currentAnim = LEDController::Animation::None;
+          // finalize at daylight white and PWM max
+          fillKelvin(6500, 255, 0, total);
+          presentFrame(255);
+          writePwm(255);
+          setAnimation(LEDController::Animation::None);
         }
         return;
       }
+      if (s_currentAnim == LEDController::Animation::Dawn)
+      {
+        // Natural dawn: one color over all pixels moving 1800 -> 6500 K in
+        // mired (long warm start, whitening toward the end) while the light
+        // grows with the square of the progress. The PWM strip joins in the
+        // second half.
+        float light = overallP * overallP;
+        uint16_t kelvin = ColorTemp::mix(1800, 6500, (uint16_t)(overallP * 256.0f));
+        fillKelvin(kelvin, (uint8_t)(light * 255.0f + 0.5f), 0, total);
+        presentFrame(255);
+        float pwmP = overallP > 0.5f ? (overallP - 0.5f) * 2.0f : 0.0f;
+        writePwm((uint8_t)(light * pwmP * 255.0f + 0.5f));
+        if (overallP >= 1.0f)
+          setAnimation(LEDController::Animation::None);
+        return;
+      }
       if (s_currentAnim == LEDController::Animation::Christmas)
       {
         // Christmas: groups of 5 LEDs flash in gold (no smooth transitions).
         // Behavior: scan forward over combined LED array in groups of `groupSize`.
         // Each step: group is ON (gold) for `onMs`, then ALL OFF for `offMs`,
         // then advance to next group. This creates a festive strobbing band.
-        uint8_t pwm = getPwmDuty(0);
+        uint8_t pwm = s_pwmDuty;
         if (pwm > 0) { markDirty(1); markDirty(2); return; }
 
-        uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
-        uint16_t n1 = s_strip1 ? s_strip1->numPixels() : 0;
-        uint32_t total = (uint32_t)n2 + (uint32_t)n1;
         if (total == 0) return;
 
-        // make the gold slightly more orange
-        // make the gold slightly more orange
-        // Orange color
-        // Make the color more golden-orange (no pure green phase)
         // Golden-orange: keep red dominant, reduce green to avoid greenish hue,
         // and a small blue component to warm toward a gold tint.
-        const uint8_t warmR = 255;
-        const uint8_t warmG = 110; // toned down to avoid green cast
-        const uint8_t warmB = 10;  // tiny blue to push toward gold
+        const uint32_t warm = Adafruit_NeoPixel::Color(255,  // red dominant
+                                                       110,  // toned down to avoid green cast
+                                                       10);  // tiny blue to push toward gold
 
         const uint16_t groupSize = 6; // LEDs per group (user requested)
         // base on/off durations (will be modulated)
@@ -281,15 +743,11 @@ namespace LEDController
           if (blendA < 0.02f) blendA = 0.02f; // always make measurable progress
           if (blendA > 1.0f) blendA = 1.0f;
         }
+        uint16_t blendT = (uint16_t)(blendA * 256.0f + 0.5f); // lerp weight, 256 = target
 
         // Render combined strips with alternating groups: off, on, off, on, ...
-        for (uint32_t ci = 0; ci < total; ++ci)
+        for (uint16_t ci = 0; ci < total; ++ci)
         {
-          Adafruit_NeoPixel *strip;
-          uint16_t pix;
-          mapCombinedToStrip((uint16_t)ci, strip, pix);
-          if (!strip) continue;
-
           // compute which group this pixel belongs to
           uint32_t gidx = ci / (uint32_t)groupSize;
           // determine if this group is scheduled to be ON for this step
@@ -298,7 +756,7 @@ namespace LEDController
           // If this group should be off, make it fully off (no residual blending).
           if (!(isOnPhase && groupShouldBeOn))
           {
-            strip->setPixelColor(pix, 0);
+            s_frame[ci] = 0;
             continue;
           }
 
@@ -318,26 +776,13 @@ namespace LEDController
           // apply slight perceptual curve so mid-brightness looks smooth
           alpha = powf(alpha, 1.8f);
 
-          // compute target color based on eased alpha
-          uint8_t tr = (uint8_t)((float)warmR * alpha + 0.5f);
-          uint8_t tg = (uint8_t)((float)warmG * alpha + 0.5f);
-          uint8_t tb = (uint8_t)((float)warmB * alpha + 0.5f);
-
-          // read previous pixel and blend toward target to avoid hard steps
-          uint32_t prevCol = strip->getPixelColor(pix);
-          uint8_t pr = (uint8_t)((prevCol >> 16) & 0xFF);
-          uint8_t pg = (uint8_t)((prevCol >> 8) & 0xFF);
-          uint8_t pb = (uint8_t)(prevCol & 0xFF);
-
-          uint8_t br = (uint8_t)((float)pr + (float)(tr - pr) * blendA + 0.5f);
-          uint8_t bg = (uint8_t)((float)pg + (float)(tg - pg) * blendA + 0.5f);
-          uint8_t bb = (uint8_t)((float)pb + (float)(tb - pb) * blendA + 0.5f);
-
-          strip->setPixelColor(pix, strip->Color(br, bg, bb));
+          // target color from eased alpha, then blend the previous frame's
+          // pixel toward it to avoid hard steps
+          uint32_t target = PixelKernels::scale(warm, (uint8_t)(alpha * 255.0f + 0.5f));
+          s_frame[ci] = PixelKernels::lerp(s_frame[ci], target, blendT);
         }
 
-        if (s_strip2) { s_strip2->setBrightness(255); s_strip2->show(); }
-        if (s_strip1) { s_strip1->setBrightness(255); s_strip1->show(); }
+        presentFrame(255);
 
         s_lastLedUpdate = now;
 
@@ -347,145 +792,114 @@ namespace LEDController
       if (s_currentAnim == LEDController::Animation::Sunset)
       {
         // Two-stage sunset (mirror of sunrise):
-        // - Stage 1 (0.0 .. 0.5): addressable go from white -> red; PWM stays at full
-        // - Stage 2 (0.5 .. 1.0): addressable red -> off; PWM fades 255 -> 0
+        // - Stage 1 (0.0 .. 0.5): addressable 6500 -> 1800 K on the blackbody curve; PWM fades 255 -> 0
+        // - Stage 2 (0.5 .. 1.0): dusk in HSV, hue turning from the 1800 K
+        //   orange through red and purple to blue-hour blue while pixels go off
         if (total > 0)
         {
           if (overallP < 0.5f)
           {
             float stageP = overallP * 2.0f; // 0..1
-            // white -> red: reduce green/blue, keep red high
-            uint8_t r = (uint8_t)min(255, (int)(255 - stageP * 50.0f));
-            uint8_t g = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
-            uint8_t b = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
-            for (uint16_t ci = 0; ci < total; ++ci)
-            {
-              Adafruit_NeoPixel *strip;
-              uint16_t pix;
-              // reverse direction so sunset flows opposite of sunrise
-              mapCombinedToStrip((total - 1 - ci), strip, pix);
-              if (!strip)
-                continue;
-              strip->setPixelColor(pix, strip->Color(r, g, b));
-            }
+            uint16_t kelvin = ColorTemp::mix(6500, 1800, (uint16_t)(stageP * 256.0f));
+            fillKelvin(kelvin, 255, 0, total);
             // keep addressable brightness full to show color
-            if (s_strip2)
-            {
-              s_strip2->setBrightness(255);
-              s_strip2->show();
-            }
-            if (s_strip1)
-            {
-              s_strip1->setBrightness(255);
-              s_strip1->show();
-            }
-            // PWM dims partially during stage 1 (255 -> 128)
+            presentFrame(255);
             uint8_t pwmStage1 = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
-            ledcWrite(0, pwmStage1);
+            writePwm(pwmStage1);
           }
           else
           {
             float stageP = (overallP - 0.5f) * 2.0f; // 0..1
-            // red -> off: progressively reduce red intensity and turn pixels off
-            uint8_t redIntensity = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
+            // Hue runs backwards (wrapping through red) from orange to blue;
+            // reverse direction so sunset flows opposite of sunrise
+            const uint16_t hueFrom = 3800;  // ~21 deg, the 1800 K orange
+            const uint16_t hueTo = 43690;   // 240 deg
+            uint16_t hue = (uint16_t)(hueFrom - (uint16_t)(stageP * (float)(uint16_t)(hueFrom - hueTo)));
+            uint8_t value = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
             uint16_t numLit = (uint16_t)max(0, (int)ceil((1.0f - stageP) * (float)total));
-            for (uint16_t ci = 0; ci < total; ++ci)
-            {
-              Adafruit_NeoPixel *strip;
-              uint16_t pix;
-              mapCombinedToStrip((total - 1 - ci), strip, pix);
-              if (!strip)
-                continue;
-              if (ci < numLit)
-              {
-                strip->setPixelColor(pix, strip->Color(redIntensity, 0, 0));
-              }
-              else
-              {
-                strip->setPixelColor(pix, 0);
-              }
-            }
+            if (numLit > total)
+              numLit = total;
+            fillFrame(0, 0, total - numLit);
+            fillCalibrated(Adafruit_NeoPixel::ColorHSV(hue, 255, value), 255, total - numLit, total);
             // reduce addressable brightness slightly as it goes dark
             uint8_t wsBrightness = (uint8_t)max(0, (int)(255 - stageP * 255.0f));
-            if (s_strip2)
-            {
-              s_strip2->setBrightness(wsBrightness);
-              s_strip2->show();
-            }
-            if (s_strip1)
-            {
-              s_strip1->setBrightness(wsBrightness);
-              s_strip1->show();
-            }
-            ledcWrite(0, 0);
+            presentFrame(wsBrightness);
+            writePwm(0);
           }
         }
         if (overallP >= 1.0f)
         {
           // finalize: all off
-          for (uint16_t ci = 0; ci < total; ++ci)
-          {
-            Adafruit_NeoPixel *strip;
-            uint16_t pix;
-            mapCombinedToStrip((total - 1 - ci), strip, pix);
-            if (!strip)
-              continue;
-            strip->setPixelColor(pix, 0);
-          }
-          if (s_strip2)
-          {
-            s_strip2->show();
-          }
-          if (s_strip1)
-          {
-            s_strip1->show();
-          }
-          ledcWrite(0, 0);
-          s_currentAnim = LEDController::Animation::None;
+          fillFrame(0, 0, total);
+          presentFrame(255);
+          writePwm(0);
+          setAnimation(LEDController::Animation::None);
         }
         return;
       }
 
       if (s_currentAnim == LEDController::Animation::Waves)
       {
-        if (overallP >= 1.0f)
+        if (s_animDur > 0 && overallP >= 1.0f)
         {
-          s_currentAnim = LEDController::Animation::None;
+          setAnimation(LEDController::Animation::None);
           markDirty(1);
           markDirty(2);
           return;
         }
-        // Waves: slower and more contrasted
-        s_wavePhase += 0.02f; // slower
-        for (int stripIdx = 0; stripIdx < 2; ++stripIdx)
+        // Waves: slower and more contrasted. The phase follows the elapsed
+        // time (0.02 per 16 ms frame) so lamps with a shared start stay in step.
+        renderWaves(s_frame, total, n2, (float)elapsed * (0.02f / FRAME_INTERVAL_MS));
+        presentFrame(220);
+        return;
+      }
+
+      if (s_currentAnim == LEDController::Animation::Caustics ||
+          s_currentAnim == LEDController::Animation::Clouds ||
+          s_currentAnim == LEDController::Animation::Storm)
+      {
+        if (s_animDur > 0 && overallP >= 1.0f)
         {
-          Adafruit_NeoPixel *strip = (stripIdx == 0) ? s_strip2 : s_strip1; // strip2 is left
-          if (!strip)
-            continue;
-          uint16_t n = strip->numPixels();
-          for (uint16_t i = 0; i < n; ++i)
-          {
-            float x = (float)i / (float)(n ? n : 1);
-            float wave = (sinf((x * 6.28318f) + s_wavePhase) + 1.0f) / 2.0f; // 0..1
-            // increase contrast by applying a simple curve
-            wave = powf(wave, 1.8f);
-            // color from deep blue -> cyan with higher contrast
-            uint8_t r = (uint8_t)(5 * wave);
-            uint8_t g = (uint8_t)(50 + 180 * wave);
-            uint8_t b = (uint8_t)(100 + 155 * wave);
-            strip->setPixelColor(i, strip->Color(r, g, b));
-          }
-          strip->setBrightness(220);
-          strip->show();
+          if (s_currentAnim == LEDController::Animation::Storm)
+            s_dimGen = StripStore::generation(StripStore::Dim) - 1; // reapply the PWM level
+          setAnimation(LEDController::Animation::None);
+          markDirty(1);
+          markDirty(2);
+          return;
+        }
+        if (s_currentAnim == LEDController::Animation::Caustics)
+          renderCaustics(s_frame, total, n2, (uint32_t)elapsed);
+        else if (s_currentAnim == LEDController::Animation::Clouds)
+          renderClouds(s_frame, total, n2, (uint32_t)elapsed);
+        else
+        {
+          uint8_t flash = renderStorm(s_frame, total, n2, (uint32_t)elapsed);
+          uint8_t base = stormBaseDuty();
+          writePwm(flash > base ? flash : base);
+        }
+        presentFrame(255);
+        return;
+      }
+
+      if (s_currentAnim == LEDController::Animation::Program)
+      {
+        if (s_animDur > 0 && overallP >= 1.0f)
+        {
+          setAnimation(LEDController::Animation::None);
+          markDirty(1);
+          markDirty(2);
+          return;
         }
+        EffectVM::renderActive(s_frame, total, n2, (uint32_t)elapsed);
+        presentFrame(EffectVM::activeBrightness());
         return;
       }
 
       if (s_currentAnim == LEDController::Animation::Police)
       {
-        if (overallP >= 1.0f)
+        if (s_animDur > 0 && overallP >= 1.0f)
         {
-          s_currentAnim = LEDController::Animation::None;
+          setAnimation(LEDController::Animation::None);
           markDirty(1);
           markDirty(2);
           return;
@@ -500,8 +914,7 @@ namespace LEDController
         // 450..520ms -> short off
         // 520..620ms -> BLUE flash 2
         // 620..800ms -> longer blackout
-        unsigned long nowMs = millis();
-        unsigned long phase = (nowMs - s_animStart) % 800UL;
+        unsigned long phase = (now - s_animStart) % 800UL;
         uint8_t r = 0, g = 0, b = 0;
         bool show = false;
         if (phase < 100)
@@ -548,110 +961,223 @@ namespace LEDController
 
         // Ensure dimmable white (PWM channel 0) is off while police runs
         // s_savedPwmDuty should have been saved in startAnimation; enforce off here too
-        ledcWrite(0, 0);
+        writePwm(0);
 
         // Apply the chosen color (or clear) across both strips
-        if (s_strip2)
-        {
-          if (show)
-          {
-            uint32_t col = s_strip2->Color(r, g, b);
-            for (uint16_t i = 0; i < s_strip2->numPixels(); ++i)
-              s_strip2->setPixelColor(i, col);
-            s_strip2->setBrightness(255);
-            s_strip2->show();
-          }
-          else
-          {
-            s_strip2->clear();
-            s_strip2->show();
-          }
-        }
-        if (s_strip1)
-        {
-          if (show)
-          {
-            uint32_t col = s_strip1->Color(r, g, b);
-            for (uint16_t i = 0; i < s_strip1->numPixels(); ++i)
-              s_strip1->setPixelColor(i, col);
-            s_strip1->setBrightness(255);
-            s_strip1->show();
-          }
-          else
-          {
-            s_strip1->clear();
-            s_strip1->show();
-          }
-        }
+        fillFrame(show ? Adafruit_NeoPixel::Color(r, g, b) : 0, 0, total);
+        presentFrame(255);
         return;
       }
     }
 
-    // If not animating, handle dirty updates
-    if (s_ws1Dirty && s_strip1)
+    // If not animating, redraw static strips whose state or image changed
+    takeImage();
+    renderStatic(s_strip1, StripStore::WS1, s_ws1Gen, s_ws1Force);
+    renderStatic(s_strip2, StripStore::WS2, s_ws2Gen, s_ws2Force);
+  }
+
+  EffectBench benchEffect(const EffectVM::Program &prog, uint32_t frames)
+  {
+    EffectBench res = {frames, frameLength(), 0, 0};
+    uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
+    static uint32_t frame[PixelOutput::MAX_PIXELS];
+    static const int32_t params[EffectVM::PARAM_COUNT] = {0, 0, 0, 0};
+
+    uint32_t t0 = micros();
+    for (uint32_t i = 0; i < frames; ++i)
+      renderWaves(frame, res.pixels, n2, 0.02f * (float)i);
+    res.nativeUs = micros() - t0;
+    t0 = micros();
+    for (uint32_t i = 0; i < frames; ++i)
+      EffectVM::render(prog, frame, res.pixels, n2, i * FRAME_INTERVAL_MS, params);
+    res.programUs = micros() - t0;
+    return res;
+  }
+
+  void benchEffects(uint32_t frames, EffectTiming *out)
+  {
+    static const char *const NAMES[EFFECT_TIMING_COUNT] = {"waves", "caustics", "clouds", "storm"};
+    static uint32_t frame[PixelOutput::MAX_PIXELS];
+    uint16_t total = frameLength();
+    uint16_t n2 = s_strip2 ? s_strip2->numPixels() : 0;
+    for (int e = 0; e < EFFECT_TIMING_COUNT; ++e)
+    {
+      uint32_t sum = 0, worst = 0;
+      for (uint32_t i = 0; i < frames; ++i)
+      {
+        uint32_t ms = i * FRAME_INTERVAL_MS;
+        uint32_t t0 = micros();
+        if (e == 0)
+          renderWaves(frame, total, n2, 0.02f * (float)i);
+        else if (e == 1)
+          renderCaustics(frame, total, n2, ms);
+        else if (e == 2)
+          renderClouds(frame, total, n2, ms);
+        else
+          renderStorm(frame, total, n2, ms);
+        uint32_t us = micros() - t0;
+        sum += us;
+        if (us > worst)
+          worst = us;
+      }
+      out[e] = EffectTiming{NAMES[e], frames ? sum / frames : 0, worst};
+    }
+  }
+
+  bool requestRecorder(const RecorderRequest &req)
+  {
+    if (s_recPending.load())
+      return false;
+    s_recRequest = req;
+    s_recRequest.path[sizeof(s_recRequest.path) - 1] = '\0';
+    s_recPending.store(true);
+    return true;
+  }
+
+  static void handleRecorderRequest()
+  {
+    if (!s_recPending.load())
+      return;
+    const RecorderRequest &req = s_recRequest;
+    if (req.kind == RecorderRequest::Start)
+    {
+      if (s_strip1 && s_strip2 && FrameRecorder::start(req.path, s_strip2->numPixels(), s_strip1->numPixels()))
+        s_framePresented = true; // capture the current output as the first frame
+    }
+    else if (req.kind == RecorderRequest::Stop)
+    {
+      FrameRecorder::stop();
+    }
+    else if (req.kind == RecorderRequest::Play)
+    {
+      startPlayback(req.path, req.repeat);
+    }
+    else
+    {
+      renderOffline(req.anim, req.durationMs, req.frameMs, req.path);
+    }
+    s_recPending.store(false);
+  }
+
+  static void updateFrameStats(uint32_t renderUs, unsigned long intervalMs)
+  {
+    if (s_frameStatsReset.exchange(false))
+      s_frameStats = LEDController::FrameStats{0, 0, 0, 0, 0};
+    FrameStats &fs = s_frameStats;
+    ++fs.frames;
+    fs.renderUsTotal += renderUs;
+    if (renderUs > fs.renderUsMax)
+      fs.renderUsMax = renderUs;
+    if (intervalMs > fs.intervalMsMax)
+      fs.intervalMsMax = intervalMs;
+    if (intervalMs > 2 * FRAME_INTERVAL_MS)
+      ++fs.lateFrames;
+  }
+
+  FrameStats frameStats()
+  {
+    return s_frameStats;
+  }
+
+  void resetFrameStats()
+  {
+    // Applied by the render task on its next frame
+    s_frameStatsReset.store(true);
+  }
+
+  void setOutputFrozen(bool frozen)
+  {
+    s_frozen.store(frozen);
+  }
+
+  bool outputFrozen()
+  {
+    return s_frozen.load();
+  }
+
+  // Release the image buffers from an upload whose client went quiet without
+  // disconnecting, so later uploads and clears are not refused forever
+  static void dropStalledPixels()
+  {
+    uint32_t owner = s_imgOwner.load();
+    if ((owner & (IMG_OWNED | IMG_WRITING)) != IMG_OWNED)
+      return; // idle, or writing right now
+    if (millis() - s_imgTouchMs.load() < PIXELS_STALL_MS)
+      return;
+    s_imgOwner.compare_exchange_strong(owner, owner & ~3u);
+  }
+
+  void loop()
+  {
+    dropStalledPixels();
+    if (s_frozen.load())
+      return; // requests and state changes wait until output resumes
+    handleRecorderRequest();
+    unsigned long now = millis();
+    if (now - s_lastFrameMs < FRAME_INTERVAL_MS)
+      return; // changes wait for the next frame and coalesce
+    unsigned long interval = now - s_lastFrameMs;
+    s_lastFrameMs = now;
+    bool animating = s_currentAnim != LEDController::Animation::None;
+    // Frames are paced in real time; animations run on the (possibly
+    // simulated) clock time
+    unsigned long clockMs = (unsigned long)Clock::ms();
+    // A new cap level redraws the static output as well
+    uint8_t scale = DailyLight::outputScale();
+    if (scale != s_outScale)
     {
-      s_ws1Dirty = false;
-      setStripSolid(*s_strip1, ws1State);
+      s_outScale = scale;
+      writePwm(s_pwmDuty);
+      s_ws1Force.store(true);
+      s_ws2Force.store(true);
     }
-    if (s_ws2Dirty && s_strip2)
+    uint32_t t0 = micros();
+    render(clockMs);
+    if (s_framePresented)
     {
-      s_ws2Dirty = false;
-      setStripSolid(*s_strip2, ws2State);
+      s_framePresented = false;
+      if (FrameRecorder::recording())
+        captureFrame(clockMs);
+      updateFrameStats(micros() - t0, animating ? interval : 0);
     }
   }
 
-  void startAnimation(LEDController::Animation anim, unsigned long durationMs)
+  void startAnimationAt(LEDController::Animation anim, unsigned long durationMs, unsigned long startMs)
   {
-    s_currentAnim = anim;
-    s_animStart = millis();
+    setAnimation(anim);
+    s_animStart = startMs;
+    s_lastLedUpdate = 0;
     s_animDur = durationMs;
-    s_wavePhase = 0.0f;
     if (anim == LEDController::Animation::Christmas) {
       s_christmasAllOffUntil = 0;
       s_christmasLastStep = 0;
       s_christmasPhaseOffset = (uint8_t)(s_animStart % 5);
     }
     // If sunrise/sunset, ensure regular PWM strip is off initially and set a single dim pixel
+    uint16_t total = frameLength();
     if (anim == LEDController::Animation::Sunrise)
     {
       // PWM channel 0 -> off
-      ledcWrite(0, 0);
-      // left strip (s_strip2) first pixel dim red
-      if (s_strip2)
-      {
-        s_strip2->clear();
-        s_strip2->setPixelColor(0, s_strip2->Color(5, 0, 0));
-        s_strip2->setBrightness(50);
-        s_strip2->show();
-      }
-      if (s_strip1)
-      {
-        s_strip1->clear();
-        s_strip1->show();
-      }
+      writePwm(0);
+      // left strip (s_strip2) first pixel a dim ember
+      fillFrame(0, 0, total);
+      if (s_strip2 && s_strip2->numPixels() > 0)
+        s_frame[s_strip2->numPixels() - 1] = ColorTemp::color(1000, 5, 2);
+      presentFrame(50);
+    }
+    else if (anim == LEDController::Animation::Dawn)
+    {
+      // start dark; the first frame brings the first light
+      writePwm(0);
+      fillFrame(0, 0, total);
+      presentFrame(255);
     }
     else if (anim == LEDController::Animation::Sunset)
     {
-      // initialize all addressable LEDs to white and PWM at full
-      if (s_strip2)
-      {
-        uint32_t col = s_strip2->Color(255, 255, 255);
-        for (uint16_t i = 0; i < s_strip2->numPixels(); ++i)
-          s_strip2->setPixelColor(i, col);
-        s_strip2->setBrightness(255);
-        s_strip2->show();
-      }
-      if (s_strip1)
-      {
-        uint32_t col = s_strip1->Color(255, 255, 255);
-        for (uint16_t i = 0; i < s_strip1->numPixels(); ++i)
-          s_strip1->setPixelColor(i, col);
-        s_strip1->setBrightness(255);
-        s_strip1->show();
-      }
-      ledcWrite(0, 255);
-      // store PWM duty knowledge implicitly (channel 0)
-      // ledcRead is available to read back if needed
+      // initialize all addressable LEDs to daylight white and PWM at full
+      fillKelvin(6500, 255, 0, total);
+      presentFrame(255);
+      writePwm(255);
     }
 
     if (anim == LEDController::Animation::Police)
@@ -660,32 +1186,109 @@ namespace LEDController
       s_policeLastToggle = 0;
       s_policeBlue = false;
       // save current PWM duty and force off while police runs
-      s_savedPwmDuty = getPwmDuty(0);
-      ledcWrite(0, 0);
+      s_savedPwmDuty = s_pwmDuty;
+      writePwm(0);
       // ensure strips are cleared/prepared
-      if (s_strip2)
-      {
-        s_strip2->clear();
-        s_strip2->show();
-      }
-      if (s_strip1)
-      {
-        s_strip1->clear();
-        s_strip1->show();
-      }
+      fillFrame(0, 0, total);
+      presentFrame(255);
+    }
+    if (anim == LEDController::Animation::Christmas)
+      fillFrame(0, 0, total); // blends start from black
+  }
+
+  unsigned long msUntilNextFrame()
+  {
+    unsigned long since = millis() - s_lastFrameMs;
+    return since >= FRAME_INTERVAL_MS ? 0 : FRAME_INTERVAL_MS - since;
+  }
+
+  bool hasPendingChanges()
+  {
+    if (StripStore::generation(StripStore::Dim) != s_dimGen)
+      return true;
+    if (s_currentAnim != LEDController::Animation::None)
+      return false; // static strips are redrawn once the animation ends
+    return s_ws1Force.load() || s_ws2Force.load() || (s_imgReady.load() & IMG_NEW) ||
+           StripStore::generation(StripStore::WS1) != s_ws1Gen ||
+           StripStore::generation(StripStore::WS2) != s_ws2Gen;
+  }
+
+  void startAnimation(LEDController::Animation anim, unsigned long durationMs)
+  {
+    startAnimationAt(anim, durationMs, (unsigned long)Clock::ms());
+  }
+
+  bool renderOffline(LEDController::Animation anim, unsigned long durationMs, unsigned long frameMs, const char *path)
+  {
+    if (frameMs == 0 || !s_strip1 || !s_strip2)
+      return false;
+    if (!FrameRecorder::start(path, s_strip2->numPixels(), s_strip1->numPixels()))
+      return false;
+    stopAnimation();
+    uint8_t liveDuty = s_pwmDuty;
+    s_suppressOutput = true;
+    // Fixed start so the same animation always produces the same recording
+    const unsigned long t0 = 1;
+    startAnimationAt(anim, durationMs, t0);
+    captureFrame(t0);
+    for (unsigned long t = frameMs; t <= durationMs; t += frameMs)
+    {
+      render(t0 + t);
+      captureFrame(t0 + t);
+      if (s_currentAnim == LEDController::Animation::None)
+        break;
+      if ((t / frameMs) % 64 == 0)
+        yield();
     }
+    FrameRecorder::stop();
+    setAnimation(LEDController::Animation::None);
+    s_suppressOutput = false;
+    s_framePresented = false;
+    // Restore the live output
+    s_pwmDuty = liveDuty;
+    s_dimGen = StripStore::generation(StripStore::Dim) - 1;
+    markDirty(1);
+    markDirty(2);
+    return true;
+  }
+
+  bool startPlayback(const char *path, bool repeat)
+  {
+    stopAnimation();
+    strncpy(s_playerPath, path, sizeof(s_playerPath) - 1);
+    s_playerPath[sizeof(s_playerPath) - 1] = '\0';
+    s_playerRepeat = repeat;
+    if (!openPlayback())
+      return false;
+    s_animStart = (unsigned long)Clock::ms();
+    s_animDur = 0;
+    setAnimation(LEDController::Animation::Playback);
+    return true;
   }
 
   void stopAnimation()
   {
+    if (s_currentAnim == LEDController::Animation::Playback)
+    {
+      s_player.close();
+      s_playerPrimed = false;
+    }
+    // Back to the stored static output on the next frame (a write of the
+    // same state does not move the generations, see StripStore::write)
+    if (s_currentAnim != LEDController::Animation::None)
+    {
+      s_dimGen = StripStore::generation(StripStore::Dim) - 1;
+      markDirty(1);
+      markDirty(2);
+    }
     // If we are stopping Police, restore saved PWM duty
     if (s_currentAnim == LEDController::Animation::Police)
     {
       // restore PWM duty
-      ledcWrite(0, s_savedPwmDuty);
+      writePwm(s_savedPwmDuty);
       s_savedPwmDuty = 0;
     }
-    s_currentAnim = LEDController::Animation::None;
+    setAnimation(LEDController::Animation::None);
   }
 
   LEDController::Animation currentAnimation()
@@ -693,6 +1296,68 @@ namespace LEDController
     return s_currentAnim;
   }
 
+  void retimeAnimation(unsigned long startMs)
+  {
+    s_animStart = startMs;
+  }
+
+  unsigned long animationStart()
+  {
+    return s_animStart;
+  }
+
+  unsigned long animationDuration()
+  {
+    return s_animDur;
+  }
+
+  struct AnimationName
+  {
+    LEDController::Animation anim;
+    const char *query;   // nullptr if not startable by name
+    const char *display;
+  };
+
+  static const AnimationName ANIMATION_NAMES[] = {
+      {LEDController::Animation::None, nullptr, "None"},
+      {LEDController::Animation::Sunrise, "sunrise", "Sunrise"},
+      {LEDController::Animation::Sunset, "sunset", "Sunset"},
+      {LEDController::Animation::Waves, "waves", "Waves"},
+      {LEDController::Animation::Police, "police", "Police"},
+      {LEDController::Animation::Christmas, "christmas", "Christmas"},
+      {LEDController::Animation::Playback, nullptr, "Playback"},
+      {LEDController::Animation::Program, nullptr, "Program"},
+      {LEDController::Animation::Caustics, "caustics", "Caustics"},
+      {LEDController::Animation::Clouds, "clouds", "Clouds"},
+      {LEDController::Animation::Storm, "storm", "Storm"},
+      {LEDController::Animation::Dawn, "dawn", "Dawn"},
+  };
+
+  bool animationFromName(const char *name, LEDController::Animation &out)
+  {
+    if (!name)
+      return false;
+    for (const AnimationName &n : ANIMATION_NAMES)
+    {
+      if (n.query && strcmp(n.query, name) == 0)
+      {
+        out = n.anim;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const char *animationName(LEDController::Animation anim)
+  {
+    for (const AnimationName &n : ANIMATION_NAMES)
+    {
+      if (n.anim == anim)
+        return n.display;
+    }
+    return "None";
+  }
+
   uint8_t getPwmDuty(int channel)
   {
     // ledcRead returns 0..(2^resolution-1). Our resolution is 8-bit in this project.
@@ -704,13 +1369,78 @@ namespace LEDController
     return (uint8_t)v;
   }
 
+  uint16_t stripLength(int stripIndex)
+  {
+    Adafruit_NeoPixel *s = (stripIndex == 1) ? s_strip1 : s_strip2;
+    return s ? s->numPixels() : 0;
+  }
+
+  uint32_t beginPixels()
+  {
+    uint32_t owner = s_imgOwner.load();
+    uint32_t token;
+    do
+    {
+      if (owner & IMG_OWNED)
+        return 0;
+      token = (owner & ~3u) + 4 + IMG_OWNED;
+    } while (!s_imgOwner.compare_exchange_weak(owner, token | IMG_WRITING));
+    memcpy(s_images[s_imgBack], s_images[s_imgLast], sizeof(s_images[0]));
+    s_imgMasks[s_imgBack] = s_imgMasks[s_imgLast];
+    s_imgTouchMs.store(millis());
+    s_imgOwner.store(token);
+    return token;
+  }
+
+  bool lockPixels(uint32_t token)
+  {
+    uint32_t owner = token;
+    return s_imgOwner.compare_exchange_strong(owner, token | IMG_WRITING);
+  }
+
+  void setPixel(uint16_t index, uint32_t color)
+  {
+    if (index < PixelOutput::MAX_PIXELS)
+      s_images[s_imgBack][index] = color;
+  }
+
+  void unlockPixels(uint32_t token)
+  {
+    s_imgTouchMs.store(millis());
+    s_imgOwner.store(token);
+  }
+
+  bool endPixels(uint32_t token, bool apply, uint8_t stripMask, uint8_t clearMask)
+  {
+    if (!lockPixels(token))
+      return false; // dropped as stalled
+    if (apply)
+    {
+      s_imgMasks[s_imgBack] = (s_imgMasks[s_imgBack] & ~clearMask) | stripMask;
+      s_imgLast = s_imgBack;
+      s_imgBack = s_imgReady.exchange(s_imgBack | IMG_NEW) & 3;
+    }
+    s_imgOwner.store(token & ~3u);
+    return true;
+  }
+
+  bool clearPixels(int stripIndex)
+  {
+    uint8_t mask = stripIndex == 1 ? 1 : stripIndex == 2 ? 2 : 3;
+    if (!(s_imgMasks[s_imgLast] & mask))
+      return true; // nothing to clear
+    uint32_t token = beginPixels();
+    return token && endPixels(token, true, 0, mask);
+  }
+
   bool readStripHardware(int stripIndex, StripState &out)
   {
     Adafruit_NeoPixel *s = (stripIndex == 1) ? s_strip1 : s_strip2;
     if (!s)
       return false;
-    // We can read brightness via Adafruit_NeoPixel::getBrightness()
-    uint8_t b = s->getBrightness();
+    // Output is pre-scaled (library brightness stays 255); report the last
+    // static brightness written to this strip
+    uint8_t b = (stripIndex == 1) ? s_ws1Brightness : s_ws2Brightness;
     out.brightness = b;
     out.on = (b > 0);
     // We don't have a safe way to read per-strip global color from the library
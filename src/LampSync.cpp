@@ -0,0 +1,693 @@
+#include "LampSync.h"
+#include <atomic>
+#include "PowerManager.h"
+#include "EventLog.h"
+#include "Clock.h"
+#include "CommandBus.h"
+
+namespace LampSync {
+
+static const uint32_t MAGIC = 0x4E59534C;   // "LSYN"
+static const uint8_t VERSION = 1;
+static const unsigned long BEACON_MS = 1000;
+static const unsigned long POLL_MS = 1000;
+static const unsigned long PEER_TIMEOUT_MS = 3500;
+static const unsigned long ELECTION_WAIT_MS = 3000;  // listen this long before claiming leadership
+static const unsigned long RETIME_MS = 1000;
+static const unsigned long REPEAT_MS = 60;           // start/stop messages are sent three times
+static const uint8_t REPEATS = 3;
+static const uint8_t LOCK_SAMPLES = 4;
+static const int64_t DRIFT_MIN_BASELINE_US = 120000000;  // 2 min
+static const int64_t DRIFT_MAX_BASELINE_US = 600000000;  // then the anchor moves up
+static const int32_t MAX_DRIFT_PPB = 200000;         // 200 ppm, far beyond any crystal
+static const uint8_t SKEW_WINDOW = 8;
+
+enum MsgType : uint8_t { MsgBeacon = 1, MsgRequest, MsgReply, MsgStart, MsgStop };
+static const uint8_t FLAG_LEADER = 1, FLAG_SYNCED = 2;
+
+struct __attribute__((packed)) Header {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t reserved;
+  uint32_t id;       // sender
+};
+
+struct __attribute__((packed)) BeaconMsg {
+  Header h;
+  int64_t netUs;     // sender's network clock at send
+  uint32_t leaderId; // 0 while it has none
+  uint8_t flags;
+};
+
+// Poll: t1 follower clock at send, t2/t3 leader network clock at receipt/reply
+struct __attribute__((packed)) RequestMsg { Header h; int64_t t1; };
+struct __attribute__((packed)) ReplyMsg { Header h; int64_t t1, t2, t3; };
+
+struct __attribute__((packed)) StartMsg {
+  Header h;
+  uint32_t key;
+  int64_t startNetUs;
+  uint32_t durationMs;
+  uint8_t anim;      // unused for MsgStop
+};
+
+struct Sample {
+  int64_t atUs;      // local clock at the middle of the exchange
+  int64_t offsetUs;  // network - local
+  int32_t delayUs;   // round trip minus leader processing
+};
+
+struct Peer {
+  uint32_t id;
+  uint32_t ip;
+  unsigned long seenMs;
+  uint8_t flags;
+  int32_t transitUs[SKEW_WINDOW];
+  uint8_t transitCount, transitPos;
+};
+
+struct Command {
+  uint32_t key;
+  uint32_t sender;
+  int64_t startNetUs;
+  uint32_t durationMs;
+  uint8_t anim;
+  bool stop;
+  bool local;        // this lamp only (startLocal/stopLocal)
+};
+
+static Port s_port = {};
+static bool s_listening = false;
+static uint32_t s_id = 0;
+
+// Shared with the UDP task (s_mux). Clock model:
+//   network = local + s_offsetUs + (local - s_refUs) * s_driftPpb / 1e9
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_refUs = 0;
+static int64_t s_offsetUs = 0;
+static int32_t s_driftPpb = 0;
+static bool s_isLeader = false;
+static uint32_t s_leaderId = 0;
+static uint32_t s_leaderIp = 0;
+static int64_t s_pollT1 = 0;   // outstanding poll; older replies are ignored
+static Sample s_samples[SAMPLES];
+static uint8_t s_sampleCount = 0, s_samplePos = 0;
+static bool s_samplesChanged = false;
+static int32_t s_bestDelayUs = 0;
+static Sample s_anchor;            // drift reference
+static bool s_anchorValid = false;
+static bool s_driftValid = false;
+static Peer s_peers[MAX_PEERS];
+static uint8_t s_peerCount = 0;
+static Command s_incoming;
+static std::atomic<bool> s_incomingPending(false);
+static StartMsg s_outgoing;
+static uint8_t s_outgoingLeft = 0;
+
+// Loop task only
+static unsigned long s_lastBeaconMs = 0;
+static unsigned long s_lastPollMs = 0;
+static unsigned long s_lastRetimeMs = 0;
+static unsigned long s_lastSendMs = 0;
+static unsigned long s_noLeaderSinceMs = 0;
+static Command s_waiting;          // accepted start not yet due
+static bool s_waitingValid = false;
+static Command s_current;          // start applied to LEDController
+static bool s_currentValid = false;
+static unsigned long s_appliedStartMs = 0;
+static uint32_t s_lastStopKey = 0;
+
+// ------------------- Clock -------------------
+
+// Local clock of the port (esp_timer on the lamp)
+static int64_t localUs()
+{
+  return s_port.nowUs ? s_port.nowUs() : 0;
+}
+
+static unsigned long localMs()
+{
+  return (unsigned long)(localUs() / 1000);
+}
+
+static int64_t toNetLocked(int64_t localUs)
+{
+  return localUs + s_offsetUs + (localUs - s_refUs) * s_driftPpb / 1000000000LL;
+}
+
+static int64_t toNet(int64_t localUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  int64_t net = toNetLocked(localUs);
+  portEXIT_CRITICAL(&s_mux);
+  return net;
+}
+
+static int64_t toLocal(int64_t netUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  int64_t guess = netUs - s_offsetUs;
+  int64_t local = netUs - s_offsetUs - (guess - s_refUs) * s_driftPpb / 1000000000LL;
+  portEXIT_CRITICAL(&s_mux);
+  return local;
+}
+
+int64_t networkUs()
+{
+  return toNet(localUs());
+}
+
+bool synced()
+{
+  portENTER_CRITICAL(&s_mux);
+  bool ok = s_isLeader || (s_leaderId != 0 && s_sampleCount >= LOCK_SAMPLES);
+  portEXIT_CRITICAL(&s_mux);
+  return ok;
+}
+
+// Refit the clock model from the samples (loop task). The offset comes from
+// the fastest exchange kept (NTP clock filter): a slow one was delayed on one
+// leg (modem sleep, retries), which biases its offset by up to half the extra
+// delay. Drift comes from how that offset moves against an anchor sample at
+// least DRIFT_MIN_BASELINE_US older, so a millisecond of offset noise costs
+// little; it only matters between polls and while the leader is lost.
+static void refit()
+{
+  portENTER_CRITICAL(&s_mux);
+  if (!s_samplesChanged || s_isLeader || s_sampleCount == 0) {
+    portEXIT_CRITICAL(&s_mux);
+    return;
+  }
+  s_samplesChanged = false;
+  const Sample* best = &s_samples[0];
+  for (int i = 1; i < s_sampleCount; ++i) {
+    if (s_samples[i].delayUs < best->delayUs) best = &s_samples[i];
+  }
+  if (!s_anchorValid || (best->atUs - s_anchor.atUs < DRIFT_MIN_BASELINE_US && best->delayUs < s_anchor.delayUs)) {
+    // Anchor on the fastest exchange seen once the window is full
+    if (s_sampleCount == SAMPLES) {
+      s_anchor = *best;
+      s_anchorValid = true;
+    }
+  } else if (best->atUs != s_refUs && best->atUs - s_anchor.atUs >= DRIFT_MIN_BASELINE_US) {
+    double ppb = (double)(best->offsetUs - s_anchor.offsetUs) * 1e9 / (double)(best->atUs - s_anchor.atUs);
+    if (ppb > MAX_DRIFT_PPB) ppb = MAX_DRIFT_PPB;
+    if (ppb < -MAX_DRIFT_PPB) ppb = -MAX_DRIFT_PPB;
+    s_driftPpb = s_driftValid ? s_driftPpb + (int32_t)((ppb - s_driftPpb) / 4) : (int32_t)ppb;
+    s_driftValid = true;
+    if (best->atUs - s_anchor.atUs >= DRIFT_MAX_BASELINE_US) s_anchor = *best;
+  }
+  s_refUs = best->atUs;
+  s_offsetUs = best->offsetUs;
+  s_bestDelayUs = best->delayUs;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+// ------------------- Messages -------------------
+
+static void fillHeader(Header& h, uint8_t type)
+{
+  h.magic = MAGIC;
+  h.version = VERSION;
+  h.type = type;
+  h.reserved = 0;
+  h.id = s_id;
+}
+
+static void onBeacon(const BeaconMsg& m, uint32_t ip, int64_t rxUs)
+{
+  int64_t transit = toNet(rxUs) - m.netUs;
+  if (transit > INT32_MAX) transit = INT32_MAX;
+  if (transit < INT32_MIN) transit = INT32_MIN;
+  unsigned long now = localMs();
+  portENTER_CRITICAL(&s_mux);
+  Peer* p = nullptr;
+  for (int i = 0; i < s_peerCount; ++i) {
+    if (s_peers[i].id == m.h.id) { p = &s_peers[i]; break; }
+  }
+  if (!p && s_peerCount < MAX_PEERS) {
+    p = &s_peers[s_peerCount++];
+    memset(p, 0, sizeof(*p));
+    p->id = m.h.id;
+  }
+  if (p) {
+    p->ip = ip;
+    p->seenMs = now;
+    p->flags = m.flags;
+    p->transitUs[p->transitPos] = (int32_t)transit;
+    p->transitPos = (p->transitPos + 1) % SKEW_WINDOW;
+    if (p->transitCount < SKEW_WINDOW) ++p->transitCount;
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+static void onRequest(const RequestMsg& m, uint32_t fromIp, int64_t rxUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  bool leader = s_isLeader;
+  portEXIT_CRITICAL(&s_mux);
+  if (!leader) return;
+  ReplyMsg r;
+  fillHeader(r.h, MsgReply);
+  r.t1 = m.t1;
+  r.t2 = toNet(rxUs);
+  r.t3 = toNet(localUs());
+  s_port.send((const uint8_t*)&r, sizeof(r), fromIp);
+}
+
+static void onReply(const ReplyMsg& m, int64_t rxUs)
+{
+  portENTER_CRITICAL(&s_mux);
+  if (!s_isLeader && m.h.id == s_leaderId && m.t1 == s_pollT1) {
+    Sample& s = s_samples[s_samplePos];
+    int64_t delay = (rxUs - m.t1) - (m.t3 - m.t2);
+    s.delayUs = delay < 0 ? 0 : (delay > INT32_MAX ? INT32_MAX : (int32_t)delay);
+    s.offsetUs = ((m.t2 - m.t1) + (m.t3 - rxUs)) / 2;
+    s.atUs = m.t1 + (rxUs - m.t1) / 2;
+    s_samplePos = (s_samplePos + 1) % SAMPLES;
+    if (s_sampleCount < SAMPLES) ++s_sampleCount;
+    s_samplesChanged = true;
+    s_pollT1 = 0;
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+// Received and local starts/stops alike are handed to loop()
+static void queueCommand(const Command& c)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_incoming = c;
+  portEXIT_CRITICAL(&s_mux);
+  s_incomingPending.store(true); // a newer command replaces one not yet applied
+  PowerManager::wake();
+}
+
+static void onCommand(const StartMsg& m)
+{
+  Command c;
+  c.key = m.key;
+  c.sender = m.h.id;
+  c.startNetUs = m.startNetUs;
+  c.durationMs = m.durationMs;
+  c.anim = m.anim;
+  c.stop = m.h.type == MsgStop;
+  c.local = false;
+  queueCommand(c);
+}
+
+// Animations that need no file (Playback and Program do)
+static bool shareable(uint8_t anim)
+{
+  LEDController::Animation a = (LEDController::Animation)anim;
+  return a != LEDController::Animation::None && a != LEDController::Animation::Playback &&
+         a != LEDController::Animation::Program && anim <= (uint8_t)LEDController::Animation::Dawn;
+}
+
+// Any task (the UDP task on the lamp)
+void receive(const uint8_t* data, size_t len, uint32_t fromIp, int64_t rxUs)
+{
+  Header h;
+  if (len < sizeof(h)) return;
+  memcpy(&h, data, sizeof(h));
+  if (h.magic != MAGIC || h.version != VERSION || h.id == s_id) return;
+  switch (h.type) {
+    case MsgBeacon:
+      if (len >= sizeof(BeaconMsg)) {
+        BeaconMsg m;
+        memcpy(&m, data, sizeof(m));
+        onBeacon(m, fromIp, rxUs);
+      }
+      break;
+    case MsgRequest:
+      if (len >= sizeof(RequestMsg)) {
+        RequestMsg m;
+        memcpy(&m, data, sizeof(m));
+        onRequest(m, fromIp, rxUs);
+      }
+      break;
+    case MsgReply:
+      if (len >= sizeof(ReplyMsg)) {
+        ReplyMsg m;
+        memcpy(&m, data, sizeof(m));
+        onReply(m, rxUs);
+      }
+      break;
+    case MsgStart:
+    case MsgStop:
+      if (len >= sizeof(StartMsg)) {
+        StartMsg m;
+        memcpy(&m, data, sizeof(m));
+        // A lamp running simulated time (Clock::simulate) is left alone
+        if (!Clock::simulated() && (m.h.type == MsgStop || shareable(m.anim))) onCommand(m);
+      }
+      break;
+  }
+}
+
+static void announce(uint8_t type, const Command& c)
+{
+  StartMsg m;
+  fillHeader(m.h, type);
+  m.key = c.key;
+  m.startNetUs = c.startNetUs;
+  m.durationMs = c.durationMs;
+  m.anim = c.anim;
+  portENTER_CRITICAL(&s_mux);
+  s_outgoing = m;
+  s_outgoingLeft = REPEATS;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+static void sendBeacon()
+{
+  BeaconMsg m;
+  fillHeader(m.h, MsgBeacon);
+  m.netUs = networkUs();
+  portENTER_CRITICAL(&s_mux);
+  m.leaderId = s_leaderId;
+  m.flags = s_isLeader ? FLAG_LEADER : 0;
+  portEXIT_CRITICAL(&s_mux);
+  if (synced()) m.flags |= FLAG_SYNCED;
+  s_port.send((const uint8_t*)&m, sizeof(m), 0);
+}
+
+static void sendPoll()
+{
+  RequestMsg m;
+  fillHeader(m.h, MsgRequest);
+  portENTER_CRITICAL(&s_mux);
+  bool poll = !s_isLeader && s_leaderId != 0;
+  uint32_t ip = s_leaderIp;
+  m.t1 = localUs();
+  if (poll) s_pollT1 = m.t1;
+  portEXIT_CRITICAL(&s_mux);
+  if (poll) s_port.send((const uint8_t*)&m, sizeof(m), ip);
+}
+
+// ------------------- Election -------------------
+
+static void follow(uint32_t id, uint32_t ip)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_isLeader = false;
+  s_leaderId = id;
+  s_leaderIp = ip;
+  s_sampleCount = 0;
+  s_samplePos = 0;
+  s_pollT1 = 0;
+  s_anchorValid = false;
+  s_driftValid = false;
+  s_driftPpb = 0; // relative to the old leader's clock
+  portEXIT_CRITICAL(&s_mux);
+  s_lastPollMs = s_lastBeaconMs - POLL_MS / 2; // next poll half way to the next beacon
+  EventLog::log(EventLog::Event::SyncLeader, id, 0);
+}
+
+// Keep the current leader while it is heard. A lamp joining a running group
+// follows the existing leader even if its own id is lower; only when no
+// leader has been heard for ELECTION_WAIT_MS does the lowest id take over.
+static void elect()
+{
+  unsigned long now = localMs();
+  uint32_t claimId = 0, claimIp = 0, lowestId = s_id;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < s_peerCount; ) {
+    Peer& p = s_peers[i];
+    if (now - p.seenMs > PEER_TIMEOUT_MS) {
+      p = s_peers[--s_peerCount];
+      continue;
+    }
+    if ((p.flags & FLAG_LEADER) && (claimId == 0 || p.id < claimId)) { claimId = p.id; claimIp = p.ip; }
+    if (p.id < lowestId) lowestId = p.id;
+    ++i;
+  }
+  bool leader = s_isLeader;
+  uint32_t current = s_leaderId;
+  portEXIT_CRITICAL(&s_mux);
+
+  if (claimId != 0) {
+    // Two groups merging: the leader with the higher id steps down
+    if ((!leader || claimId < s_id) && claimId != current) follow(claimId, claimIp);
+    return;
+  }
+  if (leader) return;
+  if (current != 0) {
+    portENTER_CRITICAL(&s_mux);
+    s_leaderId = 0; // leader lost; keep running on the last estimate
+    portEXIT_CRITICAL(&s_mux);
+    s_noLeaderSinceMs = now;
+    return;
+  }
+  if (now - s_noLeaderSinceMs >= ELECTION_WAIT_MS && lowestId == s_id) {
+    portENTER_CRITICAL(&s_mux);
+    s_isLeader = true;
+    s_leaderId = s_id;
+    portEXIT_CRITICAL(&s_mux);
+    EventLog::log(EventLog::Event::SyncLeader, s_id, 1);
+  }
+}
+
+// ------------------- Starts -------------------
+
+static void accept(const Command& c)
+{
+  if (c.sender != s_id && !CommandBus::network()) return; // a manual override holds the output
+  if (c.local) {
+    // Replaces any shared start, waiting or running
+    s_waitingValid = false;
+    s_currentValid = false;
+    if (c.stop) LEDController::stopAnimation();
+    else LEDController::startAnimation((LEDController::Animation)c.anim, c.durationMs);
+    return;
+  }
+  if (c.stop) {
+    if (c.key == s_lastStopKey) return; // repeat
+    s_lastStopKey = c.key;
+    s_waitingValid = false;
+    s_currentValid = false;
+    LEDController::stopAnimation();
+    return;
+  }
+  Command* have = s_waitingValid ? &s_waiting : (s_currentValid ? &s_current : nullptr);
+  if (have && have->key == c.key) {
+    if (c.sender >= have->sender) return; // repeat, or a later announcement of the same event
+    // The same event announced by a lower id: move to its start time
+    have->sender = c.sender;
+    have->startNetUs = c.startNetUs;
+    if (have == &s_current) s_lastRetimeMs = localMs() - RETIME_MS;
+    return;
+  }
+  s_waiting = c;
+  s_waitingValid = true;
+}
+
+static void applyDue()
+{
+  if (s_waitingValid) {
+    int64_t startUs = toLocal(s_waiting.startNetUs);
+    if (startUs > localUs()) return;
+    if (s_waiting.sender != s_id && !CommandBus::network()) {
+      s_waitingValid = false; // overridden while it was waiting
+      return;
+    }
+    unsigned long startMs = (unsigned long)Clock::msAt(startUs); // animation time
+    LEDController::startAnimationAt((LEDController::Animation)s_waiting.anim, s_waiting.durationMs, startMs);
+    s_current = s_waiting;
+    s_currentValid = true;
+    s_waitingValid = false;
+    s_appliedStartMs = startMs;
+    s_lastRetimeMs = localMs();
+    return;
+  }
+  if (!s_currentValid || localMs() - s_lastRetimeMs < RETIME_MS) return;
+  s_lastRetimeMs = localMs();
+  if (LEDController::currentAnimation() != (LEDController::Animation)s_current.anim ||
+      LEDController::animationStart() != s_appliedStartMs) {
+    s_currentValid = false; // ended, or replaced by a local start
+    return;
+  }
+  int64_t startUs = toLocal(s_current.startNetUs);
+  if (startUs > localUs()) return;
+  unsigned long startMs = (unsigned long)Clock::msAt(startUs);
+  if (startMs == s_appliedStartMs) return;
+  LEDController::retimeAnimation(startMs);
+  s_appliedStartMs = startMs;
+}
+
+void startShared(LEDController::Animation anim, unsigned long durationMs, uint32_t key)
+{
+  Command c;
+  c.key = key ? key : (esp_random() | 1);
+  c.sender = s_id;
+  // Simulated time starts local animations at once (the lead would be
+  // stretched by the clock speed)
+  c.startNetUs = networkUs() + (Clock::simulated() ? 0 : (int64_t)START_LEAD_MS * 1000);
+  c.durationMs = durationMs;
+  c.anim = (uint8_t)anim;
+  c.stop = false;
+  c.local = false;
+  if (s_listening && !Clock::simulated()) announce(MsgStart, c);
+  queueCommand(c);
+}
+
+void stopShared()
+{
+  Command c = {};
+  c.key = esp_random() | 1;
+  c.sender = s_id;
+  c.stop = true;
+  if (s_listening && !Clock::simulated()) announce(MsgStop, c);
+  queueCommand(c);
+}
+
+void startLocal(LEDController::Animation anim, unsigned long durationMs)
+{
+  Command c = {};
+  c.sender = s_id;
+  c.durationMs = durationMs;
+  c.anim = (uint8_t)anim;
+  c.local = true;
+  queueCommand(c);
+}
+
+void stopLocal()
+{
+  Command c = {};
+  c.sender = s_id;
+  c.stop = true;
+  c.local = true;
+  queueCommand(c);
+}
+
+// ------------------- Loop -------------------
+
+void begin(const Port& port)
+{
+  s_port = port;
+  s_id = port.id ? port.id : 1;
+}
+
+static void listen()
+{
+  if (!s_port.open()) return;
+  s_listening = true;
+  unsigned long now = localMs();
+  s_noLeaderSinceMs = now;
+  s_lastBeaconMs = now - BEACON_MS;
+  s_lastPollMs = now - POLL_MS / 2; // polls between beacons
+}
+
+void loop()
+{
+  if (s_incomingPending.exchange(false)) {
+    Command c;
+    portENTER_CRITICAL(&s_mux);
+    c = s_incoming;
+    portEXIT_CRITICAL(&s_mux);
+    accept(c);
+  }
+
+  if (!s_port.open) return;
+  if (!s_listening && s_port.ready()) listen();
+  if (s_listening) {
+    unsigned long now = localMs();
+    portENTER_CRITICAL(&s_mux);
+    bool send = s_outgoingLeft > 0 && now - s_lastSendMs >= REPEAT_MS;
+    StartMsg out = s_outgoing;
+    if (send) --s_outgoingLeft;
+    portEXIT_CRITICAL(&s_mux);
+    if (send) {
+      s_port.send((const uint8_t*)&out, sizeof(out), 0);
+      s_lastSendMs = now;
+    }
+    if (now - s_lastBeaconMs >= BEACON_MS) {
+      s_lastBeaconMs = now;
+      elect();
+      sendBeacon();
+    }
+    if (now - s_lastPollMs >= POLL_MS) {
+      s_lastPollMs = now;
+      sendPoll();
+    }
+    refit();
+  }
+
+  applyDue();
+}
+
+unsigned long msUntilNext()
+{
+  unsigned long wait = BEACON_MS;
+  unsigned long now = localMs();
+  if (s_listening) {
+    unsigned long since = now - s_lastBeaconMs;
+    wait = since >= BEACON_MS ? 0 : BEACON_MS - since;
+    portENTER_CRITICAL(&s_mux);
+    bool repeat = s_outgoingLeft > 0;
+    portEXIT_CRITICAL(&s_mux);
+    if (repeat) wait = min(wait, REPEAT_MS);
+  }
+  if (s_waitingValid) {
+    int64_t dueUs = toLocal(s_waiting.startNetUs) - localUs();
+    unsigned long due = dueUs <= 0 ? 0 : (unsigned long)((dueUs + 999) / 1000);
+    if (due < wait) wait = due;
+  }
+  return wait;
+}
+
+// ------------------- Status -------------------
+
+static String hexId(uint32_t id)
+{
+  char buf[9];
+  snprintf(buf, sizeof(buf), "%08x", (unsigned)id);
+  return String(buf);
+}
+
+String statusJson()
+{
+  Peer peers[MAX_PEERS];
+  portENTER_CRITICAL(&s_mux);
+  bool leader = s_isLeader;
+  uint32_t leaderId = s_leaderId;
+  int64_t local = localUs();
+  int64_t offset = toNetLocked(local) - local;
+  int32_t drift = s_driftPpb;
+  int32_t delay = s_bestDelayUs;
+  uint8_t samples = s_sampleCount;
+  uint8_t n = s_peerCount;
+  memcpy(peers, s_peers, sizeof(peers));
+  portEXIT_CRITICAL(&s_mux);
+
+  const char* role = leader ? "leader" : (leaderId ? "follower" : "alone");
+  String json = String("{\"id\":\"") + hexId(s_id) + "\",\"role\":\"" + role + "\",\"leader\":";
+  json += leaderId ? String("\"") + hexId(leaderId) + "\"" : String("null");
+  json += String(",\"synced\":") + (synced() ? "true" : "false");
+  json += String(",\"offsetUs\":") + String((long)offset);
+  json += String(",\"driftPpm\":") + String(drift / 1000.0f, 3);
+  json += String(",\"delayUs\":") + String((long)delay);
+  json += String(",\"samples\":") + String((unsigned)samples);
+  json += ",\"peers\":[";
+  unsigned long now = localMs();
+  int32_t maxSkew = 0;
+  for (int i = 0; i < n; ++i) {
+    const Peer& p = peers[i];
+    int32_t skew = 0;
+    for (int k = 0; k < p.transitCount; ++k) {
+      if (k == 0 || p.transitUs[k] < skew) skew = p.transitUs[k];
+    }
+    int32_t mag = skew < 0 ? -skew : skew;
+    if ((p.flags & FLAG_SYNCED) && mag > maxSkew) maxSkew = mag;
+    if (i) json += ",";
+    json += String("{\"id\":\"") + hexId(p.id) + "\",\"ip\":\"" + IPAddress(p.ip).toString() + "\"";
+    json += String(",\"leader\":") + ((p.flags & FLAG_LEADER) ? "true" : "false");
+    json += String(",\"synced\":") + ((p.flags & FLAG_SYNCED) ? "true" : "false");
+    json += String(",\"skewUs\":") + String((long)skew);
+    json += String(",\"ageMs\":") + String(now - p.seenMs) + "}";
+  }
+  json += String("],\"maxSkewUs\":") + String((long)maxSkew) + "}";
+  return json;
+}
+
+} // namespace LampSync
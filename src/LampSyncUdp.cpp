@@ -0,0 +1,50 @@
+#include "LampSync.h"
+#include <AsyncUDP.h>
+#include <esp_timer.h>
+#include "WiFiManager.h"
+
+// LampSync on the ESP32: esp_timer clock, UDP multicast group on the WiFi LAN
+namespace LampSync {
+
+static AsyncUDP s_udp;
+static const IPAddress GROUP(239, 255, 76, 83);
+
+static int64_t udpNowUs()
+{
+  return esp_timer_get_time();
+}
+
+static bool udpReady()
+{
+  return WifiMgr::connected();
+}
+
+static bool udpOpen()
+{
+  if (!s_udp.listenMulticast(GROUP, PORT)) return false;
+  // Runs on the UDP task; the arrival time is taken before anything else
+  s_udp.onPacket([](AsyncUDPPacket& p) {
+    int64_t rxUs = esp_timer_get_time();
+    receive(p.data(), p.length(), (uint32_t)p.remoteIP(), rxUs);
+  });
+  return true;
+}
+
+static void udpSend(const uint8_t* data, size_t length, uint32_t ip)
+{
+  s_udp.writeTo(data, length, ip ? IPAddress(ip) : GROUP, PORT);
+}
+
+void begin()
+{
+  Port port;
+  // Last four MAC bytes (the first three are the vendor prefix)
+  port.id = (uint32_t)(ESP.getEfuseMac() >> 16);
+  port.nowUs = udpNowUs;
+  port.ready = udpReady;
+  port.open = udpOpen;
+  port.send = udpSend;
+  begin(port);
+}
+
+} // namespace LampSync
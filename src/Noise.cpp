@@ -0,0 +1,106 @@
+#include "Noise.h"
+
+namespace Noise {
+
+// Lattice values: Perlin's reference permutation of 0..255
+static const uint8_t PERM[256] = {
+  151, 160, 137,  91,  90,  15, 131,  13, 201,  95,  96,  53, 194, 233,   7, 225,
+  140,  36, 103,  30,  69, 142,   8,  99,  37, 240,  21,  10,  23, 190,   6, 148,
+  247, 120, 234,  75,   0,  26, 197,  62,  94, 252, 219, 203, 117,  35,  11,  32,
+   57, 177,  33,  88, 237, 149,  56,  87, 174,  20, 125, 136, 171, 168,  68, 175,
+   74, 165,  71, 134, 139,  48,  27, 166,  77, 146, 158, 231,  83, 111, 229, 122,
+   60, 211, 133, 230, 220, 105,  92,  41,  55,  46, 245,  40, 244, 102, 143,  54,
+   65,  25,  63, 161,   1, 216,  80,  73, 209,  76, 132, 187, 208,  89,  18, 169,
+  200, 196, 135, 130, 116, 188, 159,  86, 164, 100, 109, 198, 173, 186,   3,  64,
+   52, 217, 226, 250, 124, 123,   5, 202,  38, 147, 118, 126, 255,  82,  85, 212,
+  207, 206,  59, 227,  47,  16,  58,  17, 182, 189,  28,  42, 223, 183, 170, 213,
+  119, 248, 152,   2,  44, 154, 163,  70, 221, 153, 101, 155, 167,  43, 172,   9,
+  129,  22,  39, 253,  19,  98, 108, 110,  79, 113, 224, 232, 178, 185, 112, 104,
+  218, 246,  97, 228, 251,  34, 242, 193, 238, 210, 144,  12, 191, 179, 162, 241,
+   81,  51, 145, 235, 249,  14, 239, 107,  49, 192, 214,  31, 181, 199, 106, 157,
+  184,  84, 204, 176, 115, 121,  50,  45, 127,   4, 150, 254, 138, 236, 205,  93,
+  222, 114,  67,  29,  24,  72, 243, 141, 128, 195,  78,  66, 215,  61, 156, 180,
+};
+
+// Smoothstep 3t^2 - 2t^3 over t = i / 255, scaled to 0..255
+static const uint8_t FADE[256] = {
+    0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   2,   2,   2,   3,
+    3,   3,   4,   4,   4,   5,   5,   6,   6,   7,   7,   8,   9,   9,  10,  10,
+   11,  12,  12,  13,  14,  15,  15,  16,  17,  18,  18,  19,  20,  21,  22,  23,
+   24,  25,  26,  27,  27,  28,  29,  30,  31,  33,  34,  35,  36,  37,  38,  39,
+   40,  41,  42,  44,  45,  46,  47,  48,  50,  51,  52,  53,  54,  56,  57,  58,
+   60,  61,  62,  63,  65,  66,  67,  69,  70,  72,  73,  74,  76,  77,  78,  80,
+   81,  83,  84,  85,  87,  88,  90,  91,  93,  94,  96,  97,  98, 100, 101, 103,
+  104, 106, 107, 109, 110, 112, 113, 115, 116, 118, 119, 121, 122, 124, 125, 127,
+  128, 130, 131, 133, 134, 136, 137, 139, 140, 142, 143, 145, 146, 148, 149, 151,
+  152, 154, 155, 157, 158, 159, 161, 162, 164, 165, 167, 168, 170, 171, 172, 174,
+  175, 177, 178, 179, 181, 182, 183, 185, 186, 188, 189, 190, 192, 193, 194, 195,
+  197, 198, 199, 201, 202, 203, 204, 205, 207, 208, 209, 210, 211, 213, 214, 215,
+  216, 217, 218, 219, 220, 221, 222, 224, 225, 226, 227, 228, 228, 229, 230, 231,
+  232, 233, 234, 235, 236, 237, 237, 238, 239, 240, 240, 241, 242, 243, 243, 244,
+  245, 245, 246, 246, 247, 248, 248, 249, 249, 250, 250, 251, 251, 251, 252, 252,
+  252, 253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255,
+};
+
+// a + (b - a) * w / 256 with w = 0..255 stretched to 0..256
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t w)
+{
+  int32_t wt = w + (w >> 7);
+  return (uint8_t)(a + (((int32_t)b - a) * wt >> 8));
+}
+
+uint8_t noise1(uint32_t x)
+{
+  uint8_t xi = (uint8_t)(x >> 8);
+  return lerp8(PERM[xi], PERM[(uint8_t)(xi + 1)], FADE[x & 255]);
+}
+
+uint8_t noise2(uint32_t x, uint32_t y)
+{
+  uint8_t xi = (uint8_t)(x >> 8), yi = (uint8_t)(y >> 8);
+  uint8_t u = FADE[x & 255], v = FADE[y & 255];
+  uint8_t a = PERM[xi], b = PERM[(uint8_t)(xi + 1)];
+  uint8_t aa = PERM[(uint8_t)(a + yi)], ab = PERM[(uint8_t)(a + yi + 1)];
+  uint8_t ba = PERM[(uint8_t)(b + yi)], bb = PERM[(uint8_t)(b + yi + 1)];
+  return lerp8(lerp8(aa, ba, u), lerp8(ab, bb, u), v);
+}
+
+uint8_t noise3(uint32_t x, uint32_t y, uint32_t z)
+{
+  uint8_t xi = (uint8_t)(x >> 8), yi = (uint8_t)(y >> 8), zi = (uint8_t)(z >> 8);
+  uint8_t u = FADE[x & 255], v = FADE[y & 255], w = FADE[z & 255];
+  uint8_t a = PERM[xi], b = PERM[(uint8_t)(xi + 1)];
+  uint8_t aa = PERM[(uint8_t)(a + yi)], ab = PERM[(uint8_t)(a + yi + 1)];
+  uint8_t ba = PERM[(uint8_t)(b + yi)], bb = PERM[(uint8_t)(b + yi + 1)];
+  uint8_t z0 = lerp8(lerp8(PERM[(uint8_t)(aa + zi)], PERM[(uint8_t)(ba + zi)], u),
+                     lerp8(PERM[(uint8_t)(ab + zi)], PERM[(uint8_t)(bb + zi)], u), v);
+  uint8_t z1 = lerp8(lerp8(PERM[(uint8_t)(aa + zi + 1)], PERM[(uint8_t)(ba + zi + 1)], u),
+                     lerp8(PERM[(uint8_t)(ab + zi + 1)], PERM[(uint8_t)(bb + zi + 1)], u), v);
+  return lerp8(z0, z1, w);
+}
+
+uint8_t fractal2(uint32_t x, uint32_t y, uint8_t octaves)
+{
+  uint32_t acc = 0, norm = 0;
+  uint32_t amp = 128;
+  for (uint8_t o = 0; o < octaves && amp > 0; ++o) {
+    acc += noise2(x, y) * amp;
+    norm += amp;
+    amp >>= 1;
+    // next octave: double frequency, shift so lattice points do not line up
+    x = (x << 1) + 0x3A7;
+    y = (y << 1) + 0x1C5;
+  }
+  return norm ? (uint8_t)(acc / norm) : 0;
+}
+
+uint32_t benchUs(uint32_t samples)
+{
+  volatile uint8_t sink = 0;
+  uint32_t t0 = micros();
+  for (uint32_t i = 0; i < samples; ++i) sink = sink + noise3(i * 37, i * 11, i);
+  (void)sink;
+  return micros() - t0;
+}
+
+} // namespace Noise
@@ -1,32 +1,153 @@
 #include "OTAHandler.h"
 #include <ArduinoOTA.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <atomic>
+#include "LEDController.h"
+#include "EventLog.h"
 
 namespace OTAHandler {
 
+static const unsigned long POLL_MS = 100;       // invitation polling while idle
+static const uint32_t TASK_STACK = 8192;
+static const unsigned PROGRESS_STEP_PERCENT = 10;
+
+// Result of the last upload (persisted in NVS "ota")
+struct Result {
+  uint32_t bytes;
+  uint32_t durationMs;
+  int32_t error;   // ota_error_t, or -1 when no upload was recorded
+  bool ok;
+};
+
+static TaskHandle_t s_task = nullptr;
+static std::atomic<bool> s_active(false);
+static std::atomic<uint32_t> s_bytes(0);
+static std::atomic<uint32_t> s_total(0);
+static int64_t s_startUs = 0;
+static unsigned s_nextReport = 0;  // next progress percentage to print
+static bool s_wifiSleep = true;
+static Result s_last = {0, 0, -1, false};
+
+static void saveResult(const Result& r)
+{
+  s_last = r;
+  Preferences prefs;
+  if (!prefs.begin("ota", false)) return;
+  prefs.putBytes("last", &r, sizeof(r));
+  prefs.end();
+}
+
+static void loadResult()
+{
+  Preferences prefs;
+  if (!prefs.begin("ota", true)) return;
+  if (prefs.getBytesLength("last") == sizeof(Result)) prefs.getBytes("last", &s_last, sizeof(s_last));
+  prefs.end();
+}
+
+static Result finish(bool ok, int32_t error)
+{
+  Result r;
+  r.bytes = s_bytes.load();
+  r.durationMs = (uint32_t)((esp_timer_get_time() - s_startUs) / 1000);
+  r.error = error;
+  r.ok = ok;
+  return r;
+}
+
+static void onStart()
+{
+  s_startUs = esp_timer_get_time();
+  s_bytes.store(0);
+  s_total.store(0);
+  s_nextReport = PROGRESS_STEP_PERCENT;
+  s_active.store(true);
+  LEDController::setOutputFrozen(true);
+  s_wifiSleep = WiFi.getSleep();
+  WiFi.setSleep(false);
+  EventLog::log(EventLog::Event::OtaStart);
+}
+
+static void onProgress(unsigned int progress, unsigned int total)
+{
+  s_bytes.store(progress);
+  s_total.store(total);
+  // Called for every chunk; log every 10% only
+  unsigned percent = total ? (unsigned)((uint64_t)progress * 100 / total) : 0;
+  if (percent >= s_nextReport) {
+    EventLog::log(EventLog::Event::OtaProgress, percent);
+    s_nextReport = (percent / PROGRESS_STEP_PERCENT + 1) * PROGRESS_STEP_PERCENT;
+  }
+}
+
+static void onEnd()
+{
+  Result r = finish(true, 0);
+  saveResult(r); // the device reboots right after this callback
+  EventLog::log(EventLog::Event::OtaEnd, r.bytes, r.durationMs,
+                r.durationMs ? (uint32_t)((uint64_t)r.bytes * 1000 / r.durationMs) : 0);
+}
+
+static void onError(ota_error_t error)
+{
+  saveResult(finish(false, (int32_t)error));
+  EventLog::log(EventLog::Event::OtaError, (uint32_t)error);
+  // The upload is abandoned and the device keeps running: resume output
+  WiFi.setSleep(s_wifiSleep);
+  LEDController::setOutputFrozen(false);
+  s_active.store(false);
+}
+
+static void otaTask(void*)
+{
+  for (;;) {
+    ArduinoOTA.handle(); // blocks for the whole transfer once an upload starts
+    vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+  }
+}
+
 bool begin(const char* hostname)
 {
   // Wrap in try-like defensive checks. ArduinoOTA functions don't throw but
   // init may fail if network stack isn't initialized; we return false then.
   bool ok = true;
+  loadResult();
   ArduinoOTA.setHostname(hostname);
-  ArduinoOTA.onStart([](){ Serial.println("OTA Start"); });
-  ArduinoOTA.onEnd([](){ Serial.println("\nOTA End"); });
-  ArduinoOTA.onProgress([](unsigned int progress, unsigned int total){
-    Serial.printf("OTA Progress: %u%%\r", (progress / (total / 100)));
-  });
-  ArduinoOTA.onError([](ota_error_t error){
-    Serial.printf("OTA Error[%u]\n", error);
-  });
+  ArduinoOTA.onStart(onStart);
+  ArduinoOTA.onEnd(onEnd);
+  ArduinoOTA.onProgress(onProgress);
+  ArduinoOTA.onError(onError);
 
   // begin may fail; catch that by checking return of begin() if available.
   ArduinoOTA.begin();
+  // Same core as the WiFi/TCP stack, away from the render loop
+  if (!s_task && xTaskCreatePinnedToCore(otaTask, "ota", TASK_STACK, nullptr, 1, &s_task, 0) != pdPASS) {
+    s_task = nullptr;
+    ok = false;
+  }
   return ok;
 }
 
-void handle()
+bool active()
+{
+  return s_active.load();
+}
+
+String statusJson()
 {
-  // Keep OTA handling in loop; allow caller to call this regularly.
-  ArduinoOTA.handle();
+  uint32_t total = s_total.load();
+  uint32_t progress = total ? (uint32_t)((uint64_t)s_bytes.load() * 100 / total) : 0;
+  Result r = s_last;
+  String json = String("{\"active\":") + (active() ? "true" : "false") + ",\"progress\":" + String(progress);
+  if (r.error < 0) return json + ",\"last\":null}";
+  json += String(",\"last\":{\"ok\":") + (r.ok ? "true" : "false");
+  json += String(",\"bytes\":") + String(r.bytes);
+  json += String(",\"durationMs\":") + String(r.durationMs);
+  json += String(",\"bytesPerSec\":") + String(r.durationMs ? (uint32_t)((uint64_t)r.bytes * 1000 / r.durationMs) : 0u);
+  json += String(",\"error\":") + String(r.error) + "}}";
+  return json;
 }
 
 } // namespace OTAHandler
@@ -0,0 +1,117 @@
+#include "PixelKernels.h"
+
+namespace PixelKernels {
+
+namespace Ref {
+
+static uint8_t lane(uint32_t c, int i) { return (uint8_t)(c >> (8 * i)); }
+
+uint32_t scale(uint32_t c, uint8_t s)
+{
+  uint32_t out = 0;
+  for (int i = 0; i < 4; ++i) out |= (uint32_t)((lane(c, i) * ((uint32_t)s + 1)) >> 8) << (8 * i);
+  return out;
+}
+
+uint32_t lerp(uint32_t a, uint32_t b, uint16_t t)
+{
+  uint32_t out = 0;
+  for (int i = 0; i < 4; ++i) {
+    uint32_t v = (lane(a, i) * (256u - t) + lane(b, i) * (uint32_t)t) >> 8;
+    out |= v << (8 * i);
+  }
+  return out;
+}
+
+uint32_t addSat(uint32_t a, uint32_t b)
+{
+  uint32_t out = 0;
+  for (int i = 0; i < 4; ++i) {
+    uint32_t v = (uint32_t)lane(a, i) + lane(b, i);
+    out |= (v > 255 ? 255u : v) << (8 * i);
+  }
+  return out;
+}
+
+uint32_t add(uint32_t a, uint32_t b, uint8_t s)
+{
+  return addSat(a, scale(b, s));
+}
+
+} // namespace Ref
+
+static uint32_t s_rng = 0x12345678u;
+
+static uint32_t nextRandom()
+{
+  // xorshift32
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+// Random words biased toward lane values 0 and 255, where overflow bugs hide
+static uint32_t randomPixel()
+{
+  uint32_t r = nextRandom();
+  uint32_t m = nextRandom();
+  for (int i = 0; i < 4; ++i) {
+    uint32_t sel = (m >> (8 * i)) & 7;
+    if (sel == 0) r &= ~(0xFFu << (8 * i));
+    else if (sel == 1) r |= 0xFFu << (8 * i);
+  }
+  return r;
+}
+
+uint32_t verify(uint32_t samples, uint32_t benchIterations, KernelReport* out)
+{
+  static const char* const NAMES[KERNEL_COUNT] = { "scale", "lerp", "addSat", "add" };
+  for (int k = 0; k < KERNEL_COUNT; ++k) out[k] = KernelReport{ NAMES[k], 0, 0, 0 };
+
+  s_rng = 0x12345678u;
+  for (uint32_t i = 0; i < samples; ++i) {
+    uint32_t a = randomPixel(), b = randomPixel();
+    uint8_t s = (uint8_t)(i < 256 ? i : nextRandom()); // all factors first
+    uint16_t t = (uint16_t)(i <= 256 ? i : nextRandom() % 257);
+    if (scale(a, s) != Ref::scale(a, s)) ++out[0].mismatches;
+    if (lerp(a, b, t) != Ref::lerp(a, b, t)) ++out[1].mismatches;
+    if (addSat(a, b) != Ref::addSat(a, b)) ++out[2].mismatches;
+    if (add(a, b, s) != Ref::add(a, b, s)) ++out[3].mismatches;
+  }
+
+  // Timing over one logical frame worth of pixels
+  static const uint16_t N = 256;
+  static uint32_t src[N], dst[N];
+  for (uint16_t i = 0; i < N; ++i) { src[i] = randomPixel(); dst[i] = randomPixel(); }
+  volatile uint32_t sink = 0;
+  for (int k = 0; k < KERNEL_COUNT; ++k) {
+    for (int ref = 0; ref < 2; ++ref) {
+      uint32_t t0 = micros();
+      for (uint32_t it = 0; it < benchIterations; ++it) {
+        uint8_t s = (uint8_t)(it | 1);
+        for (uint16_t i = 0; i < N; ++i) {
+          uint32_t a = dst[i], b = src[i], v;
+          switch (k) {
+            case 0:  v = ref ? Ref::scale(b, s) : scale(b, s); break;
+            case 1:  v = ref ? Ref::lerp(a, b, s) : lerp(a, b, s); break;
+            case 2:  v = ref ? Ref::addSat(a, b) : addSat(a, b); break;
+            default: v = ref ? Ref::add(a, b, s) : add(a, b, s); break;
+          }
+          dst[i] = v ^ (uint32_t)it; // keep inputs changing
+        }
+      }
+      uint32_t us = micros() - t0;
+      if (ref) out[k].scalarUs = us;
+      else out[k].swarUs = us;
+      sink = sink + dst[0];
+    }
+  }
+  (void)sink;
+
+  uint32_t total = 0;
+  for (int k = 0; k < KERNEL_COUNT; ++k) total += out[k].mismatches;
+  return total;
+}
+
+} // namespace PixelKernels
@@ -0,0 +1,18 @@
+#include "PixelOutput.h"
+
+namespace PixelOutput {
+
+void writeGeneric(const uint32_t* frame, uint8_t brightness,
+                  Adafruit_NeoPixel& left, Adafruit_NeoPixel& right)
+{
+  uint16_t n2 = left.numPixels();
+  uint16_t total = n2 + right.numPixels();
+  if (total > MAX_PIXELS) total = MAX_PIXELS;
+  for (uint16_t i = 0; i < total; ++i) {
+    Adafruit_NeoPixel& strip = i < n2 ? left : right;
+    uint16_t pix = i < n2 ? n2 - 1 - i : i - n2;
+    strip.setPixelColor(pix, PixelKernels::scale(frame[i], brightness));
+  }
+}
+
+} // namespace PixelOutput
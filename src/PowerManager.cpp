@@ -0,0 +1,136 @@
+#include "PowerManager.h"
+#include <esp_pm.h>
+#include <esp_timer.h>
+
+namespace PowerManager {
+
+static const uint32_t ACTIVE_CPU_MHZ = 240;
+static const uint32_t IDLE_CPU_MHZ = 80; // lowest frequency that keeps WiFi and APB at 80 MHz
+
+static TaskHandle_t s_loopTask = nullptr;
+static State s_state = Active;
+// Automatic light sleep / DFS through esp_pm (only if the SDK was built with
+// CONFIG_PM_ENABLE). Otherwise the CPU frequency is switched by hand.
+static bool s_pmAuto = false;
+static esp_pm_lock_handle_t s_freqLock = nullptr;
+static esp_pm_lock_handle_t s_sleepLock = nullptr;
+// LEDC runs from the APB clock, which stops in light sleep: the PWM output
+// would freeze or go dark, so light sleep waits while it is on.
+static esp_pm_lock_handle_t s_pwmLock = nullptr;
+static bool s_pwmOn = false;
+
+// Accounting (microseconds)
+static int64_t s_lastMarkUs = 0;
+static uint64_t s_runUs[StateCount] = {0, 0};
+static uint64_t s_blockedUs[StateCount] = {0, 0};
+static uint32_t s_wakeups = 0;   // early returns caused by wake()
+static uint32_t s_timeouts = 0;  // returns because the deadline passed
+
+static void account(bool blocked)
+{
+  int64_t now = esp_timer_get_time();
+  uint64_t dt = (uint64_t)(now - s_lastMarkUs);
+  if (blocked) s_blockedUs[s_state] += dt;
+  else s_runUs[s_state] += dt;
+  s_lastMarkUs = now;
+}
+
+static void enterState(State st)
+{
+  if (st == s_state) return;
+  account(false);
+  s_state = st;
+  if (s_pmAuto) {
+    if (st == Active) {
+      esp_pm_lock_acquire(s_freqLock);
+      esp_pm_lock_acquire(s_sleepLock);
+    } else {
+      esp_pm_lock_release(s_sleepLock);
+      esp_pm_lock_release(s_freqLock);
+    }
+  } else {
+    setCpuFrequencyMhz(st == Active ? ACTIVE_CPU_MHZ : IDLE_CPU_MHZ);
+  }
+}
+
+void begin()
+{
+  s_loopTask = xTaskGetCurrentTaskHandle();
+  s_lastMarkUs = esp_timer_get_time();
+
+  esp_pm_config_esp32_t cfg;
+  cfg.max_freq_mhz = ACTIVE_CPU_MHZ;
+  cfg.min_freq_mhz = IDLE_CPU_MHZ;
+  cfg.light_sleep_enable = true;
+  s_pmAuto = esp_pm_configure(&cfg) == ESP_OK &&
+             esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "render", &s_freqLock) == ESP_OK &&
+             esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "render", &s_sleepLock) == ESP_OK &&
+             esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pwm", &s_pwmLock) == ESP_OK;
+  // Start Active: setup() and the first frames run at full speed.
+  s_state = Active;
+  if (s_pmAuto) {
+    esp_pm_lock_acquire(s_freqLock);
+    esp_pm_lock_acquire(s_sleepLock);
+    if (s_pwmOn) esp_pm_lock_acquire(s_pwmLock);
+  }
+}
+
+void pwmOutput(bool on)
+{
+  if (on == s_pwmOn) return;
+  s_pwmOn = on;
+  if (!s_pmAuto) return;
+  if (on) esp_pm_lock_acquire(s_pwmLock);
+  else esp_pm_lock_release(s_pwmLock);
+}
+
+void wake()
+{
+  if (s_loopTask) xTaskNotifyGive(s_loopTask);
+}
+
+void IRAM_ATTR wakeFromISR()
+{
+  if (!s_loopTask) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(s_loopTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void sleepUntilNext(unsigned long timeoutMs, bool busy)
+{
+  enterState(busy ? Active : Idle);
+  account(false);
+  uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+  account(true);
+  if (notified) {
+    ++s_wakeups;
+  } else {
+    ++s_timeouts;
+  }
+}
+
+State state()
+{
+  return s_state;
+}
+
+String statsJson()
+{
+  // Snapshot is taken on the HTTP task; values are only approximately coherent.
+  String json = "{";
+  json += String("\"state\":\"") + (s_state == Active ? "active" : "idle") + "\",";
+  json += String("\"cpuMhz\":") + String(getCpuFrequencyMhz()) + ",";
+  json += String("\"autoLightSleep\":") + (s_pmAuto ? "true" : "false") + ",";
+  json += String("\"pwmHoldsAwake\":") + (s_pmAuto && s_pwmOn ? "true" : "false") + ",";
+  json += String("\"activeRunMs\":") + String((unsigned long)(s_runUs[Active] / 1000)) + ",";
+  json += String("\"activeBlockedMs\":") + String((unsigned long)(s_blockedUs[Active] / 1000)) + ",";
+  json += String("\"idleRunMs\":") + String((unsigned long)(s_runUs[Idle] / 1000)) + ",";
+  json += String("\"idleBlockedMs\":") + String((unsigned long)(s_blockedUs[Idle] / 1000)) + ",";
+  json += String("\"wakeups\":") + String(s_wakeups) + ",";
+  json += String("\"timeouts\":") + String(s_timeouts);
+  json += "}";
+  return json;
+}
+
+} // namespace PowerManager
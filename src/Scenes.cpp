@@ -0,0 +1,266 @@
+#include "Scenes.h"
+#include "StripStore.h"
+#include "PowerManager.h"
+#include "CommandBus.h"
+#include <Preferences.h>
+#include <atomic>
+
+namespace Scenes {
+
+enum SlotState : uint8_t { Empty = 0, Used = 1, Deleted = 2 };
+
+// Persisted record per slot (NVS key "s<slot>"). Append new fields at the end
+// and keep the Animation enum order stable: records are stored as raw bytes.
+struct Record {
+  uint8_t state;
+  uint32_t hash;
+  Scene scene;
+};
+
+static const char* NVS_NAMESPACE = "scenes";
+static const unsigned long BUTTON_DEBOUNCE_MS = 250;
+
+static Record s_table[SLOT_COUNT];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<int> s_pending(-1);
+static int s_lastRecalled = -1;
+static bool s_clearPixels = false; // a scene's image clear waits for an upload to end
+
+static int s_buttonPin = -1;
+static volatile uint32_t s_buttonPresses = 0;
+static uint32_t s_buttonSeen = 0;
+static unsigned long s_lastButtonMs = 0;
+
+// FNV-1a; 0 is reserved so a hash never looks like an unused slot
+static uint32_t hashName(const char* name)
+{
+  uint32_t h = 2166136261u;
+  for (const char* p = name; *p; ++p) {
+    h ^= (uint8_t)*p;
+    h *= 16777619u;
+  }
+  return h ? h : 1;
+}
+
+// Names are short identifiers ([A-Za-z0-9_-]) so they can go into JSON and
+// URLs unescaped.
+static bool validName(const char* name)
+{
+  if (!name || !*name) return false;
+  size_t len = 0;
+  for (const char* p = name; *p; ++p, ++len) {
+    char c = *p;
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!ok) return false;
+  }
+  return len < NAME_LEN;
+}
+
+// Probe sequence for `hash`: at most SLOT_COUNT steps. Returns the slot of a
+// used entry with that name, or -1. `freeSlot` receives the first reusable
+// slot on the way (-1 if none). Call with s_mux held.
+static int probe(const char* name, uint32_t hash, int& freeSlot)
+{
+  freeSlot = -1;
+  for (int i = 0; i < SLOT_COUNT; ++i) {
+    int slot = (int)((hash + (uint32_t)i) & (SLOT_COUNT - 1));
+    const Record& r = s_table[slot];
+    if (r.state == Used) {
+      if (r.hash == hash && strcmp(r.scene.name, name) == 0) return slot;
+      continue;
+    }
+    if (freeSlot < 0) freeSlot = slot;
+    if (r.state == Empty) break; // name would have been placed here or earlier
+  }
+  return -1;
+}
+
+static void persist(int slot)
+{
+  Record rec;
+  portENTER_CRITICAL(&s_mux);
+  rec = s_table[slot];
+  portEXIT_CRITICAL(&s_mux);
+  char key[4] = { 's', (char)('0' + slot), '\0', '\0' };
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.putBytes(key, &rec, sizeof(rec));
+  prefs.end();
+}
+
+static void IRAM_ATTR onButton()
+{
+  s_buttonPresses = s_buttonPresses + 1;
+  PowerManager::wakeFromISR();
+}
+
+void begin(int buttonPin)
+{
+  memset(s_table, 0, sizeof(s_table));
+  Preferences prefs;
+  if (prefs.begin(NVS_NAMESPACE, true)) {
+    for (int slot = 0; slot < SLOT_COUNT; ++slot) {
+      char key[4] = { 's', (char)('0' + slot), '\0', '\0' };
+      Record rec;
+      if (prefs.getBytesLength(key) == sizeof(rec) && prefs.getBytes(key, &rec, sizeof(rec)) == sizeof(rec)) {
+        rec.scene.name[NAME_LEN - 1] = '\0';
+        s_table[slot] = rec;
+      }
+    }
+    prefs.end();
+  }
+
+  s_buttonPin = buttonPin;
+  if (s_buttonPin >= 0) {
+    pinMode(s_buttonPin, INPUT_PULLUP);
+    attachInterrupt(s_buttonPin, onButton, FALLING);
+  }
+}
+
+int find(const char* name)
+{
+  if (!validName(name)) return -1;
+  uint32_t hash = hashName(name);
+  int freeSlot;
+  portENTER_CRITICAL(&s_mux);
+  int slot = probe(name, hash, freeSlot);
+  portEXIT_CRITICAL(&s_mux);
+  return slot;
+}
+
+int save(const char* name, LEDController::Animation anim, unsigned long animDurationMs)
+{
+  if (!validName(name)) return -1;
+  Record rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.state = Used;
+  rec.hash = hashName(name);
+  strncpy(rec.scene.name, name, NAME_LEN - 1);
+  rec.scene.dim = StripStore::read(StripStore::Dim);
+  rec.scene.ws1 = StripStore::read(StripStore::WS1);
+  rec.scene.ws2 = StripStore::read(StripStore::WS2);
+  rec.scene.anim = anim;
+  rec.scene.animDurationMs = animDurationMs;
+
+  int freeSlot;
+  portENTER_CRITICAL(&s_mux);
+  int slot = probe(name, rec.hash, freeSlot);
+  if (slot < 0) slot = freeSlot;
+  if (slot >= 0) s_table[slot] = rec;
+  portEXIT_CRITICAL(&s_mux);
+  if (slot >= 0) persist(slot);
+  return slot;
+}
+
+bool remove(const char* name)
+{
+  int slot = find(name);
+  if (slot < 0) return false;
+  portENTER_CRITICAL(&s_mux);
+  s_table[slot].state = Deleted; // tombstone keeps later probe chains intact
+  portEXIT_CRITICAL(&s_mux);
+  persist(slot);
+  return true;
+}
+
+bool recall(int slot)
+{
+  if (slot < 0 || slot >= SLOT_COUNT) return false;
+  portENTER_CRITICAL(&s_mux);
+  bool used = s_table[slot].state == Used;
+  portEXIT_CRITICAL(&s_mux);
+  if (!used) return false;
+  s_pending.store(slot);
+  PowerManager::wake();
+  return true;
+}
+
+static void apply(int slot)
+{
+  Scene scene;
+  portENTER_CRITICAL(&s_mux);
+  bool used = s_table[slot].state == Used;
+  scene = s_table[slot].scene;
+  portEXIT_CRITICAL(&s_mux);
+  if (!used) return;
+
+  // All of this runs on the render task before LEDController::loop(), so the
+  // next frame picks up every part of the scene together.
+  StripStore::write(StripStore::Dim, scene.dim);
+  StripStore::write(StripStore::WS1, scene.ws1);
+  StripStore::write(StripStore::WS2, scene.ws2);
+  // The scene's colors replace a per-pixel image (/api/pixels); while an
+  // upload runs the clear is retried on the next passes
+  s_clearPixels = !LEDController::clearPixels(0);
+  if (scene.anim != LEDController::Animation::None) {
+    LEDController::startAnimation(scene.anim, scene.animDurationMs);
+  } else {
+    LEDController::stopAnimation();
+  }
+  s_lastRecalled = slot;
+}
+
+// Next used slot after the last recalled one (wrapping), or -1
+static int nextUsedSlot()
+{
+  for (int i = 1; i <= SLOT_COUNT; ++i) {
+    int slot = (s_lastRecalled + i + SLOT_COUNT) % SLOT_COUNT;
+    if (s_table[slot].state == Used) return slot;
+  }
+  return -1;
+}
+
+void loop()
+{
+  int slot = s_pending.exchange(-1);
+  if (slot >= 0) apply(slot);
+  if (s_clearPixels && LEDController::clearPixels(0)) s_clearPixels = false;
+
+  uint32_t presses = s_buttonPresses;
+  if (presses != s_buttonSeen) {
+    s_buttonSeen = presses;
+    unsigned long nowMs = millis();
+    if (nowMs - s_lastButtonMs >= BUTTON_DEBOUNCE_MS) {
+      s_lastButtonMs = nowMs;
+      portENTER_CRITICAL(&s_mux);
+      int next = nextUsedSlot();
+      portEXIT_CRITICAL(&s_mux);
+      if (next >= 0) {
+        CommandBus::manual(); // the button is a manual command
+        apply(next);
+      }
+    }
+  }
+}
+
+String listJson()
+{
+  String json = "[";
+  bool first = true;
+  for (int slot = 0; slot < SLOT_COUNT; ++slot) {
+    Record rec;
+    portENTER_CRITICAL(&s_mux);
+    rec = s_table[slot];
+    portEXIT_CRITICAL(&s_mux);
+    if (rec.state != Used) continue;
+    const Scene& sc = rec.scene;
+    if (!first) json += ",";
+    first = false;
+    json += String("{\"slot\":") + slot;
+    json += String(",\"name\":\"") + sc.name + "\"";
+    json += String(",\"dim\":{\"on\":") + (sc.dim.on ? "true" : "false") + ",\"brightness\":" + String(sc.dim.brightness) + "}";
+    const StripState* strips[2] = { &sc.ws1, &sc.ws2 };
+    for (int i = 0; i < 2; ++i) {
+      const StripState& st = *strips[i];
+      json += String(",\"ws") + (i + 1) + "\":{\"on\":" + (st.on ? "true" : "false") +
+              ",\"brightness\":" + String(st.brightness) + ",\"r\":" + String(st.r) +
+              ",\"g\":" + String(st.g) + ",\"b\":" + String(st.b) + "}";
+    }
+    json += String(",\"anim\":\"") + LEDController::animationName(sc.anim) + "\"";
+    json += String(",\"durationMs\":") + String(sc.animDurationMs) + "}";
+  }
+  json += "]";
+  return json;
+}
+
+} // namespace Scenes
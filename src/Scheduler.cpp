@@ -1,127 +1,314 @@
 #include "Scheduler.h"
 #include "TimeService.h"
+#include "Scenes.h"
+#include "Sequencer.h"
+#include "LampSync.h"
+#include "Clock.h"
+#include "CommandBus.h"
+#include "StateVersion.h"
+#include <math.h>
 
 namespace Scheduler {
 
 struct Entry {
-  int hour;
-  int minute;
-  bool isUtc;
+  Rule rule;
   LEDController::Animation anim;
   unsigned long durationMs; // configured duration in ms
-  int followUpAction;
-  bool firedToday;
-  unsigned long endAtMs; // runtime: when the running animation should end (millis)
+  int sequence; // sequence slot to start instead of `anim`, -1 for none
+  int scene; // scene slot to recall instead of `anim`, -1 for none
+  time_t nextFire; // runtime: next planned firing today (epoch), 0 for none
+  time_t untilAt;  // runtime: end of today's Interval window (epoch)
 };
 
-static StripState* s_dimState = nullptr;
-static StripState* s_ws1State = nullptr;
-static StripState* s_ws2State = nullptr;
-static Adafruit_NeoPixel* s_strip1 = nullptr;
-static Adafruit_NeoPixel* s_strip2 = nullptr;
-
 static Entry s_entries[8];
 static int s_entryCount = 0;
 
+static const time_t TIME_VALID = 1000000000; // same threshold as TimeService::begin
+static const time_t MAX_LATE_S = 60; // a firing this late (clock jump, long block) is skipped
+static const unsigned long CLOCK_RETRY_MS = 1000;
+
+static float s_lat = 52.23f; // Warsaw
+static float s_lon = 21.01f;
+static int s_photoWinterMin = 8 * 60;
+static int s_photoSummerMin = 10 * 60;
+static int s_photoCenterMin = 14 * 60;
+
+// Today's plan: [s_dayStart, s_dayEnd) is the current local day. Solar and
+// photoperiod times are computed once per day in replan().
+static bool s_planned = false;
+static time_t s_dayStart = 0;
+static time_t s_dayEnd = 0;
+static time_t s_sunrise = 0;
+static time_t s_sunset = 0;
+static time_t s_photoStart = 0;
+static time_t s_photoEnd = 0;
+static time_t s_nextFire = 0; // earliest entry nextFire, or s_dayEnd
 static unsigned long s_lastCheck = 0;
 
-void init(StripState& dimState, StripState& ws1State, StripState& ws2State, Adafruit_NeoPixel& strip1, Adafruit_NeoPixel& strip2)
+void init()
 {
-  s_dimState = &dimState;
-  s_ws1State = &ws1State;
-  s_ws2State = &ws2State;
-  s_strip1 = &strip1;
-  s_strip2 = &strip2;
   s_entryCount = 0;
 
-  // Default schedule requested by user:
-  // 06:00 local run sunrise (20 min) then set waves
-  addDailyEntry(6, 0, true, LEDController::Animation::Sunrise, 60UL * 60UL * 1000UL, 1);
-  // 20:30 UTC run sunset (20 min) then stop and turn off
-  addDailyEntry(20, 10, true, LEDController::Animation::Sunset, 60UL * 60UL * 1000UL, 3);
-  addDailyEntry(10, 00, true, LEDController::Animation::Police, 30UL * 1000UL, 4);
+  // Default schedule (times are UTC):
+  // 06:00 UTC run sunrise (60 min), then set waves
+  addSequenceEntry(6, 0, true, Sequencer::define("morning", "anim:sunrise:3600000,anim:waves:0"));
+  // 20:10 UTC run sunset (60 min), then stop and turn off
+  addSequenceEntry(20, 10, true, Sequencer::define("evening", "anim:sunset:3600000,off"));
+  // 10:00 UTC police for 30 s, then sunrise with the dim strip at full brightness
+  addSequenceEntry(10, 00, true, Sequencer::define("police", "anim:police:30000,anim:sunrise:0,fade:dim:0:255"));
 }
 
-void addDailyEntry(int hour, int minute, bool isUtc, LEDController::Animation anim, unsigned long durationMs, int followUpAction)
+void setLocation(float latDeg, float lonDeg)
 {
-  if (s_entryCount >= (int)(sizeof(s_entries)/sizeof(s_entries[0]))) return;
-  s_entries[s_entryCount++] = { hour, minute, isUtc, anim, durationMs, followUpAction, false, 0 };
+  s_lat = latDeg;
+  s_lon = lonDeg;
+  s_planned = false; // recompute solar times on the next tick
+  StateVersion::bump(StateVersion::Schedule);
 }
 
-static void performFollowUp(int action)
+void setPhotoperiod(int winterMinutes, int summerMinutes, int centerMinute)
 {
-  switch (action) {
-    case 0: break;
-    case 1: // waves
-      LEDController::startAnimation(LEDController::Animation::Waves, 0);
-      break;
-    case 2: // stop all animations
-      LEDController::stopAnimation();
-      break;
-    case 3: // turn off everything
-      LEDController::stopAnimation();
-      // turn off PWM
-      LEDController::setPwmDuty(0, 0);
-      // clear addressable strips
-      if (s_strip1) { s_strip1->clear(); s_strip1->show(); }
-      if (s_strip2) { s_strip2->clear(); s_strip2->show(); }
+  s_photoWinterMin = winterMinutes;
+  s_photoSummerMin = summerMinutes;
+  s_photoCenterMin = centerMinute;
+  s_planned = false;
+  StateVersion::bump(StateVersion::Schedule);
+}
+
+bool addRule(const Rule& rule, LEDController::Animation anim, unsigned long durationMs, int sequenceSlot, int sceneSlot)
+{
+  if (s_entryCount >= (int)(sizeof(s_entries)/sizeof(s_entries[0]))) return false;
+  if (rule.trigger == Trigger::Interval && rule.intervalMin <= 0) return false;
+  s_entries[s_entryCount++] = { rule, anim, durationMs, sequenceSlot, sceneSlot, 0, 0 };
+  s_planned = false;
+  StateVersion::bump(StateVersion::Schedule);
+  return true;
+}
+
+void addDailyEntry(int hour, int minute, bool isUtc, LEDController::Animation anim, unsigned long durationMs)
+{
+  Rule rule = { Trigger::Time, hour * 60 + minute, EVERY_DAY, isUtc, 0, 0 };
+  addRule(rule, anim, durationMs);
+}
+
+void addSequenceEntry(int hour, int minute, bool isUtc, int sequenceSlot)
+{
+  if (sequenceSlot < 0) return;
+  Rule rule = { Trigger::Time, hour * 60 + minute, EVERY_DAY, isUtc, 0, 0 };
+  addRule(rule, LEDController::Animation::None, 0, sequenceSlot);
+}
+
+void addSceneEntry(int hour, int minute, bool isUtc, int sceneSlot)
+{
+  Rule rule = { Trigger::Time, hour * 60 + minute, EVERY_DAY, isUtc, 0, 0 };
+  addRule(rule, LEDController::Animation::None, 0, -1, sceneSlot);
+}
+
+// ------------------- planning -------------------
+
+// Days since 1970-01-01 for a civil (proleptic Gregorian) date
+static long daysFromCivil(int y, int m, int d)
+{
+  y -= m <= 2;
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long doy = (153L * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Sunrise/sunset (epoch seconds) for a date, sunrise equation as used by NOAA
+// with the standard -0.833 deg altitude. Both are 0 during polar day/night.
+static void solarTimes(int y, int m, int d, time_t& rise, time_t& set)
+{
+  static const double DEG = M_PI / 180.0;
+  static const time_t J2000_EPOCH = 946728000; // 2000-01-01T12:00:00Z
+  double n = (double)(daysFromCivil(y, m, d) - 10957); // days since 2000-01-01
+  double jStar = n + 0.0008 - s_lon / 360.0;
+  double M = fmod(357.5291 + 0.98560028 * jStar, 360.0);
+  double C = 1.9148 * sin(M * DEG) + 0.02 * sin(2 * M * DEG) + 0.0003 * sin(3 * M * DEG);
+  double lambda = fmod(M + C + 180.0 + 102.9372, 360.0);
+  double transit = jStar + 0.0053 * sin(M * DEG) - 0.0069 * sin(2 * lambda * DEG);
+  double sinDecl = sin(lambda * DEG) * sin(23.4397 * DEG);
+  double cosDecl = cos(asin(sinDecl));
+  double cosW = (sin(-0.833 * DEG) - sin(s_lat * DEG) * sinDecl) / (cos(s_lat * DEG) * cosDecl);
+  if (cosW < -1.0 || cosW > 1.0) {
+    rise = set = 0;
+    return;
+  }
+  double halfDay = acos(cosW) / DEG / 360.0; // fraction of a day
+  rise = J2000_EPOCH + (time_t)lround((transit - halfDay) * 86400.0);
+  set = J2000_EPOCH + (time_t)lround((transit + halfDay) * 86400.0);
+}
+
+// Local time `minute` of day on the planned date (handles DST shifts)
+static time_t localAt(const struct tm& day, int minute)
+{
+  struct tm tm = day;
+  tm.tm_hour = 0;
+  tm.tm_min = minute;
+  tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+// UTC `minute` of day, placed inside the current local day
+static time_t utcAt(const struct tm& day, int minute)
+{
+  time_t at = (time_t)daysFromCivil(day.tm_year + 1900, day.tm_mon + 1, day.tm_mday) * 86400 + (time_t)minute * 60;
+  if (at < s_dayStart) at += 86400;
+  else if (at >= s_dayEnd) at -= 86400;
+  return at;
+}
+
+static bool dayAllowed(const Entry& e, time_t at, int localWday)
+{
+  int wday = localWday;
+  if (e.rule.isUtc) {
+    struct tm utm;
+    gmtime_r(&at, &utm);
+    wday = utm.tm_wday;
+  }
+  return (e.rule.days >> wday) & 1;
+}
+
+// First firing of `e` at or after `t` within today, or 0
+static time_t planEntry(Entry& e, const struct tm& day, time_t t)
+{
+  const Rule& r = e.rule;
+  time_t at = 0;
+  switch (r.trigger) {
+    case Trigger::Time:
+    case Trigger::Interval:
+      at = r.isUtc ? utcAt(day, r.minute) : localAt(day, r.minute);
       break;
-    case 4:
-      LEDController::stopAnimation();
-      LEDController::startAnimation(LEDController::Animation::Sunrise, 0);
-      LEDController::setPwmDuty(0, 255);
+    case Trigger::Sunrise:    at = s_sunrise ? s_sunrise + (time_t)r.minute * 60 : 0; break;
+    case Trigger::Sunset:     at = s_sunset ? s_sunset + (time_t)r.minute * 60 : 0; break;
+    case Trigger::PhotoStart: at = s_photoStart + (time_t)r.minute * 60; break;
+    case Trigger::PhotoEnd:   at = s_photoEnd + (time_t)r.minute * 60; break;
   }
+  if (at == 0 || !dayAllowed(e, at, day.tm_wday)) return 0;
+
+  if (r.trigger == Trigger::Interval) {
+    e.untilAt = r.isUtc ? utcAt(day, r.untilMinute) : localAt(day, r.untilMinute);
+    time_t period = (time_t)r.intervalMin * 60;
+    if (at < t) at += ((t - at + period - 1) / period) * period;
+    if (at > e.untilAt) return 0;
+  }
+  if (at < t || at >= s_dayEnd) return 0;
+  return at;
 }
 
-void loop()
+static void updateNextFire()
+{
+  s_nextFire = s_dayEnd;
+  for (int i = 0; i < s_entryCount; ++i) {
+    time_t at = s_entries[i].nextFire;
+    if (at && at < s_nextFire) s_nextFire = at;
+  }
+}
+
+// Compute today's solar/photoperiod times and every entry's first firing.
+// Runs once per local day (or after configuration changes).
+static void replan(time_t t)
 {
-  unsigned long nowMs = millis();
-  if (nowMs - s_lastCheck < 1000) return; // check once per second
-  s_lastCheck = nowMs;
+  struct tm day;
+  localtime_r(&t, &day);
+  s_dayStart = localAt(day, 0);
+  struct tm next = day;
+  next.tm_mday += 1;
+  s_dayEnd = localAt(next, 0);
+
+  solarTimes(day.tm_year + 1900, day.tm_mon + 1, day.tm_mday, s_sunrise, s_sunset);
 
+  // Day length peaks at the summer solstice (~day 172), flipped south of the equator
+  double mean = (s_photoSummerMin + s_photoWinterMin) / 2.0;
+  double amp = (s_photoSummerMin - s_photoWinterMin) / 2.0;
+  double season = cos(2.0 * M_PI * (day.tm_yday - 172) / 365.25);
+  if (s_lat < 0) season = -season;
+  int lengthMin = (int)lround(mean + amp * season);
+  s_photoStart = localAt(day, s_photoCenterMin - lengthMin / 2);
+  s_photoEnd = localAt(day, s_photoCenterMin + (lengthMin - lengthMin / 2));
+
+  for (int i = 0; i < s_entryCount; ++i) {
+    s_entries[i].nextFire = planEntry(s_entries[i], day, t);
+  }
+  updateNextFire();
+  s_planned = true;
+  StateVersion::bump(StateVersion::Schedule);
+}
+
+static void fire(const Entry& e)
+{
+  CommandBus::ScheduleAction a;
+  a.kind = e.scene >= 0 ? a.Scene : e.sequence >= 0 ? a.Sequence : a.Anim;
+  a.anim = e.anim;
+  a.durationMs = e.durationMs;
+  a.slot = e.scene >= 0 ? e.scene : e.sequence;
+  if (!CommandBus::schedule(a)) return; // a manual override holds the output
+
+  if (e.scene >= 0) Scenes::recall(e.scene);
+  else if (e.sequence >= 0) Sequencer::start(e.sequence);
+  else {
+    // Every lamp fires the same entry; the key makes them converge on one start
+    uint32_t key = (uint32_t)e.nextFire * 31u + (uint32_t)e.anim;
+    LampSync::startShared(e.anim, e.durationMs, key ? key : 1);
+  }
+}
+
+void loop()
+{
   time_t t = TimeService::now();
-  struct tm tm;
-  gmtime_r(&t, &tm);
+  if (t < TIME_VALID) {
+    s_planned = false; // not synced yet
+    s_lastCheck = millis();
+    return;
+  }
+  // Constant-time fast path: nothing planned before s_nextFire
+  if (s_planned && t >= s_dayStart && t < s_nextFire) return;
+  if (!s_planned || t < s_dayStart || t >= s_dayEnd) {
+    replan(t);
+    if (t < s_nextFire) return;
+  }
 
   for (int i = 0; i < s_entryCount; ++i) {
     Entry& e = s_entries[i];
-    // choose hour/minute based on UTC or local (TimeService::now uses TZ env)
-    int curHour = tm.tm_hour;
-    int curMin = tm.tm_min;
-    if (e.isUtc) {
-      // To get UTC hour/min, we call gmtime_r on t (already used). The tm above is UTC.
-      curHour = tm.tm_hour;
-      curMin = tm.tm_min;
-    } else {
-      // local time: use localtime
-      struct tm ltm;
-      localtime_r(&t, &ltm);
-      curHour = ltm.tm_hour;
-      curMin = ltm.tm_min;
+    if (e.nextFire == 0 || e.nextFire > t) continue;
+    if (t - e.nextFire <= MAX_LATE_S) fire(e);
+    time_t at = 0;
+    if (e.rule.trigger == Trigger::Interval) {
+      // next slot on the interval grid after now
+      time_t period = (time_t)e.rule.intervalMin * 60;
+      at = e.nextFire + ((t - e.nextFire) / period + 1) * period;
+      if (at > e.untilAt || at >= s_dayEnd) at = 0;
     }
+    e.nextFire = at;
+  }
+  updateNextFire();
+  StateVersion::bump(StateVersion::Schedule);
+}
 
-    if (curHour == e.hour && curMin == e.minute) {
-      if (!e.firedToday) {
-        // start animation
-          LEDController::startAnimation(e.anim, e.durationMs);
-          // schedule follow-up via a delayed timer: record end timestamp in endAtMs
-          e.endAtMs = millis() + e.durationMs;
-        e.firedToday = true;
-      }
-    } else {
-      // reset firedToday when minute rolls over (guard for next day)
-      e.firedToday = false;
-    }
-    // If we have a running entry whose durationMs holds endAt, check and run follow-up
-      if (e.firedToday && e.endAtMs != 0) {
-        unsigned long nowu = millis();
-        if (nowu >= e.endAtMs) {
-          performFollowUp(e.followUpAction);
-          // clear end marker so follow-up only runs once
-          e.endAtMs = 0;
-        }
-      }
+unsigned long msUntilNextCheck()
+{
+  if (!s_planned) {
+    unsigned long since = millis() - s_lastCheck;
+    return since >= CLOCK_RETRY_MS ? 0 : CLOCK_RETRY_MS - since;
   }
+  time_t t = TimeService::now();
+  return s_nextFire > t ? Clock::realMs((uint64_t)(s_nextFire - t) * 1000) : 0;
+}
+
+static const char* triggerName(Trigger t)
+{
+  switch (t) {
+    case Trigger::Time:       return "time";
+    case Trigger::Sunrise:    return "sunrise";
+    case Trigger::Sunset:     return "sunset";
+    case Trigger::PhotoStart: return "photoStart";
+    case Trigger::PhotoEnd:   return "photoEnd";
+    case Trigger::Interval:   return "interval";
+  }
+  return "?";
 }
 
   String getScheduleJson()
@@ -129,26 +316,43 @@ void loop()
     String json = "[";
     for (int i = 0; i < s_entryCount; ++i) {
       Entry& e = s_entries[i];
-      String animName = "None";
-      switch (e.anim) {
-        case LEDController::Animation::Sunrise: animName = "Sunrise"; break;
-        case LEDController::Animation::Sunset: animName = "Sunset"; break;
-        case LEDController::Animation::Waves: animName = "Waves"; break;
-        case LEDController::Animation::Police: animName = "Police"; break;
-        default: break;
-      }
+      const Rule& r = e.rule;
+      bool timeOfDay = r.trigger == Trigger::Time || r.trigger == Trigger::Interval;
+      const char* animName = LEDController::animationName(e.anim);
       if (i) json += ",";
       json += "{";
-      json += String("\"hour\":") + e.hour + ",";
-      json += String("\"minute\":") + e.minute + ",";
-      json += String("\"isUtc\":") + (e.isUtc ? "true" : "false") + ",";
+      json += String("\"hour\":") + (timeOfDay ? r.minute / 60 : 0) + ",";
+      json += String("\"minute\":") + (timeOfDay ? r.minute % 60 : 0) + ",";
+      json += String("\"isUtc\":") + (r.isUtc ? "true" : "false") + ",";
       json += String("\"anim\":\"") + animName + "\",";
       json += String("\"durationMs\":") + e.durationMs + ",";
-      json += String("\"followUp\":") + e.followUpAction;
+      json += String("\"sequence\":") + e.sequence + ",";
+      json += String("\"scene\":") + e.scene + ",";
+      json += String("\"trigger\":\"") + triggerName(r.trigger) + "\",";
+      json += String("\"offsetMin\":") + (timeOfDay ? 0 : r.minute) + ",";
+      json += String("\"days\":") + r.days + ",";
+      if (r.trigger == Trigger::Interval) {
+        json += String("\"intervalMin\":") + r.intervalMin + ",";
+        json += String("\"untilMinute\":") + r.untilMinute + ",";
+      }
+      json += String("\"nextFire\":") + String((unsigned long)e.nextFire);
       json += "}";
     }
     json += "]";
     return json;
   }
 
+String sunJson()
+{
+  String json = "{";
+  json += String("\"lat\":") + String(s_lat, 4) + ",";
+  json += String("\"lon\":") + String(s_lon, 4) + ",";
+  json += String("\"sunrise\":") + String((unsigned long)s_sunrise) + ",";
+  json += String("\"sunset\":") + String((unsigned long)s_sunset) + ",";
+  json += String("\"photoStart\":") + String((unsigned long)s_photoStart) + ",";
+  json += String("\"photoEnd\":") + String((unsigned long)s_photoEnd);
+  json += "}";
+  return json;
+}
+
 } // namespace Scheduler
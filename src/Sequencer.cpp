@@ -0,0 +1,512 @@
+#include "Sequencer.h"
+#include "StripStore.h"
+#include "Scenes.h"
+#include "PowerManager.h"
+#include "PixelKernels.h"
+#include "Clock.h"
+#include <esp_timer.h>
+#include <atomic>
+
+namespace Sequencer {
+
+enum class StepKind : uint8_t { Anim = 0, Scene, Wait, Fade, Stop, Off };
+
+static const uint8_t ALL_TARGETS = StripStore::TargetCount;
+
+struct Step {
+  StepKind kind;
+  uint8_t target;  // Fade: StripStore::Target or ALL_TARGETS
+  uint8_t arg;     // Anim: Animation, Scene: slot
+  bool color;      // Fade: r/g/bl are set
+  uint8_t b, r, g, bl;
+  uint32_t ms;     // Anim/Wait/Fade duration
+};
+
+struct Sequence {
+  char name[NAME_LEN]; // empty = unused slot
+  uint8_t stepCount;
+  Step steps[MAX_STEPS];
+};
+
+static const int NO_REQUEST = -1;
+static const int STOP_REQUEST = -2;
+
+static Sequence s_table[SLOT_COUNT];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<int> s_request(NO_REQUEST);
+static std::atomic<bool> s_due(false);
+static std::atomic<uint32_t> s_requestSkipMs(0); // elapsedMs of the start request
+static esp_timer_handle_t s_timer = nullptr;
+
+// Running sequence (a copy, so redefining it does not affect the run). Only
+// the render task writes these; statusJson reads them under s_mux.
+static Sequence s_run;
+static int s_runStep = -1; // -1 = idle
+static int64_t s_stepEndUs = 0;
+static uint32_t s_skipMs = 0; // time still to catch up while starting mid-way
+static uint64_t s_runStartMs = 0; // Clock ms the running sequence started at (catch-up included)
+
+// Fade in progress (render task only)
+static bool s_fadeActive = false;
+static Step s_fade;
+static StripState s_fadeFrom[StripStore::TargetCount];
+static StripState s_fadeLast[StripStore::TargetCount];
+static int64_t s_fadeStartUs = 0;
+
+static void onStepTimer(void*)
+{
+  s_due.store(true);
+  PowerManager::wake();
+}
+
+void begin()
+{
+  if (s_timer) return;
+  esp_timer_create_args_t args = {};
+  args.callback = onStepTimer;
+  args.name = "sequence";
+  esp_timer_create(&args, &s_timer);
+}
+
+// ------------------- text form -------------------
+
+static bool validName(const char* name)
+{
+  if (!name || !*name) return false;
+  size_t len = 0;
+  for (const char* p = name; *p; ++p, ++len) {
+    char c = *p;
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!ok) return false;
+  }
+  return len < NAME_LEN;
+}
+
+static const char* STEP_NAMES[] = { "anim", "scene", "wait", "fade", "stop", "off" };
+static const char* TARGET_NAMES[] = { "dim", "ws1", "ws2", "all" };
+
+// Copy the field at `p` (up to ':' or ',') into `out` and advance past it.
+// Returns the field length, or -1 if it does not fit.
+static int nextField(const char*& p, char* out, size_t outLen)
+{
+  size_t n = 0;
+  while (*p && *p != ':' && *p != ',') {
+    if (n + 1 >= outLen) return -1;
+    out[n++] = *p++;
+  }
+  out[n] = '\0';
+  if (*p == ':') ++p;
+  return (int)n;
+}
+
+static bool parseUInt(const char* s, uint32_t max, uint32_t& out)
+{
+  if (*s < '0' || *s > '9') return false;
+  uint32_t acc = 0;
+  for (; *s; ++s) {
+    if (*s < '0' || *s > '9') return false;
+    if (acc > (max - (uint32_t)(*s - '0')) / 10) return false;
+    acc = acc * 10 + (uint32_t)(*s - '0');
+  }
+  out = acc;
+  return true;
+}
+
+// Parse one step starting at `p`; leaves `p` at the ',' or end of text.
+static bool parseStep(const char*& p, Step& st, const char*& err)
+{
+  char f[NAME_LEN];
+  memset(&st, 0, sizeof(st));
+  if (nextField(p, f, sizeof(f)) <= 0) { err = "empty step"; return false; }
+  int kind = -1;
+  for (int i = 0; i < (int)(sizeof(STEP_NAMES) / sizeof(STEP_NAMES[0])); ++i) {
+    if (strcmp(f, STEP_NAMES[i]) == 0) kind = i;
+  }
+  if (kind < 0) { err = "unknown step"; return false; }
+  st.kind = (StepKind)kind;
+
+  uint32_t v;
+  switch (st.kind) {
+    case StepKind::Anim: {
+      LEDController::Animation anim;
+      if (nextField(p, f, sizeof(f)) <= 0 || !LEDController::animationFromName(f, anim)) { err = "anim name"; return false; }
+      st.arg = (uint8_t)anim;
+      if (nextField(p, f, sizeof(f)) <= 0 || !parseUInt(f, 0x7FFFFFFF, st.ms)) { err = "anim ms"; return false; }
+      break;
+    }
+    case StepKind::Scene: {
+      if (nextField(p, f, sizeof(f)) <= 0) { err = "scene"; return false; }
+      int slot = parseUInt(f, Scenes::SLOT_COUNT - 1, v) ? (int)v : Scenes::find(f);
+      if (slot < 0) { err = "scene not found"; return false; }
+      st.arg = (uint8_t)slot;
+      break;
+    }
+    case StepKind::Wait:
+      if (nextField(p, f, sizeof(f)) <= 0 || !parseUInt(f, 0x7FFFFFFF, st.ms)) { err = "wait ms"; return false; }
+      break;
+    case StepKind::Fade: {
+      if (nextField(p, f, sizeof(f)) <= 0) { err = "fade target"; return false; }
+      st.target = 0xFF;
+      for (uint8_t i = 0; i < 4; ++i) {
+        if (strcmp(f, TARGET_NAMES[i]) == 0) st.target = i;
+      }
+      if (st.target == 0xFF) { err = "fade target"; return false; }
+      if (nextField(p, f, sizeof(f)) <= 0 || !parseUInt(f, 0x7FFFFFFF, st.ms)) { err = "fade ms"; return false; }
+      if (nextField(p, f, sizeof(f)) <= 0 || !parseUInt(f, 255, v)) { err = "fade brightness"; return false; }
+      st.b = (uint8_t)v;
+      if (*p && *p != ',') {
+        uint8_t* rgb[3] = { &st.r, &st.g, &st.bl };
+        for (int i = 0; i < 3; ++i) {
+          if (nextField(p, f, sizeof(f)) <= 0 || !parseUInt(f, 255, v)) { err = "fade color"; return false; }
+          *rgb[i] = (uint8_t)v;
+        }
+        st.color = true;
+      }
+      break;
+    }
+    case StepKind::Stop:
+    case StepKind::Off:
+      break;
+  }
+  if (*p && *p != ',') { err = "trailing fields"; return false; }
+  return true;
+}
+
+static void appendStep(String& out, const Step& st)
+{
+  out += STEP_NAMES[(int)st.kind];
+  switch (st.kind) {
+    case StepKind::Anim: {
+      String anim = LEDController::animationName((LEDController::Animation)st.arg);
+      anim.toLowerCase(); // query names are lower case
+      out += String(":") + anim + ":" + String(st.ms);
+      break;
+    }
+    case StepKind::Scene: out += String(":") + st.arg; break;
+    case StepKind::Wait:  out += String(":") + String(st.ms); break;
+    case StepKind::Fade:
+      out += String(":") + TARGET_NAMES[st.target] + ":" + String(st.ms) + ":" + st.b;
+      if (st.color) out += String(":") + st.r + ":" + st.g + ":" + st.bl;
+      break;
+    case StepKind::Stop:
+    case StepKind::Off:
+      break;
+  }
+}
+
+// ------------------- table -------------------
+
+// Call with s_mux held
+static int findLocked(const char* name)
+{
+  for (int i = 0; i < SLOT_COUNT; ++i) {
+    if (s_table[i].name[0] && strcmp(s_table[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+int find(const char* name)
+{
+  if (!validName(name)) return -1;
+  portENTER_CRITICAL(&s_mux);
+  int slot = findLocked(name);
+  portEXIT_CRITICAL(&s_mux);
+  return slot;
+}
+
+int define(const char* name, const char* text, const char** err)
+{
+  const char* reason = nullptr;
+  if (!err) err = &reason;
+  if (!validName(name)) { *err = "name"; return -1; }
+  if (!text || !*text) { *err = "steps"; return -1; }
+
+  Sequence seq;
+  memset(&seq, 0, sizeof(seq));
+  strncpy(seq.name, name, NAME_LEN - 1);
+  const char* p = text;
+  while (*p) {
+    if (seq.stepCount >= MAX_STEPS) { *err = "too many steps"; return -1; }
+    if (!parseStep(p, seq.steps[seq.stepCount], *err)) return -1;
+    ++seq.stepCount;
+    if (*p == ',') ++p;
+  }
+
+  portENTER_CRITICAL(&s_mux);
+  int slot = findLocked(name);
+  for (int i = 0; slot < 0 && i < SLOT_COUNT; ++i) {
+    if (!s_table[i].name[0]) slot = i;
+  }
+  if (slot >= 0) s_table[slot] = seq;
+  portEXIT_CRITICAL(&s_mux);
+  if (slot < 0) *err = "table full";
+  return slot;
+}
+
+bool remove(const char* name)
+{
+  int slot = find(name);
+  if (slot < 0) return false;
+  portENTER_CRITICAL(&s_mux);
+  s_table[slot].name[0] = '\0';
+  portEXIT_CRITICAL(&s_mux);
+  return true;
+}
+
+bool start(int slot, uint32_t elapsedMs)
+{
+  if (slot < 0 || slot >= SLOT_COUNT) return false;
+  portENTER_CRITICAL(&s_mux);
+  bool used = s_table[slot].name[0] != '\0';
+  portEXIT_CRITICAL(&s_mux);
+  if (!used) return false;
+  s_requestSkipMs.store(elapsedMs);
+  s_request.store(slot);
+  PowerManager::wake();
+  return true;
+}
+
+void stop()
+{
+  s_request.store(STOP_REQUEST);
+  PowerManager::wake();
+}
+
+// ------------------- running -------------------
+
+static void armTimer(uint32_t ms)
+{
+  esp_timer_stop(s_timer);
+  s_due.store(false);
+  // Step times are clock time; the hardware timer runs in real time
+  s_stepEndUs = Clock::us() + (int64_t)ms * 1000;
+  esp_timer_start_once(s_timer, Clock::realUs((uint64_t)ms * 1000ULL));
+}
+
+static void fadeTargets(uint8_t target, uint8_t& first, uint8_t& last)
+{
+  first = target == ALL_TARGETS ? 0 : target;
+  last = target == ALL_TARGETS ? (uint8_t)(StripStore::TargetCount - 1) : target;
+}
+
+// Brightness and color packed into one word (brightness in the top lane) so
+// a fade step is a single PixelKernels::lerp
+static uint32_t packFade(uint8_t brightness, uint8_t r, uint8_t g, uint8_t b)
+{
+  return ((uint32_t)brightness << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+// Brightness and color at fraction num/den of the fade for one target
+static StripState fadeValue(int t, uint32_t num, uint32_t den)
+{
+  const StripState& from = s_fadeFrom[t];
+  uint32_t a = packFade(from.brightness, from.r, from.g, from.b);
+  uint32_t b = s_fade.color ? packFade(s_fade.b, s_fade.r, s_fade.g, s_fade.bl)
+                            : packFade(s_fade.b, from.r, from.g, from.b);
+  uint32_t v = PixelKernels::lerp(a, b, (uint16_t)((uint64_t)num * 256 / den));
+  StripState st;
+  st.brightness = (uint8_t)(v >> 24);
+  st.r = (uint8_t)(v >> 16);
+  st.g = (uint8_t)(v >> 8);
+  st.b = (uint8_t)v;
+  st.on = true;
+  return st;
+}
+
+static void writeFade(int t, const StripState& st)
+{
+  if (memcmp(&st, &s_fadeLast[t], sizeof(st)) == 0) return; // unchanged this frame
+  s_fadeLast[t] = st;
+  StripStore::write((StripStore::Target)t, st);
+}
+
+static void finishFade()
+{
+  uint8_t first, last;
+  fadeTargets(s_fade.target, first, last);
+  for (uint8_t t = first; t <= last; ++t) {
+    StripState st = fadeValue(t, 1, 1);
+    st.on = s_fade.b > 0; // fading to 0 ends switched off
+    writeFade(t, st);
+  }
+  s_fadeActive = false;
+}
+
+static void startFade(const Step& st)
+{
+  s_fade = st;
+  uint8_t first, last;
+  fadeTargets(st.target, first, last);
+  for (uint8_t t = first; t <= last; ++t) {
+    StripState cur = StripStore::read((StripStore::Target)t);
+    if (!cur.on) cur.brightness = 0; // an off strip fades in from black
+    s_fadeFrom[t] = cur;
+    s_fadeLast[t] = StripStore::read((StripStore::Target)t);
+  }
+  s_fadeStartUs = Clock::us();
+  s_fadeActive = true;
+  if (st.ms == 0) finishFade();
+}
+
+static void stepFade()
+{
+  uint32_t elapsedMs = (uint32_t)((Clock::us() - s_fadeStartUs) / 1000);
+  if (elapsedMs >= s_fade.ms) return; // the step timer finishes it
+  uint8_t first, last;
+  fadeTargets(s_fade.target, first, last);
+  for (uint8_t t = first; t <= last; ++t) writeFade(t, fadeValue(t, elapsedMs, s_fade.ms));
+}
+
+static void setRunStep(int step)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_runStep = step;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+static void finish()
+{
+  esp_timer_stop(s_timer);
+  s_due.store(false);
+  s_fadeActive = false;
+  setRunStep(-1);
+}
+
+// Carry out the next step. Steps without a duration run back to back, so
+// e.g. "stop,fade:all:0:0" lands in a single frame.
+static void advance()
+{
+  for (;;) {
+    int next = s_runStep + 1;
+    if (next >= s_run.stepCount) { finish(); return; }
+    setRunStep(next);
+    const Step& st = s_run.steps[next];
+    bool timed = st.kind == StepKind::Anim || st.kind == StepKind::Wait || st.kind == StepKind::Fade;
+    if (timed && st.ms > 0 && s_skipMs >= st.ms) {
+      // Catching up: a step that would be over by now only leaves its end state
+      s_skipMs -= st.ms;
+      if (st.kind == StepKind::Fade) {
+        startFade(st);
+        finishFade();
+      }
+      continue;
+    }
+    // How far into this step we are; untimed steps leave the rest for later ones
+    uint32_t into = 0;
+    if (timed && st.ms > 0) {
+      into = s_skipMs;
+      s_skipMs = 0;
+    }
+    switch (st.kind) {
+      case StepKind::Anim:
+        LEDController::startAnimationAt((LEDController::Animation)st.arg, st.ms, (unsigned long)Clock::ms() - into);
+        break;
+      case StepKind::Scene:
+        Scenes::recall(st.arg);
+        break;
+      case StepKind::Wait:
+        break;
+      case StepKind::Fade:
+        startFade(st);
+        s_fadeStartUs -= (int64_t)into * 1000;
+        if (!s_fadeActive) continue;
+        break;
+      case StepKind::Stop:
+        LEDController::stopAnimation();
+        break;
+      case StepKind::Off:
+        LEDController::stopAnimation();
+        for (int t = 0; t < StripStore::TargetCount; ++t) {
+          StripStore::update((StripStore::Target)t, [](StripState& s){ s.on = false; });
+        }
+        break;
+    }
+    if (timed && st.ms > 0) {
+      armTimer(st.ms - into);
+      return;
+    }
+  }
+}
+
+void loop()
+{
+  int req = s_request.exchange(NO_REQUEST);
+  if (req == STOP_REQUEST) {
+    finish();
+  } else if (req >= 0) {
+    finish();
+    portENTER_CRITICAL(&s_mux);
+    s_run = s_table[req];
+    portEXIT_CRITICAL(&s_mux);
+    s_skipMs = s_requestSkipMs.load();
+    s_runStartMs = Clock::ms() - s_skipMs;
+    if (s_run.name[0]) advance();
+  }
+
+  if (s_due.exchange(false) && s_runStep >= 0) {
+    if (s_fadeActive) finishFade();
+    advance();
+  }
+  if (s_fadeActive) stepFade();
+}
+
+bool running(char* name, uint32_t& elapsedMs)
+{
+  if (s_runStep < 0) return false;
+  memcpy(name, s_run.name, NAME_LEN);
+  uint64_t elapsed = Clock::ms() - s_runStartMs;
+  elapsedMs = elapsed > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)elapsed;
+  return true;
+}
+
+bool fading()
+{
+  return s_fadeActive;
+}
+
+String statusJson()
+{
+  char name[NAME_LEN];
+  int step, count;
+  Step cur;
+  portENTER_CRITICAL(&s_mux);
+  step = s_runStep;
+  count = s_run.stepCount;
+  memcpy(name, s_run.name, NAME_LEN);
+  if (step >= 0) cur = s_run.steps[step];
+  portEXIT_CRITICAL(&s_mux);
+
+  String json = "{";
+  json += String("\"running\":") + (step >= 0 ? "true" : "false");
+  if (step >= 0) {
+    int64_t left = s_stepEndUs - Clock::us();
+    bool timed = cur.kind == StepKind::Anim || cur.kind == StepKind::Wait || cur.kind == StepKind::Fade;
+    json += String(",\"name\":\"") + name + "\"";
+    json += String(",\"step\":") + step + ",\"steps\":" + count;
+    json += String(",\"kind\":\"") + STEP_NAMES[(int)cur.kind] + "\"";
+    json += String(",\"remainingMs\":") + String(timed && left > 0 ? (unsigned long)(left / 1000) : 0UL);
+  }
+  json += ",\"sequences\":[";
+  bool first = true;
+  for (int slot = 0; slot < SLOT_COUNT; ++slot) {
+    Sequence seq;
+    portENTER_CRITICAL(&s_mux);
+    seq = s_table[slot];
+    portEXIT_CRITICAL(&s_mux);
+    if (!seq.name[0]) continue;
+    if (!first) json += ",";
+    first = false;
+    json += String("{\"slot\":") + slot + ",\"name\":\"" + seq.name + "\",\"steps\":\"";
+    for (int i = 0; i < seq.stepCount; ++i) {
+      if (i) json += ",";
+      String step;
+      appendStep(step, seq.steps[i]);
+      json += step;
+    }
+    json += "\"}";
+  }
+  json += "]}";
+  return json;
+}
+
+} // namespace Sequencer
@@ -0,0 +1,285 @@
+#include "StateJournal.h"
+#include "StripStore.h"
+#include "Sequencer.h"
+#include "TimeService.h"
+#include "EventLog.h"
+#include "Clock.h"
+#include <LittleFS.h>
+
+namespace StateJournal {
+
+static const char* LOG_PATH = "/state.log";
+static const char* TMP_PATH = "/state.tmp";
+static const uint32_t MAGIC = 0x314A5341; // "ASJ1"; change when Record changes
+static const time_t TIME_VALID = 1000000000; // same threshold as TimeService::begin
+
+// One journal entry, stored as raw bytes. `check` covers everything before it,
+// so a record torn by a power cut is ignored.
+struct Record {
+  uint32_t magic;
+  uint32_t seq;
+  StripState strips[StripStore::TargetCount];
+  uint8_t anim;                         // LEDController::Animation, None if not restorable
+  uint32_t animDurationMs;
+  uint32_t animElapsedMs;
+  char sequence[Sequencer::NAME_LEN];   // "" when no sequence runs
+  uint32_t sequenceElapsedMs;
+  uint32_t wall;                        // epoch seconds at the write, 0 if unknown
+  uint32_t check;
+};
+
+// What a record was taken from; a difference means the state changed
+struct Key {
+  uint32_t gen;                // StripStore::generation()
+  uint8_t anim;
+  unsigned long animStart;
+  char sequence[Sequencer::NAME_LEN];
+  uint64_t sequenceStartMs;
+};
+
+static bool s_ready = false;
+static Record s_restored;
+static bool s_haveRestored = false;
+static Key s_written;                  // key of the last append (or the restored state)
+static unsigned long s_lastAppendMs = 0;
+static bool s_pending = false;         // state differs from the last append
+static bool s_timed = false;           // something with progress is running
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_seq = 0;
+static uint16_t s_records = 0;         // records in the log file
+static uint32_t s_appends = 0;
+static uint32_t s_compactions = 0;
+static uint32_t s_failures = 0;
+static uint32_t s_restoredKind = 0;   // 0 strips only, 1 sequence, 2 animation
+static uint32_t s_restoredElapsedMs = 0;
+
+// FNV-1a over the record up to `check`
+static uint32_t checksum(const Record& r)
+{
+  const uint8_t* p = (const uint8_t*)&r;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < offsetof(Record, check); ++i) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static bool valid(const Record& r)
+{
+  return r.magic == MAGIC && r.check == checksum(r);
+}
+
+// Animations that can be restarted from their enum alone (playback and
+// effect programs need a file and parameters)
+static bool restorable(LEDController::Animation anim)
+{
+  return anim != LEDController::Animation::None && anim != LEDController::Animation::Playback &&
+         anim != LEDController::Animation::Program;
+}
+
+static void readKey(Key& k, uint32_t& sequenceElapsedMs)
+{
+  memset(&k, 0, sizeof(k));
+  k.gen = StripStore::generation();
+  LEDController::Animation anim = LEDController::currentAnimation();
+  if (restorable(anim)) {
+    k.anim = (uint8_t)anim;
+    k.animStart = LEDController::animationStart();
+  }
+  sequenceElapsedMs = 0;
+  if (Sequencer::running(k.sequence, sequenceElapsedMs))
+    k.sequenceStartMs = Clock::ms() - sequenceElapsedMs;
+}
+
+static bool sameKey(const Key& a, const Key& b)
+{
+  // A sequence start is derived from two clock reads, so allow for a tick
+  int64_t startDiff = (int64_t)(a.sequenceStartMs - b.sequenceStartMs);
+  return a.gen == b.gen && a.anim == b.anim && a.animStart == b.animStart &&
+         strcmp(a.sequence, b.sequence) == 0 && startDiff >= -1000 && startDiff <= 1000;
+}
+
+// Replace the log with one holding only `r`
+static bool compact(const Record& r)
+{
+  File f = LittleFS.open(TMP_PATH, FILE_WRITE);
+  if (!f) return false;
+  bool ok = f.write((const uint8_t*)&r, sizeof(r)) == sizeof(r);
+  f.close();
+  if (ok && !LittleFS.rename(TMP_PATH, LOG_PATH)) {
+    LittleFS.remove(LOG_PATH);
+    ok = LittleFS.rename(TMP_PATH, LOG_PATH);
+  }
+  if (!ok) return false;
+  portENTER_CRITICAL(&s_mux);
+  s_records = 1;
+  ++s_compactions;
+  portEXIT_CRITICAL(&s_mux);
+  return true;
+}
+
+static void append(const Key& key, uint32_t sequenceElapsedMs)
+{
+  Record r;
+  memset(&r, 0, sizeof(r));
+  r.magic = MAGIC;
+  r.seq = ++s_seq;
+  for (int t = 0; t < StripStore::TargetCount; ++t) r.strips[t] = StripStore::read((StripStore::Target)t);
+  r.anim = key.anim;
+  if (key.anim) {
+    r.animDurationMs = LEDController::animationDuration();
+    r.animElapsedMs = (unsigned long)Clock::ms() - key.animStart;
+  }
+  memcpy(r.sequence, key.sequence, sizeof(r.sequence));
+  r.sequenceElapsedMs = sequenceElapsedMs;
+  time_t now = TimeService::now();
+  r.wall = (now >= TIME_VALID && !Clock::simulated()) ? (uint32_t)now : 0;
+  r.check = checksum(r);
+
+  bool ok;
+  if (s_records >= MAX_RECORDS) {
+    ok = compact(r);
+  } else {
+    File f = LittleFS.open(LOG_PATH, FILE_APPEND);
+    ok = f && f.write((const uint8_t*)&r, sizeof(r)) == sizeof(r);
+    if (f) f.close();
+    if (ok) {
+      portENTER_CRITICAL(&s_mux);
+      ++s_records;
+      portEXIT_CRITICAL(&s_mux);
+    }
+  }
+  portENTER_CRITICAL(&s_mux);
+  if (ok) ++s_appends;
+  else ++s_failures;
+  portEXIT_CRITICAL(&s_mux);
+  // A failed write is not retried before the next interval either
+  s_written = key;
+  s_lastAppendMs = millis();
+  s_pending = false;
+}
+
+bool begin(StripState& dim, StripState& ws1, StripState& ws2)
+{
+  s_ready = true;
+  s_lastAppendMs = millis();
+  File f = LittleFS.open(LOG_PATH, FILE_READ);
+  if (!f) return false;
+  size_t size = f.size();
+  uint16_t records = 0;
+  Record r;
+  while (f.read((uint8_t*)&r, sizeof(r)) == sizeof(r)) {
+    ++records;
+    if (valid(r) && (!s_haveRestored || r.seq > s_restored.seq)) {
+      s_restored = r;
+      s_haveRestored = true;
+    }
+  }
+  f.close();
+  s_records = records;
+  if (s_haveRestored) {
+    s_restored.sequence[Sequencer::NAME_LEN - 1] = '\0';
+    s_seq = s_restored.seq;
+    dim = s_restored.strips[StripStore::Dim];
+    ws1 = s_restored.strips[StripStore::WS1];
+    ws2 = s_restored.strips[StripStore::WS2];
+  }
+  // A torn tail would misalign later appends: start over from the newest record
+  if (size % sizeof(Record) != 0 || records >= MAX_RECORDS) {
+    if (s_haveRestored) {
+      compact(s_restored);
+    } else {
+      LittleFS.remove(LOG_PATH);
+      s_records = 0;
+    }
+  }
+  return s_haveRestored;
+}
+
+void restore()
+{
+  if (!s_haveRestored) return;
+  const Record& r = s_restored;
+  uint32_t away = 0;
+  time_t now = TimeService::now();
+  if (r.wall && now >= TIME_VALID && !Clock::simulated() && (uint32_t)now >= r.wall) {
+    uint64_t ms = (uint64_t)((uint32_t)now - r.wall) * 1000ULL;
+    away = ms > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)ms;
+  }
+  uint32_t elapsed = 0;
+  uint32_t kind = 0;
+  int slot = r.sequence[0] ? Sequencer::find(r.sequence) : -1;
+  if (slot >= 0) {
+    elapsed = r.sequenceElapsedMs + away < r.sequenceElapsedMs ? 0xFFFFFFFFUL : r.sequenceElapsedMs + away;
+    Sequencer::start(slot, elapsed);
+    kind = 1;
+  } else if (r.anim <= (uint8_t)LEDController::Animation::Dawn && restorable((LEDController::Animation)r.anim)) {
+    // Effects are functions of the elapsed time; one past its duration ends
+    // on its first frame the way it would have
+    elapsed = r.animElapsedMs + away < r.animElapsedMs ? 0xFFFFFFFFUL : r.animElapsedMs + away;
+    LEDController::startAnimationAt((LEDController::Animation)r.anim, r.animDurationMs,
+                                    (unsigned long)Clock::ms() - elapsed);
+    kind = 2;
+  }
+  portENTER_CRITICAL(&s_mux);
+  s_restoredKind = kind;
+  s_restoredElapsedMs = elapsed;
+  portEXIT_CRITICAL(&s_mux);
+  EventLog::log(EventLog::Event::StateRestored, kind, elapsed / 1000);
+}
+
+void loop()
+{
+  if (!s_ready) return;
+  Key key;
+  uint32_t sequenceElapsedMs;
+  readKey(key, sequenceElapsedMs);
+  if (!s_pending && !sameKey(key, s_written)) s_pending = true;
+  s_timed = key.sequence[0] || (key.anim && LEDController::animationDuration() > 0);
+  unsigned long since = millis() - s_lastAppendMs;
+  if ((s_pending && since >= INTERVAL_MS) || (s_timed && since >= CHECKPOINT_MS))
+    append(key, sequenceElapsedMs);
+}
+
+unsigned long msUntilNext()
+{
+  if (!s_ready || (!s_pending && !s_timed)) return 0xFFFFFFFFUL;
+  unsigned long since = millis() - s_lastAppendMs;
+  unsigned long wait = s_pending ? INTERVAL_MS : CHECKPOINT_MS;
+  return since >= wait ? 0 : wait - since;
+}
+
+String json()
+{
+  portENTER_CRITICAL(&s_mux);
+  uint16_t records = s_records;
+  uint32_t appends = s_appends;
+  uint32_t compactions = s_compactions;
+  uint32_t failures = s_failures;
+  uint32_t restoredKind = s_restoredKind;
+  uint32_t restoredElapsedMs = s_restoredElapsedMs;
+  portEXIT_CRITICAL(&s_mux);
+
+  String json = String("{\"records\":") + String(records);
+  json += String(",\"bytes\":") + String((unsigned long)records * sizeof(Record));
+  json += String(",\"appends\":") + String(appends);
+  json += String(",\"compactions\":") + String(compactions);
+  json += String(",\"failures\":") + String(failures);
+  json += String(",\"pending\":") + (s_pending ? "true" : "false");
+  json += String(",\"lastAgeMs\":") + String(millis() - s_lastAppendMs);
+  json += ",\"restored\":";
+  if (!s_haveRestored) {
+    json += "null}";
+    return json;
+  }
+  static const char* const KIND_NAMES[] = { "strips", "sequence", "anim" };
+  json += String("{\"kind\":\"") + KIND_NAMES[restoredKind] + "\"";
+  if (restoredKind == 1) json += String(",\"name\":\"") + s_restored.sequence + "\"";
+  if (restoredKind == 2) json += String(",\"name\":\"") + LEDController::animationName((LEDController::Animation)s_restored.anim) + "\"";
+  json += String(",\"elapsedMs\":") + String(restoredElapsedMs) + "}}";
+  return json;
+}
+
+} // namespace StateJournal
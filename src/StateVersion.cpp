@@ -0,0 +1,54 @@
+#include "StateVersion.h"
+
+namespace StateVersion {
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_first = 0;
+static uint32_t s_version = 0;
+static uint32_t s_changedAt[SectionCount];
+
+// Pick the random start on first use (s_mux held)
+static void seed()
+{
+  if (s_first) return;
+  s_first = (esp_random() >> 2) | 1;
+  s_version = s_first;
+  for (int i = 0; i < SectionCount; ++i) s_changedAt[i] = s_first;
+}
+
+void bump(Section section)
+{
+  portENTER_CRITICAL(&s_mux);
+  seed();
+  s_changedAt[section] = ++s_version;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+uint32_t current()
+{
+  portENTER_CRITICAL(&s_mux);
+  seed();
+  uint32_t v = s_version;
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+uint32_t first()
+{
+  portENTER_CRITICAL(&s_mux);
+  seed();
+  uint32_t v = s_first;
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+uint32_t changedAt(Section section)
+{
+  portENTER_CRITICAL(&s_mux);
+  seed();
+  uint32_t v = s_changedAt[section];
+  portEXIT_CRITICAL(&s_mux);
+  return v;
+}
+
+} // namespace StateVersion
@@ -0,0 +1,142 @@
+#include "StripStore.h"
+#include "StateVersion.h"
+#include <atomic>
+
+namespace StripStore {
+
+// One seqlock slot per target. `seq` is odd while a write is in progress; the
+// target generation is seq / 2. The state is kept packed in atomic words so a
+// racing reader never performs a torn (undefined) read, it just retries.
+struct Slot {
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> color; // brightness << 24 | r << 16 | g << 8 | b
+  std::atomic<uint32_t> on;
+  std::atomic<uint32_t> applied;    // generation last applied by the renderer
+  std::atomic<uint32_t> superseded; // writes that replaced an unapplied write
+};
+
+static Slot s_slots[TargetCount];
+static_assert((int)StateVersion::Dim == Dim && (int)StateVersion::Ws1 == WS1 && (int)StateVersion::Ws2 == WS2,
+              "StateVersion strip sections follow Target");
+static std::atomic<uint32_t> s_generation(0);
+static portMUX_TYPE s_writeMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t packColor(const StripState& st)
+{
+  return ((uint32_t)st.brightness << 24) | ((uint32_t)st.r << 16) | ((uint32_t)st.g << 8) | (uint32_t)st.b;
+}
+
+static StripState unpack(uint32_t color, uint32_t on)
+{
+  StripState st;
+  st.brightness = (uint8_t)(color >> 24);
+  st.r = (uint8_t)(color >> 16);
+  st.g = (uint8_t)(color >> 8);
+  st.b = (uint8_t)color;
+  st.on = on != 0;
+  return st;
+}
+
+void init(const StripState& dim, const StripState& ws1, const StripState& ws2)
+{
+  const StripState* seeds[TargetCount] = { &dim, &ws1, &ws2 };
+  for (int i = 0; i < TargetCount; ++i) {
+    s_slots[i].color.store(packColor(*seeds[i]), std::memory_order_relaxed);
+    s_slots[i].on.store(seeds[i]->on ? 1 : 0, std::memory_order_relaxed);
+    s_slots[i].applied.store(0, std::memory_order_relaxed);
+    s_slots[i].superseded.store(0, std::memory_order_relaxed);
+    s_slots[i].seq.store(0, std::memory_order_release);
+  }
+  s_generation.store(0, std::memory_order_release);
+}
+
+StripState read(Target t, uint32_t& gen)
+{
+  Slot& s = s_slots[t];
+  uint32_t s1, s2, color, on;
+  do {
+    s1 = s.seq.load(std::memory_order_acquire);
+    color = s.color.load(std::memory_order_relaxed);
+    on = s.on.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    s2 = s.seq.load(std::memory_order_relaxed);
+  } while ((s1 & 1u) || s1 != s2);
+  gen = s1 >> 1;
+  return unpack(color, on);
+}
+
+StripState read(Target t)
+{
+  uint32_t gen;
+  return read(t, gen);
+}
+
+void write(Target t, const StripState& st)
+{
+  detail::lockWriter();
+  detail::commit(t, st);
+  detail::unlockWriter();
+}
+
+uint32_t generation(Target t)
+{
+  return s_slots[t].seq.load(std::memory_order_acquire) >> 1;
+}
+
+uint32_t generation()
+{
+  return s_generation.load(std::memory_order_acquire);
+}
+
+void markApplied(Target t, uint32_t gen)
+{
+  s_slots[t].applied.store(gen, std::memory_order_relaxed);
+}
+
+uint32_t superseded(Target t)
+{
+  return s_slots[t].superseded.load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+void lockWriter()
+{
+  portENTER_CRITICAL(&s_writeMux);
+}
+
+void unlockWriter()
+{
+  portEXIT_CRITICAL(&s_writeMux);
+}
+
+StripState current(Target t)
+{
+  // Only called with the writer lock held, so the slot is stable.
+  Slot& s = s_slots[t];
+  return unpack(s.color.load(std::memory_order_relaxed), s.on.load(std::memory_order_relaxed));
+}
+
+void commit(Target t, const StripState& st)
+{
+  Slot& s = s_slots[t];
+  // Writing the current state changes nothing: generation, state version and
+  // the journal stay put, so /api/state ETags stay valid
+  if (packColor(st) == s.color.load(std::memory_order_relaxed) &&
+      (st.on ? 1u : 0u) == (uint32_t)s.on.load(std::memory_order_relaxed))
+    return;
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  if ((seq >> 1) != s.applied.load(std::memory_order_relaxed))
+    s.superseded.fetch_add(1, std::memory_order_relaxed);
+  s.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.color.store(packColor(st), std::memory_order_relaxed);
+  s.on.store(st.on ? 1 : 0, std::memory_order_relaxed);
+  s.seq.store(seq + 2, std::memory_order_release);
+  s_generation.fetch_add(1, std::memory_order_release);
+  StateVersion::bump((StateVersion::Section)t);
+}
+
+} // namespace detail
+
+} // namespace StripStore
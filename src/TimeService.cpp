@@ -1,4 +1,5 @@
 #include "TimeService.h"
+#include "Clock.h"
 #include <ctime>
 #include <time.h>
 
@@ -31,7 +32,7 @@ bool begin(const char* tz, unsigned long timeoutMs)
 
 time_t now()
 {
-  return time(nullptr);
+  return Clock::now();
 }
 
 String nowIso()
@@ -30,9 +30,19 @@ bool begin(const char* hostname, const char* ssid, const char* password)
   return ok;
 }
 
+bool connected()
+{
+  return WiFi.status() == WL_CONNECTED && (uint32_t)WiFi.localIP() != 0;
+}
+
 String ipString()
 {
   return WiFi.localIP().toString();
 }
 
+uint32_t ipAddress()
+{
+  return (uint32_t)WiFi.localIP();
+}
+
 } // namespace WifiMgr
@@ -3,19 +3,36 @@
 #include <Adafruit_NeoPixel.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
 
 #include "WiFiManager.h"
 #include "OTAHandler.h"
 #include "LEDController.h"
+#include "StripStore.h"
 #include "ApiServer.h"
 #include "TimeService.h"
 #include "Scheduler.h"
+#include "PowerManager.h"
+#include "HealthMonitor.h"
+#include "Scenes.h"
+#include "Sequencer.h"
+#include "EffectVM.h"
+#include "EventLog.h"
+#include "LampSync.h"
+#include "ColorTemp.h"
+#include "CommandBus.h"
+#include "StateJournal.h"
+#include "DailyLight.h"
 
 // ------------------- PINOUT & COUNTS -------------------
 #define DIM_STRIP_PIN 4   // regular dimmable LED strip (MOSFET -> low-side)
 #define WS1_PIN 17        // first WS2812 strip data
 #define WS2_PIN 18        // second WS2812 strip data
 
+#define SCENE_BUTTON_PIN 0 // BOOT button (active low): cycles through stored scenes
+
+#define LOG_TO_SERIAL 1    // mirror the event log (/api/log) on Serial from a low-priority task
+
 #define WS1_COUNT 15
 #define WS2_COUNT 15
 
@@ -26,6 +43,10 @@ Adafruit_NeoPixel strip2(WS2_COUNT, WS2_PIN, NEO_GRB + NEO_KHZ800);
 // ------------------- HOST / NETWORK -------------------
 static const char* HOSTNAME = "aquarium-lamp";  // visible as aquarium-lamp.local
 
+// ------------------- SITE (sunrise/sunset schedule rules) -------------------
+static const float SITE_LAT = 52.23f;  // Warsaw
+static const float SITE_LON = 21.01f;
+
 // ------------------- PWM (LEDC) CONFIG -------------------
 static const int DIM_CH     = 0;     // LEDC channel for PWM
 static const int DIM_FREQ   = 5000;  // 5 kHz is fine for LED dimming
@@ -35,10 +56,11 @@ static const int DIM_RES    = 8;     // 8-bit (0..255 duty)
 AsyncWebServer server(80);
 
 // ------------------- STATE -------------------
-// Use StripState from include/LEDController.h
-StripState dimState   {255, 255, 255, 255, true}; // brightness used as PWM duty; rgb unused
-StripState ws1State   {128, 255, 255, 255, true};
-StripState ws2State   {128, 255, 255, 255, true};
+// Initial values seeded into StripStore (include/StripStore.h) when the
+// state journal has none
+static const StripState DIM_INITIAL {255, 255, 255, 255, true}; // brightness used as PWM duty; rgb unused
+static const StripState WS1_INITIAL {128, 255, 255, 255, true};
+static const StripState WS2_INITIAL {128, 255, 255, 255, true};
 
 // ------------------- HELPERS -------------------
 // helper for small functions moved to LEDController/ApiServer
@@ -48,19 +70,37 @@ StripState ws2State   {128, 255, 255, 255, true};
 // ------------------- SETUP/LOOP -------------------
 void setup()
 {
+  // Diagnostics go to the in-memory event log (/api/log)
+#if LOG_TO_SERIAL
   Serial.begin(115200);
-  delay(200);
+  EventLog::startSerialDrain();
+#endif
+  EventLog::log(EventLog::Event::Boot);
+  // Filesystem for recordings and the state journal (format on first boot)
+  if (!LittleFS.begin(true)) EventLog::log(EventLog::Event::FsMountFailed);
+  // Seed shared strip state before anything reads it: the last journaled
+  // state, or the initial values
+  StripState dim = DIM_INITIAL, ws1 = WS1_INITIAL, ws2 = WS2_INITIAL;
+  StateJournal::begin(dim, ws1, ws2);
+  StripStore::init(dim, ws1, ws2);
+  // Per-strip color temperature calibration from flash
+  ColorTemp::begin();
+  // Daily light integral: channel weights, target and stored days from flash
+  DailyLight::begin();
   // Initialize PWM via LEDController
-  LEDController::initPwm(DIM_STRIP_PIN, DIM_CH, DIM_FREQ, DIM_RES, dimState.brightness);
+  LEDController::initPwm(DIM_STRIP_PIN, DIM_CH, DIM_FREQ, DIM_RES, dim.on ? dim.brightness : 0);
 
   // Register and initialize addressable strips
   LEDController::registerStrips(strip1, strip2);
+  // Animation output specialized for this installation (falls back to the
+  // generic writer if the strips do not match)
+  LEDController::useFixedOutput<NEO_GRB, WS2_COUNT, WS1_COUNT>();
   // Ensure initial colors are shown
   LEDController::markDirty(1); LEDController::markDirty(2);
 
   // Start WiFi (best effort). OTA should still be initialized even if WiFi fails.
   bool wifiOk = WifiMgr::begin(HOSTNAME, WIFI_SSID, WIFI_PASSWORD);
-  Serial.printf("WiFi connected: %d, IP: %s\n", wifiOk ? 1 : 0, WifiMgr::ipString().c_str());
+  EventLog::log(EventLog::Event::WifiConnected, wifiOk ? 1 : 0, WifiMgr::ipAddress());
 
   // Initialize time from NTP only if WiFi connected. Best-effort; will not block OTA.
   bool timeOk = false;
@@ -68,44 +108,91 @@ void setup()
     // Europe/Warsaw (CET/CEST) POSIX TZ: CET is UTC+1, CEST is UTC+2 during DST
     timeOk = TimeService::begin("CET-1CEST,M3.5.0/2,M10.5.0/3", 10000);
   }
-  Serial.printf("Time synced: %d, now=%s\n", timeOk ? 1 : 0, TimeService::nowIso().c_str());
+  EventLog::log(EventLog::Event::TimeSynced, timeOk ? 1 : 0, (uint32_t)TimeService::now());
 
-  // Initialize OTA (kept independent). Return value not critical.
+  // Clock sync and shared animation starts with other lamps (starts once WiFi is up)
+  LampSync::begin();
+
+  // Initialize OTA on its own task (kept independent). Return value not critical.
   OTAHandler::begin(HOSTNAME);
 
   // Start web server and routes. If server fails, OTA still runs.
   ApiServer::init(server);
-  ApiServer::registerRoutes(dimState, ws1State, ws2State, strip1, strip2);
+  ApiServer::registerRoutes();
   server.begin();
 
+  // Scene presets from flash; the button cycles through them
+  Scenes::begin(SCENE_BUTTON_PIN);
+
+  // Sequence engine (step timers); the scheduler defines its sequences in init
+  Sequencer::begin();
+
   // Initialize scheduler (uses TimeService for triggers)
-  Scheduler::init(dimState, ws1State, ws2State, strip1, strip2);
+  Scheduler::init();
+  Scheduler::setLocation(SITE_LAT, SITE_LON);
+  // Photoperiod: 8 h in winter to 10 h in summer, centered on 14:00 local
+  Scheduler::setPhotoperiod(8 * 60, 10 * 60, 14 * 60);
+
+  // Continue the journaled sequence or animation (e.g. a sunrise cut by a power loss)
+  StateJournal::restore();
+
+  EventLog::log(EventLog::Event::HttpStarted);
 
-  Serial.printf("HTTP server started (hostname=%s)\n", HOSTNAME);
+  // Heap/stack sampling once a minute; warn below 8 KB largest free block
+  HealthMonitor::begin(60000UL, 8192);
+
+  // From here on loop() sleeps between deadlines; handlers wake it up.
+  PowerManager::begin();
 }
 
 void loop()
 {
-  // Keep OTA handling running; OTAHandler is isolated and safe.
-  OTAHandler::handle();
+  // Override arbitration, sequence steps, scene recalls and effect/shared
+  // starts first so their changes land in the same frame
+  CommandBus::loop();
+  Sequencer::loop();
+  Scenes::loop();
+  EffectVM::loop();
+  LampSync::loop();
+
+  // Day changes and the daily light cap, before the frame that applies it
+  DailyLight::loop();
 
   // Let LEDController handle pending updates
-  LEDController::loop(ws1State, ws2State);
+  LEDController::loop();
+  // Journal what is now on the output (coalesced appends)
+  StateJournal::loop();
 
   // If time wasn't synced at startup, try once after WiFi gets an IP.
   static bool s_timeSyncedHere = false;
-  if (!s_timeSyncedHere) {
-    String ip = WifiMgr::ipString();
-    if (ip != "0.0.0.0" && ip.length() > 0) {
-  bool ok = TimeService::begin("CET-1CEST,M3.5.0/2,M10.5.0/3", 10000);
-      Serial.printf("Deferred time sync: %d, now=%s\n", ok ? 1 : 0, TimeService::nowIso().c_str());
-      s_timeSyncedHere = true; // only attempt once here
-    }
+  if (!s_timeSyncedHere && WifiMgr::connected()) {
+    bool ok = TimeService::begin("CET-1CEST,M3.5.0/2,M10.5.0/3", 10000);
+    EventLog::log(EventLog::Event::TimeSyncDeferred, ok ? 1 : 0, (uint32_t)TimeService::now());
+    s_timeSyncedHere = true; // only attempt once here
   }
 
   // Scheduler loop (quick non-blocking)
   Scheduler::loop();
 
-  // You can add lightweight periodic tasks here (no delay(…); use vTaskDelay if needed)
-  // vTaskDelay(1); // optional yield
+  HealthMonitor::loop();
+
+  // Block until the next frame (while animating or a change is pending), the
+  // next scheduler check, or an incoming command; housekeeping above runs at
+  // least every MAX_SLEEP_MS. During an OTA upload output is frozen, so no
+  // frames are due, but the CPU stays at full speed for the transfer.
+  static const unsigned long MAX_SLEEP_MS = 250;
+  bool ota = OTAHandler::active();
+  bool animating = LEDController::currentAnimation() != LEDController::Animation::None;
+  bool frameDue = !ota && (animating || Sequencer::fading() || LEDController::hasPendingChanges());
+  unsigned long waitMs = frameDue ? LEDController::msUntilNextFrame() : Scheduler::msUntilNextCheck();
+  unsigned long syncMs = LampSync::msUntilNext();
+  if (waitMs > syncMs) waitMs = syncMs;
+  unsigned long busMs = CommandBus::msUntilNext();
+  if (waitMs > busMs) waitMs = busMs;
+  unsigned long journalMs = StateJournal::msUntilNext();
+  if (waitMs > journalMs) waitMs = journalMs;
+  unsigned long lightMs = DailyLight::msUntilNext();
+  if (waitMs > lightMs) waitMs = lightMs;
+  if (waitMs > MAX_SLEEP_MS) waitMs = MAX_SLEEP_MS;
+  PowerManager::sleepUntilNext(waitMs, animating || ota);
 }
@@ -0,0 +1,114 @@
+#pragma once
+// Host Adafruit_NeoPixel: pixels live in memory, show() only counts.
+// Brightness is applied on setPixelColor like the real library.
+#include <Arduino.h>
+
+typedef uint16_t neoPixelType;
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_RBG ((0 << 6) | (0 << 4) | (2 << 2) | (1))
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_GBR ((2 << 6) | (2 << 4) | (0 << 2) | (1))
+#define NEO_BRG ((1 << 6) | (1 << 4) | (2 << 2) | (0))
+#define NEO_BGR ((2 << 6) | (2 << 4) | (1 << 2) | (0))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800)
+    : m_n(n), m_pin(pin), m_type(type), m_pixels(new uint8_t[3 * n]())
+  {
+    m_r = (type >> 4) & 3;
+    m_g = (type >> 2) & 3;
+    m_b = type & 3;
+  }
+  ~Adafruit_NeoPixel() { delete[] m_pixels; }
+
+  void begin() {}
+  void show() { ++m_shows; }
+  bool canShow() const { return true; }
+  uint16_t numPixels() const { return m_n; }
+  uint8_t* getPixels() const { return m_pixels; }
+  void clear() { memset(m_pixels, 0, 3 * m_n); }
+
+  // Like the library, 0 is full brightness internally (stored as value + 1)
+  void setBrightness(uint8_t b) { m_brightness = (uint8_t)(b + 1); }
+  uint8_t getBrightness() const { return (uint8_t)(m_brightness - 1); }
+
+  void setPixelColor(uint16_t i, uint8_t r, uint8_t g, uint8_t b)
+  {
+    if (i >= m_n) return;
+    if (m_brightness) {
+      r = (uint8_t)((r * m_brightness) >> 8);
+      g = (uint8_t)((g * m_brightness) >> 8);
+      b = (uint8_t)((b * m_brightness) >> 8);
+    }
+    uint8_t* p = m_pixels + 3 * i;
+    p[m_r] = r;
+    p[m_g] = g;
+    p[m_b] = b;
+  }
+  void setPixelColor(uint16_t i, uint32_t c) { setPixelColor(i, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c); }
+  uint32_t getPixelColor(uint16_t i) const
+  {
+    if (i >= m_n) return 0;
+    const uint8_t* p = m_pixels + 3 * i;
+    uint32_t r = p[m_r], g = p[m_g], b = p[m_b];
+    if (m_brightness) {
+      r = (r << 8) / m_brightness;
+      g = (g << 8) / m_brightness;
+      b = (b << 8) / m_brightness;
+    }
+    return (r << 16) | (g << 8) | b;
+  }
+  void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0)
+  {
+    uint16_t end = count == 0 || first + count > m_n ? m_n : (uint16_t)(first + count);
+    for (uint16_t i = first; i < end; ++i) setPixelColor(i, c);
+  }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
+  {
+    return ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+  // The library's HSV conversion (hue 0..65535 around the wheel)
+  static uint32_t ColorHSV(uint16_t hue, uint8_t sat = 255, uint8_t val = 255)
+  {
+    uint8_t r, g, b;
+    hue = (uint16_t)((hue * 1530L + 32768) / 65536);
+    if (hue < 510) {
+      b = 0;
+      if (hue < 255) { r = 255; g = (uint8_t)hue; }
+      else { r = (uint8_t)(510 - hue); g = 255; }
+    } else if (hue < 1020) {
+      r = 0;
+      if (hue < 765) { g = 255; b = (uint8_t)(hue - 510); }
+      else { g = (uint8_t)(1020 - hue); b = 255; }
+    } else if (hue < 1530) {
+      g = 0;
+      if (hue < 1275) { r = (uint8_t)(hue - 1020); b = 255; }
+      else { r = 255; b = (uint8_t)(1530 - hue); }
+    } else {
+      r = 255; g = b = 0;
+    }
+    uint32_t v1 = 1 + val;
+    uint16_t s1 = (uint16_t)(1 + sat);
+    uint8_t s2 = (uint8_t)(255 - sat);
+    return ((((((r * s1) >> 8) + s2) * v1) & 0xff00) << 8) |
+           (((((g * s1) >> 8) + s2) * v1) & 0xff00) |
+           (((((b * s1) >> 8) + s2) * v1) >> 8);
+  }
+
+  uint32_t shows() const { return m_shows; }
+
+private:
+  Adafruit_NeoPixel(const Adafruit_NeoPixel&);
+  Adafruit_NeoPixel& operator=(const Adafruit_NeoPixel&);
+  uint16_t m_n;
+  int16_t m_pin;
+  neoPixelType m_type;
+  uint8_t* m_pixels;
+  uint8_t m_r, m_g, m_b;
+  uint8_t m_brightness = 0;
+  uint32_t m_shows = 0;
+};
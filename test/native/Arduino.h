@@ -0,0 +1,258 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core the tested modules use
+// (pio test -e native). Tests run single-threaded, so nothing here locks.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using std::min;
+using std::max;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define PROGMEM
+#define PI 3.1415926535897932384626433832795
+
+namespace Host {
+
+  // Clock behind micros()/millis() and esp_timer: steady time since start
+  // unless a test installs its own.
+  typedef int64_t (*ClockFn)();
+  inline int64_t steadyUs()
+  {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  inline ClockFn& clock()
+  {
+    static ClockFn fn = steadyUs;
+    return fn;
+  }
+  inline int64_t nowUs() { return clock()(); }
+
+  // delay(): sleeps by default; a test with its own clock advances it instead
+  typedef void (*SleepFn)(int64_t us);
+  inline void threadSleep(int64_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+  inline SleepFn& sleep()
+  {
+    static SleepFn fn = threadSleep;
+    return fn;
+  }
+
+} // namespace Host
+
+// unsigned long is 64-bit on an LP64 host, so these do not wrap at 2^32 the
+// way they do on the ESP32; tests that care cast to uint32_t.
+inline unsigned long micros() { return (unsigned long)Host::nowUs(); }
+inline unsigned long millis() { return (unsigned long)(Host::nowUs() / 1000); }
+inline void delay(uint32_t ms) { Host::sleep()((int64_t)ms * 1000); }
+inline void yield() {}
+
+inline uint32_t esp_random() { return (uint32_t)rand() * 2654435761u ^ (uint32_t)rand(); }
+
+// SNTP is not started on the host; the system clock is already set
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {}
+
+// LEDC PWM: duties are kept per channel, nothing is driven
+namespace Host {
+  inline uint32_t* ledcDuty()
+  {
+    static uint32_t duty[16];
+    return duty;
+  }
+}
+inline double ledcSetup(uint8_t, double freq, uint8_t) { return freq; }
+inline void ledcAttachPin(uint8_t, uint8_t) {}
+inline void ledcWrite(uint8_t channel, uint32_t duty) { Host::ledcDuty()[channel & 15] = duty; }
+inline uint32_t ledcRead(uint8_t channel) { return Host::ledcDuty()[channel & 15]; }
+
+// GPIO: nothing is wired; inputs read HIGH (a released button)
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define FALLING 0x02
+#define RISING 0x01
+#define CHANGE 0x03
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+
+// FreeRTOS tasks: not started on the host (everything runs on the caller's
+// thread); vTaskDelay() sleeps like delay()
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define tskIDLE_PRIORITY 0
+#define pdPASS 1
+#define pdFAIL 0
+inline void vTaskDelay(TickType_t ticks) { Host::sleep()((int64_t)ticks * 1000); }
+inline int xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, unsigned, TaskHandle_t*, int)
+{
+  return pdFAIL;
+}
+
+// FreeRTOS critical sections (no other task to exclude)
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+
+// Arduino String on std::string: numbers append as decimal text, char as a character
+class String {
+public:
+  String(const char* s = "") : m_s(s ? s : "") {}
+  String(const std::string& s) : m_s(s) {}
+  String(char c) : m_s(1, c) {}
+  explicit String(unsigned char v) : m_s(std::to_string((unsigned)v)) {}
+  explicit String(int v) : m_s(std::to_string(v)) {}
+  explicit String(unsigned int v) : m_s(std::to_string(v)) {}
+  explicit String(long v) : m_s(std::to_string(v)) {}
+  explicit String(unsigned long v) : m_s(std::to_string(v)) {}
+  explicit String(long long v) : m_s(std::to_string(v)) {}
+  explicit String(unsigned long long v) : m_s(std::to_string(v)) {}
+  explicit String(float v, unsigned char decimals = 2) : m_s(fixed(v, decimals)) {}
+  explicit String(double v, unsigned char decimals = 2) : m_s(fixed(v, decimals)) {}
+
+  const char* c_str() const { return m_s.c_str(); }
+  unsigned int length() const { return (unsigned int)m_s.size(); }
+  bool isEmpty() const { return m_s.empty(); }
+  bool reserve(unsigned int n) { m_s.reserve(n); return true; }
+  char charAt(unsigned int i) const { return i < m_s.size() ? m_s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+
+  bool concat(const char* s, unsigned int n) { m_s.append(s, n); return true; }
+  String& operator+=(const String& s) { m_s += s.m_s; return *this; }
+  String& operator+=(const char* s) { m_s += s ? s : ""; return *this; }
+  String& operator+=(char c) { m_s += c; return *this; }
+  template <typename T> String& operator+=(T v) { return *this += String(v); }
+
+  bool equals(const String& s) const { return m_s == s.m_s; }
+  bool operator==(const String& s) const { return m_s == s.m_s; }
+  bool operator==(const char* s) const { return m_s == (s ? s : ""); }
+  bool operator!=(const String& s) const { return !(*this == s); }
+  bool operator!=(const char* s) const { return !(*this == s); }
+  bool operator<(const String& s) const { return m_s < s.m_s; }
+
+  bool startsWith(const String& p) const { return m_s.compare(0, p.m_s.size(), p.m_s) == 0; }
+  bool endsWith(const String& p) const
+  {
+    return m_s.size() >= p.m_s.size() && m_s.compare(m_s.size() - p.m_s.size(), p.m_s.size(), p.m_s) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const { return found(m_s.find(c, from)); }
+  int indexOf(const String& s, unsigned int from = 0) const { return found(m_s.find(s.m_s, from)); }
+  int lastIndexOf(char c) const { return found(m_s.rfind(c)); }
+  String substring(unsigned int from) const { return from < m_s.size() ? String(m_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    if (from > to) std::swap(from, to);
+    return from < m_s.size() ? String(m_s.substr(from, to - from)) : String();
+  }
+  long toInt() const { return atol(m_s.c_str()); }
+  float toFloat() const { return (float)atof(m_s.c_str()); }
+  void toLowerCase() { for (size_t i = 0; i < m_s.size(); ++i) m_s[i] = (char)tolower((unsigned char)m_s[i]); }
+  void toUpperCase() { for (size_t i = 0; i < m_s.size(); ++i) m_s[i] = (char)toupper((unsigned char)m_s[i]); }
+  void trim()
+  {
+    size_t a = m_s.find_first_not_of(" \t\r\n");
+    size_t b = m_s.find_last_not_of(" \t\r\n");
+    m_s = a == std::string::npos ? std::string() : m_s.substr(a, b - a + 1);
+  }
+
+private:
+  static std::string fixed(double v, unsigned char decimals)
+  {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+  }
+  static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  std::string m_s;
+};
+
+inline String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, const char* b) { String s(a); s += b; return s; }
+inline String operator+(const char* a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, char b) { String s(a); s += b; return s; }
+template <typename T> inline String operator+(const String& a, T b) { String s(a); s += String(b); return s; }
+
+// IPv4 address as the ESP32 core keeps it: first octet in the low byte
+class IPAddress {
+public:
+  IPAddress(uint32_t v = 0) : m_v(v) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : m_v(a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+  uint8_t operator[](int i) const { return (uint8_t)(m_v >> (8 * i)); }
+  operator uint32_t() const { return m_v; }
+  String toString() const
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+  }
+
+private:
+  uint32_t m_v;
+};
+
+// Print and Serial (stdout)
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n)
+  {
+    size_t done = 0;
+    while (done < n && write(buf[done])) ++done;
+    return done;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  template <typename T> size_t print(T v) { return print(String(v)); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char small[128];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(small, sizeof(small), fmt, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(small)) return write((const uint8_t*)small, (size_t)n);
+    std::string big((size_t)n + 1, '\0');
+    va_start(args, fmt);
+    vsnprintf(&big[0], big.size(), fmt, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), (size_t)n);
+  }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  using Print::write;
+  size_t write(uint8_t b) override { return fputc(b, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+};
+static HardwareSerial Serial;
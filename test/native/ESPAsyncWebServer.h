@@ -0,0 +1,381 @@
+#pragma once
+// Host AsyncWebServer: the part of the library ApiServer uses, served over
+// POSIX sockets. Nothing runs in the background: handleClients() accepts,
+// reads and answers whatever is ready and is called from the main loop, so
+// handlers run on the same thread as the rest of the firmware (the host has
+// no critical sections). Like the library it answers one request per
+// connection (Connection: close). No multipart uploads or chunked replies.
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String& name, const String& value) : m_name(name), m_value(value) {}
+  const String& name() const { return m_name; }
+  const String& value() const { return m_value; }
+  bool isPost() const { return false; }
+  bool isFile() const { return false; }
+
+private:
+  String m_name, m_value;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String& name, const String& value) : m_name(name), m_value(value) {}
+  const String& name() const { return m_name; }
+  const String& value() const { return m_value; }
+
+private:
+  String m_name, m_value;
+};
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code = 200, const String& contentType = String(), const std::string& content = std::string())
+    : m_code(code), m_contentType(contentType), m_content(content) {}
+  virtual ~AsyncWebServerResponse() {}
+  void setCode(int code) { m_code = code; }
+  void addHeader(const String& name, const String& value) { m_headers.push_back(AsyncWebHeader(name, value)); }
+
+  // Status line, headers and body as sent
+  std::string serialize() const
+  {
+    std::string out = "HTTP/1.1 " + std::to_string(m_code) + " " + reason(m_code) + "\r\n";
+    if (m_contentType.length()) out += std::string("Content-Type: ") + m_contentType.c_str() + "\r\n";
+    out += "Content-Length: " + std::to_string(m_content.size()) + "\r\n";
+    for (size_t i = 0; i < m_headers.size(); ++i)
+      out += std::string(m_headers[i].name().c_str()) + ": " + m_headers[i].value().c_str() + "\r\n";
+    out += "Connection: close\r\n\r\n";
+    return out + m_content;
+  }
+
+protected:
+  static const char* reason(int code)
+  {
+    switch (code) {
+      case 200: return "OK";
+      case 304: return "Not Modified";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 409: return "Conflict";
+      case 413: return "Payload Too Large";
+      case 503: return "Service Unavailable";
+      default: return code < 400 ? "OK" : "Error";
+    }
+  }
+
+  int m_code;
+  String m_contentType;
+  std::string m_content;
+  std::vector<AsyncWebHeader> m_headers;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+  explicit AsyncResponseStream(const String& contentType) : AsyncWebServerResponse(200, contentType) {}
+  using Print::write;
+  size_t write(uint8_t b) override
+  {
+    m_content += (char)b;
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t n) override
+  {
+    m_content.append((const char*)buf, n);
+    return n;
+  }
+};
+
+class AsyncClient {
+public:
+  explicit AsyncClient(uint32_t ip = 0) : m_ip(ip) {}
+  IPAddress remoteIP() const { return IPAddress(m_ip); }
+
+private:
+  uint32_t m_ip;
+};
+
+class AsyncWebServer;
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(uint32_t ip) : _tempObject(nullptr), m_client(ip) {}
+  ~AsyncWebServerRequest()
+  {
+    if (m_onDisconnect) m_onDisconnect();
+  }
+
+  const String& url() const { return m_url; }
+  WebRequestMethodComposite method() const { return m_method; }
+  size_t contentLength() const { return m_contentLength; }
+  AsyncClient* client() { return &m_client; }
+  void onDisconnect(std::function<void(void)> fn) { m_onDisconnect = fn; }
+
+  size_t params() const { return m_params.size(); }
+  AsyncWebParameter* getParam(size_t i) const { return i < m_params.size() ? param(i) : nullptr; }
+  bool hasParam(const String& name, bool post = false, bool file = false) const { return getParam(name, post, file) != nullptr; }
+  AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false) const
+  {
+    if (post || file) return nullptr;
+    for (size_t i = 0; i < m_params.size(); ++i)
+      if (m_params[i].name() == name) return param(i);
+    return nullptr;
+  }
+  bool hasHeader(const String& name) const { return getHeader(name) != nullptr; }
+  AsyncWebHeader* getHeader(const String& name) const
+  {
+    String want = name;
+    want.toLowerCase();
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+      String have = m_headers[i].name();
+      have.toLowerCase();
+      if (have == want) return const_cast<AsyncWebHeader*>(&m_headers[i]);
+    }
+    return nullptr;
+  }
+
+  AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String())
+  {
+    return new AsyncWebServerResponse(code, contentType, content.c_str());
+  }
+  AsyncResponseStream* beginResponseStream(const String& contentType, size_t = 1460)
+  {
+    return new AsyncResponseStream(contentType);
+  }
+  void send(AsyncWebServerResponse* response)
+  {
+    if (m_response) delete response; // the library also answers only once
+    else m_response.reset(response);
+  }
+  void send(int code, const String& contentType = String(), const String& content = String())
+  {
+    send(beginResponse(code, contentType, content));
+  }
+  void send(fs::FS& fs, const String& path, const String& contentType = String(), bool download = false)
+  {
+    File f = fs.open(path.c_str(), FILE_READ);
+    if (!f || f.isDirectory()) {
+      send(404);
+      return;
+    }
+    std::string body(f.size(), '\0');
+    body.resize(f.read((uint8_t*)&body[0], body.size()));
+    AsyncWebServerResponse* r = new AsyncWebServerResponse(200, contentType, body);
+    if (download) r->addHeader("Content-Disposition", String("attachment; filename=\"") + f.name() + "\"");
+    send(r);
+  }
+
+  void* _tempObject;
+
+private:
+  friend class AsyncWebServer;
+  AsyncWebParameter* param(size_t i) const { return const_cast<AsyncWebParameter*>(&m_params[i]); }
+
+  String m_url;
+  WebRequestMethodComposite m_method = HTTP_GET;
+  size_t m_contentLength = 0;
+  std::vector<AsyncWebParameter> m_params;
+  std::vector<AsyncWebHeader> m_headers;
+  AsyncClient m_client;
+  std::function<void(void)> m_onDisconnect;
+  std::unique_ptr<AsyncWebServerResponse> m_response;
+};
+
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t)> ArBodyHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)> ArUploadHandlerFunction;
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port) : m_port(port) {}
+  ~AsyncWebServer()
+  {
+    for (size_t i = 0; i < m_clients.size(); ++i) close(m_clients[i].fd);
+    if (m_listenFd >= 0) close(m_listenFd);
+  }
+
+  void onNotFound(ArRequestHandlerFunction fn) { m_notFound = fn; }
+  void onRequestBody(ArBodyHandlerFunction fn) { m_body = fn; }
+  void onFileUpload(ArUploadHandlerFunction) {}
+
+  // Listens on 127.0.0.1 only
+  void begin()
+  {
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(m_port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(m_listenFd, (sockaddr*)&a, sizeof(a)) != 0 || listen(m_listenFd, 64) != 0 ||
+        fcntl(m_listenFd, F_SETFL, O_NONBLOCK) != 0) {
+      close(m_listenFd);
+      m_listenFd = -1;
+    }
+  }
+  bool listening() const { return m_listenFd >= 0; }
+
+  // Host only: waits up to timeoutMs for the first socket to become ready,
+  // then serves everything that is. Returns the number of requests answered.
+  int handleClients(int timeoutMs)
+  {
+    if (m_listenFd < 0) return 0;
+    std::vector<pollfd> fds(1 + m_clients.size());
+    fds[0].fd = m_listenFd;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < m_clients.size(); ++i) {
+      fds[i + 1].fd = m_clients[i].fd;
+      fds[i + 1].events = POLLIN;
+    }
+    if (poll(fds.data(), fds.size(), timeoutMs) <= 0) return 0;
+    int served = 0;
+    for (size_t i = m_clients.size(); i-- > 0; ) {
+      if (!fds[i + 1].revents) continue;
+      if (!readClient(m_clients[i], served)) {
+        close(m_clients[i].fd);
+        m_clients.erase(m_clients.begin() + i);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      sockaddr_in from;
+      socklen_t len = sizeof(from);
+      int fd;
+      while ((fd = accept(m_listenFd, (sockaddr*)&from, &len)) >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        Client c;
+        c.fd = fd;
+        c.ip = from.sin_addr.s_addr;
+        m_clients.push_back(c);
+        len = sizeof(from);
+      }
+    }
+    return served;
+  }
+
+private:
+  struct Client {
+    int fd;
+    uint32_t ip;
+    std::string in;
+  };
+
+  // False once the connection is done (answered, closed or broken)
+  bool readClient(Client& c, int& served)
+  {
+    char buf[2048];
+    ssize_t n;
+    while ((n = recv(c.fd, buf, sizeof(buf), 0)) > 0) c.in.append(buf, (size_t)n);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) return false;
+    size_t headerEnd = c.in.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return c.in.size() < 16384;
+    AsyncWebServerRequest req(c.ip);
+    size_t length = parseHead(c.in.substr(0, headerEnd), req);
+    if (c.in.size() < headerEnd + 4 + length) return true; // body still coming
+    if (length && m_body) m_body(&req, (uint8_t*)&c.in[headerEnd + 4], length, 0, length);
+    if (m_notFound) m_notFound(&req);
+    if (!req.m_response) req.send(500);
+    writeAll(c.fd, req.m_response->serialize());
+    ++served;
+    return false;
+  }
+
+  static size_t parseHead(const std::string& head, AsyncWebServerRequest& req)
+  {
+    size_t lineEnd = head.find("\r\n");
+    std::string line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' '), sp2 = line.find(' ', sp1 + 1);
+    std::string method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    static const char* const METHODS[] = { "GET", "POST", "DELETE", "PUT", "PATCH", "HEAD", "OPTIONS" };
+    for (int i = 0; i < 7; ++i)
+      if (method == METHODS[i]) req.m_method = (WebRequestMethodComposite)(1 << i);
+    size_t q = target.find('?');
+    req.m_url = decode(target.substr(0, q)).c_str();
+    if (q != std::string::npos) {
+      std::string query = target.substr(q + 1);
+      size_t pos = 0;
+      while (pos <= query.size()) {
+        size_t amp = query.find('&', pos);
+        std::string kv = query.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        if (!kv.empty()) {
+          size_t eq = kv.find('=');
+          std::string name = decode(kv.substr(0, eq)), value = eq == std::string::npos ? "" : decode(kv.substr(eq + 1));
+          req.m_params.push_back(AsyncWebParameter(name.c_str(), value.c_str()));
+        }
+        if (amp == std::string::npos) break;
+        pos = amp + 1;
+      }
+    }
+    while (lineEnd != std::string::npos) {
+      size_t start = lineEnd + 2;
+      lineEnd = head.find("\r\n", start);
+      std::string h = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+      size_t colon = h.find(':');
+      if (colon == std::string::npos) continue;
+      size_t v = h.find_first_not_of(' ', colon + 1);
+      req.m_headers.push_back(AsyncWebHeader(h.substr(0, colon).c_str(), v == std::string::npos ? "" : h.substr(v).c_str()));
+    }
+    AsyncWebHeader* cl = req.getHeader("Content-Length");
+    req.m_contentLength = cl ? (size_t)strtoul(cl->value().c_str(), nullptr, 10) : 0;
+    return req.m_contentLength;
+  }
+
+  static std::string decode(const std::string& s)
+  {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s[i] == '+') out += ' ';
+      else if (s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i + 1]) && isxdigit((unsigned char)s[i + 2])) {
+        out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else out += s[i];
+    }
+    return out;
+  }
+
+  static void writeAll(int fd, const std::string& data)
+  {
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+      if (n > 0) done += (size_t)n;
+      else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        pollfd p = { fd, POLLOUT, 0 };
+        if (poll(&p, 1, 1000) <= 0) return;
+      } else return;
+    }
+  }
+
+  uint16_t m_port;
+  int m_listenFd = -1;
+  std::vector<Client> m_clients;
+  ArRequestHandlerFunction m_notFound;
+  ArBodyHandlerFunction m_body;
+};
@@ -0,0 +1,116 @@
+#pragma once
+// Host fs::File on stdio. Paths are taken as host paths below Host::fsRoot()
+// ("" by default, so "/tmp/x.bin" is that file).
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace Host {
+  inline std::string& fsRoot()
+  {
+    static std::string root;
+    return root;
+  }
+  inline std::string fsPath(const char* path) { return fsRoot() + (path ? path : ""); }
+}
+
+namespace fs {
+
+class File {
+public:
+  File() {}
+  File(FILE* fp, const std::string& name) : m_fp(fp, fclose), m_name(name) {}
+  File(DIR* dir, const std::string& name) : m_dir(dir, closedir), m_name(name) {}
+
+  explicit operator bool() const { return m_fp || m_dir; }
+  const char* name() const
+  {
+    size_t slash = m_name.rfind('/');
+    return m_name.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  }
+  bool isDirectory() const { return (bool)m_dir; }
+
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t n) { return m_fp ? fwrite(buf, 1, n, m_fp.get()) : 0; }
+  int read()
+  {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+  size_t read(uint8_t* buf, size_t n) { return m_fp ? fread(buf, 1, n, m_fp.get()) : 0; }
+  int available() { return m_fp ? (int)(size() - position()) : 0; }
+  bool seek(uint32_t pos) { return m_fp && fseek(m_fp.get(), (long)pos, SEEK_SET) == 0; }
+  size_t position() const { return m_fp ? (size_t)ftell(m_fp.get()) : 0; }
+  size_t size() const
+  {
+    struct stat st;
+    if (!m_fp) return 0;
+    fflush(m_fp.get());
+    return fstat(fileno(m_fp.get()), &st) == 0 ? (size_t)st.st_size : 0;
+  }
+  void flush()
+  {
+    if (m_fp) fflush(m_fp.get());
+  }
+  void close()
+  {
+    m_fp.reset();
+    m_dir.reset();
+  }
+
+  File openNextFile()
+  {
+    if (!m_dir) return File();
+    while (struct dirent* e = readdir(m_dir.get())) {
+      if (e->d_name[0] == '.') continue;
+      std::string path = m_name;
+      path.append("/").append(e->d_name);
+      FILE* fp = fopen(Host::fsPath(path.c_str()).c_str(), "rb");
+      if (fp) return File(fp, path);
+    }
+    return File();
+  }
+
+private:
+  std::shared_ptr<FILE> m_fp;
+  std::shared_ptr<DIR> m_dir;
+  std::string m_name;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ, bool create = false)
+  {
+    std::string host = Host::fsPath(path);
+    struct stat st;
+    if (mode[0] == 'r' && stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+      DIR* dir = opendir(host.c_str());
+      return dir ? File(dir, path) : File();
+    }
+    const char* m = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    FILE* fp = fopen(host.c_str(), m);
+    return fp ? File(fp, path) : File();
+  }
+  bool exists(const char* path)
+  {
+    struct stat st;
+    return stat(Host::fsPath(path).c_str(), &st) == 0;
+  }
+  bool remove(const char* path) { return ::remove(Host::fsPath(path).c_str()) == 0; }
+  bool rename(const char* from, const char* to)
+  {
+    return ::rename(Host::fsPath(from).c_str(), Host::fsPath(to).c_str()) == 0;
+  }
+  bool mkdir(const char* path) { return ::mkdir(Host::fsPath(path).c_str(), 0755) == 0 || exists(path); }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,4 @@
+#pragma once
+// The firmware includes "LEDController.h" and the header is LedController.h;
+// a case-insensitive filesystem resolves that, a Linux host does not.
+#include "../../include/LedController.h"
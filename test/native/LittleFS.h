@@ -0,0 +1,19 @@
+#pragma once
+// Host LittleFS: the host filesystem below Host::fsRoot() (see FS.h)
+#include <FS.h>
+
+namespace fs {
+class LittleFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs")
+  {
+    return true;
+  }
+  void end() {}
+  size_t totalBytes() { return 1536 * 1024; }
+  size_t usedBytes() { return 0; }
+};
+} // namespace fs
+
+static fs::LittleFSFS LittleFS;
@@ -0,0 +1,78 @@
+#pragma once
+// Host NVS: namespaces of byte values in memory, empty at start
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false)
+  {
+    m_ns = &store()[name];
+    m_readOnly = readOnly;
+    return true;
+  }
+  void end() { m_ns = nullptr; }
+  bool clear()
+  {
+    if (!writable()) return false;
+    m_ns->clear();
+    return true;
+  }
+  bool remove(const char* key) { return writable() && m_ns->erase(key) > 0; }
+  bool isKey(const char* key) { return m_ns && m_ns->count(key) > 0; }
+
+  size_t putBytes(const char* key, const void* value, size_t len)
+  {
+    if (!writable()) return 0;
+    const uint8_t* p = (const uint8_t*)value;
+    (*m_ns)[key].assign(p, p + len);
+    return len;
+  }
+  size_t getBytesLength(const char* key)
+  {
+    const std::vector<uint8_t>* v = find(key);
+    return v ? v->size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen)
+  {
+    const std::vector<uint8_t>* v = find(key);
+    if (!v || v->size() > maxLen) return 0;
+    if (!v->empty()) memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+
+private:
+  typedef std::map<std::string, std::vector<uint8_t> > Namespace;
+  static std::map<std::string, Namespace>& store()
+  {
+    static std::map<std::string, Namespace> all;
+    return all;
+  }
+  bool writable() const { return m_ns && !m_readOnly; }
+  const std::vector<uint8_t>* find(const char* key) const
+  {
+    if (!m_ns) return nullptr;
+    Namespace::const_iterator it = m_ns->find(key);
+    return it == m_ns->end() ? nullptr : &it->second;
+  }
+  template <typename T> T get(const char* key, T defaultValue) const
+  {
+    const std::vector<uint8_t>* v = find(key);
+    if (!v || v->size() != sizeof(T)) return defaultValue;
+    T out;
+    memcpy(&out, v->data(), sizeof(T));
+    return out;
+  }
+
+  Namespace* m_ns = nullptr;
+  bool m_readOnly = false;
+};
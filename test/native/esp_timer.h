@@ -0,0 +1,104 @@
+#pragma once
+// Host esp_timer on the Host clock. Callbacks run from Host::runTimers(),
+// which a test calls after moving its clock, in due order.
+#include <Arduino.h>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer {
+  esp_timer_cb_t callback;
+  void* arg;
+  bool armed;
+  int64_t dueUs;
+  uint64_t periodUs; // 0 = one-shot
+};
+typedef struct esp_timer* esp_timer_handle_t;
+
+namespace Host {
+
+  inline std::vector<esp_timer*>& timers()
+  {
+    static std::vector<esp_timer*> all;
+    return all;
+  }
+
+  // Fire every timer due at the current time, earliest first
+  inline void runTimers()
+  {
+    for (;;) {
+      esp_timer* next = nullptr;
+      for (esp_timer* t : timers())
+        if (t->armed && t->dueUs <= nowUs() && (!next || t->dueUs < next->dueUs)) next = t;
+      if (!next) return;
+      if (next->periodUs) next->dueUs += (int64_t)next->periodUs;
+      else next->armed = false;
+      next->callback(next->arg);
+    }
+  }
+
+  // Milliseconds until the next armed timer is due (rounded up), for a host
+  // main loop that sleeps between them
+  inline unsigned long msUntilNextTimer()
+  {
+    unsigned long wait = (unsigned long)-1;
+    for (esp_timer* t : timers()) {
+      if (!t->armed) continue;
+      int64_t us = t->dueUs - nowUs();
+      unsigned long ms = us <= 0 ? 0 : (unsigned long)((us + 999) / 1000);
+      if (ms < wait) wait = ms;
+    }
+    return wait;
+  }
+
+} // namespace Host
+
+inline int64_t esp_timer_get_time() { return Host::nowUs(); }
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out)
+{
+  esp_timer* t = new esp_timer{ args->callback, args->arg, false, 0, 0 };
+  Host::timers().push_back(t);
+  *out = t;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t us)
+{
+  if (t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = true;
+  t->dueUs = Host::nowUs() + (int64_t)us;
+  t->periodUs = 0;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t us)
+{
+  if (t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = true;
+  t->dueUs = Host::nowUs() + (int64_t)us;
+  t->periodUs = us;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+  if (!t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = false;
+  return ESP_OK;
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t t) { return t->armed; }
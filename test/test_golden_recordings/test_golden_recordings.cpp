@@ -0,0 +1,144 @@
+// Every animation that needs no file, rendered with
+// LEDController::renderOffline and diffed against the recordings next to this
+// file (pio test -e native). After an intended change to how they look, run
+// the suite with GOLDEN_UPDATE=1 in the environment to rewrite the files, and
+// check them in.
+#include <unity.h>
+#include <string>
+#include "../../src/LEDController.cpp"
+#include "../../src/StripStore.cpp"
+#include "../../src/StateVersion.cpp"
+#include "../../src/FrameRecorder.cpp"
+#include "../../src/PixelOutput.cpp"
+#include "../../src/PixelKernels.cpp"
+#include "../../src/Noise.cpp"
+#include "../../src/Clock.cpp"
+#include "../../src/ColorTemp.cpp"
+#include "../../src/EffectVM.cpp"
+
+// The output is recorded before the daily light cap and power management see it
+namespace DailyLight {
+  void setPwm(uint8_t) {}
+  void setStrip(int, uint32_t, uint32_t, uint32_t, uint16_t) {}
+  uint8_t outputScale() { return 255; }
+}
+namespace PowerManager {
+  void wake() {}
+  void pwmOutput(bool) {}
+}
+
+// The installation in main.cpp
+static Adafruit_NeoPixel s_strip1(15, 4, NEO_GRB + NEO_KHZ800);
+static Adafruit_NeoPixel s_strip2(15, 5, NEO_GRB + NEO_KHZ800);
+static const StripState DIM_INITIAL = { 255, 255, 255, 255, true };
+static const StripState WS_INITIAL = { 128, 255, 255, 255, true };
+
+struct Golden {
+  const char* name;
+  LEDController::Animation anim;
+  unsigned long durationMs;
+  unsigned long frameMs;
+};
+// Looping effects for a few seconds at the frame rate, the ramps over a
+// minute at ten frames a second
+static const Golden WAVES = { "waves", LEDController::Animation::Waves, 6000, 20 };
+static const Golden SUNRISE = { "sunrise", LEDController::Animation::Sunrise, 60000, 100 };
+static const Golden SUNSET = { "sunset", LEDController::Animation::Sunset, 60000, 100 };
+static const Golden DAWN = { "dawn", LEDController::Animation::Dawn, 60000, 100 };
+static const Golden POLICE = { "police", LEDController::Animation::Police, 3000, 20 };
+static const Golden CHRISTMAS = { "christmas", LEDController::Animation::Christmas, 6000, 20 };
+static const Golden CAUSTICS = { "caustics", LEDController::Animation::Caustics, 6000, 20 };
+static const Golden CLOUDS = { "clouds", LEDController::Animation::Clouds, 6000, 20 };
+static const Golden STORM = { "storm", LEDController::Animation::Storm, 6000, 20 };
+
+static std::string goldenPath(const Golden& g)
+{
+  std::string dir = __FILE__;
+  dir = dir.substr(0, dir.find_last_of("/\\") + 1);
+  return dir + "golden_" + g.name + ".bin";
+}
+
+static std::string renderPath(const Golden& g)
+{
+  const char* tmp = getenv("TMPDIR");
+  return std::string(tmp && *tmp ? tmp : "/tmp") + "/aquarium_render_" + g.name + ".bin";
+}
+
+static bool updating()
+{
+  const char* v = getenv("GOLDEN_UPDATE");
+  return v && *v && strcmp(v, "0") != 0;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void checkGolden(const Golden& g)
+{
+  std::string golden = goldenPath(g);
+  if (updating()) {
+    TEST_ASSERT_TRUE(LEDController::renderOffline(g.anim, g.durationMs, g.frameMs, golden.c_str()));
+    TEST_MESSAGE(("rewrote " + golden).c_str());
+    return;
+  }
+  std::string out = renderPath(g);
+  TEST_ASSERT_TRUE(LEDController::renderOffline(g.anim, g.durationMs, g.frameMs, out.c_str()));
+  FrameRecorder::DiffReport rep;
+  bool same = FrameRecorder::diff(golden.c_str(), out.c_str(), 0, rep);
+  TEST_ASSERT_FALSE_MESSAGE(rep.layoutMismatch, "strip layout differs from the golden recording");
+  TEST_ASSERT_FALSE_MESSAGE(rep.lengthMismatch, "frame count differs from the golden recording");
+  TEST_ASSERT_EQUAL_UINT32(g.durationMs / g.frameMs + 1, rep.frames);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(-1, rep.firstMismatch, "first frame that differs");
+  TEST_ASSERT_EQUAL_UINT8_MESSAGE(0, rep.maxDelta, "largest channel difference");
+  TEST_ASSERT_EQUAL(0, rep.maxTimeSkewMs);
+  TEST_ASSERT_TRUE(same);
+  remove(out.c_str());
+}
+
+static void test_waves_matches_golden() { checkGolden(WAVES); }
+static void test_sunrise_matches_golden() { checkGolden(SUNRISE); }
+static void test_sunset_matches_golden() { checkGolden(SUNSET); }
+static void test_dawn_matches_golden() { checkGolden(DAWN); }
+static void test_police_matches_golden() { checkGolden(POLICE); }
+static void test_christmas_matches_golden() { checkGolden(CHRISTMAS); }
+static void test_caustics_matches_golden() { checkGolden(CAUSTICS); }
+static void test_clouds_matches_golden() { checkGolden(CLOUDS); }
+static void test_storm_matches_golden() { checkGolden(STORM); }
+
+// The diff sees a change in the render: a strip calibration tints the sunrise
+static void test_diff_catches_a_changed_render()
+{
+  if (updating()) TEST_IGNORE_MESSAGE("rewriting the golden recordings");
+  std::string out = renderPath(SUNRISE);
+  ColorTemp::setCalibration(1, 255, 240, 255);
+  bool rendered = LEDController::renderOffline(SUNRISE.anim, SUNRISE.durationMs, SUNRISE.frameMs, out.c_str());
+  ColorTemp::setCalibration(1, 255, 255, 255);
+  TEST_ASSERT_TRUE(rendered);
+  FrameRecorder::DiffReport rep;
+  TEST_ASSERT_FALSE(FrameRecorder::diff(goldenPath(SUNRISE).c_str(), out.c_str(), 0, rep));
+  TEST_ASSERT_GREATER_THAN(0, rep.mismatched);
+  TEST_ASSERT_FALSE(rep.lengthMismatch);
+  remove(out.c_str());
+}
+
+int main(int, char**)
+{
+  StripStore::init(DIM_INITIAL, WS_INITIAL, WS_INITIAL);
+  ColorTemp::begin();
+  LEDController::initPwm(2, 0, 5000, 8, DIM_INITIAL.brightness);
+  LEDController::registerStrips(s_strip1, s_strip2);
+  LEDController::useFixedOutput<NEO_GRB, 15, 15>();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_waves_matches_golden);
+  RUN_TEST(test_sunrise_matches_golden);
+  RUN_TEST(test_sunset_matches_golden);
+  RUN_TEST(test_dawn_matches_golden);
+  RUN_TEST(test_police_matches_golden);
+  RUN_TEST(test_christmas_matches_golden);
+  RUN_TEST(test_caustics_matches_golden);
+  RUN_TEST(test_clouds_matches_golden);
+  RUN_TEST(test_storm_matches_golden);
+  RUN_TEST(test_diff_catches_a_changed_render);
+  return UNITY_END();
+}
@@ -0,0 +1,256 @@
+// LampSync on loopback (pio test -e native): three lamps in forked processes,
+// each on its own 127.0.0.x socket with a clock that is seconds off and drifts
+// tens of ppm, and sends held back by a random 0-4 ms to stand in for WiFi.
+// After election and lock-in one follower starts Waves; the lamps then report
+// their network clock and animation phase at the same instants, and the
+// spread between them is checked. Runs in real time (about 15 s). Linux only
+// (binds 127.0.0.2 and .3); elsewhere the test is ignored.
+#include <unity.h>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../../src/LampSync.cpp"
+#include "../../src/Clock.cpp"
+
+// ------------------- fakes for the modules around it -------------------
+
+static LEDController::Animation s_anim = LEDController::Animation::None;
+static unsigned long s_animStartMs = 0;
+
+namespace LEDController {
+  void startAnimationAt(Animation anim, unsigned long, unsigned long startMs)
+  {
+    s_anim = anim;
+    s_animStartMs = startMs;
+  }
+  void startAnimation(Animation anim, unsigned long durationMs) { startAnimationAt(anim, durationMs, (unsigned long)Clock::ms()); }
+  void retimeAnimation(unsigned long startMs) { s_animStartMs = startMs; }
+  unsigned long animationStart() { return s_animStartMs; }
+  Animation currentAnimation() { return s_anim; }
+  void stopAnimation() { s_anim = Animation::None; }
+}
+namespace PowerManager {
+  void wake() {}
+}
+namespace EventLog {
+  void log(Event, uint32_t, uint32_t, uint32_t, uint32_t) {}
+}
+namespace CommandBus {
+  bool network() { return true; }
+}
+
+// ------------------- one lamp -------------------
+
+static const int LAMPS = 3;
+static const int64_t OFFSET_US[LAMPS] = { 5000000, 17250000, 2600000 };
+static const int64_t DRIFT_PPM[LAMPS] = { 0, 30, -20 };
+static const int64_t START_AT_US = 10000000;   // lamp 2 (a follower) starts Waves
+static const int64_t CHECK_AT_US = 11000000;   // then every CHECK_EVERY_US
+static const int64_t CHECK_EVERY_US = 250000;
+static const int CHECKS = 13;
+static const int64_t END_US = 14500000;
+static const int64_t MAX_SEND_DELAY_US = 4000;
+
+struct Report {
+  bool synced;
+  bool started;
+  int64_t netUs[CHECKS];   // network clock at each check
+  int64_t phaseMs[CHECKS]; // animation time at each check
+};
+
+static int s_lamp = 0;
+static int64_t s_t0 = 0;     // shared real time origin
+static int s_fd = -1;
+
+static int64_t realUs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// This lamp's clock at real time `t`
+static int64_t lampUs(int64_t t)
+{
+  int64_t elapsed = t - s_t0;
+  return OFFSET_US[s_lamp] + elapsed + elapsed * DRIFT_PPM[s_lamp] / 1000000;
+}
+
+static int64_t lampNowUs() { return lampUs(realUs()); }
+
+static uint32_t lampIp(int lamp) { return htonl(INADDR_LOOPBACK + lamp); }
+
+static sockaddr_in lampAddr(int lamp)
+{
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons(LampSync::PORT);
+  a.sin_addr.s_addr = lampIp(lamp);
+  return a;
+}
+
+struct Pending {
+  int64_t dueUs;
+  uint32_t ip;
+  std::vector<uint8_t> data;
+};
+static std::vector<Pending> s_pending;
+
+static void flushSends()
+{
+  int64_t now = realUs();
+  for (size_t i = 0; i < s_pending.size(); ) {
+    if (s_pending[i].dueUs > now) { ++i; continue; }
+    sockaddr_in to = lampAddr(0);
+    to.sin_addr.s_addr = s_pending[i].ip;
+    sendto(s_fd, s_pending[i].data.data(), s_pending[i].data.size(), 0, (sockaddr*)&to, sizeof(to));
+    s_pending.erase(s_pending.begin() + i);
+  }
+}
+
+static bool lampReady() { return true; }
+static bool lampOpen() { return true; }
+
+static void lampSend(const uint8_t* data, size_t length, uint32_t ip)
+{
+  for (int i = 0; i < LAMPS; ++i) {
+    if (i == s_lamp || (ip != 0 && ip != lampIp(i))) continue;
+    Pending p;
+    p.dueUs = realUs() + (int64_t)(rand() % (MAX_SEND_DELAY_US + 1));
+    p.ip = lampIp(i);
+    p.data.assign(data, data + length);
+    s_pending.push_back(p);
+  }
+}
+
+static void runLamp(int out)
+{
+  Report r;
+  memset(&r, 0, sizeof(r));
+  srand(1234 + s_lamp);
+  Host::clock() = lampNowUs;
+  LampSync::Port port = { 0x1000u + s_lamp, lampNowUs, lampReady, lampOpen, lampSend };
+  LampSync::begin(port);
+
+  bool started = false;
+  int check = 0;
+  while (realUs() - s_t0 < END_US) {
+    pollfd pfd = { s_fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 1) > 0) {
+      uint8_t buf[128];
+      sockaddr_in from;
+      socklen_t fromLen = sizeof(from);
+      ssize_t n = recvfrom(s_fd, buf, sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+      int64_t rxUs = lampNowUs();
+      if (n > 0) LampSync::receive(buf, (size_t)n, from.sin_addr.s_addr, rxUs);
+    }
+    flushSends();
+    LampSync::loop();
+    int64_t t = realUs() - s_t0;
+    if (!started && s_lamp == 2 && t >= START_AT_US) {
+      LampSync::startShared(LEDController::Animation::Waves, 0);
+      started = true;
+    }
+    if (check < CHECKS && t >= CHECK_AT_US + check * CHECK_EVERY_US) {
+      // Both from this lamp's clock at the check instant itself, so the time
+      // the loop took to get here does not count
+      int64_t local = lampUs(s_t0 + CHECK_AT_US + check * CHECK_EVERY_US);
+      r.netUs[check] = LampSync::toNet(local);
+      r.phaseMs[check] = (int64_t)Clock::msAt(local) - (int64_t)s_animStartMs;
+      if (check == 0) r.synced = LampSync::synced();
+      ++check;
+    }
+  }
+  r.started = s_anim == LEDController::Animation::Waves;
+  ssize_t written = write(out, &r, sizeof(r));
+  _exit(written == (ssize_t)sizeof(r) ? 0 : 1);
+}
+
+// ------------------- tests -------------------
+
+void setUp() {}
+void tearDown() {}
+
+static void test_lamps_render_the_same_frame()
+{
+  int fds[LAMPS];
+  for (int i = 0; i < LAMPS; ++i) {
+    fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in a = lampAddr(i);
+    if (fds[i] < 0 || bind(fds[i], (sockaddr*)&a, sizeof(a)) != 0) {
+      for (int j = 0; j <= i; ++j) if (fds[j] >= 0) close(fds[j]);
+      TEST_IGNORE_MESSAGE("cannot bind 127.0.0.x:4210 on this host");
+    }
+  }
+
+  s_t0 = realUs() + 100000;
+  int pipes[LAMPS];
+  pid_t pids[LAMPS];
+  fflush(stdout);
+  for (int i = 0; i < LAMPS; ++i) {
+    int p[2];
+    TEST_ASSERT_EQUAL(0, pipe(p));
+    pids[i] = fork();
+    TEST_ASSERT_TRUE(pids[i] >= 0);
+    if (pids[i] == 0) {
+      close(p[0]);
+      s_lamp = i;
+      s_fd = fds[i];
+      runLamp(p[1]);
+    }
+    close(p[1]);
+    pipes[i] = p[0];
+  }
+  for (int i = 0; i < LAMPS; ++i) close(fds[i]);
+
+  Report reports[LAMPS];
+  bool complete = true;
+  for (int i = 0; i < LAMPS; ++i) {
+    complete = read(pipes[i], &reports[i], sizeof(Report)) == (ssize_t)sizeof(Report) && complete;
+    close(pipes[i]);
+    int status = 0;
+    waitpid(pids[i], &status, 0);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(complete, "a lamp did not report");
+
+  int64_t clockSpread = 0, phaseSpread = 0;
+  for (int c = 0; c < CHECKS; ++c) {
+    int64_t netLo = reports[0].netUs[c], netHi = netLo;
+    int64_t phaseLo = reports[0].phaseMs[c], phaseHi = phaseLo;
+    for (int i = 1; i < LAMPS; ++i) {
+      netLo = std::min(netLo, reports[i].netUs[c]);
+      netHi = std::max(netHi, reports[i].netUs[c]);
+      phaseLo = std::min(phaseLo, reports[i].phaseMs[c]);
+      phaseHi = std::max(phaseHi, reports[i].phaseMs[c]);
+    }
+    clockSpread = std::max(clockSpread, netHi - netLo);
+    phaseSpread = std::max(phaseSpread, phaseHi - phaseLo);
+  }
+  char msg[96];
+  snprintf(msg, sizeof(msg), "largest spread: network clock %lld us, animation phase %lld ms",
+           (long long)clockSpread, (long long)phaseSpread);
+  TEST_MESSAGE(msg);
+
+  for (int i = 0; i < LAMPS; ++i) {
+    TEST_ASSERT_TRUE_MESSAGE(reports[i].synced, "a lamp had not locked by the first check");
+    TEST_ASSERT_TRUE_MESSAGE(reports[i].started, "a lamp did not run the shared start");
+  }
+  // Delay asymmetry can put two followers up to MAX_SEND_DELAY_US apart; the
+  // fastest-exchange filter has kept them within about 2 ms here
+  TEST_ASSERT_LESS_OR_EQUAL(3000, clockSpread);
+  // The clock spread plus a millisecond each for rounding the start and the
+  // frame time to whole milliseconds
+  TEST_ASSERT_LESS_OR_EQUAL(5, phaseSpread);
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_lamps_render_the_same_frame);
+  return UNITY_END();
+}
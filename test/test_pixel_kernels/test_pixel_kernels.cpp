@@ -0,0 +1,184 @@
+// SWAR pixel kernels against their per-channel references (pio test -e native)
+#include <unity.h>
+#include "../../src/PixelKernels.cpp"
+
+using namespace PixelKernels;
+
+static const uint32_t GUARD = 0xDEADBEEFu;
+
+// Four lanes that take every value 0..255 over v = 0..255, each in a
+// different order
+static uint32_t spread(uint32_t v)
+{
+  return (v & 0xFF) | ((255 - (v & 0xFF)) << 8) | (((v * 7) & 0xFF) << 16) | (((v ^ 0xA5) & 0xFF) << 24);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_scale_every_lane_value_and_factor()
+{
+  for (uint32_t s = 0; s < 256; ++s)
+    for (uint32_t v = 0; v < 256; ++v) {
+      uint32_t c = spread(v);
+      TEST_ASSERT_EQUAL_HEX32(Ref::scale(c, (uint8_t)s), scale(c, (uint8_t)s));
+    }
+}
+
+static void test_lerp_every_lane_pair_and_position()
+{
+  for (uint32_t x = 0; x < 256; ++x)
+    for (uint32_t y = 0; y < 256; ++y) {
+      uint32_t a = x | (y << 8) | ((255 - x) << 16) | ((255 - y) << 24);
+      uint32_t b = y | (x << 8) | ((255 - y) << 16) | ((255 - x) << 24);
+      for (uint32_t t = 0; t <= 256; ++t)
+        TEST_ASSERT_EQUAL_HEX32(Ref::lerp(a, b, (uint16_t)t), lerp(a, b, (uint16_t)t));
+    }
+  TEST_ASSERT_EQUAL_HEX32(0x00123456u, lerp(0x00123456u, 0x00FFFFFFu, 0));
+  TEST_ASSERT_EQUAL_HEX32(0xFF00FF00u, lerp(0x00FF00FFu, 0xFF00FF00u, 256));
+}
+
+static void test_addSat_every_lane_pair()
+{
+  for (uint32_t x = 0; x < 256; ++x)
+    for (uint32_t y = 0; y < 256; ++y) {
+      uint32_t a = x | (y << 8) | ((255 - x) << 16) | ((x ^ y) << 24);
+      uint32_t b = y | (x << 8) | ((255 - y) << 16) | (((x + y) & 0xFF) << 24);
+      TEST_ASSERT_EQUAL_HEX32(Ref::addSat(a, b), addSat(a, b));
+    }
+}
+
+static void test_add_every_factor()
+{
+  for (uint32_t s = 0; s < 256; ++s)
+    for (uint32_t v = 0; v < 256; ++v) {
+      uint32_t a = spread(v), b = spread(255 - v) ^ 0x0F0F0F0Fu;
+      TEST_ASSERT_EQUAL_HEX32(Ref::add(a, b, (uint8_t)s), add(a, b, (uint8_t)s));
+    }
+}
+
+// The device self-test on random words biased toward 0 and 255
+static void test_verify_reports_no_mismatches()
+{
+  KernelReport report[KERNEL_COUNT];
+  TEST_ASSERT_EQUAL_UINT32(0, verify(200000, 1, report));
+  for (int k = 0; k < KERNEL_COUNT; ++k) TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, report[k].mismatches, report[k].name);
+}
+
+// Buffer kernels: every length up to a few words past a multiple of 8, at
+// each start offset, with guard words on both sides that must survive
+static const int MAX_N = 37;
+static const int PAD = 4;
+
+struct Buffers {
+  uint32_t a[PAD + MAX_N + PAD + 4];
+  uint32_t b[PAD + MAX_N + PAD + 4];
+  uint32_t dst[PAD + MAX_N + PAD + 4];
+};
+
+static void prepare(Buffers& buf, int offset, int n)
+{
+  s_rng = 0xC0FFEE00u ^ (uint32_t)(n * 8 + offset);
+  for (size_t i = 0; i < sizeof(buf.a) / sizeof(buf.a[0]); ++i) {
+    buf.a[i] = randomPixel();
+    buf.b[i] = randomPixel();
+    buf.dst[i] = GUARD;
+  }
+  for (int i = 0; i < n; ++i) buf.dst[PAD + offset + i] = randomPixel();
+}
+
+static void checkGuards(const Buffers& buf, int offset, int n)
+{
+  for (int i = 0; i < PAD + offset; ++i) TEST_ASSERT_EQUAL_HEX32(GUARD, buf.dst[i]);
+  for (size_t i = PAD + offset + n; i < sizeof(buf.dst) / sizeof(buf.dst[0]); ++i)
+    TEST_ASSERT_EQUAL_HEX32(GUARD, buf.dst[i]);
+}
+
+static void test_buffer_kernels_odd_lengths_and_offsets()
+{
+  Buffers buf;
+  uint32_t before[MAX_N];
+  for (int n = 0; n <= MAX_N; ++n)
+    for (int offset = 0; offset < 4; ++offset) {
+      int at = PAD + offset;
+      uint8_t s = (uint8_t)(n * 37 + offset * 61);
+      uint16_t t = (uint16_t)((n * 53 + offset * 17) % 257);
+
+      prepare(buf, offset, n);
+      fill(buf.dst + at, (uint16_t)n, 0x00ABCDEFu);
+      for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(0x00ABCDEFu, buf.dst[at + i]);
+      checkGuards(buf, offset, n);
+
+      prepare(buf, offset, n);
+      scale(buf.dst + at, buf.a + at, (uint16_t)n, s);
+      for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::scale(buf.a[at + i], s), buf.dst[at + i]);
+      checkGuards(buf, offset, n);
+
+      prepare(buf, offset, n);
+      lerp(buf.dst + at, buf.a + at, buf.b + at, (uint16_t)n, t);
+      for (int i = 0; i < n; ++i)
+        TEST_ASSERT_EQUAL_HEX32(Ref::lerp(buf.a[at + i], buf.b[at + i], t), buf.dst[at + i]);
+      checkGuards(buf, offset, n);
+
+      prepare(buf, offset, n);
+      memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+      add(buf.dst + at, buf.a + at, (uint16_t)n, s);
+      for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::add(before[i], buf.a[at + i], s), buf.dst[at + i]);
+      checkGuards(buf, offset, n);
+
+      prepare(buf, offset, n);
+      memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+      addSat(buf.dst + at, buf.a + at, (uint16_t)n);
+      for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::addSat(before[i], buf.a[at + i]), buf.dst[at + i]);
+      checkGuards(buf, offset, n);
+    }
+}
+
+// dst may alias a source
+static void test_buffer_kernels_in_place()
+{
+  Buffers buf;
+  uint32_t before[MAX_N];
+  for (int n = 1; n <= MAX_N; n += 2) {
+    int at = PAD + 1;
+    uint8_t s = (uint8_t)(n * 29);
+    uint16_t t = (uint16_t)(n * 7 % 257);
+
+    prepare(buf, 1, n);
+    memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+    scale(buf.dst + at, buf.dst + at, (uint16_t)n, s);
+    for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::scale(before[i], s), buf.dst[at + i]);
+    checkGuards(buf, 1, n);
+
+    prepare(buf, 1, n);
+    memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+    lerp(buf.dst + at, buf.dst + at, buf.b + at, (uint16_t)n, t);
+    for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::lerp(before[i], buf.b[at + i], t), buf.dst[at + i]);
+    checkGuards(buf, 1, n);
+
+    prepare(buf, 1, n);
+    memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+    add(buf.dst + at, buf.dst + at, (uint16_t)n, s);
+    for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::add(before[i], before[i], s), buf.dst[at + i]);
+    checkGuards(buf, 1, n);
+
+    prepare(buf, 1, n);
+    memcpy(before, buf.dst + at, n * sizeof(uint32_t));
+    addSat(buf.dst + at, buf.dst + at, (uint16_t)n);
+    for (int i = 0; i < n; ++i) TEST_ASSERT_EQUAL_HEX32(Ref::addSat(before[i], before[i]), buf.dst[at + i]);
+    checkGuards(buf, 1, n);
+  }
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_scale_every_lane_value_and_factor);
+  RUN_TEST(test_lerp_every_lane_pair_and_position);
+  RUN_TEST(test_addSat_every_lane_pair);
+  RUN_TEST(test_add_every_factor);
+  RUN_TEST(test_verify_reports_no_mismatches);
+  RUN_TEST(test_buffer_kernels_odd_lengths_and_offsets);
+  RUN_TEST(test_buffer_kernels_in_place);
+  return UNITY_END();
+}
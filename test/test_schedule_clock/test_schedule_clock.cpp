@@ -0,0 +1,220 @@
+// Scheduler and Sequencer firings on simulated time (pio test -e native):
+// three days across each DST change in Central Europe, with the 32-bit
+// millisecond wrap in the middle of a sunrise.
+#include <unity.h>
+#include <vector>
+#include "../../src/Clock.cpp"
+#include "../../src/TimeService.cpp"
+#include "../../src/StateVersion.cpp"
+#include "../../src/StripStore.cpp"
+#include "../../src/Sequencer.cpp"
+#include "../../src/Scheduler.cpp"
+
+// ------------------- host clock -------------------
+
+static int64_t s_hostUs = 1000000;
+static int64_t hostClock() { return s_hostUs; }
+static void hostSleep(int64_t us) { s_hostUs += us; }
+
+// ------------------- fakes for the modules around them -------------------
+
+struct Start {
+  LEDController::Animation anim;
+  unsigned long durationMs;
+  time_t wall;       // Clock::now() at the call
+  uint32_t startMs;  // animation start as the device keeps it (32-bit)
+  bool shared;       // through LampSync (a plain schedule entry)
+};
+static std::vector<Start> s_starts;
+static std::vector<time_t> s_stops;
+
+namespace LEDController {
+  static const char* const QUERY[] = { nullptr, "sunrise", "sunset", "waves", "police", "christmas" };
+  static const char* const DISPLAY[] = { "None", "Sunrise", "Sunset", "Waves", "Police", "Christmas" };
+  bool animationFromName(const char* name, Animation& out)
+  {
+    for (int i = 1; i < 6; ++i)
+      if (strcmp(QUERY[i], name) == 0) { out = (Animation)i; return true; }
+    return false;
+  }
+  const char* animationName(Animation anim) { return (int)anim < 6 ? DISPLAY[(int)anim] : "?"; }
+  void startAnimationAt(Animation anim, unsigned long durationMs, unsigned long startMs)
+  {
+    s_starts.push_back(Start{ anim, durationMs, Clock::now(), (uint32_t)startMs, false });
+  }
+  void stopAnimation() { s_stops.push_back(Clock::now()); }
+}
+namespace LampSync {
+  void startShared(LEDController::Animation anim, unsigned long durationMs, uint32_t)
+  {
+    s_starts.push_back(Start{ anim, durationMs, Clock::now(), (uint32_t)Clock::ms(), true });
+  }
+}
+namespace Scenes {
+  int find(const char*) { return -1; }
+  bool recall(int) { return true; }
+}
+namespace CommandBus {
+  bool schedule(const ScheduleAction&) { return true; }
+}
+namespace PowerManager {
+  void wake() {}
+}
+
+// ------------------- driving the main loop -------------------
+
+static const char* TZ_CET = "CET-1CEST,M3.5.0/2,M10.5.0/3";
+// One main loop pass every STEP_US of real time: 0.9 s of clock time at MAX_SPEED
+static const int64_t STEP_US = 250;
+
+static time_t s_wrapWall = 0; // wall time the low 32 bits of Clock::ms() last wrapped
+
+static time_t utc(int y, int m, int d, int h, int min, int s = 0)
+{
+  return (time_t)Scheduler::daysFromCivil(y, m, d) * 86400 + h * 3600 + min * 60 + s;
+}
+
+static void runUntil(time_t wall)
+{
+  uint32_t lastLow = (uint32_t)Clock::ms();
+  while (Clock::now() < wall) {
+    s_hostUs += STEP_US;
+    Host::runTimers();
+    Sequencer::loop();
+    Scheduler::loop();
+    uint32_t low = (uint32_t)Clock::ms();
+    if (low < lastLow) s_wrapWall = Clock::now();
+    lastLow = low;
+  }
+}
+
+static std::vector<Start> startsOf(LEDController::Animation anim, bool shared)
+{
+  std::vector<Start> out;
+  for (const Start& s : s_starts)
+    if (s.anim == anim && s.shared == shared) out.push_back(s);
+  return out;
+}
+
+// A firing at `expected`, seen by a main loop pass at most one step later
+static void assertAt(time_t expected, time_t wall)
+{
+  TEST_ASSERT_GREATER_OR_EQUAL(expected, wall);
+  TEST_ASSERT_LESS_OR_EQUAL(expected + 1, wall);
+}
+
+static void localDate(time_t t, struct tm& out) { localtime_r(&t, &out); }
+
+void setUp()
+{
+  s_starts.clear();
+  s_stops.clear();
+}
+void tearDown() {}
+
+// The built-in sequences (Scheduler::init) fire at their UTC times every day
+static void assertDefaults(int y, int m, int firstDay)
+{
+  std::vector<Start> sunrise = startsOf(LEDController::Animation::Sunrise, false);
+  std::vector<Start> waves = startsOf(LEDController::Animation::Waves, false);
+  std::vector<Start> police = startsOf(LEDController::Animation::Police, false);
+  std::vector<Start> sunset = startsOf(LEDController::Animation::Sunset, false);
+  TEST_ASSERT_EQUAL(3, waves.size());
+  TEST_ASSERT_EQUAL(3, police.size());
+  TEST_ASSERT_EQUAL(3, sunset.size());
+  TEST_ASSERT_EQUAL(6, sunrise.size()); // morning, and police's second step
+  TEST_ASSERT_EQUAL(3, s_stops.size());  // evening ends with "off"
+  for (int i = 0; i < 3; ++i) {
+    int d = firstDay + i;
+    // morning: sunrise for an hour, then waves until something replaces it
+    assertAt(utc(y, m, d, 6, 0), sunrise[2 * i].wall);
+    TEST_ASSERT_EQUAL_UINT32(3600000, sunrise[2 * i].durationMs);
+    assertAt(utc(y, m, d, 7, 0), waves[i].wall);
+    TEST_ASSERT_EQUAL_UINT32(0, waves[i].durationMs);
+    // police: 30 s, then sunrise with no duration
+    assertAt(utc(y, m, d, 10, 0), police[i].wall);
+    assertAt(utc(y, m, d, 10, 0, 30), sunrise[2 * i + 1].wall);
+    // evening: sunset for an hour, then off
+    assertAt(utc(y, m, d, 20, 10), sunset[i].wall);
+    assertAt(utc(y, m, d, 21, 10), s_stops[i]);
+  }
+  TEST_ASSERT_FALSE(StripStore::read(StripStore::Dim).on);
+}
+
+// The 07:00 local entry moves an hour in UTC across the change; 02:30 local
+// fires once on each local day, including the one where it does not exist
+// (spring) or happens twice (autumn)
+static void assertLocalEntries(const time_t* sevenUtc, int firstDay)
+{
+  std::vector<Start> seven = startsOf(LEDController::Animation::Waves, true);
+  TEST_ASSERT_EQUAL(3, seven.size());
+  for (int i = 0; i < 3; ++i) {
+    assertAt(sevenUtc[i], seven[i].wall);
+    TEST_ASSERT_EQUAL(0, seven[i].durationMs);
+  }
+  std::vector<Start> night = startsOf(LEDController::Animation::Christmas, true);
+  TEST_ASSERT_EQUAL(3, night.size());
+  for (int i = 0; i < 3; ++i) {
+    struct tm tm;
+    localDate(night[i].wall, tm);
+    TEST_ASSERT_EQUAL(firstDay + i, tm.tm_mday);
+    TEST_ASSERT_EQUAL(30, tm.tm_min);
+    TEST_ASSERT_TRUE(tm.tm_hour == 2 || (i == 1 && tm.tm_hour == 3));
+  }
+}
+
+static void test_spring_forward_and_wrap()
+{
+  // Low 32 bits of Clock::ms() wrap at 06:30 UTC on the change day, half way
+  // through the morning sunrise
+  uint32_t wrapInMs = (uint32_t)(utc(2026, 3, 29, 6, 30) - utc(2026, 3, 28, 0, 0)) * 1000;
+  TEST_ASSERT_TRUE(Clock::simulate(utc(2026, 3, 28, 0, 0), Clock::MAX_SPEED, wrapInMs));
+  runUntil(utc(2026, 3, 29, 6, 45));
+
+  // Mid-sunrise on the wrap: the sequence and the animation still measure 45 minutes
+  TEST_ASSERT_INT_WITHIN(1, utc(2026, 3, 29, 6, 30), s_wrapWall);
+  char name[Sequencer::NAME_LEN];
+  uint32_t elapsedMs = 0;
+  TEST_ASSERT_TRUE(Sequencer::running(name, elapsedMs));
+  TEST_ASSERT_EQUAL_STRING("morning", name);
+  TEST_ASSERT_INT_WITHIN(1000, 45UL * 60 * 1000, elapsedMs);
+  const Start& sunrise = s_starts.back();
+  TEST_ASSERT_TRUE(sunrise.anim == LEDController::Animation::Sunrise);
+  TEST_ASSERT_INT_WITHIN(1000, 45UL * 60 * 1000, (uint32_t)((uint32_t)Clock::ms() - sunrise.startMs));
+
+  runUntil(utc(2026, 3, 31, 0, 0));
+  assertDefaults(2026, 3, 28);
+  const time_t seven[3] = { utc(2026, 3, 28, 6, 0), utc(2026, 3, 29, 5, 0), utc(2026, 3, 30, 5, 0) };
+  assertLocalEntries(seven, 28);
+  // The sunrise still ran its hour across the wrap
+  std::vector<Start> rises = startsOf(LEDController::Animation::Sunrise, false);
+  std::vector<Start> waves = startsOf(LEDController::Animation::Waves, false);
+  TEST_ASSERT_INT_WITHIN(1000, 3600000, (uint32_t)(waves[1].startMs - rises[2].startMs));
+}
+
+static void test_fall_back()
+{
+  TEST_ASSERT_TRUE(Clock::simulate(utc(2026, 10, 24, 0, 0), Clock::MAX_SPEED));
+  runUntil(utc(2026, 10, 27, 0, 0));
+  assertDefaults(2026, 10, 24);
+  const time_t seven[3] = { utc(2026, 10, 24, 5, 0), utc(2026, 10, 25, 6, 0), utc(2026, 10, 26, 6, 0) };
+  assertLocalEntries(seven, 24);
+}
+
+int main(int, char**)
+{
+  Host::clock() = hostClock;
+  Host::sleep() = hostSleep;
+  TimeService::begin(TZ_CET, 0); // sets the zone; the host clock is already valid
+  StripState on = { 128, 255, 255, 255, true };
+  StripStore::init(on, on, on);
+  Sequencer::begin();
+  Scheduler::init();
+  Scheduler::addDailyEntry(7, 0, false, LEDController::Animation::Waves, 0);
+  Scheduler::addDailyEntry(2, 30, false, LEDController::Animation::Christmas, 0);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_spring_forward_and_wrap);
+  RUN_TEST(test_fall_back);
+  return UNITY_END();
+}
@@ -0,0 +1,168 @@
+// ApiServer's routes on the development machine, as a target for
+// tools/loadtest.py without a lamp:
+//   pio run -e native_api && .pio/build/native_api/program [port]
+// The firmware modules behind the routes are the real ones, set up and looped
+// as in main.cpp; the platform modules (WiFi, OTA, power management, heap
+// monitor) are replaced below and the strips are kept in memory. Files land
+// in ./apihost-fs. Everything runs on one thread: requests are answered where
+// the lamp would sleep, so a request never overlaps a frame as it can on the
+// lamp, and the timings say nothing about the ESP32 itself.
+#include <signal.h>
+#include <sys/stat.h>
+#include <ESPAsyncWebServer.h>
+#include "../../src/ApiServer.cpp"
+#include "../../src/Clock.cpp"
+#include "../../src/ColorTemp.cpp"
+#include "../../src/CommandBus.cpp"
+#include "../../src/DailyLight.cpp"
+#include "../../src/EffectVM.cpp"
+#include "../../src/EventLog.cpp"
+#include "../../src/FrameRecorder.cpp"
+#include "../../src/LEDController.cpp"
+#include "../../src/LampSync.cpp"
+#include "../../src/Noise.cpp"
+#include "../../src/PixelKernels.cpp"
+#include "../../src/PixelOutput.cpp"
+#include "../../src/Scenes.cpp"
+#include "../../src/Scheduler.cpp"
+#include "../../src/Sequencer.cpp"
+#include "../../src/StateJournal.cpp"
+#include "../../src/StateVersion.cpp"
+#include "../../src/StripStore.cpp"
+#include "../../src/TimeService.cpp"
+
+static AsyncWebServer* s_server = nullptr;
+static bool s_woken = false;
+
+// ------------------- platform modules -------------------
+
+namespace WifiMgr {
+  bool begin(const char*, const char*, const char*) { return true; }
+  bool connected() { return true; }
+  String ipString() { return "127.0.0.1"; }
+  uint32_t ipAddress() { return IPAddress(127, 0, 0, 1); }
+}
+
+namespace OTAHandler {
+  bool begin(const char*) { return true; }
+  bool active() { return false; }
+  String statusJson() { return "{\"active\":false,\"progress\":0,\"last\":null}"; }
+}
+
+// Sleeping is serving: requests are answered while the loop waits
+namespace PowerManager {
+  void begin() {}
+  void wake() { s_woken = true; }
+  void wakeFromISR() { s_woken = true; }
+  void sleepUntilNext(unsigned long timeoutMs, bool)
+  {
+    s_server->handleClients(s_woken ? 0 : (int)timeoutMs);
+    s_woken = false;
+  }
+  void pwmOutput(bool) {}
+  State state() { return Active; }
+  String statsJson() { return "{\"state\":\"active\",\"host\":true}"; }
+}
+
+namespace HealthMonitor {
+  void begin(unsigned long, uint32_t) {}
+  void loop() {}
+  void json(Print& out) { out.print("{\"current\":null,\"host\":true}"); }
+}
+
+// Other lamps are not looked for: every start is local
+namespace LampSync {
+  static int64_t hostNowUs() { return esp_timer_get_time(); }
+  static bool hostOffline() { return false; }
+  static void hostSend(const uint8_t*, size_t, uint32_t) {}
+  void begin()
+  {
+    Port port = { 1, hostNowUs, hostOffline, hostOffline, hostSend };
+    begin(port);
+  }
+}
+
+// ------------------- main.cpp on the host -------------------
+
+static Adafruit_NeoPixel strip1(15, 17, NEO_GRB + NEO_KHZ800);
+static Adafruit_NeoPixel strip2(15, 18, NEO_GRB + NEO_KHZ800);
+static const StripState DIM_INITIAL {255, 255, 255, 255, true};
+static const StripState WS1_INITIAL {128, 255, 255, 255, true};
+static const StripState WS2_INITIAL {128, 255, 255, 255, true};
+
+static volatile sig_atomic_t s_stop = 0;
+static void onSignal(int) { s_stop = 1; }
+
+static void setup(uint16_t port)
+{
+  mkdir("apihost-fs", 0755);
+  Host::fsRoot() = "apihost-fs";
+  EventLog::log(EventLog::Event::Boot);
+  LittleFS.begin(true);
+  StripState dim = DIM_INITIAL, ws1 = WS1_INITIAL, ws2 = WS2_INITIAL;
+  StateJournal::begin(dim, ws1, ws2);
+  StripStore::init(dim, ws1, ws2);
+  ColorTemp::begin();
+  DailyLight::begin();
+  LEDController::initPwm(4, 0, 5000, 8, dim.on ? dim.brightness : 0);
+  LEDController::registerStrips(strip1, strip2);
+  LEDController::useFixedOutput<NEO_GRB, 15, 15>();
+  LEDController::markDirty(1); LEDController::markDirty(2);
+  TimeService::begin("CET-1CEST,M3.5.0/2,M10.5.0/3", 0);
+  LampSync::begin();
+
+  static AsyncWebServer server(port);
+  s_server = &server;
+  ApiServer::init(server);
+  ApiServer::registerRoutes();
+  server.begin();
+
+  Scenes::begin(0);
+  Sequencer::begin();
+  Scheduler::init();
+  Scheduler::setLocation(52.23f, 21.01f);
+  Scheduler::setPhotoperiod(8 * 60, 10 * 60, 14 * 60);
+  StateJournal::restore();
+}
+
+static void loop()
+{
+  CommandBus::loop();
+  Sequencer::loop();
+  Scenes::loop();
+  EffectVM::loop();
+  LampSync::loop();
+  DailyLight::loop();
+  LEDController::loop();
+  StateJournal::loop();
+  Scheduler::loop();
+  Host::runTimers();
+
+  static const unsigned long MAX_SLEEP_MS = 250;
+  bool animating = LEDController::currentAnimation() != LEDController::Animation::None;
+  bool frameDue = animating || Sequencer::fading() || LEDController::hasPendingChanges();
+  unsigned long waitMs = frameDue ? LEDController::msUntilNextFrame() : Scheduler::msUntilNextCheck();
+  waitMs = std::min(waitMs, LampSync::msUntilNext());
+  waitMs = std::min(waitMs, CommandBus::msUntilNext());
+  waitMs = std::min(waitMs, StateJournal::msUntilNext());
+  waitMs = std::min(waitMs, DailyLight::msUntilNext());
+  waitMs = std::min(waitMs, Host::msUntilNextTimer());
+  waitMs = std::min(waitMs, MAX_SLEEP_MS);
+  PowerManager::sleepUntilNext(waitMs, animating);
+}
+
+int main(int argc, char** argv)
+{
+  uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : 8080;
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  setup(port);
+  if (!s_server->listening()) {
+    fprintf(stderr, "cannot listen on 127.0.0.1:%u\n", (unsigned)port);
+    return 1;
+  }
+  printf("ApiServer on http://127.0.0.1:%u/ (files in ./apihost-fs)\n", (unsigned)port);
+  fflush(stdout);
+  while (!s_stop) loop();
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Bake an animation into a playback recording on the development machine, so
+// the lamp does not spend minutes of render task and flash writes on it:
+//   pio run -e native_bake
+//   .pio/build/native_bake/program <anim> <dur ms> [frame ms] [out]
+// <anim> is a name as in /api/anim/start (waves, sunrise, christmas, ...);
+// frames default to 20 ms and the output to data/bake_<anim>.bin, so
+// `pio run -t uploadfs` puts it on LittleFS as /bake_<anim>.bin for
+// /api/anim/play. The render is LEDController::renderOffline for the strips in
+// main.cpp (the same as test_golden_recordings); the lamp's color temperature
+// calibration lives in its NVS and is not applied here.
+#include <sys/stat.h>
+#include <string>
+#include "../../src/LEDController.cpp"
+#include "../../src/StripStore.cpp"
+#include "../../src/StateVersion.cpp"
+#include "../../src/FrameRecorder.cpp"
+#include "../../src/PixelOutput.cpp"
+#include "../../src/PixelKernels.cpp"
+#include "../../src/Noise.cpp"
+#include "../../src/Clock.cpp"
+#include "../../src/ColorTemp.cpp"
+#include "../../src/EffectVM.cpp"
+
+// The output is recorded before the daily light cap and power management see it
+namespace DailyLight {
+  void setPwm(uint8_t) {}
+  void setStrip(int, uint32_t, uint32_t, uint32_t, uint16_t) {}
+  uint8_t outputScale() { return 255; }
+}
+namespace PowerManager {
+  void wake() {}
+  void pwmOutput(bool) {}
+}
+
+// The installation in main.cpp: playback refuses recordings of other sizes
+static Adafruit_NeoPixel s_strip1(15, 17, NEO_GRB + NEO_KHZ800);
+static Adafruit_NeoPixel s_strip2(15, 18, NEO_GRB + NEO_KHZ800);
+static const StripState DIM_INITIAL = { 255, 255, 255, 255, true };
+static const StripState WS_INITIAL = { 128, 255, 255, 255, true };
+
+int main(int argc, char** argv)
+{
+  LEDController::Animation anim;
+  long durationMs = argc > 2 ? atol(argv[2]) : 0;
+  long frameMs = argc > 3 ? atol(argv[3]) : 20;
+  if (argc < 3 || argc > 5 || !LEDController::animationFromName(argv[1], anim) ||
+      durationMs <= 0 || frameMs <= 0 || frameMs > 60000) {
+    fprintf(stderr, "usage: %s <anim> <dur ms> [frame ms] [out]\n", argv[0]);
+    return 2;
+  }
+  std::string out;
+  if (argc > 4) {
+    out = argv[4];
+  } else {
+    mkdir("data", 0755);
+    out = "data/bake_";
+    out.append(argv[1]).append(".bin");
+  }
+
+  StripStore::init(DIM_INITIAL, WS_INITIAL, WS_INITIAL);
+  ColorTemp::begin();
+  LEDController::initPwm(4, 0, 5000, 8, DIM_INITIAL.brightness);
+  LEDController::registerStrips(s_strip1, s_strip2);
+  LEDController::useFixedOutput<NEO_GRB, 15, 15>();
+
+  if (!LEDController::renderOffline(anim, (unsigned long)durationMs, (unsigned long)frameMs, out.c_str())) {
+    fprintf(stderr, "cannot write %s\n", out.c_str());
+    return 1;
+  }
+  struct stat st;
+  long bytes = stat(out.c_str(), &st) == 0 ? (long)st.st_size : -1;
+  printf("%s: %lu frames, %ld bytes\n", out.c_str(), (unsigned long)FrameRecorder::framesRecorded(), bytes);
+  return 0;
+}
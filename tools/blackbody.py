@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""Generate the blackbody color table used by ColorTemp (src/ColorTemp.cpp).
+
+For every temperature from 1000 K to 12000 K in 100 K steps, integrates
+Planck's law against the CIE 1931 2-degree observer (multi-lobe fit by Wyman,
+Sloan and Shirley, 2013), converts XYZ to linear sRGB (D65) and scales the
+result so the largest channel is 255. Values are linear light, which is what
+LED PWM produces; they are not gamma encoded.
+
+  python3 tools/blackbody.py   # prints the BLACKBODY[] initializer
+"""
+import math
+
+MIN_K, MAX_K, STEP_K = 1000, 12000, 100
+
+
+def g(x, mu, s1, s2):
+    t = (x - mu) / (s1 if x < mu else s2)
+    return math.exp(-0.5 * t * t)
+
+
+def cie1931(nm):
+    x = 1.056 * g(nm, 599.8, 37.9, 31.0) + 0.362 * g(nm, 442.0, 16.0, 26.7) - 0.065 * g(nm, 501.1, 20.4, 26.2)
+    y = 0.821 * g(nm, 568.8, 46.9, 40.5) + 0.286 * g(nm, 530.9, 16.3, 31.1)
+    z = 1.217 * g(nm, 437.0, 11.8, 36.0) + 0.681 * g(nm, 459.0, 26.0, 13.8)
+    return x, y, z
+
+
+def planck(nm, kelvin):
+    h, c, k = 6.62607015e-34, 2.99792458e8, 1.380649e-23
+    l = nm * 1e-9
+    return 1.0 / (l ** 5 * (math.exp(h * c / (l * k * kelvin)) - 1.0))
+
+
+def blackbody(kelvin):
+    X = Y = Z = 0.0
+    for nm in range(380, 781, 1):
+        p = planck(nm, kelvin)
+        x, y, z = cie1931(nm)
+        X += p * x
+        Y += p * y
+        Z += p * z
+    r = 3.2406 * X - 1.5372 * Y - 0.4986 * Z
+    gr = -0.9689 * X + 1.8758 * Y + 0.0415 * Z
+    b = 0.0557 * X - 0.2040 * Y + 1.0570 * Z
+    rgb = [max(0.0, v) for v in (r, gr, b)]
+    m = max(rgb)
+    return [int(round(255 * v / m)) for v in rgb]
+
+
+def main():
+    # Packed 0x00RRGGBB words, five per line (500 K)
+    temps = list(range(MIN_K, MAX_K + 1, STEP_K))
+    for i in range(0, len(temps), 5):
+        row = temps[i:i + 5]
+        words = ", ".join("0x%06X" % (r << 16 | gr << 8 | b) for r, gr, b in map(blackbody, row))
+        print("  %s, // %d K" % (words, row[0]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Assembler for lamp effect programs (see include/EffectVM.h).
+
+Source is whitespace separated tokens; ';' starts a comment. A token is a
+mnemonic (lower case opcode name, e.g. "sin8"), a number (decimal or 0x hex,
+pushed with the smallest push that holds it), a color "#rrggbb" (pushed as
+0x00RRGGBB) or "p0".."p3" (the start parameters). The program must end with
+"out". Prints the bytecode as hex, or uploads it with --upload.
+
+Examples:
+  python3 tools/fxasm.py ripple.fx
+  python3 tools/fxasm.py ripple.fx --upload aquarium-lamp.local --name ripple
+  echo "#003264 #05e6ff pos 256 mul len div time 51 1000 muldiv add sin8 dup mul 8 shr lerpc out" \\
+      | python3 tools/fxasm.py -
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import sys
+import urllib.parse
+
+# Same order as EffectVM::Op
+OPCODES = [
+    "push8", "push16", "push32", "param",
+    "idx", "pos", "len", "count", "side", "time",
+    "dup", "drop", "swap", "over",
+    "add", "sub", "mul", "div", "mod",
+    "neg", "abs",
+    "min", "max", "and", "or", "xor", "shl", "shr",
+    "lt", "gt", "eq",
+    "sel",
+    "muldiv",
+    "sin8", "tri8", "clamp8",
+    "scale8",
+    "rgb",
+    "lerpc",
+    "scalec",
+    "addc",
+    "out",
+    "noise2", "noise3",
+]
+OP = {name: i for i, name in enumerate(OPCODES)}
+MAX_CODE = 128
+
+
+def push(value):
+    if 0 <= value <= 0xFF:
+        return bytes([OP["push8"], value])
+    if -0x8000 <= value <= 0x7FFF:
+        return bytes([OP["push16"]]) + (value & 0xFFFF).to_bytes(2, "little")
+    if -0x80000000 <= value <= 0xFFFFFFFF:
+        return bytes([OP["push32"]]) + (value & 0xFFFFFFFF).to_bytes(4, "little")
+    raise ValueError("constant out of range: %d" % value)
+
+
+def assemble(text):
+    code = bytearray()
+    for lineno, line in enumerate(text.splitlines(), 1):
+        for token in line.split(";", 1)[0].split():
+            tok = token.lower()
+            try:
+                if tok in OP and tok not in ("push8", "push16", "push32", "param"):
+                    code.append(OP[tok])
+                elif tok.startswith("#") and len(tok) == 7:
+                    code += push(int(tok[1:], 16))
+                elif len(tok) == 2 and tok[0] == "p" and tok[1] in "0123":
+                    code += bytes([OP["param"], int(tok[1])])
+                else:
+                    code += push(int(tok, 0))
+            except ValueError:
+                raise SystemExit("line %d: bad token '%s'" % (lineno, token))
+    if not code or code[-1] != OP["out"]:
+        raise SystemExit("program must end with 'out'")
+    if len(code) > MAX_CODE:
+        raise SystemExit("program is %d bytes (max %d)" % (len(code), MAX_CODE))
+    return bytes(code)
+
+
+def upload(host, port, name, code):
+    path = "/api/fx/upload?" + urllib.parse.urlencode({"name": name, "code": code.hex()})
+    conn = http.client.HTTPConnection(host, port, timeout=10)
+    try:
+        conn.request("GET", path)
+        resp = conn.getresponse()
+        body = resp.read().decode("utf-8", "replace")
+    finally:
+        conn.close()
+    print(body)
+    return resp.status == 200
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", help="program source file, or - for stdin")
+    ap.add_argument("--upload", metavar="HOST", help="upload to the lamp at HOST")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("--name", help="program name on the lamp (default: source file name)")
+    args = ap.parse_args()
+
+    text = sys.stdin.read() if args.source == "-" else open(args.source).read()
+    code = assemble(text)
+    if not args.upload:
+        print(code.hex())
+        return
+    name = args.name or args.source.rsplit("/", 1)[-1].split(".", 1)[0]
+    if not upload(args.upload, args.port, name, code):
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""HTTP load test for the aquarium lamp API.
+
+Replays a weighted mix of requests at a fixed concurrency against the lamp
+(or anything serving the same routes) and reports throughput plus
+p50/p99/p999 latency, overall and per endpoint. When the target is the lamp
+itself, /api/stats is reset before and read after the run to show the impact
+on frame timing (render time, longest frame interval, late frames) and on
+request dispatch.
+
+Set-commands change the lamp's output like a user would: each one is a manual
+command, so the first stops a sequence the schedule is running, and the
+values are journaled to flash (coalesced). They are sent with hold=0 so the
+schedule is not held off for the default two hours afterwards. "anim" is not
+in the default mix: every request restarts the animation (local=1 keeps it
+from reaching the other lamps of a LampSync group).
+
+Without a lamp, tools/apihost serves the same routes on the development
+machine (pio run -e native_api, then .pio/build/native_api/program 8080).
+
+Examples:
+  python3 tools/loadtest.py --host aquarium-lamp.local
+  python3 tools/loadtest.py --host 192.168.1.50 --concurrency 8 --duration 30 \
+      --mix state=60,ws1=30,anim=10
+  python3 tools/loadtest.py --host 127.0.0.1 --port 8080
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import json
+import random
+import threading
+import time
+
+# Request kinds selectable in --mix. Callables return a path for each request
+# so set-commands carry varying values like a slider drag does; hold=0 leaves
+# the schedule running afterwards.
+KINDS = {
+    "state": lambda rnd: "/api/state",
+    "ws1": lambda rnd: "/api/ws1/set?b=%d&r=%d&g=%d&b2=%d&hold=0" % (
+        rnd.randrange(256), rnd.randrange(256), rnd.randrange(256), rnd.randrange(256)),
+    "ws2": lambda rnd: "/api/ws2/set?b=%d&r=%d&g=%d&b2=%d&hold=0" % (
+        rnd.randrange(256), rnd.randrange(256), rnd.randrange(256), rnd.randrange(256)),
+    "dim": lambda rnd: "/api/dim/brightness?b=%d&hold=0" % rnd.randrange(256),
+    "anim": lambda rnd: "/api/anim/start?name=%s&dur=60000&local=1&hold=0" % rnd.choice(["waves", "christmas"]),
+    "stats": lambda rnd: "/api/stats",
+}
+
+
+def parse_mix(text):
+    mix = []
+    for part in text.split(","):
+        name, _, weight = part.partition("=")
+        name = name.strip()
+        if name not in KINDS:
+            raise SystemExit("unknown request kind '%s' (choose from %s)" % (name, ", ".join(sorted(KINDS))))
+        mix.append((name, float(weight or 1)))
+    return mix
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float("nan")
+    k = min(len(sorted_values) - 1, max(0, int(round(p / 100.0 * (len(sorted_values) - 1)))))
+    return sorted_values[k]
+
+
+def fetch_json(host, port, path, timeout):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        conn.request("GET", path)
+        resp = conn.getresponse()
+        body = resp.read()
+        return json.loads(body) if resp.status == 200 else None
+    except (OSError, ValueError, http.client.HTTPException):
+        return None
+    finally:
+        conn.close()
+
+
+class Worker(threading.Thread):
+    def __init__(self, args, mix, deadline, seed):
+        super().__init__(daemon=True)
+        self.args = args
+        self.names = [m[0] for m in mix]
+        self.weights = [m[1] for m in mix]
+        self.deadline = deadline
+        self.rnd = random.Random(seed)
+        self.samples = {}  # kind -> list of latency seconds
+        self.errors = {}   # kind -> count
+
+    def run(self):
+        conn = None
+        while time.monotonic() < self.deadline:
+            kind = self.rnd.choices(self.names, self.weights)[0]
+            path = KINDS[kind](self.rnd)
+            if conn is None:
+                conn = http.client.HTTPConnection(self.args.host, self.args.port, timeout=self.args.timeout)
+            start = time.perf_counter()
+            try:
+                conn.request("GET", path, headers={"Connection": "keep-alive"})
+                resp = conn.getresponse()
+                resp.read()
+                ok = resp.status < 400
+                if resp.getheader("Connection", "").lower() == "close":
+                    conn.close()
+                    conn = None
+            except (OSError, http.client.HTTPException):
+                ok = False
+                conn.close()
+                conn = None
+            elapsed = time.perf_counter() - start
+            if ok:
+                self.samples.setdefault(kind, []).append(elapsed)
+            else:
+                self.errors[kind] = self.errors.get(kind, 0) + 1
+            if self.args.think > 0:
+                time.sleep(self.args.think / 1000.0)
+        if conn is not None:
+            conn.close()
+
+
+def report_line(label, values, errors, wall):
+    values = sorted(values)
+    ms = lambda v: v * 1000.0
+    return "%-8s %7d ok %5d err %8.1f req/s   p50 %7.1f ms   p99 %7.1f ms   p999 %7.1f ms   max %7.1f ms" % (
+        label, len(values), errors, len(values) / wall,
+        ms(percentile(values, 50)), ms(percentile(values, 99)),
+        ms(percentile(values, 99.9)), ms(values[-1]) if values else float("nan"))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--host", default="aquarium-lamp.local")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("--concurrency", type=int, default=4, help="parallel clients (default 4)")
+    ap.add_argument("--duration", type=float, default=20.0, help="seconds to run (default 20)")
+    ap.add_argument("--mix", default="state=60,ws1=25,ws2=15",
+                    help="weighted request mix, kinds: %s" % ", ".join(sorted(KINDS)))
+    ap.add_argument("--think", type=float, default=0.0, help="pause per client between requests, ms")
+    ap.add_argument("--timeout", type=float, default=5.0, help="per-request timeout, s")
+    ap.add_argument("--no-device-stats", action="store_true",
+                    help="do not read /api/stats (target is not the lamp)")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+    mix = parse_mix(args.mix)
+
+    if not args.no_device_stats:
+        fetch_json(args.host, args.port, "/api/stats?reset=1", args.timeout)
+
+    deadline = time.monotonic() + args.duration
+    workers = [Worker(args, mix, deadline, args.seed + i) for i in range(args.concurrency)]
+    wall_start = time.monotonic()
+    for w in workers:
+        w.start()
+    for w in workers:
+        w.join()
+    wall = time.monotonic() - wall_start
+
+    all_values, all_errors = [], 0
+    per_kind = {}
+    for w in workers:
+        for kind, values in w.samples.items():
+            per_kind.setdefault(kind, [[], 0])[0].extend(values)
+            all_values.extend(values)
+        for kind, count in w.errors.items():
+            per_kind.setdefault(kind, [[], 0])[1] += count
+            all_errors += count
+
+    print("target %s:%d  concurrency %d  duration %.1f s  mix %s" % (
+        args.host, args.port, args.concurrency, wall, args.mix))
+    print(report_line("all", all_values, all_errors, wall))
+    for kind in sorted(per_kind):
+        print(report_line(kind, per_kind[kind][0], per_kind[kind][1], wall))
+
+    if not args.no_device_stats:
+        stats = fetch_json(args.host, args.port, "/api/stats", args.timeout)
+        if stats is None:
+            print("device stats: unavailable")
+            return
+        frames = stats.get("frames", {})
+        dispatch = stats.get("dispatch", {})
+        print("device frames: %d presented, render avg %s us max %s us, longest interval %s ms, late %s" % (
+            frames.get("frames", 0), frames.get("renderUsAvg"), frames.get("renderUsMax"),
+            frames.get("intervalMsMax"), frames.get("lateFrames")))
+        print("device dispatch: %d requests, lookup avg %s us max %s us, handler avg %s us max %s us" % (
+            dispatch.get("requests", 0), dispatch.get("lookupUsAvg"), dispatch.get("lookupUsMax"),
+            dispatch.get("handlerUsAvg"), dispatch.get("handlerUsMax")))
+        print("device coalescing: writes %s superseded %s" % (stats.get("writes"), stats.get("superseded")))
+
+
+if __name__ == "__main__":
+    main()